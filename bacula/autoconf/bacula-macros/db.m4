@@ -969,6 +969,7 @@ AC_HELP_STRING([--with-postgresql@<:@=DIR@:>@], [Include PostgreSQL support. DIR
 
          AC_CHECK_LIB(pq, PQisthreadsafe, AC_DEFINE(HAVE_PQISTHREADSAFE, 1, [Set if have PQisthreadsafe]))
          AC_CHECK_LIB(pq, PQputCopyData, AC_DEFINE(HAVE_PQ_COPY, 1, [Set if have PQputCopyData]))
+         AC_CHECK_LIB(pq, PQsetSingleRowMode, AC_DEFINE(HAVE_PQ_SINGLE_ROW, 1, [Set if have PQsetSingleRowMode]))
          if test "x$ac_cv_lib_pq_PQputCopyData" = "xyes"; then
              if test $support_batch_insert = yes ; then
                  AC_DEFINE(HAVE_POSTGRESQL_BATCH_FILE_INSERT, 1, [Set if PostgreSQL DB batch insert code enabled])
@@ -434,6 +434,25 @@ void b_memset(const char *file, int line, void *mem, int val, size_t num);
 #define Dmsg13(lvl,msg,a1,a2,a3,a4,a5,a6,a7,a8,a9,a10,a11,a12,a13)
 #endif /* DEBUG */
 
+/**
+ * Tracepoints, the arguments are integers stored in binary and edited
+ * later by the trace writer thread (see lib/tracebuf.c), the format
+ * must use %lld, %llu or %llx
+ */
+#ifdef DEBUG
+#define Tpt0(lvl, msg)                  if (chk_dbglvl(lvl)) tp_msg(__FILE__, __LINE__, lvl, msg, 0, 0, 0, 0)
+#define Tpt1(lvl, msg, a1)              if (chk_dbglvl(lvl)) tp_msg(__FILE__, __LINE__, lvl, msg, (int64_t)(a1), 0, 0, 0)
+#define Tpt2(lvl, msg, a1, a2)          if (chk_dbglvl(lvl)) tp_msg(__FILE__, __LINE__, lvl, msg, (int64_t)(a1), (int64_t)(a2), 0, 0)
+#define Tpt3(lvl, msg, a1, a2, a3)      if (chk_dbglvl(lvl)) tp_msg(__FILE__, __LINE__, lvl, msg, (int64_t)(a1), (int64_t)(a2), (int64_t)(a3), 0)
+#define Tpt4(lvl, msg, a1, a2, a3, a4)  if (chk_dbglvl(lvl)) tp_msg(__FILE__, __LINE__, lvl, msg, (int64_t)(a1), (int64_t)(a2), (int64_t)(a3), (int64_t)(a4))
+#else
+#define Tpt0(lvl, msg)
+#define Tpt1(lvl, msg, a1)
+#define Tpt2(lvl, msg, a1, a2)
+#define Tpt3(lvl, msg, a1, a2, a3)
+#define Tpt4(lvl, msg, a1, a2, a3, a4)
+#endif /* DEBUG */
+
 #ifdef TRACE_FILE
 #define Tmsg0(lvl, msg)             t_msg(__FILE__, __LINE__, lvl, msg)
 #define Tmsg1(lvl, msg, a1)         t_msg(__FILE__, __LINE__, lvl, msg, a1)
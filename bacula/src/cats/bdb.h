@@ -241,6 +241,7 @@ public:
    int bdb_get_client_ids(JCR *jcr, int *num_ids, DBId_t **ids);
    bool bdb_get_media_ids(JCR *jcr, MEDIA_DBR *mr, int *num_ids, uint32_t **ids);
    int  bdb_get_job_volume_parameters(JCR *jcr, JobId_t JobId, VOL_PARAMS **VolParams);
+   int  bdb_get_filemedia_records(JCR *jcr, JobId_t JobId, DBId_t MediaId, uint64_t StartAddr, uint64_t EndAddr, FILEMEDIA_DBR **fm);
    bool bdb_get_counter_record(JCR *jcr, COUNTER_DBR *cr);
    bool bdb_get_query_dbids(JCR *jcr, POOL_MEM &query, dbid_list &ids);
    bool bdb_get_file_list(JCR *jcr, char *jobids,
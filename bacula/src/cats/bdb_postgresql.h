@@ -27,6 +27,8 @@ private:
    PGresult *m_result;
    POOLMEM *m_buf;                /* Buffer to manipulate queries */
 
+   bool sql_stream_query(const char *query, DB_RESULT_HANDLER *result_handler, void *ctx);
+
 public:
    BDB_POSTGRESQL();
    ~BDB_POSTGRESQL();
@@ -20,7 +20,7 @@
 #include "bacula.h"
 #include "cats.h" 
 #if HAVE_SQLITE3 || HAVE_MYSQL || HAVE_POSTGRESQL
-#include "lib/htable.h"
+#include "lib/ohtable.h"
 #include "bvfs.h"
 
 /* from libbacfind */
@@ -231,63 +231,6 @@ int Bvfs::set_jobids(char *ids)
  */
 
 
-/*
- * Working Object to store PathId already seen (avoid
- * database queries), equivalent to %cache_ppathid in perl
- */
-
-#define NITEMS 50000
-class pathid_cache {
-private:
-   hlink *nodes;
-   int nb_node;
-   int max_node;
-
-   alist *table_node;
-
-   htable *cache_ppathid;
-
-public:
-   pathid_cache() {
-      hlink link;
-      cache_ppathid = (htable *)malloc(sizeof(htable));
-      cache_ppathid->init(&link, &link, NITEMS);
-      max_node = NITEMS;
-      nodes = (hlink *) malloc(max_node * sizeof (hlink));
-      nb_node = 0;
-      table_node = New(alist(5, owned_by_alist));
-      table_node->append(nodes);
-   };
-
-   hlink *get_hlink() {
-      if (++nb_node >= max_node) {
-         nb_node = 0;
-         nodes = (hlink *)malloc(max_node * sizeof(hlink));
-         table_node->append(nodes);
-      }
-      return nodes + nb_node;
-   };
-
-   bool lookup(char *pathid) {
-      bool ret = cache_ppathid->lookup(pathid) != NULL;
-      return ret;
-   };
-
-   void insert(char *pathid) {
-      hlink *h = get_hlink();
-      cache_ppathid->insert(pathid, h);
-   };
-
-   ~pathid_cache() {
-      cache_ppathid->destroy();
-      free(cache_ppathid);
-      delete table_node;
-   };
-private:
-   pathid_cache(const pathid_cache &); /* prohibit pass by value */
-   pathid_cache &operator= (const pathid_cache &);/* prohibit class assignment*/
-} ;
-
 /* Return the parent_dir with the trailing /  (update the given string)
  * TODO: see in the rest of bacula if we don't have already this function
  * dir=/tmp/toto/
@@ -348,88 +291,224 @@ char *bvfs_basename_dir(char *path)
    return p;
 }
 
-static void build_path_hierarchy(JCR *jcr, BDB *mdb,
-                                 pathid_cache &ppathid_cache,
-                                 char *org_pathid, char *path)
+/* Temporary table used to compute the parents of a set of directories */
+static const char *create_bvfs_parent_table[] = {
+   /* MySQL */
+   "CREATE TEMPORARY TABLE bvfs_parent (PathId INTEGER, PPath BLOB)",
+   /* PostgreSQL */
+   "CREATE TEMPORARY TABLE bvfs_parent (PathId INTEGER, PPath TEXT)",
+   /* SQLite */
+   "CREATE TEMPORARY TABLE bvfs_parent (PathId INTEGER, PPath TEXT)"
+};
+
+/*
+ * Lock taken with the bvfs_hierarchy_mutex while we create Path and
+ *  PathHierarchy records, it serializes us with the batch insert of the
+ *  Path table by the backup jobs (see batch_lock_path_query). The
+ *  transaction is opened here, bdb_start_transaction() does nothing
+ *  without MultipleConnections and PostgreSQL locks only inside one.
+ */
+static const char *bvfs_lock_hierarchy_query[] = {
+   /* MySQL */
+   NULL,
+   /* PostgreSQL */
+   "BEGIN; LOCK TABLE Path, PathHierarchy IN SHARE ROW EXCLUSIVE MODE",
+   /* SQLite */
+   NULL
+};
+
+static const char *bvfs_unlock_hierarchy_query[] = {
+   /* MySQL */
+   NULL,
+   /* PostgreSQL */
+   "COMMIT",
+   /* SQLite */
+   NULL
+};
+
+/*
+ * Path and PathHierarchy are shared by all jobs, two catalog connections
+ *  that create the same directories at the same time would get unique
+ *  key errors. The records are created and committed by one job at a
+ *  time under this mutex. The directories of a job and their parents,
+ *  the biggest part of the work, are computed before it is taken.
+ */
+static pthread_mutex_t bvfs_hierarchy_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Take the bvfs_hierarchy_mutex and lock the tables */
+static bool bvfs_lock_hierarchy(JCR *jcr, BDB *mdb)
 {
-   Dmsg1(dbglevel, "build_path_hierarchy(%s)\n", path);
-   char pathid[50];
-   ATTR_DBR parent;
-   char *bkp = mdb->path;
-   bstrncpy(pathid, org_pathid, sizeof(pathid));
-
-   /* Does the ppathid exist for this ? we use a memory cache...  In order to
-    * avoid the full loop, we consider that if a dir is allready in the
-    * PathHierarchy table, then there is no need to calculate all the
-    * hierarchy
-    */
-   while (path && *path)
-   {
-      if (!ppathid_cache.lookup(pathid))
-      {
-         Mmsg(mdb->cmd,
-              "SELECT PPathId FROM PathHierarchy WHERE PathId = %s",
-              pathid);
-
-         if (!mdb->QueryDB(jcr, mdb->cmd)) {
-            goto bail_out;      /* Query failed, just leave */
+   const char *lock = bvfs_lock_hierarchy_query[mdb->bdb_get_type_index()];
+
+   P(bvfs_hierarchy_mutex);
+   if (!lock) {
+      mdb->bdb_start_transaction(jcr);
+      return true;
+   }
+   return mdb->QueryDB(jcr, (char *)lock);
+}
+
+/*
+ * Commit the new records, or cancel them after an error, and release
+ *  the lock. Called even if bvfs_lock_hierarchy() failed.
+ */
+static bool bvfs_unlock_hierarchy(JCR *jcr, BDB *mdb, bool ok)
+{
+   const char *unlock = bvfs_unlock_hierarchy_query[mdb->bdb_get_type_index()];
+
+   if (!unlock) {
+      mdb->bdb_end_transaction(jcr);
+   } else if (!mdb->QueryDB(jcr, (char *)(ok ? unlock : "ROLLBACK"))) {
+      ok = false;
+   }
+   V(bvfs_hierarchy_mutex);
+   return ok;
+}
+
+/* Number of rows sent in each multi-rows INSERT to the bvfs_parent table */
+#define BVFS_PARENT_INSERT_ROWS 1000
+
+/*
+ * Build the PathHierarchy of a set of directories with a few set-based
+ *  queries per directory level instead of a lookup per directory.
+ *
+ * The select_query returns the PathId and the Path of directories that
+ *  are not yet in the PathHierarchy table. The parent of each directory is
+ *  computed here and stored in the bvfs_parent table, then the missing
+ *  parents are created in the Path table and the links are inserted with
+ *  a single INSERT ... SELECT. The next level is made of the parents that
+ *  were not yet in the hierarchy, so we stop as soon as we reach a part of
+ *  the tree that was already computed by a previous job.
+ *
+ * The first level, the directories of the job, is computed without the
+ *  lock, the records are created with it, see bvfs_lock_hierarchy().
+ */
+static bool build_path_hierarchy(JCR *jcr, BDB *mdb, const char *select_query)
+{
+   POOL_MEM query, values, path, esc, tmp;
+   alist inserts(100, owned_by_alist);
+   SQL_ROW row;
+   char *ins;
+   int nb, level;
+   bool ret = false;
+   bool locked = false;
+
+   mdb->QueryDB(jcr, (char *)"DROP TABLE IF EXISTS bvfs_parent");
+   if (!mdb->QueryDB(jcr, (char *)create_bvfs_parent_table[mdb->bdb_get_type_index()])) {
+      return false;
+   }
+
+   pm_strcpy(query, select_query);
+   for (level = 0; ; level++) {
+      Dmsg2(dbglevel_sql, "level=%d q=%s\n", level, query.c_str());
+      if (!mdb->QueryDB(jcr, query.c_str())) {
+         goto bail_out;
+      }
+      if (mdb->sql_num_rows() == 0) {
+         break;                 /* The hierarchy is complete */
+      }
+
+      /* We cannot query the catalog while reading the result, so the
+       * INSERT queries are prepared in memory first
+       */
+      nb = 0;
+      while ((row = mdb->sql_fetch_row())) {
+         int len;
+         pm_strcpy(path, row[1]);
+         if (*path.c_str() == 0) {
+            continue;           /* The root has no parent */
+         }
+         bvfs_parent_dir(path.c_str());
+         len = strlen(path.c_str());
+         esc.check_size(len * 2 + 1);
+         mdb->bdb_escape_string(jcr, esc.c_str(), path.c_str(), len);
+         Mmsg(tmp, "%s(%s,'%s')", nb ? "," : "", row[0], esc.c_str());
+         if (nb == 0) {
+            pm_strcpy(values, "INSERT INTO bvfs_parent (PathId, PPath) VALUES ");
+         }
+         pm_strcat(values, tmp.c_str());
+         if (++nb == BVFS_PARENT_INSERT_ROWS) {
+            inserts.append(bstrdup(values.c_str()));
+            nb = 0;
+         }
+      }
+      if (nb > 0) {
+         inserts.append(bstrdup(values.c_str()));
+      }
+      Dmsg2(dbglevel, "level=%d %d insert(s) to compute parents\n", level, inserts.size());
+
+      if (!mdb->QueryDB(jcr, (char *)"DELETE FROM bvfs_parent")) {
+         goto bail_out;
+      }
+      foreach_alist(ins, &inserts) {
+         if (!mdb->QueryDB(jcr, ins)) {
+            goto bail_out;
          }
+      }
+      inserts.destroy();
+      inserts.init(100, owned_by_alist);
 
-         /* Do we have a result ? */
-         if (mdb->sql_num_rows() > 0) {
-            ppathid_cache.insert(pathid);
-            /* This dir was in the db ...
-             * It means we can leave, the tree has allready been built for
-             * this dir
-             */
+      if (!locked) {
+         locked = true;
+         if (!bvfs_lock_hierarchy(jcr, mdb)) {
             goto bail_out;
-         } else {
-            /* search or create parent PathId in Path table */
-            mdb->path = bvfs_parent_dir(path);
-            mdb->pnl = strlen(mdb->path);
-            if (!mdb->bdb_create_path_record(jcr, &parent)) {
-               goto bail_out;
-            }
-            ppathid_cache.insert(pathid);
-
-            Mmsg(mdb->cmd,
-                 "INSERT INTO PathHierarchy (PathId, PPathId) "
-                 "VALUES (%s,%lld)",
-                 pathid, (uint64_t) parent.PathId);
-
-            if (!mdb->InsertDB(jcr, mdb->cmd)) {
-               goto bail_out;   /* Can't insert the record, just leave */
-            }
-
-            edit_uint64(parent.PathId, pathid);
-            path = mdb->path;   /* already done */
          }
-      } else {
-         /* It's already in the cache.  We can leave, no time to waste here,
-          * all the parent dirs have allready been done
-          */
+      }
+
+      /* Create the parents that are not in the Path table */
+      Mmsg(query,
+           "INSERT INTO Path (Path) "
+             "SELECT DISTINCT PPath FROM bvfs_parent AS T "
+              "WHERE NOT EXISTS (SELECT 1 FROM Path WHERE Path.Path = T.PPath)");
+      if (!mdb->QueryDB(jcr, query.c_str())) {
+         goto bail_out;
+      }
+
+      /* Link each directory to its parent, another job may have done
+       * it for the first level since it was computed
+       */
+      Mmsg(query,
+           "INSERT INTO PathHierarchy (PathId, PPathId) "
+             "SELECT T.PathId, Path.PathId "
+               "FROM bvfs_parent AS T JOIN Path ON (Path.Path = T.PPath) "
+              "WHERE NOT EXISTS (SELECT 1 FROM PathHierarchy AS H "
+                                "WHERE H.PathId = T.PathId)");
+      if (!mdb->QueryDB(jcr, query.c_str())) {
          goto bail_out;
       }
+
+      /* Next level, the parents that are not yet in the hierarchy */
+      Mmsg(query,
+           "SELECT DISTINCT Path.PathId, Path.Path "
+             "FROM bvfs_parent AS T JOIN Path ON (Path.Path = T.PPath) "
+                  "LEFT JOIN PathHierarchy AS H ON (H.PathId = Path.PathId) "
+            "WHERE H.PathId IS NULL AND Path.Path <> ''");
    }
+   ret = true;
 
 bail_out:
-   mdb->path = bkp;
-   mdb->fnl = 0;
+   if (locked) {
+      ret = bvfs_unlock_hierarchy(jcr, mdb, ret);
+   }
+   mdb->QueryDB(jcr, (char *)"DROP TABLE IF EXISTS bvfs_parent");
+   return ret;
 }
 
 /*
- * Internal function to update path_hierarchy cache with a shared pathid cache
+ * Internal function to update path_hierarchy cache of a job
+ *  When visibility_filled is set, the PathVisibility records of the
+ *  job were already inserted from the batch table during the backup.
  * return Error 0
  *        OK    1
  */
 static int update_path_hierarchy_cache(JCR *jcr,
                                         BDB *mdb,
-                                        pathid_cache &ppathid_cache,
-                                        JobId_t JobId)
+                                        JobId_t JobId,
+                                        bool visibility_filled)
 {
    Dmsg0(dbglevel, "update_path_hierarchy_cache()\n");
    uint32_t ret=0;
-   uint32_t num;
+   POOL_MEM sel;
    char jobid[50];
    edit_uint64(JobId, jobid);
 
@@ -451,64 +530,48 @@ static int update_path_hierarchy_cache(JCR *jcr,
    }
 
    /* Inserting path records for JobId */
-   Mmsg(mdb->cmd, "INSERT INTO PathVisibility (PathId, JobId) "
-                   "SELECT DISTINCT PathId, JobId "
-                     "FROM (SELECT PathId, JobId FROM File WHERE JobId = %s AND FileIndex > 0 "
-                           "UNION "
-                           "SELECT PathId, BaseFiles.JobId "
-                             "FROM BaseFiles JOIN File AS F USING (FileId) "
-                            "WHERE BaseFiles.JobId = %s) AS B",
-        jobid, jobid);
-
-   if (!mdb->QueryDB(jcr, mdb->cmd)) {
-      Dmsg1(dbglevel, "Can't fill PathVisibility %d\n", (uint32_t)JobId );
-      goto bail_out;
+   if (!visibility_filled) {
+      /* Records can be left by the batch insert or by a previous attempt */
+      Mmsg(mdb->cmd, "DELETE FROM PathVisibility WHERE JobId = %s", jobid);
+      if (!mdb->QueryDB(jcr, mdb->cmd)) {
+         goto bail_out;
+      }
+      Mmsg(mdb->cmd, "INSERT INTO PathVisibility (PathId, JobId) "
+                      "SELECT DISTINCT PathId, JobId "
+                        "FROM (SELECT PathId, JobId FROM File WHERE JobId = %s AND FileIndex > 0 "
+                              "UNION "
+                              "SELECT PathId, BaseFiles.JobId "
+                                "FROM BaseFiles JOIN File AS F USING (FileId) "
+                               "WHERE BaseFiles.JobId = %s) AS B",
+           jobid, jobid);
+
+      if (!mdb->QueryDB(jcr, mdb->cmd)) {
+         Dmsg1(dbglevel, "Can't fill PathVisibility %d\n", (uint32_t)JobId );
+         goto bail_out;
+      }
    }
 
    /* Now we have to do the directory recursion stuff to determine missing
-    * visibility We try to avoid recursion, to be as fast as possible We also
-    * only work on not allready hierarchised directories...
+    * visibility. We only work on not already hierarchised directories,
+    * one directory level at a time.
     */
-   Mmsg(mdb->cmd,
+   Mmsg(sel,
      "SELECT PathVisibility.PathId, Path "
        "FROM PathVisibility "
             "JOIN Path ON( PathVisibility.PathId = Path.PathId) "
             "LEFT JOIN PathHierarchy "
          "ON (PathVisibility.PathId = PathHierarchy.PathId) "
       "WHERE PathVisibility.JobId = %s "
-        "AND PathHierarchy.PathId IS NULL "
-      "ORDER BY Path", jobid);
-   Dmsg1(dbglevel_sql, "q=%s\n", mdb->cmd);
+        "AND PathHierarchy.PathId IS NULL", jobid);
 
-   if (!mdb->QueryDB(jcr, mdb->cmd)) {
-      Dmsg1(dbglevel, "Can't get new Path %d\n", (uint32_t)JobId );
+   mdb->bdb_end_transaction(jcr);
+
+   if (!build_path_hierarchy(jcr, mdb, sel.c_str())) {
+      Dmsg1(dbglevel, "Can't build PathHierarchy %d\n", (uint32_t)JobId );
       goto bail_out;
    }
 
-   /* TODO: I need to reuse the DB connection without emptying the result
-    * So, now i'm copying the result in memory to be able to query the
-    * catalog descriptor again.
-    */
-   num = mdb->sql_num_rows();
-   if (num > 0) {
-      char **result = (char **)malloc (num * 2 * sizeof(char *));
-
-      SQL_ROW row;
-      int i=0;
-      while((row = mdb->sql_fetch_row())) {
-         result[i++] = bstrdup(row[0]);
-         result[i++] = bstrdup(row[1]);
-      }
-
-      i=0;
-      while (num > 0) {
-         build_path_hierarchy(jcr, mdb, ppathid_cache, result[i], result[i+1]);
-         free(result[i++]);
-         free(result[i++]);
-         num--;
-      }
-      free(result);
-   }
+   mdb->bdb_start_transaction(jcr);
 
    if (mdb->bdb_get_type_index() == SQL_TYPE_SQLITE3) {
       Mmsg(mdb->cmd,
@@ -720,9 +783,27 @@ void Bvfs::fv_update_size_and_count(int64_t pathid, int64_t size, int64_t count)
    db->UpdateDB(jcr, db->cmd, false);
 }
 
-void bvfs_update_cache(JCR *jcr, BDB *mdb)
+/* Remove the PathVisibility records of jobs that no longer exist */
+static void bvfs_clean_visibility(JCR *jcr, BDB *mdb)
 {
    uint32_t nb=0;
+
+   mdb->bdb_lock();
+   mdb->bdb_start_transaction(jcr);
+   Dmsg0(dbglevel, "Cleaning pathvisibility\n");
+   Mmsg(mdb->cmd,
+        "DELETE FROM PathVisibility "
+         "WHERE NOT EXISTS "
+        "(SELECT 1 FROM Job WHERE JobId=PathVisibility.JobId)");
+   nb = mdb->DeleteDB(jcr, mdb->cmd);
+   Dmsg1(dbglevel, "Affected row(s) = %d\n", nb);
+
+   mdb->bdb_end_transaction(jcr);
+   mdb->bdb_unlock();
+}
+
+void bvfs_update_cache(JCR *jcr, BDB *mdb)
+{
    db_list_ctx jobids_list;
 
    mdb->bdb_lock();
@@ -776,16 +857,7 @@ void bvfs_update_cache(JCR *jcr, BDB *mdb)
 
    bvfs_update_path_hierarchy_cache(jcr, mdb, jobids_list.list);
 
-   mdb->bdb_start_transaction(jcr);
-   Dmsg0(dbglevel, "Cleaning pathvisibility\n");
-   Mmsg(mdb->cmd,
-        "DELETE FROM PathVisibility "
-         "WHERE NOT EXISTS "
-        "(SELECT 1 FROM Job WHERE JobId=PathVisibility.JobId)");
-   nb = mdb->DeleteDB(jcr, mdb->cmd);
-   Dmsg1(dbglevel, "Affected row(s) = %d\n", nb);
-
-   mdb->bdb_end_transaction(jcr);
+   bvfs_clean_visibility(jcr, mdb);
    mdb->bdb_unlock();
 }
 
@@ -795,7 +867,6 @@ void bvfs_update_cache(JCR *jcr, BDB *mdb)
 int
 bvfs_update_path_hierarchy_cache(JCR *jcr, BDB *mdb, char *jobids)
 {
-   pathid_cache ppathid_cache;
    JobId_t JobId;
    char *p;
    int ret=1;
@@ -810,13 +881,226 @@ bvfs_update_path_hierarchy_cache(JCR *jcr, BDB *mdb, char *jobids)
          break;
       }
       Dmsg1(dbglevel, "Updating cache for %lld\n", (uint64_t)JobId);
-      if (!update_path_hierarchy_cache(jcr, mdb, ppathid_cache, JobId)) {
+      if (!update_path_hierarchy_cache(jcr, mdb, JobId, false)) {
          ret = 0;
       }
    }
    return ret;
 }
 
+/*
+ * Fill the PathVisibility table with the directories of the batch table
+ *  while it still exists, so we don't have to scan the File table of the
+ *  job later. It is called after each flush of the batch table, and the
+ *  hierarchy is computed at the end of the job with
+ *  bvfs_update_job_path_hierarchy_cache().
+ */
+bool bvfs_fill_visibility_from_batch(JCR *jcr, BDB *mdb)
+{
+   bool ret;
+
+   mdb->bdb_lock();
+   mdb->set_use_fatal_jmsg(false);
+
+   /* The batch table can be flushed multiple times during a job */
+   Mmsg(mdb->cmd,
+        "INSERT INTO PathVisibility (PathId, JobId) "
+          "SELECT DISTINCT Path.PathId, batch.JobId "
+            "FROM batch JOIN Path ON (batch.Path = Path.Path) "
+           "WHERE batch.FileIndex > 0 "
+             "AND NOT EXISTS (SELECT 1 FROM PathVisibility AS V "
+                              "WHERE V.JobId = batch.JobId AND V.PathId = Path.PathId)");
+   ret = mdb->QueryDB(jcr, mdb->cmd);
+   if (!ret) {
+      Dmsg1(dbglevel, "Can't fill PathVisibility from batch. ERR=%s\n", mdb->errmsg);
+      /* The cache will be computed later from the File table */
+      Mmsg(mdb->cmd, "DELETE FROM PathVisibility WHERE JobId=%lu", (unsigned long)jcr->JobId);
+      mdb->QueryDB(jcr, mdb->cmd);
+   }
+
+   mdb->set_use_fatal_jmsg(true);
+   mdb->bdb_unlock();
+   return ret;
+}
+
+/*
+ * Compute the PathHierarchy of a job for which the PathVisibility table
+ *  was filled with bvfs_fill_visibility_from_batch(). Only the directories
+ *  that are new for this job are computed.
+ */
+int bvfs_update_job_path_hierarchy_cache(JCR *jcr, BDB *mdb, JobId_t JobId)
+{
+   Dmsg1(dbglevel, "Updating cache from batch for %lld\n", (uint64_t)JobId);
+   return update_path_hierarchy_cache(jcr, mdb, JobId, true);
+}
+
+/*
+ * Background update of the cache with multiple catalog connections.
+ *  The list of jobids is shared by the workers, each of them takes
+ *  the next jobid of the list until the list is empty.
+ */
+static pthread_mutex_t bvfs_update_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bvfs_update_status bvfs_update_st;
+static char *bvfs_update_jobids = NULL;
+static char *bvfs_update_next = NULL;
+
+/* Called with the mutex locked when a worker (or the starter) leaves */
+static void bvfs_update_release()
+{
+   if (--bvfs_update_st.running == 0) {
+      bvfs_update_st.end_time = time(NULL);
+      bfree_and_null(bvfs_update_jobids);
+      bvfs_update_next = NULL;
+   }
+}
+
+static void *bvfs_update_worker(void *arg)
+{
+   BDB *mdb = (BDB *)arg;
+   JobId_t JobId;
+   int stat, ret;
+
+   for (;;) {
+      P(bvfs_update_mutex);
+      stat = get_next_jobid_from_list(&bvfs_update_next, &JobId);
+      V(bvfs_update_mutex);
+
+      if (stat <= 0) {
+         break;
+      }
+      ret = update_path_hierarchy_cache(NULL, mdb, JobId, false);
+
+      P(bvfs_update_mutex);
+      bvfs_update_st.done++;
+      if (!ret) {
+         bvfs_update_st.errors++;
+      }
+      V(bvfs_update_mutex);
+   }
+
+   db_close_database(NULL, mdb);
+
+   P(bvfs_update_mutex);
+   bvfs_update_release();
+   V(bvfs_update_mutex);
+   return NULL;
+}
+
+/*
+ * Update the bvfs cache of the given jobids (or of all jobs without a
+ *  cache if jobids is NULL) with nb_workers catalog connections.
+ *  When background is set, we return as soon as the workers are started,
+ *  the progress can be followed with bvfs_get_update_status().
+ *
+ * Returns the number of workers started, 0 if there is nothing to do,
+ *  -1 if an update is already running or on error.
+ */
+int bvfs_update_cache_parallel(JCR *jcr, BDB *mdb, char *jobids,
+                               int nb_workers, bool background)
+{
+   db_list_ctx lst;
+   pthread_t *tids;
+   uint32_t total = 0;
+   int i, started = 0;
+
+   if (jobids) {
+      lst.add(jobids);
+   } else {
+      mdb->bdb_lock();
+      Mmsg(mdb->cmd,
+ "SELECT JobId from Job "
+  "WHERE HasCache = 0 "
+    "AND Type IN ('B') AND JobStatus IN ('T', 'f', 'A') "
+  "ORDER BY JobId");
+      mdb->bdb_sql_query(mdb->cmd, db_list_handler, &lst);
+      mdb->bdb_unlock();
+   }
+   for (char *p = lst.list; *p ; p++) {
+      if (*p == ',') {
+         total++;
+      }
+   }
+   if (*lst.list) {
+      total++;
+   }
+
+   P(bvfs_update_mutex);
+   if (bvfs_update_st.running > 0) {
+      V(bvfs_update_mutex);
+      Mmsg(mdb->errmsg, _("A BVFS cache update is already running.\n"));
+      return -1;
+   }
+   memset(&bvfs_update_st, 0, sizeof(bvfs_update_st));
+   bvfs_update_st.running = 1;  /* Keep the list until all workers are started */
+   bvfs_update_st.total = total;
+   bvfs_update_st.start_time = time(NULL);
+   bvfs_update_jobids = bstrdup(lst.list);
+   bvfs_update_next = bvfs_update_jobids;
+   V(bvfs_update_mutex);
+
+   /* SQLite doesn't like concurrent writers */
+   if (nb_workers < 1 || mdb->bdb_get_type_index() == SQL_TYPE_SQLITE3) {
+      nb_workers = 1;
+   }
+   if ((uint32_t)nb_workers > total) {
+      nb_workers = total;
+   }
+
+   tids = (pthread_t *)malloc((nb_workers + 1) * sizeof(pthread_t));
+   for (i = 0; i < nb_workers; i++) {
+      BDB *db = mdb->bdb_clone_database_connection(jcr, true);
+      if (!db || !db_open_database(jcr, db)) {
+         Mmsg(mdb->errmsg, _("Could not open a new catalog connection. ERR=%s\n"),
+              db ? db->bdb_strerror() : "");
+         if (db) {
+            db_close_database(jcr, db);
+         }
+         break;
+      }
+      P(bvfs_update_mutex);
+      bvfs_update_st.running++;
+      V(bvfs_update_mutex);
+      if (pthread_create(&tids[started], NULL, bvfs_update_worker, (void *)db) != 0) {
+         P(bvfs_update_mutex);
+         bvfs_update_st.running--;
+         V(bvfs_update_mutex);
+         db_close_database(jcr, db);
+         break;
+      }
+      started++;
+   }
+
+   P(bvfs_update_mutex);
+   bvfs_update_st.workers = started;
+   bvfs_update_release();
+   V(bvfs_update_mutex);
+
+   for (i = 0; i < started; i++) {
+      if (background) {
+         pthread_detach(tids[i]);
+      } else {
+         pthread_join(tids[i], NULL);
+      }
+   }
+   free(tids);
+
+   if (total > 0 && started == 0) {
+      return -1;
+   }
+   if (!background) {
+      bvfs_clean_visibility(jcr, mdb);
+   }
+   return started;
+}
+
+/* Get a copy of the progress of the last bvfs_update_cache_parallel() */
+void bvfs_get_update_status(bvfs_update_status *st)
+{
+   P(bvfs_update_mutex);
+   memcpy(st, &bvfs_update_st, sizeof(bvfs_update_status));
+   V(bvfs_update_mutex);
+}
+
 /*
  * Update the bvfs fileview for given jobids
  */
@@ -1383,7 +1667,6 @@ bool Bvfs::drop_restore_list(char *output_table)
 }
 
 struct hardlink {
-   hlink lnk;
    uint32_t jobid;
    int32_t  fileindex;
 };
@@ -1448,7 +1731,7 @@ bool Bvfs::insert_hardlinks(char *output_table)
    POOL_MEM query, tmp1, tmp2;
    int nb=0;
 
-   hardlinks = New(htable(hl, &hl->lnk));
+   hardlinks = New(ohtable(hl, NULL));
    missing_hardlinks = New(alist(100, not_owned_by_alist));
    Dmsg0(dbglevel, "Inserting hardlinks method=standard\n");
 
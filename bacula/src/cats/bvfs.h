@@ -326,7 +326,7 @@ private:
    alist *pool_acl;
    char  *last_dir_acl;
 
-   htable *hardlinks;           /* Check if we already saw a given hardlink */
+   ohtable *hardlinks;          /* Check if we already saw a given hardlink */
    alist  *missing_hardlinks;   /* list with all the missing jobid/fileindex1 */
 
    ATTR *attr;                /* Can be use by handler to call decode_stat() */
@@ -362,9 +362,25 @@ private:
 #define bvfs_is_volume_list(row) ((row)[BVFS_Type][0] == BVFS_VOLUME_LIST)
 #define bvfs_is_delta_list(row) ((row)[BVFS_Type][0] == BVFS_DELTA_RECORD)
 
+/* Progress of the cache update done by bvfs_update_cache_parallel() */
+struct bvfs_update_status {
+   int      running;            /* number of workers still running */
+   int      workers;            /* number of workers started */
+   uint32_t total;              /* number of jobs to process */
+   uint32_t done;               /* number of jobs processed */
+   uint32_t errors;             /* number of jobs in error */
+   time_t   start_time;
+   time_t   end_time;           /* 0 while running */
+};
+
 void bvfs_update_fv_cache(JCR *jcr, BDB *mdb, char *jobids);
 int bvfs_update_path_hierarchy_cache(JCR *jcr, BDB *mdb, char *jobids);
 void bvfs_update_cache(JCR *jcr, BDB *mdb);
+int bvfs_update_cache_parallel(JCR *jcr, BDB *mdb, char *jobids,
+                               int nb_workers, bool background);
+void bvfs_get_update_status(bvfs_update_status *st);
+bool bvfs_fill_visibility_from_batch(JCR *jcr, BDB *mdb);
+int bvfs_update_job_path_hierarchy_cache(JCR *jcr, BDB *mdb, JobId_t JobId);
 char *bvfs_parent_dir(char *path);
 
 /* Return the basename of the with the trailing /  (update the given string)
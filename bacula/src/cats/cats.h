@@ -218,6 +218,7 @@ struct VOL_PARAMS {
    uint64_t StartAddr;                /* Start address */
    uint64_t EndAddr;                  /* End address */
    int32_t InChanger;                 /* InChanger flag */
+   DBId_t MediaId;                    /* MediaId */
 };
 
 
@@ -55,6 +55,9 @@
 #define dbglvl_info  DT_SQL|50
 #define dbglvl_err   DT_SQL|10
 
+/* Maximum number of rows fetched at once by the cursor of a big query */
+#define BIG_QUERY_MAX_FETCH  10000
+
 /* -----------------------------------------------------------------------
  *
  *   PostgreSQL dependent defines and subroutines
@@ -575,18 +578,112 @@ void BDB_POSTGRESQL::bdb_end_transaction(JCR *jcr)
 }
 
 
+#ifdef HAVE_PQ_SINGLE_ROW
+/*
+ * Send a SELECT and give each row to the result_handler as soon as
+ *  libpq has received it (single row mode). The result set is never
+ *  materialized and there is no round-trip per batch of rows. When
+ *  the handler asks to stop, the query is canceled on the server,
+ *  except inside a transaction that the cancel would abort, the
+ *  rest of the rows is then read and dropped.
+ *
+ * Called with the bdb lock held.
+ */
+bool BDB_POSTGRESQL::sql_stream_query(const char *query,
+                                      DB_RESULT_HANDLER *result_handler,
+                                      void *ctx)
+{
+   BDB_POSTGRESQL *mdb = this;
+   PGresult *res;
+   int nfields, ntuples;
+   uint64_t nrows = 0;
+   bool retval = true;
+   bool stop = false;
+
+   if (mdb->m_result) {
+      PQclear(mdb->m_result);
+      mdb->m_result = NULL;
+   }
+   if (!PQsendQuery(mdb->m_db_handle, query)) {
+      Mmsg(mdb->errmsg, _("Query failed: %s: ERR=%s\n"), query, sql_strerror());
+      Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
+      return false;
+   }
+   if (!PQsetSingleRowMode(mdb->m_db_handle)) {
+      /* Still correct, the result is returned in one piece */
+      Dmsg0(dbglvl_err, "Could not set the single row mode\n");
+   }
+
+   /* PQgetResult() must be called until NULL, even after an error */
+   while ((res = PQgetResult(mdb->m_db_handle)) != NULL) {
+      switch (PQresultStatus(res)) {
+      case PGRES_SINGLE_TUPLE:
+      case PGRES_TUPLES_OK:     /* last one, empty in single row mode */
+         nfields = PQnfields(res);
+         ntuples = PQntuples(res);
+         if (ntuples > 0 && (!mdb->m_rows || mdb->m_rows_size < nfields)) {
+            if (mdb->m_rows) {
+               free(mdb->m_rows);
+            }
+            mdb->m_rows = (SQL_ROW)malloc(sizeof(char *) * nfields);
+            mdb->m_rows_size = nfields;
+         }
+         for (int i = 0; !stop && i < ntuples; i++) {
+            for (int j = 0; j < nfields; j++) {
+               mdb->m_rows[j] = PQgetvalue(res, i, j);
+            }
+            nrows++;
+            if (result_handler(ctx, nfields, mdb->m_rows)) {
+               stop = true;
+            }
+         }
+         if (stop && !mdb->m_transaction &&
+             PQresultStatus(res) == PGRES_SINGLE_TUPLE) {
+            /* Do not read the rest of the result */
+            char errbuf[256];
+            PGcancel *cancel = PQgetCancel(mdb->m_db_handle);
+            if (cancel) {
+               PQcancel(cancel, errbuf, sizeof(errbuf));
+               PQfreeCancel(cancel);
+            }
+         }
+         break;
+      default:
+         if (!stop) {             /* a canceled query ends with an error */
+            Mmsg(mdb->errmsg, _("Query failed: %s: ERR=%s\n"), query,
+                 PQresultErrorMessage(res));
+            Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
+            retval = false;
+         }
+         break;
+      }
+      PQclear(res);
+   }
+   Dmsg1(dbglvl_info, "sql_stream_query finished with %lld rows\n", nrows);
+   return retval;
+}
+#endif
+
 /*
  * Submit a general SQL command, and for each row returned,
  *  the result_handler is called with the ctx.
+ *
+ * With a recent libpq, the rows are streamed with the single row
+ *  mode. Otherwise a cursor is used, the number of rows fetched at
+ *  once grows up to BIG_QUERY_MAX_FETCH.
  */
 bool BDB_POSTGRESQL::bdb_big_sql_query(const char *query,
                                        DB_RESULT_HANDLER *result_handler,
                                        void *ctx)
 {
    BDB_POSTGRESQL *mdb = this;
-   SQL_ROW row; 
    bool retval = false; 
+#ifndef HAVE_PQ_SINGLE_ROW
+   SQL_ROW row; 
    bool in_transaction = mdb->m_transaction;
+   int fetch = 100;
+   bool stop = false;
+#endif
 
    Dmsg1(dbglvl_info, "db_sql_query starts with '%s'\n", query);
 
@@ -602,6 +699,12 @@ bool BDB_POSTGRESQL::bdb_big_sql_query(const char *query,
 
    bdb_lock();
 
+#ifdef HAVE_PQ_SINGLE_ROW
+   retval = sql_stream_query(query, result_handler, ctx);
+   Dmsg0(dbglvl_info, "db_big_sql_query finished\n");
+   bdb_unlock();
+   return retval;
+#else
    if (!in_transaction) {       /* CURSOR needs transaction */
       sql_query("BEGIN");
    }
@@ -615,20 +718,24 @@ bool BDB_POSTGRESQL::bdb_big_sql_query(const char *query,
    }
 
    do {
-      if (!sql_query("FETCH 100 FROM _bac_cursor")) {
+      Mmsg(m_buf, "FETCH %d FROM _bac_cursor", fetch);
+      if (!sql_query(m_buf)) {
          Mmsg(mdb->errmsg, _("Fetch failed: ERR=%s\n"), sql_strerror());
          Dmsg1(dbglvl_err, "%s\n", mdb->errmsg);
          goto get_out;
       }
-      while ((row = sql_fetch_row()) != NULL) {
+      while (!stop && (row = sql_fetch_row()) != NULL) {
          Dmsg1(dbglvl_info, "Fetching %d rows\n", mdb->m_num_rows);
-         if (result_handler(ctx, mdb->m_num_fields, row))
-            break;
+         if (result_handler(ctx, mdb->m_num_fields, row)) {
+            stop = true;
+         }
       }
       PQclear(mdb->m_result);
       m_result = NULL;
+      /* Fewer round-trips for big result sets */
+      fetch = MIN(fetch * 2, BIG_QUERY_MAX_FETCH);
 
-   } while (m_num_rows > 0);    /* TODO: Can probably test against 100 */
+   } while (!stop && m_num_rows > 0);
 
    sql_query("CLOSE _bac_cursor");
 
@@ -643,6 +750,7 @@ get_out:
 
    bdb_unlock();
    return retval;
+#endif
 }
 
 /* 
@@ -236,6 +236,8 @@ void bdb_free_restoreobject_record(JCR *jcr, ROBJECT_DBR *rr);
            mdb->bdb_get_media_ids(jcr, mr, num_ids, ids)
 #define db_get_job_volume_parameters(jcr, mdb, JobId, VolParams) \
            mdb->bdb_get_job_volume_parameters(jcr, JobId, VolParams)
+#define db_get_filemedia_records(jcr, mdb, JobId, MediaId, saddr, eaddr, fm) \
+           mdb->bdb_get_filemedia_records(jcr, JobId, MediaId, saddr, eaddr, fm)
 #define db_get_counter_record(jcr, mdb, cr) \
            mdb->bdb_get_counter_record(jcr, cr)
 #define db_get_query_dbids(jcr, mdb, query, ids) \
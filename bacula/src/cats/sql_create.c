@@ -30,6 +30,7 @@ static const int dbglevel = 100;
 #if HAVE_SQLITE3 || HAVE_MYSQL || HAVE_POSTGRESQL
  
 #include  "cats.h"
+#include  "bvfs.h"
 
 /* -----------------------------------------------------------------------
  *
@@ -895,6 +896,13 @@ bool bdb_write_batch_file_records(JCR *jcr)
       goto bail_out; 
    }
 
+   /* Feed the BVFS cache while the batch table is still there */
+   if (jcr->bvfs_batch_cache && !jcr->HasBase) {
+      if (!bvfs_fill_visibility_from_batch(jcr, jcr->db_batch)) {
+         jcr->bvfs_batch_cache = false; /* will be done later from File */
+      }
+   }
+
    jcr->JobStatus = JobStatus;    /* reset entry status */
    retval = true; 
  
@@ -1050,6 +1058,7 @@ bool BDB::bdb_create_attributes_record(JCR *jcr, ATTR_DBR *ar)
          ret = bdb_create_batch_file_attributes_record(jcr, ar);
          /* Error message already printed */
       } else { 
+         jcr->bvfs_batch_cache = false; /* the cache needs the batch table */
          ret = bdb_create_file_attributes_record(jcr, ar);
       } 
    } else if (jcr->HasBase) {
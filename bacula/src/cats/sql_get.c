@@ -420,7 +420,7 @@ int BDB::bdb_get_job_volume_parameters(JCR *jcr, JobId_t JobId, VOL_PARAMS **Vol
    Mmsg(cmd,
 "SELECT VolumeName,MediaType,FirstIndex,LastIndex,StartFile,"
 "JobMedia.EndFile,StartBlock,JobMedia.EndBlock,"
-"Slot,StorageId,InChanger"
+"Slot,StorageId,InChanger,JobMedia.MediaId"
 " FROM JobMedia,Media WHERE JobMedia.JobId=%s"
 " AND JobMedia.MediaId=Media.MediaId ORDER BY VolIndex,JobMediaId",
         edit_int64(JobId, ed1));
@@ -460,6 +460,7 @@ int BDB::bdb_get_job_volume_parameters(JCR *jcr, JobId_t JobId, VOL_PARAMS **Vol
                Vols[i].Slot = str_to_uint64(row[8]);
                StorageId = str_to_uint64(row[9]);
                Vols[i].InChanger = str_to_uint64(row[10]);
+               Vols[i].MediaId = str_to_uint64(row[11]);
                Vols[i].Storage[0] = 0;
                SId[i] = StorageId;
             }
@@ -486,6 +487,60 @@ int BDB::bdb_get_job_volume_parameters(JCR *jcr, JobId_t JobId, VOL_PARAMS **Vol
 }
 
 
+/**
+ * Get the FileMedia records of a Job written on a given Volume
+ *  between two addresses, ordered by address on the Volume.
+ *
+ *  Returns: -1 on error
+ *           number of FileMedia records found (malloced structure!)
+ */
+int BDB::bdb_get_filemedia_records(JCR *jcr, JobId_t JobId, DBId_t MediaId,
+                                   uint64_t StartAddr, uint64_t EndAddr,
+                                   FILEMEDIA_DBR **fm)
+{
+   SQL_ROW row;
+   char ed1[50], ed2[50], ed3[50], ed4[50];
+   int stat = -1;
+   FILEMEDIA_DBR *fms;
+
+   *fm = NULL;
+   bdb_lock();
+   Mmsg(cmd,
+"SELECT FileIndex,BlockAddress,RecordNo,FileOffset FROM FileMedia"
+" WHERE JobId=%s AND MediaId=%s AND BlockAddress>=%s AND BlockAddress<=%s"
+" ORDER BY BlockAddress,RecordNo",
+        edit_int64(JobId, ed1), edit_int64(MediaId, ed2),
+        edit_uint64(StartAddr, ed3), edit_uint64(EndAddr, ed4));
+
+   Dmsg1(130, "FileMedia=%s\n", cmd);
+   if (QueryDB(jcr, cmd)) {
+      stat = sql_num_rows();
+      if (stat > 0) {
+         *fm = fms = (FILEMEDIA_DBR *)malloc(stat * sizeof(FILEMEDIA_DBR));
+         for (int i=0; i < stat; i++) {
+            if ((row = sql_fetch_row()) == NULL) {
+               Mmsg2(errmsg, _("Error fetching row %d: ERR=%s\n"), i, sql_strerror());
+               Jmsg(jcr, M_ERROR, 0, "%s", errmsg);
+               free(fms);
+               *fm = NULL;
+               stat = -1;
+               break;
+            }
+            fms[i].JobId = JobId;
+            fms[i].MediaId = MediaId;
+            fms[i].FileIndex = str_to_uint64(row[0]);
+            fms[i].BlockAddress = str_to_uint64(row[1]);
+            fms[i].RecordNo = str_to_uint64(row[2]);
+            fms[i].FileOffset = str_to_uint64(row[3]);
+         }
+      }
+      sql_free_result();
+   }
+   bdb_unlock();
+   return stat;
+}
+
+
 /**
  * Get JobMedia record
  *  Returns: false on error or no JobMedia found
@@ -34,6 +34,7 @@
 #include "bacula.h"
 #include "dird.h"
 #include "ua.h"
+#include "cats/bvfs.h"
 
 
 /* Commands sent to File daemon */
@@ -107,6 +108,9 @@ bool do_backup_init(JCR *jcr)
      return do_vbackup_init(jcr);
    }
 
+   /* PathVisibility records are inserted from the batch table */
+   jcr->bvfs_batch_cache = jcr->job->UpdateBvfsCache;
+
    jcr->store_mngr->reset_rstorage();
 
    /* If pool storage specified, use it instead of job storage */
@@ -228,6 +232,7 @@ static bool is_checksum_needed_by_fileset(JCR *jcr)
             case '1':           /* SHA1 */
             case '2':           /* SHA256 */
             case '3':           /* SHA512 */
+            case '4':           /* XXH64 */
                if (in_block) {
                   Dmsg0(50, "Checksum will be sent to FD\n");
                   return true;
@@ -749,6 +754,12 @@ bool do_backup(JCR *jcr)
    }
 
    if (!jcr->is_canceled() && stat == JS_Terminated) {
+      if (jcr->bvfs_batch_cache && !jcr->HasBase) {
+         /* Only the new directories of the job have to be computed */
+         if (!bvfs_update_job_path_hierarchy_cache(jcr, jcr->db, jcr->JobId)) {
+            Jmsg(jcr, M_WARNING, 0, _("Unable to update the BVFS cache.\n"));
+         }
+      }
       backup_cleanup(jcr, stat);
       return true;
    }
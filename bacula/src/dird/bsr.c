@@ -342,16 +342,167 @@ void display_bsr_info(UAContext *ua, RESTORE_CTX &rx)
    return;
 }
 
+/*
+ * Write one bsr section for a part of a JobMedia record
+ */
+static uint32_t write_bsr_section(RBSR *bsr, VOL_PARAMS *vp, FILE *fd,
+                   uint64_t StartAddr, uint64_t EndAddr,
+                   int32_t FirstIndex, int32_t LastIndex)
+{
+   char ed1[50], ed2[50];
+   uint32_t count;
+   char device[MAX_NAME_LENGTH];
+
+   if (strcmp(vp->Storage, "") != 0) {
+      fprintf(fd, "Storage=\"%s\"\n", vp->Storage);
+   }
+   fprintf(fd, "Volume=\"%s\"\n", vp->VolumeName);
+   fprintf(fd, "MediaType=\"%s\"\n", vp->MediaType);
+   if (bsr->fileregex) {
+      fprintf(fd, "FileRegex=%s\n", bsr->fileregex);
+   }
+   if (get_storage_device(device, vp->Storage)) {
+      fprintf(fd, "Device=\"%s\"\n", device);
+   }
+   if (vp->Slot > 0) {
+      fprintf(fd, "Slot=%d\n", vp->Slot);
+   }
+   fprintf(fd, "VolSessionId=%u\n", bsr->VolSessionId);
+   fprintf(fd, "VolSessionTime=%u\n", bsr->VolSessionTime);
+   fprintf(fd, "VolAddr=%s-%s\n", edit_uint64(StartAddr, ed1),
+           edit_uint64(EndAddr, ed2));
+   Dmsg2(100, "bsr VolParam FI=%u LI=%u\n", FirstIndex, LastIndex);
+
+   count = write_findex(bsr->fi_list, FirstIndex, LastIndex, fd);
+   if (count) {
+      fprintf(fd, "Count=%u\n", count);
+   }
+   return count;
+}
+
+/*
+ * Write a bsr section for a range of selected files and update the totals
+ *  like write_bsr_item() does for a complete JobMedia record.
+ */
+static void write_bsr_range(RBSR *bsr, VOL_PARAMS *vp, FILE *fd,
+                   uint64_t StartAddr, uint64_t EndAddr,
+                   int32_t FirstIndex, int32_t LastIndex,
+                   bool &first, uint32_t &LastWritten, uint32_t &total_count)
+{
+   total_count += write_bsr_section(bsr, vp, fd, StartAddr, EndAddr,
+                                    FirstIndex, LastIndex);
+   /* The first file may be the continuation of the previous section */
+   if (!first && LastWritten == (uint32_t)FirstIndex) {
+      total_count--;
+   }
+   first = false;
+   LastWritten = LastIndex;
+}
+
+/*
+ * Use the FileMedia records written by the Storage Daemon to
+ *  split a JobMedia record into the Volume address ranges that
+ *  really contain the selected files. Each range gets its own
+ *  bsr section so that the SD can position directly on it.
+ *
+ *  Returns: false if there is no FileMedia record for this part
+ *             of the Volume, nothing is written in that case.
+ */
+static bool write_bsr_filemedia(RBSR *bsr, UAContext *ua, VOL_PARAMS *vp,
+                   FILE *fd, bool &first, uint32_t &LastIndex,
+                   uint32_t &total_count)
+{
+   FILEMEDIA_DBR *fm = NULL;
+   RBSR_FINDEX *fi, *next_fi;
+   int nb, j = 0, k = 0, n;
+   int32_t lo = 0, hi = 0;
+   uint64_t saddr = 0, eaddr = 0;
+   uint64_t s = vp->StartAddr;
+
+   if (!ua->db || vp->MediaId == 0) {
+      return false;
+   }
+   nb = db_get_filemedia_records(ua->jcr, ua->db, bsr->JobId, vp->MediaId,
+                                 vp->StartAddr, vp->EndAddr, &fm);
+   if (nb <= 0) {
+      return false;
+   }
+
+   fi = (RBSR_FINDEX *)bsr->fi_list->first();
+   while (fi) {
+      int32_t findex = fi->findex;
+      int32_t findex2 = fi->findex2;
+      uint64_t e = vp->EndAddr;
+
+      /* Merge contiguous groups, see write_findex() */
+      for (next_fi = (RBSR_FINDEX *)bsr->fi_list->next(fi);
+           next_fi && next_fi->findex == (findex2+1);
+           next_fi = (RBSR_FINDEX *)bsr->fi_list->next(next_fi)) {
+         findex2 = next_fi->findex2;
+      }
+      fi = next_fi;
+
+      if (findex2 < (int32_t)vp->FirstIndex || findex > (int32_t)vp->LastIndex) {
+         continue;
+      }
+      findex = MAX(findex, (int32_t)vp->FirstIndex);
+      findex2 = MIN(findex2, (int32_t)vp->LastIndex);
+
+      /*
+       * The first file starts after the last index written before it,
+       *  and the last file ends in the block where the next file starts.
+       *  FileIndexes are in address order, so j and k only move forward.
+       */
+      while (j < nb && ((int32_t)fm[j].FileIndex < findex ||
+                        ((int32_t)fm[j].FileIndex == findex && fm[j].FileOffset == 0))) {
+         s = fm[j].BlockAddress;
+         j++;
+      }
+      k = MAX(k, j);
+      while (k < nb && (int32_t)fm[k].FileIndex <= findex2) {
+         k++;
+      }
+      /*
+       * The block of the next index also holds the end of our last file.
+       *  The address of a record is the one of the last byte of its block,
+       *  so stop just before the next block we know of.
+       */
+      for (n = k; n < nb; n++) {
+         if (fm[n].BlockAddress > fm[k].BlockAddress) {
+            e = fm[n].BlockAddress - 1;
+            break;
+         }
+      }
+      if (lo && s <= eaddr) {
+         eaddr = MAX(eaddr, e); /* Overlap with the current range, extend it */
+         hi = findex2;
+         continue;
+      }
+      if (lo) {
+         write_bsr_range(bsr, vp, fd, saddr, eaddr, lo, hi, first, LastIndex,
+                         total_count);
+      }
+      lo = findex;
+      hi = findex2;
+      saddr = s;
+      eaddr = e;
+   }
+   if (lo) {
+      write_bsr_range(bsr, vp, fd, saddr, eaddr, lo, hi, first, LastIndex,
+                      total_count);
+   }
+   free(fm);
+   return true;
+}
+
 /*
  * Write bsr data for a single bsr record
  */
 static uint32_t write_bsr_item(RBSR *bsr, UAContext *ua,
                    RESTORE_CTX &rx, FILE *fd, bool &first, uint32_t &LastIndex)
 {
-   char ed1[50], ed2[50];
    uint32_t count = 0;
    uint32_t total_count = 0;
-   char device[MAX_NAME_LENGTH];
 
    /*
     * For a given volume, loop over all the JobMedia records.
@@ -367,32 +518,15 @@ static uint32_t write_bsr_item(RBSR *bsr, UAContext *ua,
          find_storage_resource(ua, rx, bsr->VolParams[i].Storage,
                                        bsr->VolParams[i].MediaType);
       }
-      if (strcmp(bsr->VolParams[i].Storage, "") != 0) {
-         fprintf(fd, "Storage=\"%s\"\n", bsr->VolParams[i].Storage);
-      }
-      fprintf(fd, "Volume=\"%s\"\n", bsr->VolParams[i].VolumeName);
-      fprintf(fd, "MediaType=\"%s\"\n", bsr->VolParams[i].MediaType);
-      if (bsr->fileregex) {
-         fprintf(fd, "FileRegex=%s\n", bsr->fileregex);
-      }
-      if (get_storage_device(device, bsr->VolParams[i].Storage)) {
-         fprintf(fd, "Device=\"%s\"\n", device);
-      }
-      if (bsr->VolParams[i].Slot > 0) {
-         fprintf(fd, "Slot=%d\n", bsr->VolParams[i].Slot);
-      }
-      fprintf(fd, "VolSessionId=%u\n", bsr->VolSessionId);
-      fprintf(fd, "VolSessionTime=%u\n", bsr->VolSessionTime);
-      fprintf(fd, "VolAddr=%s-%s\n", edit_uint64(bsr->VolParams[i].StartAddr, ed1),
-              edit_uint64(bsr->VolParams[i].EndAddr, ed2));
-      Dmsg2(100, "bsr VolParam FI=%u LI=%u\n",
-            bsr->VolParams[i].FirstIndex, bsr->VolParams[i].LastIndex);
-
-      count = write_findex(bsr->fi_list, bsr->VolParams[i].FirstIndex,
-                           bsr->VolParams[i].LastIndex, fd);
-      if (count) {
-         fprintf(fd, "Count=%u\n", count);
+      if (write_bsr_filemedia(bsr, ua, &bsr->VolParams[i], fd, first,
+                              LastIndex, total_count)) {
+         continue;
       }
+      count = write_bsr_section(bsr, &bsr->VolParams[i], fd,
+                                bsr->VolParams[i].StartAddr,
+                                bsr->VolParams[i].EndAddr,
+                                bsr->VolParams[i].FirstIndex,
+                                bsr->VolParams[i].LastIndex);
       total_count += count;
       /* If the same file is present on two tapes or in two files
        *   on a tape, it is a continuation, and should not be treated
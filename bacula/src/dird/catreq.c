@@ -432,7 +432,7 @@ void catalog_request(JCR *jcr, BSOCK *bs)
       db_lock(jcr->db);
       db_start_transaction(jcr, jcr->db);
       while (bs->recv() >= 0) {
-         if (ok && sscanf(bs->msg, "%llu %lu %llu %lu %llu\n",
+         if (ok && sscanf(bs->msg, "%llu %u %llu %u %llu\n",
                           &MediaId, &fm.FileIndex,
                           &fm.BlockAddress, &fm.RecordNo,
                           &fm.FileOffset) != 5)
@@ -442,7 +442,7 @@ void catalog_request(JCR *jcr, BSOCK *bs)
          }
          if (ok) {
             fm.MediaId = MediaId;
-            fm.JobId = jcr->JobId;
+            fm.JobId = jm.JobId;
             Dmsg6(50, "create_filemedia JobId=%lu MediaId=%lu FI=%lu address=%llu:%u offset=%llu\n",
                   fm.JobId, fm.MediaId, fm.FileIndex, fm.BlockAddress, fm.RecordNo, fm.FileOffset);
             ok = db_create_filemedia_record(jcr, jcr->db, &fm);
@@ -704,6 +704,10 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
          len = CRYPTO_DIGEST_SHA512_SIZE;
          type = CRYPTO_DIGEST_SHA512;
          break;
+      case STREAM_XXH64_DIGEST:
+         len = CRYPTO_DIGEST_XXH64_SIZE;
+         type = CRYPTO_DIGEST_XXH64;
+         break;
       default:
          /* Never reached ... */
          Jmsg(jcr, M_ERROR, 0, _("Catalog error updating file digest. Unsupported digest stream type: %d"),
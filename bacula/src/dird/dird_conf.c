@@ -382,6 +382,9 @@ static RES_ITEM dir_items[] = {
    {"MaximumConcurrentJobs", store_pint32, ITEM(res_dir.MaxConcurrentJobs), 0, ITEM_DEFAULT, 20},
    {"MaximumReloadRequests", store_pint32, ITEM(res_dir.MaxReload), 0, ITEM_DEFAULT, 32},
    {"MaximumConsoleConnections", store_pint32, ITEM(res_dir.MaxConsoleConnect), 0, ITEM_DEFAULT, 20},
+   {"PruneWorkers", store_pint32, ITEM(res_dir.PruneWorkers), 0, ITEM_DEFAULT, 0},
+   {"PruneChunkSize", store_pint32, ITEM(res_dir.PruneChunkSize), 0, ITEM_DEFAULT, 50000},
+   {"MaximumPruneRate", store_pint32, ITEM(res_dir.MaxPruneRate), 0, ITEM_DEFAULT, 0},
    {"Password",    store_password, ITEM(res_dir.password), 0, ITEM_REQUIRED, 0},
    {"FdConnectTimeout", store_time,ITEM(res_dir.FDConnectTimeout), 0, ITEM_DEFAULT, 3 * 60},
    {"SdConnectTimeout", store_time,ITEM(res_dir.SDConnectTimeout), 0, ITEM_DEFAULT, 30 * 60},
@@ -675,6 +678,7 @@ RES_ITEM job_items[] = {
    {"CancelQueuedDuplicates",  store_bool, ITEM(res_job.CancelQueuedDuplicates), 0, ITEM_DEFAULT, false},
    {"CancelRunningDuplicates", store_bool, ITEM(res_job.CancelRunningDuplicates), 0, ITEM_DEFAULT, false},
    {"DeleteConsolidatedJobs",  store_bool, ITEM(res_job.DeleteConsolidatedJobs), 0, ITEM_DEFAULT, false},
+   {"UpdateBvfsCache",  store_bool, ITEM(res_job.UpdateBvfsCache), 0, ITEM_DEFAULT, false},
    {"PluginOptions", store_str, ITEM(res_job.PluginOptions), 0, 0, 0},
    {"Base", store_alist_res, ITEM(res_job.base),  R_JOB, 0, 0},
    {"Tag",         store_alist_str, ITEM(res_job.tag), 0, 0, 0},
@@ -108,6 +108,9 @@ public:
    uint32_t MaxSpawnedJobs;           /* Max Jobs that can be started by Migration/Copy */
    uint32_t MaxConsoleConnect;        /* Max concurrent console session */
    uint32_t MaxReload;                /* Maximum reload requests */
+   uint32_t PruneWorkers;             /* Background File pruning threads */
+   uint32_t PruneChunkSize;           /* File records deleted per statement */
+   uint32_t MaxPruneRate;             /* File records deleted per second */
    utime_t FDConnectTimeout;          /* timeout for connect in seconds */
    utime_t SDConnectTimeout;          /* timeout in seconds */
    utime_t heartbeat_interval;        /* Interval to send heartbeats */
@@ -518,6 +521,7 @@ public:
    bool CancelRunningDuplicates;      /* Cancel Running jobs */
    bool PurgeMigrateJob;              /* Purges source job on completion */
    bool DeleteConsolidatedJobs;       /* Delete or not consolidated Virtual Full jobs */
+   bool UpdateBvfsCache;              /* Build the BVFS cache at the end of the job */
 
    alist *tag;                        /* tags defined for this Job */
    alist *base;                       /* Base jobs */
@@ -505,6 +505,7 @@ static bool send_fileset(JCR *jcr)
             bool enhanced_wild = false;
             bool stripped_opts = false;
             bool compress_disabled = false;
+            bool xxh64_disabled = false;
             char newopts[MAX_FOPTS];
 
             for (k=0; fo->opts[k]!='\0'; k++) {
@@ -518,9 +519,13 @@ static bool send_fileset(JCR *jcr)
              * Strip out compression option Zn if disallowed
              *  for this Storage.
              * Strip out dedup option dn if old FD
+             * Replace XXH64 signature S4 by MD5 if old FD, it would
+             *  read SHA1 followed by an unknown option
              */
             bool strip_compress = store && !store->AllowCompress;
-            if (strip_compress || jcr->FDVersion >= 11) {
+            bool strip_xxh64 = jcr->FDVersion < 15 || jcr->FDVersion == 213 ||
+                               jcr->FDVersion == 214;
+            if (strip_compress || strip_xxh64 || jcr->FDVersion >= 11) {
                int j = 0;
                for (k=0; fo->opts[k]!='\0'; k++) {
                   /* Z compress option is followed by the single-digit compress level or 'o' */
@@ -531,6 +536,12 @@ static bool send_fileset(JCR *jcr)
                   } else if (jcr->FDVersion < 11 && fo->opts[k]=='d') {
                      stripped_opts = true;
                      k++;              /* skip level */
+                  } else if (strip_xxh64 && fo->opts[k]=='S' && fo->opts[k+1]=='4') {
+                     stripped_opts = true;
+                     xxh64_disabled = true;
+                     newopts[j] = 'M';
+                     j++;
+                     k++;              /* skip digest type */
                   } else {
                      newopts[j] = fo->opts[k];
                      j++;
@@ -541,6 +552,10 @@ static bool send_fileset(JCR *jcr)
                   Jmsg(jcr, M_INFO, 0,
                       _("FD compression disabled for this Job because AllowCompression=No in Storage resource.\n") );
                }
+               if (xxh64_disabled) {
+                  Jmsg(jcr, M_WARNING, 0,
+                      _("Client does not support the XXH64 signature, using MD5 for this Job.\n"));
+               }
             }
             if (stripped_opts) {
                /* Send the new trimmed option set without overwriting fo->opts */
@@ -191,6 +191,7 @@ struct s_fs_opt FS_options[] = {
    {"Sha256",   INC_KW_DIGEST,       "S2"},
    {"Sha512",   INC_KW_DIGEST,       "S3"},
    {"Sha1",     INC_KW_DIGEST,        "S"},
+   {"Xxh64",    INC_KW_DIGEST,       "S4"},
    {"Gzip",     INC_KW_COMPRESSION,  "Z6"},
    {"Gzip1",    INC_KW_COMPRESSION,  "Z1"},
    {"Gzip2",    INC_KW_COMPRESSION,  "Z2"},
@@ -273,11 +274,11 @@ static void scan_include_options(LEX *lc, int keyword, char *opts, int optlen)
    /* Check if the options are correct */
    switch(keyword) {
    case INC_KW_VERIFY:
-      fs_options = "ipnugsamcd5123:V"; /* From dird/verify.c */
+      fs_options = "ipnugsamcd51234:V"; /* From dird/verify.c */
       break;
    case INC_KW_BASEJOB:
    case INC_KW_ACCURATE:
-      fs_options = "oipnugsamMcdA5123:JC"; /* From filed/accurate.c accurate_check_file() */
+      fs_options = "oipnugsamMcdA51234:JC"; /* From filed/accurate.c accurate_check_file() */
       break;
    default:
       break;
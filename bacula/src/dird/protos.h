@@ -335,6 +335,10 @@ int file_delete_handler(void *ctx, int num_fields, char **row);
 int get_prune_list_for_volume(UAContext *ua, MEDIA_DBR *mr, del_ctx *del);
 int exclude_running_jobs_from_list(del_ctx *prune_list);
 
+/* prune_engine.c */
+int delete_file_records(JCR *jcr, BDB *db, char *jobs, bool background);
+void prune_background_cmd(UAContext *ua);
+
 /* ua_purge.c */
 bool is_volume_purged(UAContext *ua, MEDIA_DBR *mr, bool force=false);
 bool mark_media_purged(UAContext *ua, MEDIA_DBR *mr);
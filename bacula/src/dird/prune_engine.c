@@ -0,0 +1,495 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *
+ *   Bacula Director -- Chunked deletion of File records
+ *
+ *  The File table is by far the biggest table of the catalog. Deleting
+ *  the File records of a large list of jobs with a single statement fills
+ *  the transaction log and keeps the catalog locked for a long time.
+ *
+ *  Here the File records are deleted job by job in FileId ranges of
+ *  PruneChunkSize rows (the FileIds of a job are mostly contiguous), small
+ *  jobs are grouped in a single statement, and the deletion can be
+ *  throttled to MaximumPruneRate records per second.
+ *
+ *  When PruneWorkers is set in the Director resource, the File pruning is
+ *  done in the background by worker threads using their own catalog
+ *  connection, and a job is marked PurgedFiles only once all its File
+ *  records are gone. The Job record stays, so if the Director stops
+ *  before the end, the jobs are selected again by the next pruning.
+ *  When the Job record itself is deleted, the File records are always
+ *  deleted first by the caller. The background work can be followed,
+ *  suspended and resumed with the "prune background" command.
+ *
+ */
+
+#include "bacula.h"
+#include "dird.h"
+
+static const int dbglvl = 100;
+
+/* Number of jobs handled by a background worker between two updates */
+#define PRUNE_JOBS_PER_BATCH 100
+
+/* Parameters of a deletion, copied from the Director resource */
+struct prune_params {
+   uint32_t chunk;              /* Max FileId range per DELETE statement */
+   uint32_t rate;               /* Max records deleted per second, 0 = no limit */
+};
+
+/* A list of jobs to clean in the background */
+struct prune_task {
+   dlink link;
+   JobId_t *JobId;              /* Sorted list of JobIds */
+   int num_ids;                 /* Number of JobIds */
+   int next;                    /* Next JobId to process */
+   int running;                 /* Workers attached to this task */
+   prune_params p;
+};
+
+/* Progress of the background engine */
+static struct {
+   bool paused;
+   int workers;                 /* Running worker threads */
+   uint32_t queued;             /* Jobs not yet processed */
+   uint32_t done;               /* Jobs processed */
+   uint32_t errors;             /* Jobs with an error */
+   uint64_t deleted;            /* File records deleted */
+   time_t start_time;           /* Start of the current activity */
+   time_t last_time;            /* Last deletion */
+} prune_st;
+
+static pthread_mutex_t prune_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prune_cond = PTHREAD_COND_INITIALIZER;
+static dlist *prune_tasks = NULL;
+
+static int jobid_cmp(const void *a, const void *b)
+{
+   JobId_t j1 = *(JobId_t *)a;
+   JobId_t j2 = *(JobId_t *)b;
+   return (j1 > j2) - (j1 < j2);
+}
+
+static int file_range_handler(void *ctx, int num_fields, char **row)
+{
+   int64_t *range = (int64_t *)ctx;
+   if (row[0] && row[1]) {
+      range[0] = str_to_int64(row[0]);
+      range[1] = str_to_int64(row[1]);
+   }
+   return 0;
+}
+
+/* Sleep enough to stay under the given number of records per second */
+static void prune_throttle(btime_t start, uint64_t deleted, uint32_t rate)
+{
+   btime_t wait;
+
+   if (rate == 0) {
+      return;
+   }
+   wait = (btime_t)(deleted * 1000000 / rate) - (get_current_btime() - start);
+   if (wait > 0) {
+      bmicrosleep(wait / 1000000, wait % 1000000);
+   }
+}
+
+/* Wait here while the background engine is paused */
+static void prune_wait_if_paused()
+{
+   struct timespec timeout;
+
+   P(prune_mutex);
+   while (prune_st.paused) {
+      timeout.tv_sec = time(NULL) + 30;
+      timeout.tv_nsec = 0;
+      pthread_cond_timedwait(&prune_cond, &prune_mutex, &timeout);
+   }
+   V(prune_mutex);
+}
+
+static void prune_account(uint64_t deleted)
+{
+   P(prune_mutex);
+   prune_st.deleted += deleted;
+   prune_st.last_time = time(NULL);
+   V(prune_mutex);
+}
+
+static int64_t prune_delete(JCR *jcr, BDB *db, POOLMEM *query)
+{
+   int64_t ret;
+
+   Dmsg1(dbglvl, "Delete File sql=%s\n", query);
+   db_lock(db);
+   ret = db->DeleteDB(jcr, query);
+   db_unlock(db);
+   return ret;
+}
+
+/*
+ * Delete the File records of a list of JobIds.
+ *  The jobs that fit in a chunk are grouped in a single statement, the
+ *  others are deleted by FileId ranges.
+ *
+ *  Returns: false on error
+ */
+static bool delete_file_records_from_ids(JCR *jcr, BDB *db, JobId_t *ids,
+                                         int num_ids, prune_params *p,
+                                         bool background)
+{
+   POOL_MEM query(PM_MESSAGE), small(PM_MESSAGE);
+   char ed1[50], ed2[50], ed3[50];
+   int64_t range[2], lo, ret;
+   uint64_t deleted = 0, small_span = 0;
+   btime_t start = get_current_btime();
+   bool ok = true;
+
+   for (int i = 0; i < num_ids && ok; i++) {
+      range[0] = range[1] = 0;
+      Mmsg(query, "SELECT MIN(FileId), MAX(FileId) FROM File WHERE JobId=%s",
+           edit_uint64(ids[i], ed1));
+      if (!db_sql_query(db, query.c_str(), file_range_handler, range)) {
+         ok = false;
+         break;
+      }
+      if (range[1] == 0) {
+         continue;              /* No File record */
+      }
+
+      if (range[1] - range[0] < (int64_t)p->chunk) {
+         /* Small job, will be deleted with the next group */
+         if (*small.c_str()) {
+            pm_strcat(small, ",");
+         }
+         pm_strcat(small, ed1);
+         small_span += range[1] - range[0] + 1;
+         if (small_span < p->chunk && i < num_ids - 1) {
+            continue;
+         }
+         if (background) {
+            prune_wait_if_paused();
+         }
+         Mmsg(query, "DELETE FROM File WHERE JobId IN (%s)", small.c_str());
+         if ((ret = prune_delete(jcr, db, query.c_str())) < 0) {
+            ok = false;
+            break;
+         }
+         pm_strcpy(small, "");
+         small_span = 0;
+         deleted += ret;
+         if (background) {
+            prune_account(ret);
+         }
+         prune_throttle(start, deleted, p->rate);
+         continue;
+      }
+
+      for (lo = range[0]; lo <= range[1]; lo += p->chunk) {
+         if (background) {
+            prune_wait_if_paused();
+         }
+         Mmsg(query, "DELETE FROM File WHERE JobId=%s AND FileId>=%s AND FileId<%s",
+              ed1, edit_int64(lo, ed2), edit_int64(lo + p->chunk, ed3));
+         if ((ret = prune_delete(jcr, db, query.c_str())) < 0) {
+            ok = false;
+            break;
+         }
+         deleted += ret;
+         if (background) {
+            prune_account(ret);
+         }
+         prune_throttle(start, deleted, p->rate);
+      }
+   }
+
+   /* The last group, if the last job was a big one */
+   if (ok && *small.c_str()) {
+      Mmsg(query, "DELETE FROM File WHERE JobId IN (%s)", small.c_str());
+      if ((ret = prune_delete(jcr, db, query.c_str())) < 0) {
+         ok = false;
+      } else if (background) {
+         prune_account(ret);
+      }
+   }
+   return ok;
+}
+
+/* Remove a task from the list, called with the mutex locked */
+static void prune_task_release(prune_task *task)
+{
+   if (--task->running == 0) {
+      prune_tasks->remove(task);
+      free(task->JobId);
+      free(task);
+   }
+}
+
+/* Argument of a worker thread */
+struct prune_worker_arg {
+   prune_task *task;
+   BDB *db;                     /* Connection of the worker */
+};
+
+static void *prune_worker(void *arg)
+{
+   prune_task *task = ((prune_worker_arg *)arg)->task;
+   BDB *db = ((prune_worker_arg *)arg)->db;
+   POOL_MEM query(PM_MESSAGE);
+   char ed1[50];
+   int first, num;
+   bool ok;
+
+   free(arg);
+   pthread_detach(pthread_self());
+
+   for (;;) {
+      P(prune_mutex);
+      first = task->next;
+      num = MIN(PRUNE_JOBS_PER_BATCH, task->num_ids - first);
+      task->next += num;
+      V(prune_mutex);
+
+      if (num <= 0) {
+         break;
+      }
+      ok = delete_file_records_from_ids(NULL, db, task->JobId + first, num,
+                                        &task->p, true);
+      if (ok) {
+         pm_strcpy(query, "UPDATE Job SET PurgedFiles=1 WHERE JobId IN (");
+         for (int i = 0; i < num; i++) {
+            if (i > 0) {
+               pm_strcat(query, ",");
+            }
+            pm_strcat(query, edit_uint64(task->JobId[first + i], ed1));
+         }
+         pm_strcat(query, ")");
+         ok = db_sql_query(db, query.c_str(), NULL, NULL);
+      }
+      if (!ok) {
+         Dmsg1(dbglvl, "Background prune error: %s", db_strerror(db));
+      }
+
+      P(prune_mutex);
+      prune_st.queued -= num;
+      prune_st.done += num;
+      if (!ok) {
+         prune_st.errors += num;
+      }
+      V(prune_mutex);
+   }
+
+   db_close_database(NULL, db);
+
+   P(prune_mutex);
+   prune_st.workers--;
+   prune_task_release(task);
+   V(prune_mutex);
+   return NULL;
+}
+
+/* Check if a JobId is already handled by the engine, mutex locked */
+static bool prune_is_queued(JobId_t JobId)
+{
+   prune_task *task;
+
+   foreach_dlist(task, prune_tasks) {
+      if (bsearch(&JobId, task->JobId, task->num_ids, sizeof(JobId_t), jobid_cmp)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/*
+ * Give a list of JobIds to the background workers
+ *  Returns: false if the workers cannot be started
+ */
+static bool prune_queue_jobs(JCR *jcr, BDB *db, JobId_t *ids, int num_ids,
+                             prune_params *p, int max_workers)
+{
+   prune_task *task;
+   int nb_workers, started = 0;
+   pthread_t tid;
+
+   qsort(ids, num_ids, sizeof(JobId_t), jobid_cmp);
+
+   task = (prune_task *)malloc(sizeof(prune_task));
+   memset(task, 0, sizeof(prune_task));
+   task->JobId = (JobId_t *)malloc(num_ids * sizeof(JobId_t));
+   task->p = *p;
+   task->running = 1;           /* Our reference until the workers are started */
+
+   P(prune_mutex);
+   if (!prune_tasks) {
+      prune_tasks = New(dlist(task, &task->link));
+   }
+   for (int i = 0; i < num_ids; i++) {
+      if (!prune_is_queued(ids[i])) {
+         task->JobId[task->num_ids++] = ids[i];
+      }
+   }
+   if (task->num_ids == 0) {
+      V(prune_mutex);
+      free(task->JobId);
+      free(task);
+      return true;
+   }
+   if (prune_st.workers == 0 && prune_st.queued == 0) {
+      prune_st.start_time = time(NULL);
+   }
+   prune_st.queued += task->num_ids;
+   prune_tasks->append(task);
+
+   /* Share the workers with the tasks already running, but start at least one */
+   nb_workers = MAX(1, max_workers - prune_st.workers);
+   nb_workers = MIN(nb_workers, (task->num_ids + PRUNE_JOBS_PER_BATCH - 1) / PRUNE_JOBS_PER_BATCH);
+   V(prune_mutex);
+
+   for (int i = 0; i < nb_workers; i++) {
+      prune_worker_arg *arg;
+      BDB *wdb = db->bdb_clone_database_connection(jcr, true);
+      if (!wdb || !db_open_database(jcr, wdb)) {
+         Dmsg1(dbglvl, "Could not open a new catalog connection. ERR=%s\n",
+               wdb ? wdb->bdb_strerror() : "");
+         if (wdb) {
+            db_close_database(jcr, wdb);
+         }
+         break;
+      }
+      arg = (prune_worker_arg *)malloc(sizeof(prune_worker_arg));
+      arg->task = task;
+      arg->db = wdb;
+      P(prune_mutex);
+      task->running++;
+      prune_st.workers++;
+      V(prune_mutex);
+      if (pthread_create(&tid, NULL, prune_worker, (void *)arg) != 0) {
+         free(arg);
+         db_close_database(jcr, wdb);
+         P(prune_mutex);
+         task->running--;
+         prune_st.workers--;
+         V(prune_mutex);
+         break;
+      }
+      started++;
+   }
+
+   P(prune_mutex);
+   if (started == 0) {
+      /* Nothing will process these jobs, forget them */
+      prune_st.queued -= task->num_ids;
+      task->num_ids = 0;
+   }
+   prune_task_release(task);
+   V(prune_mutex);
+   return started > 0;
+}
+
+/*
+ * Delete the File records of a list of jobs ("1,2,3") in bounded batches.
+ *  With background set, the jobs can be given to the background workers,
+ *  the caller must then keep the Job records.
+ *
+ *  Returns: 1 if the records are deleted and the jobs can be marked
+ *             PurgedFiles by the caller,
+ *           0 if the jobs were given to the background workers,
+ *          -1 on error.
+ */
+int delete_file_records(JCR *jcr, BDB *db, char *jobs, bool background)
+{
+   prune_params p;
+   JobId_t *ids;
+   JobId_t JobId;
+   int num_ids = 0, max_ids = 1, workers, stat;
+   char *q;
+   bool ret;
+
+   LockRes();
+   p.chunk = director->PruneChunkSize;
+   p.rate = director->MaxPruneRate;
+   workers = director->PruneWorkers;
+   UnlockRes();
+   if (p.chunk == 0) {
+      p.chunk = 1;
+   }
+
+   for (q = jobs; *q; q++) {
+      if (*q == ',') {
+         max_ids++;
+      }
+   }
+   ids = (JobId_t *)malloc(max_ids * sizeof(JobId_t));
+   q = jobs;
+   while ((stat = get_next_jobid_from_list(&q, &JobId)) > 0 && num_ids < max_ids) {
+      if (JobId > 0) {
+         ids[num_ids++] = JobId;
+      }
+   }
+
+   /* SQLite doesn't like concurrent writers */
+   if (background && workers > 0 && num_ids > 0 &&
+       db->bdb_get_type_index() != SQL_TYPE_SQLITE3) {
+      if (prune_queue_jobs(jcr, db, ids, num_ids, &p, workers)) {
+         Dmsg1(dbglvl, "Jobs %s given to the background prune engine\n", jobs);
+         free(ids);
+         return 0;
+      }
+      /* Fall back to the direct deletion */
+   }
+
+   ret = delete_file_records_from_ids(jcr, db, ids, num_ids, &p, false);
+   free(ids);
+   return ret ? 1 : -1;
+}
+
+/*
+ * Status and control of the background deletion
+ *
+ *   prune background [status|pause|resume]
+ */
+void prune_background_cmd(UAContext *ua)
+{
+   char ed1[50], ed2[50], dt[MAX_TIME_LENGTH];
+   utime_t elapsed;
+
+   P(prune_mutex);
+   if (find_arg(ua, NT_("pause")) > 0) {
+      prune_st.paused = true;
+   } else if (find_arg(ua, NT_("resume")) > 0) {
+      prune_st.paused = false;
+      pthread_cond_broadcast(&prune_cond);
+   }
+
+   ua->send_msg(_("Background pruning: %s workers=%d queued=%u done=%u errors=%u\n"),
+                prune_st.paused ? _("paused") :
+                   (prune_st.workers > 0 ? _("running") : _("idle")),
+                prune_st.workers, prune_st.queued, prune_st.done, prune_st.errors);
+   if (prune_st.start_time > 0) {
+      elapsed = (prune_st.last_time > prune_st.start_time) ?
+         prune_st.last_time - prune_st.start_time : 1;
+      bstrftime_nc(dt, sizeof(dt), prune_st.start_time);
+      ua->send_msg(_(" Started %s, %s File records deleted (%s/s)\n"), dt,
+                   edit_uint64_with_commas(prune_st.deleted, ed1),
+                   edit_uint64_with_commas(prune_st.deleted / elapsed, ed2));
+   }
+   V(prune_mutex);
+}
@@ -155,7 +155,8 @@ static struct cmdstruct commands[] = {                                      /* C
 
  { NT_("prune"),      prunecmd,      _("Prune expired records from catalog"),
    NT_("files | jobs | snapshot  [client=<client-name>] | client=<client-name> | \n"
-       "\t[expired] [all | allpools | allfrompool] [pool=<pool>] [mediatype=<type>] volume=<volume-name> [yes]"),
+       "\t[expired] [all | allpools | allfrompool] [pool=<pool>] [mediatype=<type>] volume=<volume-name> [yes] |\n"
+       "\tbackground [pause | resume]"),
    true},
 
  { NT_("purge"),      purge_cmd,     _("Purge records from catalog"), NT_("files [client=<cli> jobid=<id>] | jobs [client=<cli> name=<jobname>] | volume=<vol> [mediatype=<type> pool=<pool> allpools storage=<st> drive=<num>]"),  true},
@@ -196,7 +197,7 @@ static struct cmdstruct commands[] = {                                      /* C
 
  { NT_("stop"),       cancel_cmd,    _("Stop a job"), NT_("jobid=<number-list> job=<job-name> ujobid=<unique-jobid> all"), false},
  { NT_("setdebug"),   setdebug_cmd,  _("Sets debug level"),
-   NT_("level=<nn> trace=0/1 options=<0tTc> tags=<tags> | client=<client-name> | dir | storage=<storage-name> | all"), true},
+   NT_("level=<nn> trace=0/1 options=<0tTcaA> tags=<tags> | client=<client-name> | dir | storage=<storage-name> | all"), true},
 
  { NT_("setbandwidth"),   setbwlimit_cmd,  _("Sets bandwidth"),
    NT_("limit=<speed> client=<client-name> jobid=<number> job=<job-name> ujobid=<unique-jobid>"), true},
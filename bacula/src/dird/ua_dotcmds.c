@@ -364,17 +364,62 @@ static bool dot_bvfs_decode_lstat(UAContext *ua, const char *cmd)
    return true;
 }
 
+/*
+ * .bvfs_update [jobid=1,2,3] [workers=4 [background]]
+ * .bvfs_update status
+ *
+ * With workers, the PathVisibility records and the directories of the
+ *  jobs are computed in parallel, the new Path and PathHierarchy records
+ *  are still created by one worker at a time.
+ */
 static bool dot_bvfs_update(UAContext *ua, const char *cmd)
 {
+   char *jobids = NULL;
+   int workers = 0;
+   int ret;
+
+   if (find_arg(ua, "status") > 0) {
+      bvfs_update_status st;
+      bvfs_get_update_status(&st);
+      ua->send_msg("running=%d workers=%d total=%lu done=%lu errors=%lu "
+                   "start_time=%lld end_time=%lld\n",
+                   st.running, st.workers, (unsigned long)st.total,
+                   (unsigned long)st.done, (unsigned long)st.errors,
+                   (int64_t)st.start_time, (int64_t)st.end_time);
+      return true;
+   }
+
    if (!open_new_client_db(ua)) {
       return 1;
    }
 
    int pos = find_arg_with_value(ua, "jobid");
    if (pos != -1 && is_a_number_list(ua->argv[pos])) {
-      if (!bvfs_update_path_hierarchy_cache(ua->jcr, ua->db, ua->argv[pos])) {
-         ua->error_msg("ERROR: BVFS reported a problem for %s\n",
-                       ua->argv[pos]);
+      jobids = ua->argv[pos];
+   }
+   pos = find_arg_with_value(ua, "workers");
+   if (pos != -1 && is_a_number(ua->argv[pos])) {
+      workers = str_to_int64(ua->argv[pos]);
+   }
+
+   if (workers > 0) {
+      /* Each worker has its own catalog connection */
+      bool background = find_arg(ua, "background") > 0;
+      ret = bvfs_update_cache_parallel(ua->jcr, ua->db, jobids, workers,
+                                       background);
+      if (ret < 0) {
+         ua->error_msg("ERROR: BVFS reported a problem. %s", db_strerror(ua->db));
+      } else if (!background) {
+         bvfs_update_status st;
+         bvfs_get_update_status(&st);
+         if (st.errors > 0) {
+            ua->error_msg("ERROR: BVFS reported a problem for %lu job(s)\n",
+                          (unsigned long)st.errors);
+         }
+      }
+   } else if (jobids) {
+      if (!bvfs_update_path_hierarchy_cache(ua->jcr, ua->db, jobids)) {
+         ua->error_msg("ERROR: BVFS reported a problem for %s\n", jobids);
       }
    } else {
       /* update cache for all jobids */
@@ -212,6 +212,7 @@ static int prune_events(UAContext *ua, int retention)
  *    prune jobs (from) client=xxx [pool=yyy]
  *    prune volume=xxx
  *    prune stats
+ *    prune background [pause|resume]
  */
 int prunecmd(UAContext *ua, const char *cmd)
 {
@@ -230,6 +231,7 @@ int prunecmd(UAContext *ua, const char *cmd)
       NT_("Stats"),
       NT_("Snapshots"),
       NT_("Events"),
+      NT_("Background"),
       NULL};
 
    if (!open_new_client_db(ua)) {
@@ -238,7 +240,7 @@ int prunecmd(UAContext *ua, const char *cmd)
 
    /* First search args */
    kw = find_arg_keyword(ua, keywords);
-   if (kw < 0 || kw > 5) {
+   if (kw < 0 || kw > 6) {
       /* no args, so ask user */
       kw = do_keyword_prompt(ua, _("Choose item to prune"), keywords);
    }
@@ -322,6 +324,9 @@ int prunecmd(UAContext *ua, const char *cmd)
       retention = dir->events_retention;
       prune_events(ua, retention);
       return true;
+   case 6:  /* background File deletion status */
+      prune_background_cmd(ua);
+      return true;
    default:
       break;
    }
@@ -34,6 +34,7 @@
 /* Forward referenced functions */
 static int purge_files_from_client(UAContext *ua, CLIENT *client);
 static int purge_jobs_from_client(UAContext *ua, CLIENT *client, char *job);
+static int do_purge_files_from_jobs(UAContext *ua, char *jobs, bool background);
 int truncate_cmd(UAContext *ua, const char *cmd);
 
 static const char *select_jobsfiles_from_client =
@@ -358,16 +359,32 @@ static int purge_jobs_from_client(UAContext *ua, CLIENT *client, char* job)
  * Remove File records from a list of JobIds. Jobs must be secured.
  */
 void purge_files_from_jobs(UAContext *ua, char *jobs)
+{
+   do_purge_files_from_jobs(ua, jobs, true);
+}
+
+/*
+ * Delete the File records and the records that go with them. With
+ *  background set, the File records may be deleted later by the
+ *  background workers, and the Job records must stay.
+ *
+ * Returns: 1 if the File records are deleted, 0 if they are given to
+ *  the background workers, -1 on error.
+ */
+static int do_purge_files_from_jobs(UAContext *ua, char *jobs, bool background)
 {
    POOL_MEM query(PM_MESSAGE);
+   int deleted;
 
    Mmsg(query, "DELETE FROM TagJob WHERE JobId IN (%s)", jobs);
    db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
    Dmsg1(050, "Delete TagJob sql=%s\n", query.c_str());
 
-   Mmsg(query, "DELETE FROM File WHERE JobId IN (%s)", jobs);
-   db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
-   Dmsg1(050, "Delete File sql=%s\n", query.c_str());
+   /* File records are deleted by chunks, maybe in the background */
+   deleted = delete_file_records(ua->jcr, ua->db, jobs, background);
+   if (deleted < 0) {
+      return deleted;           /* Keep the other records, we will try again */
+   }
 
    Mmsg(query, "DELETE FROM FileMedia WHERE JobId IN (%s)", jobs);
    db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
@@ -386,10 +403,15 @@ void purge_files_from_jobs(UAContext *ua, char *jobs)
     * avoid having too many Jobs to process in future prunings. If
     * we don't do this, the number of JobId's in our in memory list
     * could grow very large.
+    * When the File records are deleted in the background, the
+    * workers will do it when they are done.
     */
-   Mmsg(query, "UPDATE Job SET PurgedFiles=1 WHERE JobId IN (%s)", jobs);
-   db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
-   Dmsg1(050, "Mark purged sql=%s\n", query.c_str());
+   if (deleted > 0) {
+      Mmsg(query, "UPDATE Job SET PurgedFiles=1 WHERE JobId IN (%s)", jobs);
+      db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
+      Dmsg1(050, "Mark purged sql=%s\n", query.c_str());
+   }
+   return deleted;
 }
 
 /*
@@ -515,8 +537,14 @@ void purge_jobs_from_catalog(UAContext *ua, char *jobs)
    /* Keep track of this important event */
    ua->send_events("DC0002", EVENTS_TYPE_COMMAND, "purge jobid=%s", jobs);
 
-   /* Delete (or purge) records associated with the job */
-   purge_files_from_jobs(ua, jobs);
+   /* Delete (or purge) records associated with the job. The File records
+    * must be gone before the Job record, nothing would select them after.
+    */
+   if (do_purge_files_from_jobs(ua, jobs, false) < 0) {
+      ua->error_msg(_("Unable to delete the File records of JobId(s) %s. ERR=%s"),
+                    jobs, db_strerror(ua->db));
+      return;
+   }
 
    Mmsg(query, "DELETE FROM JobMedia WHERE JobId IN (%s)", jobs);
    db_sql_query(ua->db, query.c_str(), NULL, (void *)NULL);
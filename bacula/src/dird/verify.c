@@ -807,6 +807,9 @@ void get_attributes_and_compare_to_catalog(JCR *jcr, JobId_t JobId)
             case '3':                 /* compare SHA512 */
                do_Digest = CRYPTO_DIGEST_SHA512;
                break;
+            case '4':                 /* compare XXH64 */
+               do_Digest = CRYPTO_DIGEST_XXH64;
+               break;
             case ':':
             case 'V':
             default:
@@ -24,7 +24,6 @@
 static int dbglvl=100;
 
 typedef struct PrivateCurFile {
-   hlink link;
    char *fname;
    char *lstat;
    char *chksum;
@@ -58,6 +57,32 @@ static bool accurate_mark_file_as_seen(JCR *jcr, CurFile *elt)
    return true;
 }
 
+/*
+ * Mark as seen the files of the top directory for which changed() is
+ *  false, used when the list of the changed files comes from the change
+ *  journal. The other files are marked when they are found.
+ */
+void accurate_mark_tree_as_seen(JCR *jcr, char *top,
+                                bool changed(void *ctx, char *fname), void *ctx)
+{
+   CurFile *elt;
+   int len = strlen(top);
+
+   if (!jcr->accurate || !jcr->file_list) {
+      return;
+   }
+   while (len > 0 && IsPathSeparator(top[len - 1])) {
+      len--;                    /* "/" matches everything */
+   }
+   foreach_htable(elt, jcr->file_list) {
+      if (strncmp(elt->fname, top, len) == 0 &&
+          (elt->fname[len] == 0 || IsPathSeparator(elt->fname[len])) &&
+          !changed(ctx, elt->fname)) {
+         elt->seen = 1;
+      }
+   }
+}
+
 static bool accurate_lookup(JCR *jcr, char *fname, CurFile *ret)
 {
    bool found=false;
@@ -76,8 +101,8 @@ static bool accurate_lookup(JCR *jcr, char *fname, CurFile *ret)
 static bool accurate_init(JCR *jcr, int nbfile)
 {
    CurFile *elt = NULL;
-   jcr->file_list = (htable *)malloc(sizeof(htable));
-   jcr->file_list->init(elt, &elt->link, nbfile);
+   jcr->file_list = (ohtable *)malloc(sizeof(ohtable));
+   jcr->file_list->init(elt, NULL, nbfile);
    return true;
 }
 
@@ -377,7 +402,7 @@ static int check_checksum_diff(JCR *jcr, FF_PKT *ff_pkt, CurFile *elt)
     */
    if (ff_pkt->type != FT_LNKSAVED &&
          (S_ISREG(ff_pkt->statp.st_mode) &&
-          ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512)))
+          ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512|FO_XXH64)))
    {
 
       if (!*elt->chksum && !jcr->rerunning) {
@@ -405,6 +430,10 @@ static int check_checksum_diff(JCR *jcr, FF_PKT *ff_pkt, CurFile *elt)
       } else if (ff_pkt->flags & FO_SHA512) {
          digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA512);
          digest_stream = STREAM_SHA512_DIGEST;
+
+      } else if (ff_pkt->flags & FO_XXH64) {
+         digest = crypto_digest_new(jcr, CRYPTO_DIGEST_XXH64);
+         digest_stream = STREAM_XXH64_DIGEST;
       }
 
       /* Did digest initialization fail? */
@@ -631,9 +660,10 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
       case '1':                /* compare SHA1 */
       case '2':                /* compare SHA256 */
       case '3':                /* compare SHA512 */
+      case '4':                /* compare XXH64 */
          if (ff_pkt->type != FT_LNKSAVED &&
                (S_ISREG(ff_pkt->statp.st_mode) &&
-                ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512))) {
+                ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512|FO_XXH64))) {
             checksum = true;
          }
          break;
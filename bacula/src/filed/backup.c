@@ -157,6 +157,7 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
    if (jcr->accurate) {
       set_find_changed_function((FF_PKT *)jcr->ff, accurate_check_file);
    }
+   set_find_prefetch(jcr->ff, me->prefetch_files);
    start_heartbeat_monitor(jcr);
 
 #ifdef HAVE_ACL
@@ -170,11 +171,15 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
       return false;
    }
 
+   /* The change journal may give the list of the changed files */
+   change_journal_job_start(jcr, (FF_PKT *)jcr->ff);
+
    /** Subroutine save_file() is called for each file */
    if (!find_files(jcr, (FF_PKT *)jcr->ff, save_file, plugin_save)) {
       ok = false;                     /* error */
       jcr->setJobStatus(JS_ErrorTerminated);
    }
+   change_journal_job_end(jcr, (FF_PKT *)jcr->ff);
 
 #ifdef HAVE_ACL
    if (jcr->bacl && jcr->bacl->get_acl_nr_errors() > 0) {
@@ -659,6 +664,60 @@ bail_out:
    return rtnstat;
 }
 
+#ifdef SEEK_DATA
+/*
+ * Move the read position of a sparse file over the blocks that
+ *  are entirely in a hole. The blocks stay on the same boundaries
+ *  and the last block is always read, so the stream is the one we
+ *  get by reading every block and dropping the blocks of zeros.
+ */
+static void sparse_skip_holes(bctx_t &bctx)
+{
+   BFILE *bfd = &bctx.ff_pkt->bfd;
+   uint64_t size = (uint64_t)bctx.ff_pkt->statp.st_size;
+   uint64_t addr, last;
+   boffset_t data, hole;
+
+   if (bctx.fileAddr < bctx.data_end || bctx.fileAddr >= size) {
+      return;                         /* in a data extent or at the end */
+   }
+   data = blseek(bfd, (boffset_t)bctx.fileAddr, SEEK_DATA);
+   if (data < 0) {
+      if (bfd->berrno != ENXIO) {
+         /* Not supported by the filesystem, read every block */
+         Dmsg2(200, "SEEK_DATA failed on %s ERR=%d\n", bctx.ff_pkt->fname,
+               bfd->berrno);
+         bctx.seek_data = false;
+         blseek(bfd, (boffset_t)bctx.fileAddr, SEEK_SET);
+         return;
+      }
+      data = hole = size;             /* only a hole up to the end */
+   } else {
+      hole = blseek(bfd, data, SEEK_HOLE);
+      if (hole < 0) {
+         hole = size;
+      }
+   }
+   bctx.data_end = hole;
+
+   addr = ((uint64_t)data / bctx.rsize) * bctx.rsize;
+   last = ((size - 1) / bctx.rsize) * bctx.rsize;
+   addr = MIN(addr, last);
+   addr = MAX(addr, bctx.fileAddr);
+   /* SEEK_DATA and SEEK_HOLE did move the file position */
+   if (blseek(bfd, (boffset_t)addr, SEEK_SET) != (boffset_t)addr) {
+      bctx.seek_data = false;
+      blseek(bfd, (boffset_t)bctx.fileAddr, SEEK_SET);
+      return;
+   }
+   if (addr > bctx.fileAddr) {
+      Dmsg3(400, "Skip hole in %s %lld-%lld\n", bctx.ff_pkt->fname,
+            bctx.fileAddr, addr);
+   }
+   bctx.fileAddr = addr;
+}
+#endif
+
 /**
  * Send data read from an already open file descriptor.
  *
@@ -789,6 +848,22 @@ static int send_data(bctx_t &bctx, int stream)
    /* Fall through to standard bread() loop */
 #endif
 
+#ifdef SEEK_DATA
+   /*
+    * A sparse regular file that has fewer blocks allocated than its
+    *  size has holes, we ask the filesystem where the data is rather
+    *  than reading the holes and testing them for zeros.
+    */
+   bctx.seek_data = (bctx.ff_pkt->flags & FO_SPARSE) &&
+      !bctx.ff_pkt->cmd_plugin && S_ISREG(bctx.ff_pkt->statp.st_mode) &&
+      (uint64_t)bctx.ff_pkt->statp.st_blocks * 512 <
+         (uint64_t)bctx.ff_pkt->statp.st_size;
+   bctx.data_end = 0;
+   if (bctx.seek_data) {
+      sparse_skip_holes(bctx);
+   }
+#endif
+
    /*
     * Normal read the file data in a loop and send it to SD
     */
@@ -799,6 +874,11 @@ static int send_data(bctx_t &bctx, int stream)
       if (jcr->sd_packet_mgr) {
          jcr->sd_packet_mgr->send(jcr, sd); // Send a POLL request if needed
       }
+#ifdef SEEK_DATA
+      if (bctx.seek_data) {
+         sparse_skip_holes(bctx);
+      }
+#endif
    } /* end while read file data */
    goto finish_sending;
 
@@ -854,6 +934,7 @@ finish_sending:
    if (bctx.cipher_ctx) {
       crypto_cipher_free(bctx.cipher_ctx);
    }
+   digest_pipe_wait(bctx.dpipe);       /* digests are complete */
    return 1;
 
 err:
@@ -862,6 +943,7 @@ err:
       crypto_cipher_free(bctx.cipher_ctx);
    }
 
+   digest_pipe_wait(bctx.dpipe);
    sd->msg = bctx.msgsave; /* restore bnet buffer */
    sd->msglen = 0;
    return 0;
@@ -920,15 +1002,9 @@ bool process_and_send_data(bctx_t &bctx)
    /** Uncompressed cipher input length */
    bctx.cipher_input_len = sd->msglen;
 
-   /** Update checksum if requested */
-   if (bctx.digest) {
-      crypto_digest_update(bctx.digest, (uint8_t *)bctx.rbuf, sd->msglen);
-   }
-
-   /** Update signing digest if requested */
-   if (bctx.signing_digest) {
-      crypto_digest_update(bctx.signing_digest, (uint8_t *)bctx.rbuf, sd->msglen);
-   }
+   /** Update checksum and signing digest if requested */
+   digest_pipe_update(bctx.dpipe, bctx.digest, bctx.signing_digest,
+                      (uint8_t *)bctx.rbuf, sd->msglen);
 
    if (have_libz && !do_libz_compression(bctx)) {
       goto err;
@@ -1319,7 +1395,7 @@ static bool send_resource_fork(bctx_t &bctx)
    if (ff_pkt->type != FT_LNKSAVED && (S_ISREG(ff_pkt->statp.st_mode) &&
        ff_pkt->flags & FO_HFSPLUS)) {
       if (ff_pkt->hfsinfo.rsrclength > 0) {
-         int flags;
+         uint64_t flags;
          int rsrc_stream;
          if (bopen_rsrc(&ff_pkt->bfd, ff_pkt->fname, O_RDONLY | O_BINARY, 0) < 0) {
             ff_pkt->ff_errno = errno;
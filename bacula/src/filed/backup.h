@@ -36,12 +36,17 @@ struct bctx_t {
    int32_t rsize;
    POOLMEM *msgsave;
 
+   /* Sparse variables */
+   bool seek_data;                    /* Skip the holes with SEEK_DATA */
+   uint64_t data_end;                 /* End of the current data extent */
+
    /* Dedup variables */
    bool dedup_client_side;
 
    /* Crypto variables */
    DIGEST *digest;
    DIGEST *signing_digest;
+   digest_pipe *dpipe;                /* Digest thread, NULL to digest inline */
    int digest_stream;
    SIGNATURE *sig;
    CIPHER_CONTEXT *cipher_ctx;
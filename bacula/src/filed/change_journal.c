@@ -0,0 +1,1091 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  Bacula File Daemon -- Change journal
+ *
+ *  When ChangeJournal is enabled, the top directories of the backup jobs
+ *  are watched with inotify, and every change is appended to the journal
+ *  file in the working directory. Each backup job writes a "J <Job>"
+ *  record when it starts, so an Incremental or a Differential job can find
+ *  the files changed since the start of the job it is based on (PrevJob)
+ *  by reading the records written after the "J <PrevJob>" record, instead
+ *  of walking the whole tree. The usual checks (mtime/ctime, accurate) are
+ *  still done on the files given by the journal.
+ *
+ *  The journal is not used for a tree (and the tree is walked) when:
+ *   - the tree was not completely watched when the previous job started
+ *   - events were lost (queue overflow, unmount) since the previous job
+ *   - the previous job record was removed from the journal
+ *   - the tree crosses file systems, does not recurse or uses a snapshot
+ *   - the tree is on a network, cluster or FUSE file system, the changes
+ *     done by the other hosts or by the FUSE daemon are not reported
+ *   - a file with several hard links was changed since the previous job,
+ *     its other names are not known
+ *
+ *  Writes done through a shared mmap() are not reported by inotify, do not
+ *  use the journal for trees where files are modified this way.
+ *
+ *  The records are:
+ *   W <dir>   Top directory <dir> is completely watched
+ *   X <dir>   Top directory <dir> is no longer completely watched
+ *   G         Some events were lost
+ *   J <Job>   Job <Job> starts here
+ *   F <file>  File created or modified
+ *   H <file>  File with several hard links created or modified
+ *   D <dir>   Directory entry modified
+ *   T <dir>   Directory created or moved here, the tree must be saved
+ *   R <file>  File or directory removed or moved away
+ *
+ *  Watches do not survive a restart of the File Daemon, so the journal
+ *  is started again from scratch each time.
+ */
+
+#include "bacula.h"
+#include "filed.h"
+
+static const int dbglvl = 150;
+
+#ifdef HAVE_LINUX_OS
+
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <poll.h>
+
+#define CJ_MASK (IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                 IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_ONLYDIR | \
+                 IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+/* Flags of the entries of a job window */
+#define CJ_FILE     0x01             /* Changed file */
+#define CJ_DIR      0x02             /* Changed directory entry */
+#define CJ_TREE     0x04             /* New directory tree */
+#define CJ_REMOVED  0x08             /* Removed file or tree */
+
+/* Avoid writing the same record again and again between two jobs */
+struct cj_seen_item {
+   hlink link;
+   char key[1];
+};
+
+/* A path found in the journal for a job */
+struct cj_entry {
+   hlink link;
+   int flags;
+   char path[1];
+};
+
+/* What a job can use from the journal */
+struct cj_window {
+   htable *entries;                  /* cj_entry indexed by path */
+   alist roots;                      /* Top directories that can use the journal */
+   bool hardlink;                    /* A file with hard links was changed */
+};
+
+/* The jobs that the next jobs of the same name can use as PrevJob */
+struct cj_job {
+   char name[MAX_NAME_LENGTH];       /* Job name, without the date */
+   char last[MAX_NAME_LENGTH];       /* Last job, for an Incremental */
+   char full[MAX_NAME_LENGTH];       /* Last Full job, for a Differential */
+};
+
+/* Network, cluster and FUSE file systems where inotify misses changes */
+static const struct {
+   uint32_t magic;
+   const char *name;
+} cj_remote_fs[] = {
+   { 0x6969,     "nfs" },
+   { 0x517B,     "smbfs" },
+   { 0xFF534D42, "cifs" },
+   { 0xFE534D42, "smb2" },
+   { 0x65735546, "fuse" },
+   { 0x73757245, "coda" },
+   { 0x5346414F, "afs" },
+   { 0x00C36400, "ceph" },
+   { 0x01021997, "9p" },
+   { 0x01161970, "gfs2" },
+   { 0x7461636F, "ocfs2" },
+   { 0x0BD00BD0, "lustre" },
+   { 0x47504653, "gpfs" },
+   { 0, NULL }
+};
+
+static pthread_mutex_t cj_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t cj_tid;
+static bool cj_running = false;
+static bool cj_quit = false;
+static int cj_fd = -1;                /* inotify descriptor */
+static FILE *cj_fp = NULL;            /* Journal, opened in append mode */
+static POOLMEM *cj_fname = NULL;      /* Journal file name */
+static uint64_t cj_max_size = 0;      /* Size that triggers a compaction */
+static char **cj_wd = NULL;           /* Path of each watch descriptor */
+static int cj_wd_size = 0;
+static int cj_nb_watches = 0;
+static alist *cj_roots = NULL;        /* Watched top directories */
+static alist *cj_failed = NULL;       /* Top directories that cannot be watched */
+static htable *cj_seen = NULL;        /* Records written since the last job */
+static alist *cj_jobs = NULL;         /* cj_job of each job name */
+static int cj_readers = 0;            /* Jobs reading the journal */
+static uint32_t cj_nb_records = 0;    /* Records written */
+static uint32_t cj_nb_gaps = 0;       /* Number of lost events situations */
+
+/* Is path equal to root or under it */
+static bool cj_under(const char *path, const char *root)
+{
+   int len = strlen(root);
+   if (len == 1 && root[0] == '/') {
+      return path[0] == '/';
+   }
+   return strncmp(path, root, len) == 0 && (path[len] == '/' || path[len] == 0);
+}
+
+/* Keep a copy of a directory name without the trailing slashes */
+static char *cj_strip(const char *dir)
+{
+   char *ret = bstrdup(dir);
+   int len = strlen(ret);
+   while (len > 1 && ret[len - 1] == '/') {
+      ret[--len] = 0;
+   }
+   return ret;
+}
+
+static bool cj_in_list(alist *lst, const char *dir)
+{
+   char *elt;
+   foreach_alist(elt, lst) {
+      if (strcmp(elt, dir) == 0) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/* Returns the name of the file system if inotify cannot see all changes */
+static const char *cj_get_remote_fs(const char *dir)
+{
+   struct statfs st;
+
+   if (statfs(dir, &st) != 0) {
+      return NULL;
+   }
+   for (int i = 0; cj_remote_fs[i].name; i++) {
+      if ((uint32_t)st.f_type == cj_remote_fs[i].magic) {
+         return cj_remote_fs[i].name;
+      }
+   }
+   return NULL;
+}
+
+/* Get the Job name from the unique Job name "<name>.<date>_<seq>" */
+static void cj_get_job_name(const char *Job, char *name)
+{
+   const char *p = strrchr(Job, '_');
+   int len = strlen(Job);
+
+   /* The date is "%Y-%m-%d_%H.%M.%S", 19 characters */
+   if (p && p - Job > 20 && p[-20] == '.') {
+      len = p - Job - 20;
+   }
+   bstrncpy(name, Job, MIN(len + 1, MAX_NAME_LENGTH));
+}
+
+/* Find the job name of a unique Job name, called with the mutex locked */
+static cj_job *cj_lookup_job(const char *Job)
+{
+   char name[MAX_NAME_LENGTH];
+   cj_job *job;
+
+   cj_get_job_name(Job, name);
+   foreach_alist(job, cj_jobs) {
+      if (strcmp(job->name, name) == 0) {
+         return job;
+      }
+   }
+   job = (cj_job *)malloc(sizeof(cj_job));
+   memset(job, 0, sizeof(cj_job));
+   bstrncpy(job->name, name, sizeof(job->name));
+   cj_jobs->append(job);
+   return job;
+}
+
+static void cj_seen_reset()
+{
+   cj_seen_item *item = NULL;
+   if (cj_seen) {
+      cj_seen->destroy();
+      free(cj_seen);
+   }
+   cj_seen = (htable *)malloc(sizeof(htable));
+   cj_seen->init(item, &item->link, 1000);
+}
+
+/*
+ * Append a record to the journal, called with the mutex locked.
+ *  The newlines and the backslashes of the path are escaped.
+ *
+ *  Returns: false if the record was already written since the last job
+ */
+static bool cj_write(char op, const char *path)
+{
+   POOL_MEM rec(PM_FNAME);
+   cj_seen_item *item;
+   char *p;
+   int len;
+
+   if (!cj_fp) {
+      return false;
+   }
+   len = Mmsg(rec, "%c ", op);
+   for (const char *q = path; *q; q++) {
+      rec.check_size(len + 3);
+      p = rec.c_str() + len;
+      if (*q == '\n') {
+         *p++ = '\\';
+         *p++ = 'n';
+         len += 2;
+      } else if (*q == '\\') {
+         *p++ = '\\';
+         *p++ = '\\';
+         len += 2;
+      } else {
+         *p++ = *q;
+         len++;
+      }
+      *p = 0;
+   }
+
+   /* Files and directories are written only once between two jobs */
+   if (op == 'F' || op == 'H' || op == 'D') {
+      if (cj_seen->lookup(rec.c_str())) {
+         return false;
+      }
+      /* Do not keep too many entries in memory, it is just an optimization */
+      if (cj_seen->size() > 1000000) {
+         cj_seen_reset();
+      }
+      item = (cj_seen_item *)cj_seen->hash_malloc(sizeof(cj_seen_item) + len);
+      bstrncpy(item->key, rec.c_str(), len + 1);
+      cj_seen->insert(item->key, item);
+   }
+   fprintf(cj_fp, "%s\n", rec.c_str());
+   cj_nb_records++;
+   return true;
+}
+
+/* Read an escaped path from a record */
+static void cj_unescape(char *path)
+{
+   char *p = path, *q = path;
+   while (*p) {
+      if (*p == '\\' && p[1] == 'n') {
+         *q++ = '\n';
+         p += 2;
+      } else if (*p == '\\' && p[1] == '\\') {
+         *q++ = '\\';
+         p += 2;
+      } else {
+         *q++ = *p++;
+      }
+   }
+   *q = 0;
+}
+
+static void cj_set_wd(int wd, const char *path)
+{
+   if (wd >= cj_wd_size) {
+      int size = MAX(wd + 1, cj_wd_size * 2);
+      cj_wd = (char **)brealloc(cj_wd, size * sizeof(char *));
+      memset(cj_wd + cj_wd_size, 0, (size - cj_wd_size) * sizeof(char *));
+      cj_wd_size = size;
+   }
+   if (cj_wd[wd]) {
+      free(cj_wd[wd]);          /* Directory renamed */
+   } else {
+      cj_nb_watches++;
+   }
+   cj_wd[wd] = bstrdup(path);
+}
+
+static void cj_clear_wd(int wd)
+{
+   if (wd >= 0 && wd < cj_wd_size && cj_wd[wd]) {
+      free(cj_wd[wd]);
+      cj_wd[wd] = NULL;
+      cj_nb_watches--;
+   }
+}
+
+/*
+ * Watch a directory and all its subdirectories of the same file system.
+ *  When lock is set, the tree is walked without the mutex, it is taken
+ *  only to record each watch, otherwise it is called with the mutex locked.
+ *
+ *  Returns: number of directories watched, -1 if some cannot be watched
+ */
+static int cj_watch_tree(const char *top, bool lock)
+{
+   alist todo(100, owned_by_alist);
+   POOL_MEM sub(PM_FNAME);
+   struct dirent *entry;
+   struct stat statp;
+   DIR *dp;
+   char *dir;
+   dev_t dev;
+   int wd, nb = 0;
+
+   if (lstat(top, &statp) != 0 || !S_ISDIR(statp.st_mode)) {
+      return 0;
+   }
+   dev = statp.st_dev;
+   todo.append(bstrdup(top));
+
+   while ((dir = (char *)todo.pop()) != NULL) {
+      if (lock) {
+         P(cj_mutex);
+      }
+      wd = inotify_add_watch(cj_fd, dir, CJ_MASK);
+      if (wd >= 0) {
+         cj_set_wd(wd, dir);
+      }
+      if (lock) {
+         V(cj_mutex);
+      }
+      if (wd < 0) {
+         berrno be;
+         if (errno == ENOENT || errno == ENOTDIR) {
+            free(dir);
+            continue;           /* Removed in the meantime, the parent has the event */
+         }
+         Dmsg2(dbglvl, "Cannot watch %s ERR=%s\n", dir, be.bstrerror());
+         free(dir);
+         return -1;
+      }
+      nb++;
+
+      if ((dp = opendir(dir)) == NULL) {
+         free(dir);
+         continue;
+      }
+      while ((entry = readdir(dp)) != NULL) {
+         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+         }
+         if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) {
+            continue;
+         }
+         Mmsg(sub, "%s%s%s", dir, IsPathSeparator(dir[strlen(dir) - 1]) ? "" : "/",
+              entry->d_name);
+         if (lstat(sub.c_str(), &statp) != 0 || !S_ISDIR(statp.st_mode) ||
+             statp.st_dev != dev) {
+            continue;           /* Other file systems are not walked by the backup */
+         }
+         todo.append(bstrdup(sub.c_str()));
+      }
+      closedir(dp);
+      free(dir);
+   }
+   return nb;
+}
+
+/* Stop watching a directory moved away, called with the mutex locked */
+static void cj_unwatch_tree(const char *top)
+{
+   for (int i = 0; i < cj_wd_size; i++) {
+      if (cj_wd[i] && cj_under(cj_wd[i], top)) {
+         inotify_rm_watch(cj_fd, i);
+         cj_clear_wd(i);
+      }
+   }
+}
+
+/* The top directories that contain path are no longer usable */
+static void cj_invalidate_roots(const char *path)
+{
+   char *root;
+   for (int i = cj_roots->size() - 1; i >= 0; i--) {
+      root = (char *)cj_roots->get(i);
+      if (path == NULL || cj_under(path, root) || cj_under(root, path)) {
+         cj_write('X', root);
+         cj_roots->remove(i);
+         free(root);
+      }
+   }
+}
+
+static void cj_handle_event(struct inotify_event *ev)
+{
+   POOL_MEM path(PM_FNAME);
+   const char *dir;
+   bool isdir = (ev->mask & IN_ISDIR) != 0;
+
+   if (ev->mask & IN_Q_OVERFLOW) {
+      Dmsg0(dbglvl, "inotify queue overflow\n");
+      cj_write('G', "");
+      cj_nb_gaps++;
+      return;
+   }
+   if (ev->wd < 0 || ev->wd >= cj_wd_size || (dir = cj_wd[ev->wd]) == NULL) {
+      return;
+   }
+   if (ev->mask & IN_IGNORED) {
+      cj_clear_wd(ev->wd);      /* Directory deleted */
+      return;
+   }
+   if (ev->mask & IN_UNMOUNT) {
+      /* The watches of this file system are gone */
+      cj_write('G', "");
+      cj_nb_gaps++;
+      cj_invalidate_roots(dir);
+      return;
+   }
+   if (ev->len == 0 || ev->name[0] == 0) {
+      if (ev->mask & IN_ATTRIB) {
+         cj_write('D', dir);    /* The directory itself */
+      }
+      return;
+   }
+   Mmsg(path, "%s%s%s", dir, IsPathSeparator(dir[strlen(dir) - 1]) ? "" : "/",
+        ev->name);
+   Dmsg2(dbglvl + 50, "event 0x%x on %s\n", ev->mask, path.c_str());
+
+   if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+      cj_write('R', path.c_str());
+      cj_write('D', dir);
+      /* A deleted directory removes its own watch */
+      if (isdir && (ev->mask & IN_MOVED_FROM)) {
+         cj_unwatch_tree(path.c_str());
+      }
+
+   } else if (isdir && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+      cj_write('T', path.c_str());
+      cj_write('D', dir);
+      if (cj_watch_tree(path.c_str(), false) < 0) {
+         cj_invalidate_roots(path.c_str());
+      }
+
+   } else if (isdir) {
+      cj_write('D', path.c_str());
+
+   } else {
+      /* The other names of a file with hard links are not known */
+      if (cj_write('F', path.c_str()) || (ev->mask & IN_CREATE)) {
+         struct stat statp;
+         if (lstat(path.c_str(), &statp) == 0 && statp.st_nlink > 1) {
+            cj_write('H', path.c_str());
+         }
+      }
+      if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+         cj_write('D', dir);
+      }
+   }
+}
+
+/* Read all pending events, called with the mutex locked */
+static void cj_read_events()
+{
+   char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+   struct inotify_event *ev;
+   ssize_t len;
+
+   while ((len = read(cj_fd, buf, sizeof(buf))) > 0) {
+      for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+         ev = (struct inotify_event *)p;
+         cj_handle_event(ev);
+      }
+   }
+   if (cj_fp) {
+      fflush(cj_fp);
+   }
+}
+
+static void *cj_thread(void *arg)
+{
+   struct pollfd pfd;
+
+   set_jcr_in_tsd(INVALID_JCR);
+   while (!cj_quit) {
+      pfd.fd = cj_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, 1000) > 0) {
+         P(cj_mutex);
+         cj_read_events();
+         V(cj_mutex);
+      }
+   }
+   return NULL;
+}
+
+/*
+ * Start the change journal if enabled in the FileDaemon resource
+ */
+void change_journal_init(CLIENT *client)
+{
+   if (!client->change_journal) {
+      return;
+   }
+   cj_fname = get_pool_memory(PM_FNAME);
+   Mmsg(cj_fname, "%s/%s.journal", client->working_directory, client->hdr.name);
+   cj_max_size = client->change_journal_max_size;
+
+   /* The watches of the previous run are gone, start from scratch */
+   if ((cj_fp = bfopen(cj_fname, "w")) == NULL) {
+      berrno be;
+      Emsg2(M_ERROR, 0, _("Cannot create change journal %s. ERR=%s\n"),
+            cj_fname, be.bstrerror());
+      goto bail_out;
+   }
+   if ((cj_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+      berrno be;
+      Emsg1(M_ERROR, 0, _("Cannot initialize inotify for the change journal. ERR=%s\n"),
+            be.bstrerror());
+      goto bail_out;
+   }
+   cj_roots = New(alist(10, owned_by_alist));
+   cj_failed = New(alist(10, owned_by_alist));
+   cj_jobs = New(alist(10, owned_by_alist));
+   cj_seen_reset();
+   if (pthread_create(&cj_tid, NULL, cj_thread, NULL) != 0) {
+      berrno be;
+      Emsg1(M_ERROR, 0, _("Cannot start the change journal thread. ERR=%s\n"),
+            be.bstrerror());
+      goto bail_out;
+   }
+   cj_running = true;
+   Dmsg1(dbglvl, "Change journal %s started\n", cj_fname);
+   return;
+
+bail_out:
+   change_journal_term();
+}
+
+void change_journal_term()
+{
+   if (cj_running) {
+      cj_quit = true;
+      pthread_join(cj_tid, NULL);
+      cj_running = false;
+   }
+   if (cj_fd >= 0) {
+      close(cj_fd);
+      cj_fd = -1;
+   }
+   if (cj_fp) {
+      fclose(cj_fp);
+      cj_fp = NULL;
+   }
+   for (int i = 0; i < cj_wd_size; i++) {
+      cj_clear_wd(i);
+   }
+   bfree_and_null(cj_wd);
+   cj_wd_size = 0;
+   if (cj_roots) {
+      delete cj_roots;
+      cj_roots = NULL;
+   }
+   if (cj_failed) {
+      delete cj_failed;
+      cj_failed = NULL;
+   }
+   if (cj_jobs) {
+      delete cj_jobs;
+      cj_jobs = NULL;
+   }
+   if (cj_seen) {
+      cj_seen->destroy();
+      free(cj_seen);
+      cj_seen = NULL;
+   }
+   free_and_null_pool_memory(cj_fname);
+}
+
+/*
+ * Load the records written after the start of the previous job.
+ *  Returns NULL if the previous job is unknown.
+ */
+static cj_window *cj_load_window(JCR *jcr, uint64_t size)
+{
+   POOL_MEM line(PM_FNAME);
+   cj_window *w = NULL;
+   cj_entry *entry = NULL;
+   alist watched(10, owned_by_alist);
+   char *path, *root;
+   uint64_t pos = 0;
+   int len;
+   FILE *fp;
+
+   if ((fp = bfopen(cj_fname, "r")) == NULL) {
+      return NULL;
+   }
+   while (pos < size && bfgets(line.addr(), fp)) {
+      pos += strlen(line.c_str());
+      strip_trailing_newline(line.c_str());
+      if (line.c_str()[0] == 0 || line.c_str()[1] != ' ') {
+         continue;
+      }
+      path = line.c_str() + 2;
+      cj_unescape(path);
+
+      switch (line.c_str()[0]) {
+      case 'W':
+         if (!cj_in_list(&watched, path)) {
+            watched.append(bstrdup(path));
+         }
+         break;
+      case 'X':
+         for (int i = watched.size() - 1; i >= 0; i--) {
+            if (strcmp((char *)watched.get(i), path) == 0) {
+               free(watched.remove(i));
+            }
+         }
+         if (w) {
+            for (int i = w->roots.size() - 1; i >= 0; i--) {
+               if (strcmp((char *)w->roots.get(i), path) == 0) {
+                  free(w->roots.remove(i));
+               }
+            }
+         }
+         break;
+      case 'G':
+         if (w) {
+            w->roots.destroy();
+         }
+         break;
+      case 'J':
+         if (strcmp(path, jcr->PrevJob) != 0) {
+            break;
+         }
+         /* Start of the previous job, the window starts here */
+         if (w) {
+            w->entries->destroy();
+            free(w->entries);
+            w->roots.destroy();
+         } else {
+            w = (cj_window *)malloc(sizeof(cj_window));
+            memset((void *)w, 0, sizeof(cj_window));
+            w->roots.init(10, owned_by_alist);
+         }
+         w->entries = (htable *)malloc(sizeof(htable));
+         w->entries->init(entry, &entry->link, 10000);
+         w->hardlink = false;
+         foreach_alist(root, &watched) {
+            w->roots.append(bstrdup(root));
+         }
+         break;
+      case 'H':
+         if (w) {
+            w->hardlink = true;
+         }
+         break;
+      case 'F':
+      case 'D':
+      case 'T':
+      case 'R':
+         if (!w) {
+            break;
+         }
+         entry = (cj_entry *)w->entries->lookup(path);
+         if (!entry) {
+            len = strlen(path);
+            entry = (cj_entry *)w->entries->hash_malloc(sizeof(cj_entry) + len);
+            entry->flags = 0;
+            bstrncpy(entry->path, path, len + 1);
+            w->entries->insert(entry->path, entry);
+         }
+         switch (line.c_str()[0]) {
+         case 'F': entry->flags |= CJ_FILE;    break;
+         case 'D': entry->flags |= CJ_DIR;     break;
+         case 'T': entry->flags |= CJ_TREE;    break;
+         case 'R': entry->flags |= CJ_REMOVED; break;
+         }
+         break;
+      default:
+         break;
+      }
+   }
+   fclose(fp);
+   if (w && w->hardlink && w->roots.size() > 0) {
+      Jmsg(jcr, M_INFO, 0, _("A file with several hard links changed since job %s, the file system will be scanned.\n"),
+           jcr->PrevJob);
+      w->roots.destroy();
+
+   } else if (w && w->roots.size() == 0) {
+      Jmsg(jcr, M_INFO, 0, _("Change journal incomplete since job %s, the file system will be scanned.\n"),
+           jcr->PrevJob);
+   }
+   return w;
+}
+
+static void cj_free_window(cj_window *w)
+{
+   if (w) {
+      w->entries->destroy();
+      free(w->entries);
+      w->roots.destroy();
+      free(w);
+   }
+}
+
+/*
+ * Used by accurate, a file is changed if it is in the journal, or if one
+ *  of its parent directories was created or removed.
+ */
+static bool cj_is_changed(void *ctx, char *fname)
+{
+   cj_window *w = (cj_window *)ctx;
+   cj_entry *entry;
+   POOL_MEM path(PM_FNAME);
+   char *p;
+   int len;
+
+   pm_strcpy(path, fname);
+   len = strlen(path.c_str());
+   while (len > 1 && path.c_str()[len - 1] == '/') {
+      path.c_str()[--len] = 0;
+   }
+   if (w->entries->lookup(path.c_str())) {
+      return true;
+   }
+   while ((p = strrchr(path.c_str(), '/')) != NULL && p != path.c_str()) {
+      *p = 0;
+      entry = (cj_entry *)w->entries->lookup(path.c_str());
+      if (entry && entry->flags & (CJ_TREE | CJ_REMOVED)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/* Is one of the parents of the entry a new tree, that will be walked */
+static bool cj_in_new_tree(cj_window *w, cj_entry *entry, int top_len)
+{
+   POOL_MEM path(PM_FNAME);
+   cj_entry *parent;
+   char *p;
+
+   pm_strcpy(path, entry->path);
+   while ((p = strrchr(path.c_str(), '/')) != NULL && p - path.c_str() > top_len) {
+      *p = 0;
+      parent = (cj_entry *)w->entries->lookup(path.c_str());
+      if (parent && parent->flags & CJ_TREE) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/* Children first, the directory entries are saved after their content */
+static int cj_entry_cmp(const void *a, const void *b)
+{
+   return strcmp((*(cj_entry **)b)->path, (*(cj_entry **)a)->path);
+}
+
+/*
+ * Called by find_files() for each top directory, we handle the directory
+ *  with the journal if possible, otherwise the tree will be walked.
+ */
+static bool change_journal_find_files(JCR *jcr, FF_PKT *ff, char *top_fname)
+{
+   cj_window *w = (cj_window *)ff->journal_ctx;
+   cj_entry *entry, **tab;
+   struct stat statp;
+   char *top;
+   int nb = 0, top_len;
+   bool ok = false;
+
+   if (!w || ff->flags & (FO_MULTIFS | FO_NO_RECURSION)) {
+      return false;
+   }
+   if (lstat(top_fname, &statp) != 0 || !S_ISDIR(statp.st_mode)) {
+      return false;
+   }
+   top = cj_strip(top_fname);
+   if (!cj_in_list(&w->roots, top)) {
+      Dmsg1(dbglvl, "No journal for %s\n", top);
+      goto bail_out;
+   }
+   top_len = strcmp(top, "/") == 0 ? 0 : strlen(top);
+
+   tab = (cj_entry **)malloc((w->entries->size() + 1) * sizeof(cj_entry *));
+   foreach_htable(entry, w->entries) {
+      if (cj_under(entry->path, top)) {
+         tab[nb++] = entry;
+      }
+   }
+   qsort(tab, nb, sizeof(cj_entry *), cj_entry_cmp);
+   Jmsg(jcr, M_INFO, 0, _("Using the change journal for \"%s\", %d entries since job %s.\n"),
+        top, nb, jcr->PrevJob);
+
+   /* The files not in the journal did not change */
+   if (jcr->accurate) {
+      accurate_mark_tree_as_seen(jcr, top, cj_is_changed, w);
+   }
+
+   for (int i = 0; i < nb && !job_canceled(jcr); i++) {
+      entry = tab[i];
+      if (cj_in_new_tree(w, entry, top_len)) {
+         continue;              /* Saved with the new directory */
+      }
+      if (entry->flags & (CJ_TREE | CJ_FILE)) {
+         find_journal_entry(jcr, ff, top_fname, entry->path, statp.st_dev, false);
+      } else if (entry->flags & CJ_DIR) {
+         find_journal_entry(jcr, ff, top_fname, entry->path, statp.st_dev, true);
+      }
+   }
+   free(tab);
+   ok = true;
+
+bail_out:
+   free(top);
+   return ok;
+}
+
+/*
+ * A backup job starts. We watch its top directories, then we mark the
+ *  start of the job in the journal. For an Incremental or a Differential
+ *  job, we get the changes since the previous job.
+ */
+void change_journal_job_start(JCR *jcr, FF_PKT *ff)
+{
+   findFILESET *fileset = ff->fileset;
+   findINCEXE *incexe;
+   dlistString *node;
+   struct stat statp;
+   alist todo(10, owned_by_alist);
+   cj_window *w = NULL;
+   uint64_t size = 0;
+   const char *fs;
+   char *dir;
+   int nb;
+
+   if (!cj_running || !fileset || jcr->Snapshot) {
+      return;
+   }
+
+   /* Find the top directories that are not watched yet */
+   P(cj_mutex);
+   for (int i = 0; i < fileset->include_list.size(); i++) {
+      incexe = (findINCEXE *)fileset->include_list.get(i);
+      foreach_dlist(node, &incexe->name_list) {
+         if (lstat(node->c_str(), &statp) != 0 || !S_ISDIR(statp.st_mode)) {
+            continue;
+         }
+         dir = cj_strip(node->c_str());
+         if (cj_in_list(cj_roots, dir) || cj_in_list(cj_failed, dir) ||
+             cj_in_list(&todo, dir)) {
+            free(dir);
+            continue;
+         }
+         todo.append(dir);
+      }
+   }
+   V(cj_mutex);
+
+   /* The trees are walked without the mutex, the events are still read */
+   foreach_alist(dir, &todo) {
+      if ((fs = cj_get_remote_fs(dir)) != NULL) {
+         Jmsg(jcr, M_INFO, 0, _("Change journal not used for \"%s\" on a %s file system, "
+                                "the tree will be scanned.\n"), dir, fs);
+         nb = -1;
+      } else if ((nb = cj_watch_tree(dir, true)) < 0) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Cannot watch all directories of \"%s\" for the change journal. "
+                                   "Check fs.inotify.max_user_watches. ERR=%s\n"),
+              dir, be.bstrerror());
+      } else {
+         Jmsg(jcr, M_INFO, 0, _("Change journal is watching %d directories of \"%s\".\n"),
+              nb, dir);
+      }
+      P(cj_mutex);
+      if (cj_in_list(cj_roots, dir) || cj_in_list(cj_failed, dir)) {
+         /* Done by a concurrent job */
+      } else if (nb < 0) {
+         cj_write('X', dir);
+         cj_failed->append(bstrdup(dir));
+      } else {
+         cj_write('W', dir);
+         cj_roots->append(bstrdup(dir));
+      }
+      V(cj_mutex);
+   }
+
+   /* All the events before this point are seen by this job */
+   P(cj_mutex);
+   cj_read_events();
+   if (cj_fp) {
+      fflush(cj_fp);
+      size = ftello(cj_fp);
+   }
+   cj_write('J', jcr->Job);
+   fflush(cj_fp);
+   cj_seen_reset();
+   cj_readers++;
+   V(cj_mutex);
+
+   if (jcr->PrevJob[0] && (jcr->getJobLevel() == L_INCREMENTAL ||
+                           jcr->getJobLevel() == L_DIFFERENTIAL)) {
+      w = cj_load_window(jcr, size);
+   }
+   if (w) {
+      set_find_journal_function(ff, change_journal_find_files, w);
+   }
+}
+
+/* Can a job be the PrevJob of a next job, called with the mutex locked */
+static bool cj_is_needed(const char *Job)
+{
+   cj_job *job;
+   foreach_alist(job, cj_jobs) {
+      if (strcmp(job->last, Job) == 0 || strcmp(job->full, Job) == 0) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/*
+ * Compact the journal, the records after the start of the oldest job
+ *  that can still be used as PrevJob are kept (the last job and the
+ *  last Full job of each job name). Called with the mutex locked.
+ */
+static void cj_compact()
+{
+   POOL_MEM line(PM_FNAME), tmp(PM_FNAME);
+   FILE *fp, *out;
+   uint64_t pos = 0, last = 0, oldest = 0, size;
+   alist watched(10, owned_by_alist);
+   bool found = false;
+   char *root;
+   int len;
+
+   fflush(cj_fp);
+   if ((fp = bfopen(cj_fname, "r")) == NULL) {
+      return;
+   }
+   while (bfgets(line.addr(), fp)) {
+      len = strlen(line.c_str());
+      if (line.c_str()[0] == 'J' && line.c_str()[1] == ' ') {
+         last = pos;
+         strip_trailing_newline(line.c_str());
+         cj_unescape(line.c_str() + 2);
+         if (!found && cj_is_needed(line.c_str() + 2)) {
+            oldest = pos;
+            found = true;
+         }
+      }
+      pos += len;
+   }
+   size = pos;
+   if (found) {
+      last = oldest;
+   }
+   if (last == 0) {
+      fclose(fp);
+      return;                   /* Nothing to remove */
+   }
+   Mmsg(tmp, "%s.tmp", cj_fname);
+   if ((out = bfopen(tmp.c_str(), "w")) == NULL) {
+      fclose(fp);
+      return;
+   }
+   /* The top directories watched at the start of the kept job */
+   fseeko(fp, 0, SEEK_SET);
+   for (pos = 0; pos < last && bfgets(line.addr(), fp); pos += len) {
+      len = strlen(line.c_str());
+      if (line.c_str()[0] == 'W' && line.c_str()[1] == ' ') {
+         if (!cj_in_list(&watched, line.c_str())) {
+            watched.append(bstrdup(line.c_str()));
+         }
+      } else if (line.c_str()[0] == 'X' && line.c_str()[1] == ' ') {
+         line.c_str()[0] = 'W';
+         for (int i = watched.size() - 1; i >= 0; i--) {
+            if (strcmp((char *)watched.get(i), line.c_str()) == 0) {
+               free(watched.remove(i));
+            }
+         }
+      }
+   }
+   foreach_alist(root, &watched) {
+      fputs(root, out);
+   }
+   while (bfgets(line.addr(), fp)) {
+      fputs(line.c_str(), out);
+   }
+   fclose(fp);
+   if (fclose(out) != 0 || rename(tmp.c_str(), cj_fname) != 0) {
+      unlink(tmp.c_str());
+      return;
+   }
+   fclose(cj_fp);
+   cj_fp = bfopen(cj_fname, "a");
+   Dmsg2(dbglvl, "Change journal compacted from %lld to %lld bytes\n", size, size - last);
+}
+
+void change_journal_job_end(JCR *jcr, FF_PKT *ff)
+{
+   if (!cj_running || !ff->fileset || jcr->Snapshot) {
+      return;                   /* change_journal_job_start() did nothing */
+   }
+   cj_free_window((cj_window *)ff->journal_ctx);
+   set_find_journal_function(ff, NULL, NULL);
+
+   P(cj_mutex);
+   /* Remember the jobs that the next jobs will use as PrevJob */
+   if (!job_canceled(jcr)) {
+      cj_job *job = cj_lookup_job(jcr->Job);
+      bstrncpy(job->last, jcr->Job, sizeof(job->last));
+      if (jcr->getJobLevel() == L_FULL) {
+         bstrncpy(job->full, jcr->Job, sizeof(job->full));
+      }
+   }
+   if (--cj_readers == 0 && cj_max_size > 0 && cj_fp &&
+       (uint64_t)ftello(cj_fp) > cj_max_size) {
+      cj_compact();
+   }
+   V(cj_mutex);
+}
+
+int change_journal_status(POOL_MEM &msg)
+{
+   int len;
+   if (!cj_running) {
+      return 0;
+   }
+   P(cj_mutex);
+   len = Mmsg(msg, _(" Change journal: roots=%d watches=%d records=%u gaps=%u\n"),
+              cj_roots->size(), cj_nb_watches, cj_nb_records, cj_nb_gaps);
+   V(cj_mutex);
+   return len;
+}
+
+#else  /* HAVE_LINUX_OS */
+
+void change_journal_init(CLIENT *client)
+{
+   if (client->change_journal) {
+      Emsg0(M_WARNING, 0, _("ChangeJournal is not supported on this platform.\n"));
+   }
+}
+
+void change_journal_term() {}
+void change_journal_job_start(JCR *jcr, FF_PKT *ff) {}
+void change_journal_job_end(JCR *jcr, FF_PKT *ff) {}
+int change_journal_status(POOL_MEM &msg) { return 0; }
+
+#endif  /* HAVE_LINUX_OS */
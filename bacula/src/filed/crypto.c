@@ -72,7 +72,7 @@ bool crypto_setup_digests(bctx_t &bctx)
 
    /**
     * Setup for digest handling. If this fails, the digest will be set to NULL
-    * and not used. Note, the digest (file hash) can be any one of the four
+    * and not used. Note, the digest (file hash) can be any one of the five
     * algorithms below.
     *
     * The signing digest is a single algorithm depending on
@@ -96,6 +96,10 @@ bool crypto_setup_digests(bctx_t &bctx)
    } else if (ff_pkt->flags & FO_SHA512) {
       bctx.digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA512);
       bctx.digest_stream = STREAM_SHA512_DIGEST;
+
+   } else if (ff_pkt->flags & FO_XXH64) {
+      bctx.digest = crypto_digest_new(jcr, CRYPTO_DIGEST_XXH64);
+      bctx.digest_stream = STREAM_XXH64_DIGEST;
    }
 
    /** Did digest initialization fail? */
@@ -123,6 +127,10 @@ bool crypto_setup_digests(bctx_t &bctx)
       }
    }
 
+   /** Digest the file data in the helper thread if it is worth it */
+   bctx.dpipe = digest_pipe_get(jcr, bctx.digest ? bctx.digest : bctx.signing_digest,
+                                ff_pkt->statp.st_size);
+
    /** Enable encryption */
    if (jcr->crypto.pki_encrypt) {
       ff_pkt->flags |= FO_ENCRYPT;
@@ -315,6 +323,8 @@ bool crypto_terminate_digests(bctx_t &bctx)
 
 void crypto_free(bctx_t &bctx)
 {
+   digest_pipe_wait(bctx.dpipe);      /* the thread may still use the digests */
+   bctx.dpipe = NULL;
    if (bctx.digest) {
       crypto_digest_free(bctx.digest);
       bctx.digest = NULL;
@@ -328,3 +338,174 @@ void crypto_free(bctx_t &bctx)
       bctx.sig = NULL;
    }
 }
+
+/*
+ * Digest helper thread
+ *
+ *  The cryptographic digests (MD5, SHA-1, SHA-2) cost more CPU than
+ *  reading the file, so they are computed by a helper thread while the
+ *  job thread reads, compresses and sends the next blocks. The blocks are
+ *  copied, the job thread can reuse its buffer immediately, and the
+ *  number of blocks in the pipe is limited by the worker fifo size.
+ *
+ *  The fast XXH64 hash and the files smaller than one block are digested
+ *  inline, the copy and the synchronization would cost more than the
+ *  digest itself.
+ */
+
+/* Header of a work item, the data follows */
+struct digest_item {
+   DIGEST *digest;
+   DIGEST *signing_digest;
+   uint32_t len;
+};
+
+struct digest_pipe {
+   JCR *jcr;
+   worker *wrk;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;               /* signaled when pending reaches 0 */
+   int32_t pending;                   /* queued blocks not yet digested */
+   bool started;                      /* the thread is created */
+};
+
+static void *digest_thread(void *arg)
+{
+   worker *wrk = (worker *)arg;
+   digest_pipe *dp = (digest_pipe *)wrk->get_ctx();
+   digest_item *item;
+   uint8_t *data;
+
+   wrk->set_running();
+   while (!wrk->is_quit_state()) {
+      if ((item = (digest_item *)wrk->dequeue()) == NULL) {
+         break;
+      }
+      data = (uint8_t *)(item + 1);
+      if (item->digest) {
+         crypto_digest_update(item->digest, data, item->len);
+      }
+      if (item->signing_digest) {
+         crypto_digest_update(item->signing_digest, data, item->len);
+      }
+      wrk->push_free_buffer(item);
+
+      P(dp->mutex);
+      if (--dp->pending == 0) {
+         pthread_cond_signal(&dp->cond);
+      }
+      V(dp->mutex);
+   }
+   Dmsg1(200, "JobId=%d digest thread quits\n", dp->jcr->JobId);
+
+   /* Release a job thread waiting for buffers that will never be digested */
+   P(dp->mutex);
+   dp->pending = 0;
+   pthread_cond_signal(&dp->cond);
+   V(dp->mutex);
+   return NULL;
+}
+
+/*
+ * Return the digest thread of the job if the digest of a file of
+ *  this size should be computed in the thread, NULL otherwise.
+ */
+digest_pipe *digest_pipe_get(JCR *jcr, DIGEST *digest, int64_t size)
+{
+   digest_pipe *dp;
+
+   if (!me->digest_thread || !digest ||
+       crypto_digest_type(digest) == CRYPTO_DIGEST_XXH64 ||
+       size <= (int64_t)jcr->buf_size) {
+      return NULL;
+   }
+   if (!jcr->crypto.dpipe) {
+      dp = (digest_pipe *)malloc(sizeof(digest_pipe));
+      memset(dp, 0, sizeof(digest_pipe));
+      dp->jcr = jcr;
+      pthread_mutex_init(&dp->mutex, NULL);
+      pthread_cond_init(&dp->cond, NULL);
+      dp->wrk = New(worker(10));
+      jcr->crypto.dpipe = dp;
+   }
+   return jcr->crypto.dpipe;
+}
+
+/*
+ * Digest a block of data, in the helper thread when dp is set
+ */
+void digest_pipe_update(digest_pipe *dp, DIGEST *digest, DIGEST *signing_digest,
+                        const uint8_t *buf, uint32_t len)
+{
+   digest_item *item;
+
+   if (!dp) {
+      if (digest) {
+         crypto_digest_update(digest, buf, len);
+      }
+      if (signing_digest) {
+         crypto_digest_update(signing_digest, buf, len);
+      }
+      return;
+   }
+   item = (digest_item *)dp->wrk->pop_free_buffer();
+   if (!item) {
+      item = (digest_item *)get_memory(sizeof(digest_item) + len);
+   } else {
+      item = (digest_item *)check_pool_memory_size((POOLMEM *)item,
+                                                   sizeof(digest_item) + len);
+   }
+   item->digest = digest;
+   item->signing_digest = signing_digest;
+   item->len = len;
+   memcpy(item + 1, buf, len);
+
+   P(dp->mutex);
+   dp->pending++;
+   V(dp->mutex);
+
+   dp->wrk->queue(item);
+   /* The thread is started after the first queue() to find a valid fifo */
+   if (!dp->started) {
+      dp->started = true;
+      dp->wrk->start(digest_thread, dp);
+   }
+}
+
+/*
+ * Wait until all the blocks given to the thread are digested,
+ *  the digests can then be finalized or freed.
+ */
+void digest_pipe_wait(digest_pipe *dp)
+{
+   if (!dp) {
+      return;
+   }
+   P(dp->mutex);
+   while (dp->pending > 0) {
+      pthread_cond_wait(&dp->cond, &dp->mutex);
+   }
+   V(dp->mutex);
+}
+
+/*
+ * Stop the digest thread of the job
+ */
+void digest_pipe_free(JCR *jcr)
+{
+   digest_pipe *dp = jcr->crypto.dpipe;
+
+   if (!dp) {
+      return;
+   }
+   digest_pipe_wait(dp);
+   if (dp->started) {
+      dp->wrk->set_quit_state();
+      dp->wrk->stop();
+   }
+   delete dp->wrk;
+   pthread_cond_destroy(&dp->cond);
+   pthread_mutex_destroy(&dp->mutex);
+   free(dp);
+   jcr->crypto.dpipe = NULL;
+}
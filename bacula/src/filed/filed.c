@@ -280,6 +280,11 @@ int main (int argc, char *argv[])
 
    start_collector_threads();    /* start collector thread for every Collector resource */
 
+   change_journal_init(me);      /* Watch the backed up trees if enabled */
+
+   /* Report the restores interrupted by a stop of the daemon */
+   report_restore_journals(me->working_directory);
+
    /* Keep track of the important events */
    events_send_msg(NULL, "FD0001",
                    EVENTS_TYPE_DAEMON, "*Daemon*",
@@ -316,6 +321,7 @@ void terminate_filed(int sig)
    fdcallsdir_stop_server();
    stop_watchdog();
    terminate_collector_threads();
+   change_journal_term();
 
    bnet_stop_thread_server(server_tid);
    generate_daemon_event(NULL, "Exit");
@@ -37,6 +37,7 @@
 
 #define FILE_DAEMON 1
 #include  "lib/htable.h"
+#include  "lib/ohtable.h"
 #if BEEF
 #include  "bee_filed_dedup.h"
 #else
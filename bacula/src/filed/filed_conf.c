@@ -94,6 +94,8 @@ static RES_ITEM cli_items[] = {
    {"SdConnectTimeout", store_time,ITEM(res_client.SDConnectTimeout), 0, ITEM_DEFAULT, 60 * 30},
    {"HeartbeatInterval", store_time, ITEM(res_client.heartbeat_interval), 0, ITEM_DEFAULT, 5 * 60},
    {"MaximumNetworkBufferSize", store_pint32, ITEM(res_client.max_network_buffer_size), 0, 0, 0},
+   {"MaximumRestoreWriters", store_pint32, ITEM(res_client.max_restore_writers), 0, ITEM_DEFAULT, 0},
+   {"RestoreAttributesJournal", store_bool, ITEM(res_client.restore_attributes_journal), 0, ITEM_DEFAULT, false},
 #if BEEF
    {"FipsRequire", store_bool, ITEM(res_client.require_fips), 0, 0, 0},
 #endif
@@ -120,6 +122,10 @@ static RES_ITEM cli_items[] = {
    {"DisableCommand",        store_alist_str, ITEM(res_client.disable_cmds), 0, 0, 0},
    {"MaximumJobErrorCount",  store_pint32,    ITEM(res_client.max_job_errors),  0, ITEM_DEFAULT, 1000},
    {"SdPacketCheck",         store_pint32,    ITEM(res_client.sd_packet_check),  0, ITEM_DEFAULT, 0},
+   {"DigestThread",          store_bool,      ITEM(res_client.digest_thread), 0, ITEM_DEFAULT, true},
+   {"PrefetchFiles",         store_pint32,    ITEM(res_client.prefetch_files), 0, ITEM_DEFAULT, 0},
+   {"ChangeJournal",         store_bool,      ITEM(res_client.change_journal), 0, ITEM_DEFAULT, false},
+   {"ChangeJournalMaximumSize", store_size64, ITEM(res_client.change_journal_max_size), 0, ITEM_DEFAULT, 1024*1024*1024},
 #if BEEF
    {"DedupIndexDirectory",   store_dir,    ITEM(res_client.dedup_index_dir), 0, 0, 0}, /* deprecated */
    {"EnableClientRehydration", store_bool,    ITEM(res_client.allow_dedup_cache), 0, ITEM_DEFAULT, false},
@@ -304,6 +310,8 @@ static void dump_client_resource(CLIENT *client, void sendit(const char *msg, in
                  OT_STRING,   "FDAddress", get_first_address(client->FDaddrs, tmp.c_str(), PM_MESSAGE),
                  OT_INT64,    "SDConnectTimeout", client->SDConnectTimeout,
                  OT_INT32,    "MaximumNetworkBufferSize", client->max_network_buffer_size,
+                 OT_INT32,    "MaximumRestoreWriters", client->max_restore_writers,
+                 OT_BOOL,     "RestoreAttributesJournal", client->restore_attributes_journal,
                  OT_INT64,    "MaximumBandwidthPerJob", client->max_bandwidth_per_job,
                  OT_BOOL,     "CommCommpression", client->comm_compression,
                  OT_ALIST_STR, "DisableCommand", client->disable_cmds,
@@ -135,6 +135,8 @@ struct CLIENT {
    utime_t SDConnectTimeout;          /* timeout in seconds */
    utime_t heartbeat_interval;        /* Interval to send heartbeats */
    uint32_t max_network_buffer_size;  /* max network buf size */
+   uint32_t max_restore_writers;      /* Threads writing the small files during a restore */
+   bool restore_attributes_journal;   /* Set the restored attributes at the end of the job */
    uint32_t max_job_errors;           /* Maximum number of errors tolerated by the client to fail the job */
    int32_t sd_packet_check;           /* Send a POLL request every X data packets */
    bool comm_compression;             /* Enable comm line compression */
@@ -164,6 +166,10 @@ struct CLIENT {
    uint64_t max_bandwidth_per_job;    /* Bandwidth limitation (global) */
    bool require_fips;                  /* Check for FIPS module */
    bool allow_dedup_cache;            /* allow the use of dedup cache for rehydration */
+   bool digest_thread;                /* Compute the file digests in a helper thread */
+   int32_t prefetch_files;            /* Files to prefetch ahead of the backup */
+   bool change_journal;               /* Watch the backed up trees for changes */
+   uint64_t change_journal_max_size;  /* Compact the change journal above this size */
    alist *disable_cmds;               /* Commands to disable */
    bool *disabled_cmds_array;         /* Disabled commands array */
 };
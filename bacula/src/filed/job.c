@@ -1922,6 +1922,10 @@ static int set_options(findFOPTS *fo, const char *opts)
             p++;
             break;
 #endif
+         case '4':
+            fo->flags |= FO_XXH64;
+            p++;
+            break;
          default:
             /*
              * If 2 or 3 is seen here, SHA2 is not configured, so
@@ -3443,6 +3447,7 @@ void filed_free_jcr(JCR *jcr)
    if (jcr->last_fname) {
       free_pool_memory(jcr->last_fname);
    }
+   digest_pipe_free(jcr);
 #ifdef WIN32_VSS
    VSSCleanup(jcr->pVSSClient);
 #endif
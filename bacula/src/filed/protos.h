@@ -36,6 +36,13 @@ void store_runres(LEX *lc, RES_ITEM *item, int index, int pass);
 
 /* From restore.c */
 bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length);
+bool decompress_buffer(JCR *jcr, const char *fname, int32_t stream,
+                       char **data, uint32_t *length, POOLMEM **buf, int32_t *buf_size);
+bool sparse_data(JCR *jcr, const char *fname, BFILE *bfd, uint64_t *addr,
+                 char **data, uint32_t *length, int flags);
+
+/* From restore_journal.c */
+void report_restore_journals(const char *dir);
 
 /* From authenticate.c */
 class FDAuthenticateDIR: public AuthenticateBase
@@ -88,6 +95,23 @@ bool accurate_mark_file_as_seen(JCR *jcr, char *fname);
 void accurate_free(JCR *jcr);
 bool accurate_check_file(JCR *jcr, ATTR *attr, char *digest);
 bool accurate_get_file_attribs(JCR *jcr, accurate_attribs_pkt *att);
+void accurate_mark_tree_as_seen(JCR *jcr, char *top,
+                                bool changed(void *ctx, char *fname), void *ctx);
+
+/* from change_journal.c */
+void change_journal_init(CLIENT *client);
+void change_journal_term();
+void change_journal_job_start(JCR *jcr, FF_PKT *ff);
+void change_journal_job_end(JCR *jcr, FF_PKT *ff);
+int change_journal_status(POOL_MEM &msg);
+
+/* from crypto.c */
+struct digest_pipe;
+digest_pipe *digest_pipe_get(JCR *jcr, DIGEST *digest, int64_t size);
+void digest_pipe_update(digest_pipe *dp, DIGEST *digest, DIGEST *signing_digest,
+                        const uint8_t *buf, uint32_t len);
+void digest_pipe_wait(digest_pipe *dp);
+void digest_pipe_free(JCR *jcr);
 
 /* from backup.c */
 void strip_path(FF_PKT *ff_pkt);
@@ -81,6 +81,7 @@ static bool verify_signature(r_ctx &rctx);
 static void free_signature(r_ctx &rctx);
 static void free_session(r_ctx &rctx);
 static bool close_previous_stream(r_ctx &rctx);
+static bool write_writer_data(r_ctx &rctx);
 static int32_t extract_data(r_ctx &rctx, POOLMEM *buf, int32_t buflen);
 static bool flush_cipher(r_ctx &rctx, BFILE *bfd,  uint64_t *addr, int flags, int32_t stream,
                   RESTORE_CIPHER_CTX *cipher_ctx);
@@ -406,6 +407,15 @@ void do_restore(JCR *jcr)
       jcr->compress_buf_size = compress_buf_size;
    }
 
+   if (client && client->max_restore_writers > 0) {
+      rctx.writers = new_restore_writers(jcr, client->max_restore_writers);
+   }
+#ifndef HAVE_WIN32
+   if (client && client->restore_attributes_journal) {
+      rctx.journal = open_restore_journal(jcr, client->working_directory);
+   }
+#endif
+
    GetMsg *fdmsg = get_msg_buffer(jcr, sd, rec_header);
 
    fdmsg->start_read_sock();
@@ -530,6 +540,7 @@ void do_restore(JCR *jcr)
          if (!close_previous_stream(rctx)) {
             goto get_out;
          }
+         attr = rctx.attr;              /* may have been given to the writers */
 
          /*
           * TODO: manage deleted files
@@ -639,9 +650,20 @@ void do_restore(JCR *jcr)
                /* set attributes now because file will not be extracted */
                if (jcr->plugin) {
                   plugin_set_attributes(jcr, attr, &rctx.bfd);
+               } else if (rctx.journal) {
+                  if (!restore_journal_add(rctx.journal, jcr, attr, &rctx.bfd)) {
+                     set_attributes(jcr, attr, &rctx.bfd);
+                  }
+               } else if (attr->type == FT_DIREND && rctx.writers &&
+                          restore_writer_busy(rctx.writers)) {
+                  /* Files of this directory are being written, do it after */
+                  restore_writer_defer_dir(rctx.writers, attr);
+                  attr = rctx.attr = new_attr(jcr);
                } else {
                   set_attributes(jcr, attr, &rctx.bfd);
                }
+            } else if (rctx.writers && restore_writer_eligible(jcr, attr)) {
+               rctx.witem = new_restore_writer_item(rctx.writers);
             }
             break;
          }
@@ -818,6 +840,21 @@ void do_restore(JCR *jcr)
                }
             }
 
+            if (rctx.witem) {
+               if (!(rctx.flags & (FO_ENCRYPT|FO_WIN32DECOMP)) &&
+                   rctx.witem->data_len + bmsg->rbuflen <= 2 * RESTORE_WRITER_MAX_FILE_SIZE) {
+                  jcr->ReadBytes += bmsg->rbuflen;
+                  restore_writer_add(rctx.witem, rctx.stream, rctx.flags,
+                                     bmsg->rbuf, bmsg->rbuflen);
+                  break;
+               }
+               /* Not for the writers after all, continue in sequence */
+               if (!write_writer_data(rctx)) {
+                  rctx.extract = false;
+                  bclose(&rctx.bfd);
+                  continue;
+               }
+            }
             if (extract_data(rctx, bmsg->rbuf, bmsg->rbuflen) < 0) {
                rctx.extract = false;
                bclose(&rctx.bfd);
@@ -1042,6 +1079,7 @@ void do_restore(JCR *jcr)
       case STREAM_SHA1_DIGEST:
       case STREAM_SHA256_DIGEST:
       case STREAM_SHA512_DIGEST:
+      case STREAM_XXH64_DIGEST:
          break;
 
       case STREAM_PROGRAM_NAMES:
@@ -1149,6 +1187,19 @@ ok_out:
    fdmsg->wait_read_sock(jcr->is_job_canceled());
    delete bmsg;
    free_GetMsg(fdmsg);
+   if (rctx.witem) {
+      free_restore_writer_item(rctx.witem);
+      rctx.witem = NULL;
+   }
+   /* Wait for the files and the directories not yet done */
+   free_restore_writers(rctx.writers);
+   rctx.writers = NULL;
+   if (rctx.journal) {
+      close_restore_journal(jcr, rctx.journal,
+         (client && client->max_restore_writers > 0) ?
+            client->max_restore_writers : RESTORE_JOURNAL_THREADS);
+      rctx.journal = NULL;
+   }
    Dsm_check(200);
    /*
     * First output the statistics.
@@ -1287,7 +1338,7 @@ static int do_file_digest(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
    return (digest_file(jcr, ff_pkt, jcr->crypto.digest));
 }
 
-bool sparse_data(JCR *jcr, BFILE *bfd, uint64_t *addr, char **data, uint32_t *length, int flags)
+bool sparse_data(JCR *jcr, const char *fname, BFILE *bfd, uint64_t *addr, char **data, uint32_t *length, int flags)
 {
    unser_declare;
    uint64_t faddr;
@@ -1300,7 +1351,7 @@ bool sparse_data(JCR *jcr, BFILE *bfd, uint64_t *addr, char **data, uint32_t *le
       if (blseek(bfd, (boffset_t)*addr, SEEK_SET) < 0) {
          berrno be;
          Jmsg3(jcr, M_ERROR, 0, _("Seek to %s error on %s: ERR=%s\n"),
-               edit_uint64(*addr, ec1), jcr->last_fname,
+               edit_uint64(*addr, ec1), fname,
                be.bstrerror(bfd->berrno));
          return false;
       }
@@ -1310,13 +1361,18 @@ bool sparse_data(JCR *jcr, BFILE *bfd, uint64_t *addr, char **data, uint32_t *le
    return true;
 }
 
-bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
+/*
+ * Decompress a data record into *buf, the buffer is grown if needed.
+ *  fname is used for the error messages.
+ */
+bool decompress_buffer(JCR *jcr, const char *fname, int32_t stream,
+                       char **data, uint32_t *length, POOLMEM **buf, int32_t *buf_size)
 {
 #if defined(HAVE_LZO) || defined(HAVE_LIBZ)
    char ec1[50];                   /* Buffer printing huge values */
 #endif
 
-   Dmsg1(200, "Stream found in decompress_data(): %d\n", stream);
+   Dmsg1(200, "Stream found in decompress_buffer(): %d\n", stream);
    if(stream == STREAM_COMPRESSED_DATA || stream == STREAM_SPARSE_COMPRESSED_DATA || stream == STREAM_WIN32_COMPRESSED_DATA
        || stream == STREAM_ENCRYPTED_FILE_COMPRESSED_DATA || stream == STREAM_ENCRYPTED_WIN32_COMPRESSED_DATA)
    {
@@ -1352,27 +1408,26 @@ bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
       switch(comp_magic) {
 #ifdef HAVE_LZO
          case COMPRESS_LZO1X:
-            compress_len = jcr->compress_buf_size;
+            compress_len = *buf_size;
             cbuf = (const unsigned char*)*data + sizeof(comp_stream_header);
             real_compress_len = *length - sizeof(comp_stream_header);
             Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
             while ((r=lzo1x_decompress_safe(cbuf, real_compress_len,
-                                            (unsigned char *)jcr->compress_buf, &compress_len, NULL)) == LZO_E_OUTPUT_OVERRUN)
+                                            (unsigned char *)*buf, &compress_len, NULL)) == LZO_E_OUTPUT_OVERRUN)
             {
                /*
                 * The buffer size is too small, try with a bigger one
                 */
-               compress_len = jcr->compress_buf_size = jcr->compress_buf_size + (jcr->compress_buf_size >> 1);
+               compress_len = *buf_size = *buf_size + (*buf_size >> 1);
                Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
-               jcr->compress_buf = check_pool_memory_size(jcr->compress_buf,
-                                                    compress_len);
+               *buf = check_pool_memory_size(*buf, compress_len);
             }
             if (r != LZO_E_OK) {
                Qmsg(jcr, M_ERROR, 0, _("LZO uncompression error on file %s. ERR=%d\n"),
-                    jcr->last_fname, r);
+                    fname, r);
                return false;
             }
-            *data = jcr->compress_buf;
+            *data = *buf;
             *length = compress_len;
             Dmsg2(200, "Write uncompressed %d bytes, total before write=%s\n", compress_len, edit_uint64(jcr->JobBytes, ec1));
             return true;
@@ -1391,23 +1446,22 @@ bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
        *  needed by the zlib routines, they should not otherwise
        *  be used in Bacula.
        */
-      compress_len = jcr->compress_buf_size;
+      compress_len = *buf_size;
       Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
-      while ((stat=uncompress((Byte *)jcr->compress_buf, &compress_len,
+      while ((stat=uncompress((Byte *)*buf, &compress_len,
                               (const Byte *)*data, (uLong)*length)) == Z_BUF_ERROR)
       {
          /* The buffer size is too small, try with a bigger one. */
-         compress_len = jcr->compress_buf_size = jcr->compress_buf_size + (jcr->compress_buf_size >> 1);
+         compress_len = *buf_size = *buf_size + (*buf_size >> 1);
          Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
-         jcr->compress_buf = check_pool_memory_size(jcr->compress_buf,
-                                                    compress_len);
+         *buf = check_pool_memory_size(*buf, compress_len);
       }
       if (stat != Z_OK) {
          Qmsg(jcr, M_ERROR, 0, _("Uncompression error on file %s. ERR=%s\n"),
-              jcr->last_fname, zlib_strerror(stat));
+              fname, zlib_strerror(stat));
          return false;
       }
-      *data = jcr->compress_buf;
+      *data = *buf;
       *length = compress_len;
       Dmsg2(200, "Write uncompressed %d bytes, total before write=%s\n", compress_len, edit_uint64(jcr->JobBytes, ec1));
       return true;
@@ -1418,6 +1472,12 @@ bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
    }
 }
 
+bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
+{
+   return decompress_buffer(jcr, jcr->last_fname, stream, data, length,
+                            &jcr->compress_buf, &jcr->compress_buf_size);
+}
+
 static void unser_crypto_packet_len(RESTORE_CIPHER_CTX *ctx)
 {
    unser_declare;
@@ -1586,7 +1646,7 @@ int32_t extract_data(r_ctx &rctx, POOLMEM *buf, int32_t buflen)
    }
 
    if ((flags & FO_SPARSE) || (flags & FO_OFFSETS)) {
-      if (!sparse_data(jcr, bfd, &rctx.fileAddr, &wbuf, &wsize, flags)) {
+      if (!sparse_data(jcr, jcr->last_fname, bfd, &rctx.fileAddr, &wbuf, &wsize, flags)) {
          goto get_out;
       }
    }
@@ -1622,6 +1682,24 @@ get_out:
    return -1;
 }
 
+/*
+ * Write the data kept for the restore writers in sequence, used
+ *  when the current file cannot be given to the writers.
+ */
+static bool write_writer_data(r_ctx &rctx)
+{
+   JCR *jcr = rctx.jcr;
+   uint64_t written = 0;
+   bool ok;
+
+   ok = restore_writer_write(jcr, rctx.witem, &rctx.bfd, jcr->last_fname,
+                             &rctx.fileAddr, &written);
+   jcr->JobBytes += written;
+   free_restore_writer_item(rctx.witem);
+   rctx.witem = NULL;
+   return ok;
+}
+
 /*
  * If extracting, close any previous stream
  */
@@ -1629,6 +1707,12 @@ static bool close_previous_stream(r_ctx &rctx)
 {
    bool rtn = true;
 
+   if (rctx.witem && !rctx.extract) {
+      /* The extraction was aborted, drop the data */
+      free_restore_writer_item(rctx.witem);
+      rctx.witem = NULL;
+   }
+
    /*
     * If extracting, it was from previous stream, so
     * close the output file and validate the signature.
@@ -1645,6 +1729,26 @@ static bool close_previous_stream(r_ctx &rctx)
          deallocate_fork_cipher(rctx);
       }
 
+      if (rctx.witem) {
+         /*
+          * The delayed streams and the signature use jcr->last_fname,
+          *  so such a file is written by the job.
+          */
+         if (rctx.sig || (rctx.delayed_streams && !rctx.delayed_streams->empty())) {
+            if (!write_writer_data(rctx)) {
+               bclose(&rctx.bfd);
+            }
+         } else {
+            restore_writer_dispatch(rctx.writers, rctx.witem, rctx.attr, &rctx.bfd);
+            rctx.witem = NULL;
+            rctx.attr = new_attr(rctx.jcr);
+            rctx.extract = false;
+            rctx.jcr->ff->flags = 0;
+            Dmsg0(130, "Stop extracting, given to the restore writers.\n");
+            return true;
+         }
+      }
+
       if (rctx.efs) {
          rctx.efs->finish_work();
          bclose(&rctx.bfd);
@@ -1653,7 +1757,8 @@ static bool close_previous_stream(r_ctx &rctx)
 
       if (rctx.jcr->plugin) {
          plugin_set_attributes(rctx.jcr, rctx.attr, &rctx.bfd);
-      } else {
+      } else if (!rctx.journal ||
+                 !restore_journal_add(rctx.journal, rctx.jcr, rctx.attr, &rctx.bfd)) {
          set_attributes(rctx.jcr, rctx.attr, &rctx.bfd);
       }
       rctx.extract = false;
@@ -1725,7 +1830,7 @@ again:
    Dmsg2(130, "Encryption writing full block, %u bytes, remaining %u bytes in buffer\n", wsize, cipher_ctx->buf_len);
 
    if ((flags & FO_SPARSE) || (flags & FO_OFFSETS)) {
-      if (!sparse_data(jcr, bfd, addr, &wbuf, &wsize, flags)) {
+      if (!sparse_data(jcr, jcr->last_fname, bfd, addr, &wbuf, &wsize, flags)) {
          return false;
       }
    }
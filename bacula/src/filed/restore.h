@@ -38,6 +38,68 @@ struct RESTORE_CIPHER_CTX {
    int32_t packet_len;                 /* Total bytes in packet */
 };
 
+/*
+ * Small files written by the restore writer threads, see restore_writer.c
+ */
+#define RESTORE_WRITER_MAX_FILE_SIZE (1024 * 1024)     /* bigger files are written by the job */
+#define RESTORE_WRITER_MAX_QUEUED    (64 * 1024 * 1024) /* data waiting for a writer */
+#define RESTORE_WRITER_MAX_ITEMS     32                /* files open per writer */
+
+/* Header of a data record kept in RESTORE_WRITER_ITEM::data */
+struct RESTORE_WRITER_REC {
+   int32_t stream;                     /* stream less new bits */
+   int32_t flags;                      /* FO_SPARSE, FO_OFFSETS, FO_COMPRESS */
+   uint32_t len;                       /* length of the data that follows */
+};
+
+struct RESTORE_WRITERS;
+
+struct RESTORE_WRITER_ITEM {
+   dlink link;                         /* in RESTORE_WRITERS::inflight */
+   RESTORE_WRITERS *rw;
+   uint64_t seq;                       /* dispatch order */
+   ATTR *attr;                         /* attributes of the file */
+   BFILE bfd;                          /* file opened by the job */
+   POOLMEM *data;                      /* RESTORE_WRITER_REC + data, ... */
+   uint32_t data_len;
+};
+
+/* Directory attributes waiting for the files written before them */
+struct RESTORE_DEFERRED_DIR {
+   dlink link;
+   uint64_t seq;                       /* last file dispatched before the directory */
+   ATTR *attr;
+};
+
+struct RESTORE_WRITERS {
+   JCR *jcr;
+   workq_t wq;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;                /* signaled when an item is done */
+   dlist *inflight;                    /* items not yet written, in seq order */
+   dlist *dirs;                        /* RESTORE_DEFERRED_DIR in seq order */
+   uint64_t seq;                       /* last dispatched item */
+   uint32_t max_items;
+   uint64_t queued_bytes;              /* data of the items in flight */
+   uint64_t bytes;                     /* written, not yet added to JobBytes */
+   uint32_t nb_files;                  /* written by the threads */
+};
+
+/*
+ * Attributes set at the end of the restore, see restore_journal.c
+ */
+#define RESTORE_JOURNAL_EXT     ".restore-attrs"
+#define RESTORE_JOURNAL_MAGIC   "BaculaAttrJournal1"
+#define RESTORE_JOURNAL_THREADS 4               /* when MaximumRestoreWriters is not set */
+#define RESTORE_JOURNAL_CHUNK_SIZE 1000         /* entries given to a thread */
+
+struct RESTORE_JOURNAL {
+   FILE *fp;
+   POOLMEM *fname;
+   POOLMEM *rec;                       /* record being written */
+   uint32_t count;                     /* records written */
+};
+
 /*
  * Restore context
  */
@@ -60,6 +122,9 @@ struct r_ctx {
    bool extract;                       /* set when extracting */
    bool update_attr;                   /* set when we update attributes, but no data */
    alist *delayed_streams;             /* streams that should be restored as last */
+   RESTORE_WRITERS *writers;           /* threads writing the small files */
+   RESTORE_WRITER_ITEM *witem;         /* data of the current file for the writers */
+   RESTORE_JOURNAL *journal;           /* attributes set at the end of the job */
    worker *efs;                        /* Windows EFS worker thread */
    int32_t count;                      /* Debug count */
 
@@ -69,6 +134,27 @@ struct r_ctx {
    RESTORE_CIPHER_CTX fork_cipher_ctx; /* Cryptographic restore context (if any) for alternative stream */
 };
 
+/* From restore_writer.c */
+RESTORE_WRITERS *new_restore_writers(JCR *jcr, int nb_writers);
+void free_restore_writers(RESTORE_WRITERS *rw);
+bool restore_writer_eligible(JCR *jcr, ATTR *attr);
+RESTORE_WRITER_ITEM *new_restore_writer_item(RESTORE_WRITERS *rw);
+void free_restore_writer_item(RESTORE_WRITER_ITEM *item);
+void restore_writer_add(RESTORE_WRITER_ITEM *item, int32_t stream, int flags,
+                        char *buf, uint32_t len);
+bool restore_writer_write(JCR *jcr, RESTORE_WRITER_ITEM *item, BFILE *bfd,
+                          const char *fname, uint64_t *addr, uint64_t *written);
+void restore_writer_dispatch(RESTORE_WRITERS *rw, RESTORE_WRITER_ITEM *item,
+                             ATTR *attr, BFILE *bfd);
+void restore_writer_defer_dir(RESTORE_WRITERS *rw, ATTR *attr);
+bool restore_writer_busy(RESTORE_WRITERS *rw);
+void restore_writer_update(RESTORE_WRITERS *rw, bool wait);
+
+/* From restore_journal.c */
+RESTORE_JOURNAL *open_restore_journal(JCR *jcr, const char *dir);
+bool restore_journal_add(RESTORE_JOURNAL *j, JCR *jcr, ATTR *attr, BFILE *bfd);
+void close_restore_journal(JCR *jcr, RESTORE_JOURNAL *j, int nb_threads);
+
 #endif
 
 #ifdef TEST_WORKER
@@ -0,0 +1,353 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Bacula File Daemon restore_journal.c
+ *
+ *  Journal of the attributes to set at the end of a restore.
+ *
+ *  With "Restore Attributes Journal = yes", the owner, modes and
+ *  times of the directories, regular files and symbolic links
+ *  restored by the job are not set between the data writes. They
+ *  are appended to a journal in the working directory, and applied
+ *  at the end of the job sorted by path. The files and links are
+ *  done by several threads, the directories are done after them by
+ *  one thread, children first. The regular files are opened again to
+ *  set the owner and modes with the file descriptor.
+ *
+ *  A journal left by an interrupted restore is not applied when the
+ *  File daemon starts, the files may have been changed or restored
+ *  again since then. It is reported and kept for the administrator.
+ *
+ *  Record format, see restore_journal_add()
+ *    uint32 record length, int32 type, uint32 mode, uint32 uid,
+ *    uint32 gid, int64 atime, int64 mtime, uint32 flags, path + nul
+ */
+
+#include "bacula.h"
+#include "filed.h"
+#include "restore.h"
+
+#define RESTORE_JOURNAL_HDR   40        /* record without the path */
+
+/* Part of the sorted journal given to a thread */
+struct RESTORE_JOURNAL_CHUNK {
+   JCR *jcr;
+   char **recs;
+   int nb;
+};
+
+static void *apply_journal_chunk(void *arg);
+
+/*
+ * Create the journal of the job in dir
+ */
+RESTORE_JOURNAL *open_restore_journal(JCR *jcr, const char *dir)
+{
+   RESTORE_JOURNAL *j = (RESTORE_JOURNAL *)malloc(sizeof(RESTORE_JOURNAL));
+
+   bmemset(j, 0, sizeof(RESTORE_JOURNAL));
+   j->fname = get_pool_memory(PM_FNAME);
+   Mmsg(j->fname, "%s/%s%s", dir, jcr->Job, RESTORE_JOURNAL_EXT);
+   if ((j->fp = bfopen(j->fname, "w+b")) == NULL ||
+       fwrite(RESTORE_JOURNAL_MAGIC, sizeof(RESTORE_JOURNAL_MAGIC), 1, j->fp) != 1) {
+      berrno be;
+      Jmsg2(jcr, M_WARNING, 0, _("Could not create the attributes journal %s. ERR=%s\n"),
+            j->fname, be.bstrerror());
+      if (j->fp) {
+         fclose(j->fp);
+         unlink(j->fname);
+      }
+      free_pool_memory(j->fname);
+      free(j);
+      return NULL;
+   }
+   j->rec = get_pool_memory(PM_MESSAGE);
+   Dmsg1(50, "Using attributes journal %s\n", j->fname);
+   return j;
+}
+
+/*
+ * Close the file if open and keep the attributes for the end
+ *  of the job.
+ *
+ * Returns: false if the attributes must be set now
+ */
+bool restore_journal_add(RESTORE_JOURNAL *j, JCR *jcr, ATTR *attr, BFILE *bfd)
+{
+   uint32_t len, reclen;
+   uint32_t flags = 0;
+   ser_declare;
+
+   if (attr->type != FT_REG && attr->type != FT_REGE &&
+       attr->type != FT_DIREND && attr->type != FT_LNK) {
+      return false;
+   }
+   if (is_bopen(bfd)) {
+      check_restored_size(jcr, attr, bfd);
+      bclose(bfd);
+   }
+#ifdef HAVE_CHFLAGS
+   flags = attr->statp.st_flags;
+#endif
+   len = strlen(attr->ofname) + 1;
+   reclen = RESTORE_JOURNAL_HDR + len;
+   j->rec = check_pool_memory_size(j->rec, reclen);
+   ser_begin(j->rec, reclen);
+   ser_uint32(reclen);
+   ser_int32(attr->type);
+   ser_uint32(attr->statp.st_mode);
+   ser_uint32(attr->statp.st_uid);
+   ser_uint32(attr->statp.st_gid);
+   ser_int64(attr->statp.st_atime);
+   ser_int64(attr->statp.st_mtime);
+   ser_uint32(flags);
+   ser_bytes(attr->ofname, len);
+   ser_check(j->rec, reclen);
+
+   if (fwrite(j->rec, reclen, 1, j->fp) != 1) {
+      berrno be;
+      Jmsg2(jcr, M_ERROR, 0, _("Write error on the attributes journal %s. ERR=%s\n"),
+            j->fname, be.bstrerror());
+      return false;
+   }
+   j->count++;
+   pm_strcpy(attr->ofname, "*none*");
+   return true;
+}
+
+/* Children first, a directory is done after its content */
+static int journal_cmp(const void *a, const void *b)
+{
+   const char *r1 = *(const char **)a;
+   const char *r2 = *(const char **)b;
+   return strcmp(r2 + RESTORE_JOURNAL_HDR, r1 + RESTORE_JOURNAL_HDR);
+}
+
+/* File type of a journal record, see restore_journal_add() */
+static int32_t journal_type(char *rec)
+{
+   int32_t type;
+   ser_declare;
+
+   unser_begin(rec + sizeof(uint32_t), sizeof(int32_t));
+   unser_int32(type);
+   return type;
+}
+
+/* Give the records to apply_journal_chunk() in the current thread */
+static void apply_journal_recs(JCR *jcr, char **recs, int nb)
+{
+   RESTORE_JOURNAL_CHUNK *chunk = (RESTORE_JOURNAL_CHUNK *)malloc(sizeof(RESTORE_JOURNAL_CHUNK));
+   chunk->jcr = jcr;
+   chunk->recs = recs;
+   chunk->nb = nb;
+   apply_journal_chunk(chunk);
+}
+
+/*
+ * Read a journal, sort it and set the attributes with nb_threads
+ *
+ * Returns: number of entries applied
+ */
+static int apply_journal_file(JCR *jcr, const char *fname, FILE *fp, int nb_threads)
+{
+   char *buf = NULL;
+   char **recs = NULL, **dirs = NULL;
+   int nb = 0, max = 0, nb_files = 0, nb_dirs = 0;
+   boffset_t size, pos;
+   uint32_t reclen;
+   workq_t wq;
+   ser_declare;
+
+   if (fseeko(fp, 0, SEEK_END) != 0 || (size = ftello(fp)) < 0 ||
+       fseeko(fp, 0, SEEK_SET) != 0) {
+      goto bail_out;
+   }
+   buf = (char *)malloc(size + 1);
+   if (size < (boffset_t)sizeof(RESTORE_JOURNAL_MAGIC) ||
+       fread(buf, size, 1, fp) != 1 ||
+       memcmp(buf, RESTORE_JOURNAL_MAGIC, sizeof(RESTORE_JOURNAL_MAGIC)) != 0) {
+      Jmsg1(jcr, M_WARNING, 0, _("Invalid attributes journal %s ignored.\n"), fname);
+      goto bail_out;
+   }
+
+   /* A record cut by a crash ends the journal */
+   for (pos = sizeof(RESTORE_JOURNAL_MAGIC); pos + RESTORE_JOURNAL_HDR < size; pos += reclen) {
+      unser_begin(buf + pos, sizeof(uint32_t));
+      unser_uint32(reclen);
+      if (reclen <= RESTORE_JOURNAL_HDR || pos + reclen > size ||
+          buf[pos + reclen - 1] != 0) {
+         break;
+      }
+      if (nb == max) {
+         max = max ? max * 2 : 1024;
+         recs = (char **)realloc(recs, max * sizeof(char *));
+      }
+      recs[nb++] = buf + pos;
+   }
+   if (nb == 0) {
+      goto bail_out;
+   }
+   qsort(recs, nb, sizeof(char *), journal_cmp);
+
+   /*
+    * Setting the attributes of a file or a link does not change its
+    *  directory, they can be done in any order. The time of a directory
+    *  must be set after its content, but the chunk of a directory can
+    *  be done before the chunks of its children, so the directories are
+    *  kept in a second list that is done at the end, in the sort order.
+    */
+   dirs = (char **)malloc(nb * sizeof(char *));
+   for (int i = 0; i < nb; i++) {
+      if (journal_type(recs[i]) == FT_DIREND) {
+         dirs[nb_dirs++] = recs[i];
+      } else {
+         recs[nb_files++] = recs[i];
+      }
+   }
+   Dmsg4(50, "Apply %d files and %d directories of %s with %d threads\n",
+         nb_files, nb_dirs, fname, nb_threads);
+
+   if (nb_threads <= 1 || nb_files <= RESTORE_JOURNAL_CHUNK_SIZE ||
+       workq_init(&wq, nb_threads, apply_journal_chunk) != 0) {
+      apply_journal_recs(jcr, recs, nb_files);
+   } else {
+      for (int i = 0; i < nb_files; i += RESTORE_JOURNAL_CHUNK_SIZE) {
+         RESTORE_JOURNAL_CHUNK *chunk = (RESTORE_JOURNAL_CHUNK *)malloc(sizeof(RESTORE_JOURNAL_CHUNK));
+         chunk->jcr = jcr;
+         chunk->recs = recs + i;
+         chunk->nb = MIN(RESTORE_JOURNAL_CHUNK_SIZE, nb_files - i);
+         if (workq_add(&wq, chunk, NULL, 0) != 0) {
+            apply_journal_chunk(chunk);
+         }
+      }
+      workq_wait_idle(&wq);
+      workq_destroy(&wq);
+   }
+   if (nb_dirs > 0) {
+      apply_journal_recs(jcr, dirs, nb_dirs);
+   }
+
+bail_out:
+   if (dirs) {
+      free(dirs);
+   }
+   if (recs) {
+      free(recs);
+   }
+   if (buf) {
+      free(buf);
+   }
+   return nb;
+}
+
+/*
+ * Set the attributes of a part of the journal, can be a workq engine
+ */
+static void *apply_journal_chunk(void *arg)
+{
+   RESTORE_JOURNAL_CHUNK *chunk = (RESTORE_JOURNAL_CHUNK *)arg;
+   JCR *jcr = chunk->jcr;
+   ATTR *attr = new_attr(jcr);
+   BFILE bfd;
+   uint32_t reclen;
+   ser_declare;
+
+   set_jcr_in_tsd(jcr);
+   binit(&bfd);
+   /* Also done for a canceled job, the files are already there */
+   for (int i = 0; i < chunk->nb; i++) {
+      unser_begin(chunk->recs[i], RESTORE_JOURNAL_HDR);
+      unser_uint32(reclen);
+      unser_int32(attr->type);
+      unser_uint32(attr->statp.st_mode);
+      unser_uint32(attr->statp.st_uid);
+      unser_uint32(attr->statp.st_gid);
+      unser_int64(attr->statp.st_atime);
+      unser_int64(attr->statp.st_mtime);
+#ifdef HAVE_CHFLAGS
+      unser_uint32(attr->statp.st_flags);
+#endif
+      attr->statp.st_size = 0;        /* size checked when the file was closed */
+      pm_strcpy(attr->ofname, chunk->recs[i] + RESTORE_JOURNAL_HDR);
+      Dmsg2(400, "Set attributes of %s len=%d\n", attr->ofname, reclen);
+      /* Not a file that replaced ours with a link */
+      if ((attr->type == FT_REG || attr->type == FT_REGE) &&
+          bopen(&bfd, attr->ofname, O_RDONLY | O_BINARY | O_NOFOLLOW | O_NONBLOCK, 0) < 0) {
+         berrno be;
+         Jmsg2(jcr, M_ERROR, 0, _("Unable to open %s to set its attributes. ERR=%s\n"),
+               attr->ofname, be.bstrerror());
+         continue;
+      }
+      set_unix_attributes(jcr, attr, &bfd);
+   }
+   free_attr(attr);
+   free(chunk);
+   return NULL;
+}
+
+/*
+ * Apply the journal at the end of the job and remove it
+ */
+void close_restore_journal(JCR *jcr, RESTORE_JOURNAL *j, int nb_threads)
+{
+   int nb;
+
+   if (!j) {
+      return;
+   }
+   if (fflush(j->fp) != 0) {
+      berrno be;
+      Jmsg2(jcr, M_ERROR, 0, _("Write error on the attributes journal %s. ERR=%s\n"),
+            j->fname, be.bstrerror());
+   }
+   nb = apply_journal_file(jcr, j->fname, j->fp, nb_threads);
+   Dmsg2(50, "Applied %d/%d entries of the attributes journal\n", nb, j->count);
+   fclose(j->fp);
+   unlink(j->fname);
+   free_pool_memory(j->fname);
+   free_pool_memory(j->rec);
+   free(j);
+}
+
+/*
+ * Called at startup, report the restores that were interrupted
+ */
+void report_restore_journals(const char *dir)
+{
+   DIR *dp;
+   struct dirent *entry;
+   int len;
+   int ext_len = strlen(RESTORE_JOURNAL_EXT);
+
+   if ((dp = opendir(dir)) == NULL) {
+      return;
+   }
+   while ((entry = readdir(dp)) != NULL) {
+      len = strlen(entry->d_name);
+      if (len <= ext_len ||
+          strcmp(entry->d_name + len - ext_len, RESTORE_JOURNAL_EXT) != 0) {
+         continue;
+      }
+      Jmsg(NULL, M_WARNING, 0, _("The restore %.*s was interrupted, the owner, modes and times "
+            "of its files may not be set. They are in the journal %s/%s, remove it when done.\n"),
+            len - ext_len, entry->d_name, dir, entry->d_name);
+   }
+   closedir(dp);
+}
@@ -0,0 +1,359 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Bacula File Daemon restore_writer.c
+ *
+ *  Threads writing the data of the small files during a restore.
+ *
+ *  The job thread still reads the records from the Storage daemon
+ *  and creates the files in order. For a small regular file, the
+ *  data records are kept in memory until the next file shows up,
+ *  then the file (already open) is given to a writer thread that
+ *  decompresses and writes the data, sets the attributes and closes
+ *  it. Files that are large, encrypted, handled by a plugin or that
+ *  have ACLs, xattrs or a signature are still written by the job.
+ *
+ *  The writes are done out of order, so the attributes of a
+ *  directory are set once all the files dispatched before the
+ *  directory are written, otherwise its mtime would be lost.
+ */
+
+#include "bacula.h"
+#include "filed.h"
+#include "restore.h"
+
+static void *restore_writer_engine(void *arg);
+
+/*
+ * Start nb_writers threads for the restore of jcr
+ */
+RESTORE_WRITERS *new_restore_writers(JCR *jcr, int nb_writers)
+{
+   RESTORE_WRITER_ITEM *item = NULL;
+   RESTORE_DEFERRED_DIR *dir = NULL;
+   int stat;
+   RESTORE_WRITERS *rw = (RESTORE_WRITERS *)malloc(sizeof(RESTORE_WRITERS));
+
+   bmemset(rw, 0, sizeof(RESTORE_WRITERS));
+   rw->jcr = jcr;
+   if ((stat = workq_init(&rw->wq, nb_writers, restore_writer_engine)) != 0) {
+      berrno be;
+      Jmsg1(jcr, M_WARNING, 0, _("Could not start the restore writers. ERR=%s\n"),
+            be.bstrerror(stat));
+      free(rw);
+      return NULL;
+   }
+   pthread_mutex_init(&rw->mutex, NULL);
+   pthread_cond_init(&rw->cond, NULL);
+   rw->inflight = New(dlist(item, &item->link));
+   rw->dirs = New(dlist(dir, &dir->link));
+   rw->max_items = nb_writers * RESTORE_WRITER_MAX_ITEMS;
+   Dmsg1(50, "Start %d restore writers\n", nb_writers);
+   return rw;
+}
+
+/*
+ * Wait for the writers, set the directory attributes that
+ *  are still pending and stop the threads.
+ */
+void free_restore_writers(RESTORE_WRITERS *rw)
+{
+   if (!rw) {
+      return;
+   }
+   restore_writer_update(rw, true);
+   workq_destroy(&rw->wq);
+   if (rw->nb_files > 0) {
+      Jmsg(rw->jcr, M_INFO, 0, _("%d files written by %d restore writers.\n"),
+           rw->nb_files, rw->wq.max_workers);
+   }
+   delete rw->inflight;
+   delete rw->dirs;
+   pthread_cond_destroy(&rw->cond);
+   pthread_mutex_destroy(&rw->mutex);
+   free(rw);
+}
+
+/*
+ * Check if the data of the file described by attr
+ *  can be written by a writer thread.
+ */
+bool restore_writer_eligible(JCR *jcr, ATTR *attr)
+{
+#if defined(HAVE_WIN32) || defined(HAVE_DARWIN_OS)
+   return false;                      /* Win32 streams and resource forks */
+#else
+   if (jcr->plugin) {
+      return false;
+   }
+   if (attr->type != FT_REG && attr->type != FT_REGE) {
+      return false;
+   }
+   if (attr->statp.st_size > RESTORE_WRITER_MAX_FILE_SIZE) {
+      return false;
+   }
+   switch (attr->data_stream) {
+   case STREAM_FILE_DATA:
+   case STREAM_SPARSE_DATA:
+   case STREAM_GZIP_DATA:
+   case STREAM_SPARSE_GZIP_DATA:
+   case STREAM_COMPRESSED_DATA:
+   case STREAM_SPARSE_COMPRESSED_DATA:
+      return true;
+   default:
+      return false;
+   }
+#endif
+}
+
+RESTORE_WRITER_ITEM *new_restore_writer_item(RESTORE_WRITERS *rw)
+{
+   RESTORE_WRITER_ITEM *item = (RESTORE_WRITER_ITEM *)malloc(sizeof(RESTORE_WRITER_ITEM));
+   bmemset(item, 0, sizeof(RESTORE_WRITER_ITEM));
+   item->rw = rw;
+   binit(&item->bfd);
+   item->data = get_pool_memory(PM_MESSAGE);
+   return item;
+}
+
+void free_restore_writer_item(RESTORE_WRITER_ITEM *item)
+{
+   if (item->attr) {
+      free_attr(item->attr);
+   }
+   bclose(&item->bfd);
+   free_pool_memory(item->data);
+   free(item);
+}
+
+/*
+ * Keep a data record of the file
+ */
+void restore_writer_add(RESTORE_WRITER_ITEM *item, int32_t stream, int flags,
+                        char *buf, uint32_t len)
+{
+   RESTORE_WRITER_REC rec;
+
+   rec.stream = stream;
+   rec.flags = flags & (FO_SPARSE|FO_OFFSETS|FO_COMPRESS);
+   rec.len = len;
+   item->data = check_pool_memory_size(item->data,
+                                       item->data_len + sizeof(rec) + len);
+   memcpy(item->data + item->data_len, &rec, sizeof(rec));
+   memcpy(item->data + item->data_len + sizeof(rec), buf, len);
+   item->data_len += sizeof(rec) + len;
+}
+
+/*
+ * Write the records kept in item to bfd. This is done by the
+ *  writer threads, and by the job when a file must finally be
+ *  handled in sequence. addr is the current write address.
+ *
+ * Returns: false on error, the error is reported
+ */
+bool restore_writer_write(JCR *jcr, RESTORE_WRITER_ITEM *item, BFILE *bfd,
+                          const char *fname, uint64_t *addr, uint64_t *written)
+{
+   RESTORE_WRITER_REC rec;
+   POOLMEM *cbuf = NULL;
+   int32_t cbuf_size = 0;
+   uint32_t pos = 0;
+   bool ok = false;
+
+   while (pos < item->data_len) {
+      memcpy(&rec, item->data + pos, sizeof(rec));
+      char *wbuf = item->data + pos + sizeof(rec);
+      uint32_t wsize = rec.len;
+      pos += sizeof(rec) + rec.len;
+
+      if (rec.flags & (FO_SPARSE|FO_OFFSETS)) {
+         if (!sparse_data(jcr, fname, bfd, addr, &wbuf, &wsize, rec.flags)) {
+            goto bail_out;
+         }
+      }
+      if (rec.flags & FO_COMPRESS) {
+         if (!cbuf) {
+            cbuf_size = jcr->buf_size + 12 + ((jcr->buf_size+999) / 1000) + 100;
+            cbuf = get_memory(cbuf_size);
+         }
+         if (!decompress_buffer(jcr, fname, rec.stream, &wbuf, &wsize, &cbuf, &cbuf_size)) {
+            goto bail_out;
+         }
+      }
+      if (bwrite(bfd, wbuf, wsize) != (ssize_t)wsize) {
+         berrno be;
+         Jmsg2(jcr, M_ERROR, 0, _("Write error on %s: ERR=%s\n"),
+               fname, be.bstrerror(bfd->berrno));
+         goto bail_out;
+      }
+      *addr += wsize;
+      *written += wsize;
+   }
+   ok = true;
+
+bail_out:
+   if (cbuf) {
+      free_pool_memory(cbuf);
+   }
+   return ok;
+}
+
+/*
+ * Give the file to the writers, the job thread must not use
+ *  attr and bfd anymore. We wait here when too many files or too
+ *  much data are in flight.
+ */
+void restore_writer_dispatch(RESTORE_WRITERS *rw, RESTORE_WRITER_ITEM *item,
+                             ATTR *attr, BFILE *bfd)
+{
+   int stat;
+
+   item->attr = attr;
+   memcpy(&item->bfd, bfd, sizeof(BFILE));
+   binit(bfd);
+
+   P(rw->mutex);
+   while ((uint32_t)rw->inflight->size() >= rw->max_items ||
+          (rw->queued_bytes > 0 &&
+           rw->queued_bytes + item->data_len > RESTORE_WRITER_MAX_QUEUED)) {
+      pthread_cond_wait(&rw->cond, &rw->mutex);
+   }
+   item->seq = ++rw->seq;
+   rw->inflight->append(item);
+   rw->queued_bytes += item->data_len;
+   V(rw->mutex);
+
+   if ((stat = workq_add(&rw->wq, item, NULL, 0)) != 0) {
+      berrno be;
+      Jmsg2(rw->jcr, M_ERROR, 0, _("Could not queue %s to a restore writer. ERR=%s\n"),
+            attr->ofname, be.bstrerror(stat));
+      P(rw->mutex);
+      rw->inflight->remove(item);
+      rw->queued_bytes -= item->data_len;
+      pthread_cond_broadcast(&rw->cond);
+      V(rw->mutex);
+      free_restore_writer_item(item);
+   }
+   restore_writer_update(rw, false);
+}
+
+/*
+ * Keep the attributes of a directory until the files dispatched
+ *  so far are written. The attributes are now owned by rw.
+ */
+void restore_writer_defer_dir(RESTORE_WRITERS *rw, ATTR *attr)
+{
+   RESTORE_DEFERRED_DIR *dir = (RESTORE_DEFERRED_DIR *)malloc(sizeof(RESTORE_DEFERRED_DIR));
+   bmemset(dir, 0, sizeof(RESTORE_DEFERRED_DIR));
+   dir->attr = attr;
+   P(rw->mutex);
+   dir->seq = rw->seq;
+   rw->dirs->append(dir);
+   V(rw->mutex);
+   Dmsg2(200, "Defer attributes of %s seq=%lld\n", attr->ofname, dir->seq);
+}
+
+/*
+ * Return true if some files are not yet written
+ */
+bool restore_writer_busy(RESTORE_WRITERS *rw)
+{
+   bool busy;
+   P(rw->mutex);
+   busy = rw->inflight->size() > 0;
+   V(rw->mutex);
+   return busy;
+}
+
+/*
+ * Called by the job thread, update the job counters and set the
+ *  attributes of the directories that are ready. With wait, all
+ *  the files and directories are done when we return.
+ */
+void restore_writer_update(RESTORE_WRITERS *rw, bool wait)
+{
+   JCR *jcr = rw->jcr;
+   RESTORE_WRITER_ITEM *first;
+   RESTORE_DEFERRED_DIR *dir = NULL;
+   dlist ready(dir, &dir->link);       /* set outside of the lock */
+
+   P(rw->mutex);
+   while (wait && rw->inflight->size() > 0) {
+      pthread_cond_wait(&rw->cond, &rw->mutex);
+   }
+   jcr->JobBytes += rw->bytes;
+   rw->bytes = 0;
+
+   /* Items complete out of order, the first one has the lowest seq */
+   first = (RESTORE_WRITER_ITEM *)rw->inflight->first();
+   while ((dir = (RESTORE_DEFERRED_DIR *)rw->dirs->first()) != NULL) {
+      if (first && first->seq <= dir->seq) {
+         break;
+      }
+      rw->dirs->remove(dir);
+      ready.append(dir);
+   }
+   V(rw->mutex);
+
+   while ((dir = (RESTORE_DEFERRED_DIR *)ready.first()) != NULL) {
+      BFILE bfd;
+      binit(&bfd);
+      Dmsg2(200, "Set attributes of %s seq=%lld\n", dir->attr->ofname, dir->seq);
+      set_attributes(jcr, dir->attr, &bfd);
+      ready.remove(dir);
+      free_attr(dir->attr);
+      free(dir);
+   }
+}
+
+/*
+ * Writer thread, called by the workq for each file
+ */
+static void *restore_writer_engine(void *arg)
+{
+   RESTORE_WRITER_ITEM *item = (RESTORE_WRITER_ITEM *)arg;
+   RESTORE_WRITERS *rw = item->rw;
+   JCR *jcr = rw->jcr;
+   uint64_t addr = 0, written = 0;
+   bool ok = false;
+
+   set_jcr_in_tsd(jcr);
+   if (!job_canceled(jcr)) {
+      ok = restore_writer_write(jcr, item, &item->bfd, item->attr->ofname,
+                                &addr, &written);
+   }
+   if (ok) {
+      /* Does not touch the umask shared with the job thread */
+      set_unix_attributes(jcr, item->attr, &item->bfd);
+   } else {
+      bclose(&item->bfd);
+   }
+
+   P(rw->mutex);
+   rw->inflight->remove(item);
+   rw->queued_bytes -= item->data_len;
+   rw->bytes += written;
+   rw->nb_files++;
+   pthread_cond_broadcast(&rw->cond);
+   V(rw->mutex);
+
+   free_restore_writer_item(item);
+   set_jcr_in_tsd(INVALID_JCR);
+   return NULL;
+}
@@ -235,6 +235,13 @@ static void  list_status_header(STATUS_PKT *sp)
    len = Mmsg(msg, " Crypto: fips=%s crypto=%s\n", crypto_get_fips_enabled(), crypto_get_version());
    sendit(msg.c_str(), len, sp);
 
+   if ((len = change_journal_status(msg)) > 0) {
+      sendit(msg.c_str(), len, sp);
+   }
+   if ((len = async_trace_status(msg)) > 0) {
+      sendit(msg.c_str(), len, sp);
+   }
+
    if (chk_dbglvl(1)) {
       len = Mmsg(msg, " APIs: %sGPFS\n", GPFSLIB::enabled()?"":"!");
       sendit(msg.c_str(), len, sp);
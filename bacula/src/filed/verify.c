@@ -217,7 +217,7 @@ static int verify_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
     * First we initialise, then we read files, other streams and Finder Info.
     */
    if (ff_pkt->type != FT_LNKSAVED && (S_ISREG(ff_pkt->statp.st_mode) &&
-            ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512))) {
+            ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512|FO_XXH64))) {
       /*
        * Create our digest context. If this fails, the digest will be set to NULL
        * and not used.
@@ -237,6 +237,10 @@ static int verify_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
       } else if (ff_pkt->flags & FO_SHA512) {
          digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA512);
          digest_stream = STREAM_SHA512_DIGEST;
+
+      } else if (ff_pkt->flags & FO_XXH64) {
+         digest = crypto_digest_new(jcr, CRYPTO_DIGEST_XXH64);
+         digest_stream = STREAM_XXH64_DIGEST;
       }
 
       /* Did digest initialization fail? */
@@ -353,6 +357,7 @@ static int read_digest(BFILE *bfd, DIGEST *digest, JCR *jcr)
    int64_t bufsiz = jcr->buf_size;
    FF_PKT *ff_pkt = (FF_PKT *)jcr->ff;
    uint64_t fileAddr = 0;             /* file address */
+   digest_pipe *dp = digest_pipe_get(jcr, digest, ff_pkt->statp.st_size);
 
    buf = (char *)malloc(bufsiz);
    Dmsg0(50, "=== read_digest\n");
@@ -379,7 +384,7 @@ static int read_digest(BFILE *bfd, DIGEST *digest, JCR *jcr)
          }
       }
 
-      crypto_digest_update(digest, (uint8_t *)buf, n);
+      digest_pipe_update(dp, digest, NULL, (uint8_t *)buf, n);
 
       /* Can be used by BaseJobs or with accurate, update only for Verify
        * jobs
@@ -389,6 +394,7 @@ static int read_digest(BFILE *bfd, DIGEST *digest, JCR *jcr)
       }
       jcr->ReadBytes += n;
    }
+   digest_pipe_wait(dp);              /* the digest can be finalized */
    free(buf);
    if (n < 0) {
       berrno be;
@@ -167,6 +167,10 @@ void v_ctx::scan_fileset()
             digesttype = CRYPTO_DIGEST_SHA512;
             return;
          }
+         if (fo->flags & FO_XXH64) {
+            digesttype = CRYPTO_DIGEST_XXH64;
+            return;
+         }
       }
    }
    digesttype = CRYPTO_DIGEST_NONE;
@@ -444,6 +448,11 @@ void do_verify_volume(JCR *jcr)
          digest_code = "SHA512";
          break;
 
+      case STREAM_XXH64_DIGEST:
+         bin_to_base64(digest, sizeof(digest), (char *)bmsg->rbuf, CRYPTO_DIGEST_XXH64_SIZE, true);
+         digest_code = "XXH64";
+         break;
+
       default:
          *digest = 0;
          break;
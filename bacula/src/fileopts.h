@@ -64,5 +64,6 @@
 #define FO_PLUGIN        (1<<29)      /* Plugin data stream -- return to plugin on restore */
 #define FO_OFFSETS       (1<<30)      /* Keep I/O file offsets */
 #define FO_DEDUPLICATION (1ULL<<31)   /* Do deduplication */
+#define FO_XXH64         (1ULL<<32)   /* Do XXH64 checksum (fast, not cryptographic) */
 
 #endif /* __BFILEOPTSS_H */
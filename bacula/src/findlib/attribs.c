@@ -102,7 +102,9 @@ void set_own_mod(ATTR *attr, char *path, uid_t owner, gid_t group, mode_t mode)
 bool set_mod_own_time(JCR *jcr, BFILE *ofd, ATTR *attr)
 {
    bool ok = true;
+#if !defined(HAVE_FUTIMES) || !defined(HAVE_LUTIMES)
    struct utimbuf ut;
+#endif
 
    ASSERTD(attr->type != FT_LNK, "function set_mod_own_time() not designed to handle SYMLINK");
 
@@ -166,12 +168,21 @@ bool set_mod_own_time(JCR *jcr, BFILE *ofd, ATTR *attr)
          ok = false;
       }
       /*
-       * Reset file times.
+       * Reset file times, of the file itself if it was replaced by a link
        */
+#ifdef HAVE_LUTIMES
+      struct timeval times[2];
+      times[0].tv_sec = attr->statp.st_atime;
+      times[0].tv_usec = 0;
+      times[1].tv_sec = attr->statp.st_mtime;
+      times[1].tv_usec = 0;
+      if (lutimes(attr->ofname, times) < 0 && print_error(jcr)) {
+#else
       ut.actime = attr->statp.st_atime;
       ut.modtime = attr->statp.st_mtime;
 
       if (utime(attr->ofname, &ut) < 0 && print_error(jcr)) {
+#endif
          berrno be;
          Jmsg2(jcr, M_ERROR, 0, _("Unable to set file times %s: ERR=%s\n"),
             attr->ofname, be.bstrerror());
@@ -575,8 +586,7 @@ int32_t decode_LinkFI(char *buf, struct stat *statp, int stat_size)
 bool set_attributes(JCR *jcr, ATTR *attr, BFILE *ofd)
 {
    mode_t old_mask;
-   bool ok = true;
-   boffset_t fsize;
+   bool ok;
 
    if (!uid_set) {
       my_uid = getuid();
@@ -611,6 +621,18 @@ bool set_attributes(JCR *jcr, ATTR *attr, BFILE *ofd)
 #endif /* HAVE_WIN32 */
 
    old_mask = umask(0);
+   ok = set_unix_attributes(jcr, attr, ofd);
+   umask(old_mask);
+   return ok;
+}
+
+/*
+ * Compare the size of an open restored file with the original one
+ */
+void check_restored_size(JCR *jcr, ATTR *attr, BFILE *ofd)
+{
+   boffset_t fsize;
+
    if (is_bopen(ofd)) {
       char ec1[50], ec2[50];
       fsize = blseek(ofd, 0, SEEK_END);
@@ -621,6 +643,23 @@ bool set_attributes(JCR *jcr, ATTR *attr, BFILE *ofd)
             edit_uint64(fsize, ec2));
       }
    }
+}
+
+/*
+ * Set the owner, modes, times and flags of a restored file and
+ *  close it. The process umask is not changed, so this part can
+ *  be called by several threads, see filed/restore_writer.c
+ */
+bool set_unix_attributes(JCR *jcr, ATTR *attr, BFILE *ofd)
+{
+   bool ok = true;
+
+   if (!uid_set) {
+      my_uid = getuid();
+      my_gid = getgid();
+      uid_set = true;
+   }
+   check_restored_size(jcr, attr, ofd);
 
    /*
     * We do not restore sockets, so skip trying to restore their
@@ -697,7 +736,6 @@ bail_out:
       bclose(ofd);
    }
    pm_strcpy(attr->ofname, "*none*");
-   umask(old_mask);
    return ok;
 }
 
@@ -128,6 +128,8 @@ const char *stream_to_ascii(int stream)
          return _("SHA256 digest");
       case STREAM_SHA512_DIGEST:
          return _("SHA512 digest");
+      case STREAM_XXH64_DIGEST:
+         return _("XXH64 digest");
       case STREAM_SIGNED_DIGEST:
          return _("Signed digest");
       case STREAM_ENCRYPTED_FILE_DATA:
@@ -409,6 +411,7 @@ bool is_restore_stream_supported(int stream)
    case STREAM_SHA256_DIGEST:
    case STREAM_SHA512_DIGEST:
 #endif
+   case STREAM_XXH64_DIGEST:
 #ifdef HAVE_CRYPTO
    case STREAM_SIGNED_DIGEST:
    case STREAM_ENCRYPTED_FILE_DATA:
@@ -964,6 +967,7 @@ bool is_restore_stream_supported(int stream)
    case STREAM_SHA256_DIGEST:
    case STREAM_SHA512_DIGEST:
 #endif
+   case STREAM_XXH64_DIGEST:
 #ifdef HAVE_CRYPTO
    case STREAM_SIGNED_DIGEST:
    case STREAM_ENCRYPTED_FILE_DATA:
@@ -92,6 +92,30 @@ set_find_changed_function(FF_PKT *ff, bool check_fct(JCR *jcr, FF_PKT *ff))
    ff->check_fct = check_fct;
 }
 
+/*
+ * The journal function is called for each top level directory of an
+ *  Incremental or Differential backup. It returns true when it has
+ *  handled the directory with find_journal_entry() from a list of the
+ *  changed files, false when the tree must be walked.
+ */
+void
+set_find_journal_function(FF_PKT *ff, bool journal_fct(JCR *jcr, FF_PKT *ff, char *top_fname),
+                          void *ctx)
+{
+   ff->journal_fct = journal_fct;
+   ff->journal_ctx = ctx;
+}
+
+/*
+ * Read the directories nb_files entries ahead and prefetch
+ *  the files in helper threads, see prefetch.c
+ */
+void
+set_find_prefetch(FF_PKT *ff, int32_t nb_files)
+{
+   ff->prefetch_files = nb_files;
+}
+
 void
 set_find_snapshot_function(FF_PKT *ff, 
                            bool convert_path(JCR *jcr, FF_PKT *ff, dlist *filelist, dlistString *node))
@@ -190,6 +214,14 @@ find_files(JCR *jcr, FF_PKT *ff, int file_save(JCR *jcr, FF_PKT *ff_pkt, bool to
                ff->snapshot_convert_fct(jcr, ff, &incexe->name_list, node);
             }
 
+            /* The change journal may know the files that changed in this tree */
+            if (ff->journal_fct && ff->journal_fct(jcr, ff, fname.c_str())) {
+               if (job_canceled(jcr)) {
+                  return 0;
+               }
+               continue;
+            }
+
             if (find_one_file(jcr, ff, our_callback, fname.c_str(), ff->top_fname, (dev_t)-1, true) == 0) {
                return 0;                  /* error return */
             }
@@ -424,6 +456,66 @@ bool accept_file(FF_PKT *ff)
    return true;
 }
 
+/*
+ * Handle one entry given by the change journal for the tree top_fname.
+ *  The entry is skipped if one of its parent directories would have been
+ *  excluded or ignored by a walk of the tree. With dir_only, we save only
+ *  the directory entry, otherwise new directories are walked.
+ *
+ *  Returns: 0 on error, like find_one_file()
+ */
+int find_journal_entry(JCR *jcr, FF_PKT *ff, char *top_fname, char *fname,
+                       dev_t top_dev, bool dir_only)
+{
+   POOL_MEM dir(PM_FNAME);
+   struct stat statp;
+   int len = strlen(top_fname);
+   int rtn_stat;
+   char *p;
+
+   /* The top directory itself is handled like in a walk of the tree */
+   while (len > 1 && IsPathSeparator(top_fname[len - 1])) {
+      len--;
+   }
+   if (strncmp(fname, top_fname, len) == 0 && fname[len] == 0) {
+      ff->top_fname = top_fname;
+      ff->dir_only = dir_only;
+      rtn_stat = find_one_file(jcr, ff, our_callback, fname, fname, (dev_t)-1, true);
+      ff->dir_only = false;
+      return rtn_stat;
+   }
+
+   /* Check the parent directories below the top directory */
+   pm_strcpy(dir, fname);
+   for (p = dir.c_str() + len + 1; (p = strchr(p, '/')) != NULL; p++) {
+      *p = 0;
+      ff->fname = dir.c_str();
+      ff->statp.st_mode = S_IFDIR;
+      if (!accept_file(ff) || have_ignoredir(ff)) {
+         Dmsg1(dbglvl, "Skip journal entry %s\n", fname);
+         return 1;
+      }
+      *p = '/';
+   }
+   /* The top directory may be ignored too */
+   pm_strcpy(dir, top_fname);
+   ff->fname = dir.c_str();
+   if (have_ignoredir(ff)) {
+      return 1;
+   }
+
+   /* The file is gone since, nothing to do, the journal has the deletion */
+   if (lstat(fname, &statp) != 0 || statp.st_dev != top_dev) {
+      Dmsg1(dbglvl, "Journal entry %s not found or on another device\n", fname);
+      return 1;
+   }
+   ff->top_fname = top_fname;
+   ff->dir_only = dir_only;
+   rtn_stat = find_one_file(jcr, ff, our_callback, fname, fname, top_dev, false);
+   ff->dir_only = false;
+   return rtn_stat;
+}
+
 /*
  * The code comes here for each file examined.
  * We filter the files, then call the user's callback if
@@ -498,6 +590,7 @@ term_find_files(FF_PKT *ff)
    if (ff->mtab_list) {
       delete ff->mtab_list;
    }
+   term_find_prefetch(ff);
    hard_links = term_find_one(ff);
    free(ff);
    return hard_links;
@@ -191,6 +191,11 @@ struct FF_PKT {
    int (*file_save)(JCR *, FF_PKT *, bool); /* User's callback */
    int (*plugin_save)(JCR *, FF_PKT *, bool); /* User's callback */
    bool (*check_fct)(JCR *, FF_PKT *); /* optionnal user fct to check file changes */
+   bool (*journal_fct)(JCR *, FF_PKT *, char *); /* optional user fct to list changed files */
+   void *journal_ctx;                 /* private data of journal_fct */
+   int32_t prefetch_files;            /* directory entries to prefetch ahead */
+   struct prefetch_ctx *prefetch;     /* prefetch helper threads */
+   bool dir_only;                     /* do not descend into the directory */
 
    /* Values set by accept_file while processing Options */
    uint64_t flags;                    /* backup options */
@@ -349,7 +349,7 @@ bool check_changes(JCR *jcr, FF_PKT *ff_pkt)
    return true;
 }
 
-static bool have_ignoredir(FF_PKT *ff_pkt)
+bool have_ignoredir(FF_PKT *ff_pkt)
 {
    struct stat sb;
    char *ignoredir;
@@ -622,6 +622,7 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
 
    } else if (S_ISDIR(ff_pkt->statp.st_mode)) {
       DIR *directory;
+      prefetch_dir *prefetch;
       POOL_MEM dname(PM_FNAME);
       char *link;
       int link_len;
@@ -739,7 +740,9 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
 #if defined(HAVE_WIN32)
       is_win32_mount_point = ff_pkt->statp.st_rdev == WIN32_MOUNT_POINT;
 #endif
-      if (!top_level && ff_pkt->flags & FO_NO_RECURSION) {
+      if (ff_pkt->dir_only) {
+         recurse = false;       /* Change journal, only the directory entry */
+      } else if (!top_level && ff_pkt->flags & FO_NO_RECURSION) {
          ff_pkt->type = FT_NORECURSE;
          recurse = false;
       } else if (!top_level &&
@@ -814,6 +817,9 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
       snap_link[slen++] = '/';             /* add back one */
       snap_link[slen] = 0;
 
+      /* The next entries may be read ahead and prefetched */
+      prefetch = prefetch_opendir(jcr, ff_pkt, snap_link);
+
       /*
        * Process all files in this directory entry (recursing).
        *    This would possibly run faster if we chdir to the directory
@@ -825,7 +831,7 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
          int l;
          int i;
 
-         status = breaddir(directory, dname.addr());
+         status = prefetch_readdir(prefetch, directory, dname.addr());
          if (status != 0) {
             /* error or end of directory */
 //          Dmsg1(99, "breaddir returned stat=%d\n", status);
@@ -861,6 +867,7 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
          }
 
       }
+      prefetch_closedir(prefetch);
       closedir(directory);
       free(link);
       free(snap_link);
@@ -0,0 +1,383 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Prefetch the files of a directory ahead of the backup
+ *
+ *  When a tree holds a lot of small files, the backup spends most
+ *  of its time waiting for the inode and the first block of each
+ *  file, one file after the other. Here, the directory entries are
+ *  read a window of prefetch_files entries ahead of the one being
+ *  backed up, and each entry of the window is given to a few helper
+ *  threads that lstat() it and, for a small regular file, open it
+ *  and ask the kernel to read it with posix_fadvise(WILLNEED). When
+ *  the job thread comes to the file, the metadata and the data are
+ *  already in memory.
+ *
+ *  The helper threads only warm the caches, the job thread still does
+ *  all the real work, so an entry that cannot be prefetched is simply
+ *  skipped. An entry that the job thread reaches before a helper is
+ *  canceled, and the queue never blocks the job thread: when it is
+ *  full, the entry is dropped.
+ */
+
+#include "bacula.h"
+#include "find.h"
+
+int breaddir(DIR *dirp, POOLMEM *&d_name);
+
+#ifndef HAVE_WIN32
+
+static const int dbglvl = 450;
+
+/* Maximum number of helper threads */
+#define PREFETCH_THREADS   4
+
+/* Bigger files are not read ahead, only their metadata */
+#define PREFETCH_MAX_SIZE  (1024 * 1024)
+
+/* Maximum size of a directory window */
+#define PREFETCH_MAX_FILES 1024
+
+/* Entries queued for each entry of a directory window */
+#define PREFETCH_QUEUE_FACTOR 8
+
+/* A file waiting to be prefetched */
+struct pf_item {
+   uint64_t id;                       /* 0 when the item is canceled */
+   POOLMEM *fname;                    /* full path of the file */
+};
+
+/* The prefetch helper threads of a job */
+struct prefetch_ctx {
+   JCR *jcr;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;               /* signaled when an item is queued */
+   pf_item *items;                    /* ring of the queued items */
+   int32_t size;                      /* size of the ring */
+   int32_t first;                     /* oldest queued item */
+   int32_t count;                     /* number of queued items */
+   uint64_t next_id;                  /* id of the last queued item */
+   bool quit;                         /* the threads must stop */
+   bool incremental;                  /* only changed files are read */
+   time_t save_time;                  /* start of the incremental */
+   int nb_threads;
+   pthread_t threads[PREFETCH_THREADS];
+   uint64_t nb_queued;                /* statistics */
+   uint64_t nb_dropped;
+   uint64_t nb_canceled;
+   uint64_t nb_read;
+};
+
+/* The window of the entries read ahead in a directory */
+struct prefetch_dir {
+   prefetch_ctx *pf;
+   POOLMEM **names;                   /* names read from the directory */
+   uint64_t *ids;                     /* id of each queued name */
+   int32_t size;                      /* size of the window */
+   int32_t first;                     /* oldest name */
+   int32_t count;                     /* number of names */
+   int status;                        /* breaddir() status at the end */
+   POOLMEM *path;                     /* directory path with a trailing slash */
+   int32_t plen;                      /* length of the directory path */
+};
+
+/*
+ * Warm the caches for one file
+ */
+static void prefetch_file(prefetch_ctx *pf, char *fname)
+{
+   struct stat statp;
+   int fd;
+
+   if (lstat(fname, &statp) != 0 || !S_ISREG(statp.st_mode) ||
+       statp.st_size == 0 || statp.st_size > PREFETCH_MAX_SIZE) {
+      return;
+   }
+   /* An Incremental or Differential job does not read unchanged files */
+   if (pf->incremental && statp.st_mtime < pf->save_time &&
+       statp.st_ctime < pf->save_time) {
+      return;
+   }
+   fd = open(fname, O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC | O_NOATIME);
+   if (fd < 0 && errno == EPERM) {
+      /* O_NOATIME is allowed only for the owner of the file */
+      fd = open(fname, O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+   }
+   if (fd < 0) {
+      return;
+   }
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+   posix_fadvise(fd, 0, statp.st_size, POSIX_FADV_WILLNEED);
+#endif
+   close(fd);
+   P(pf->mutex);
+   pf->nb_read++;
+   V(pf->mutex);
+}
+
+static void *prefetch_thread(void *arg)
+{
+   prefetch_ctx *pf = (prefetch_ctx *)arg;
+   POOLMEM *fname = get_pool_memory(PM_FNAME);
+   pf_item *item;
+   bool ok;
+
+   P(pf->mutex);
+   while (!pf->quit) {
+      if (pf->count == 0) {
+         pthread_cond_wait(&pf->cond, &pf->mutex);
+         continue;
+      }
+      item = &pf->items[pf->first];
+      pf->first = (pf->first + 1) % pf->size;
+      pf->count--;
+      ok = item->id != 0;
+      item->id = 0;
+      if (!ok) {
+         continue;                    /* canceled */
+      }
+      pm_strcpy(fname, item->fname);
+      V(pf->mutex);
+      prefetch_file(pf, fname);
+      P(pf->mutex);
+   }
+   V(pf->mutex);
+   free_pool_memory(fname);
+   return NULL;
+}
+
+/*
+ * Queue a file for the helper threads, return its id
+ *  or 0 if the queue is full.
+ */
+static uint64_t prefetch_queue(prefetch_ctx *pf, const char *fname)
+{
+   pf_item *item;
+   uint64_t id;
+
+   P(pf->mutex);
+   if (pf->count == pf->size) {
+      pf->nb_dropped++;
+      V(pf->mutex);
+      return 0;
+   }
+   /* The ring and the ids advance together, see prefetch_cancel() */
+   item = &pf->items[(pf->first + pf->count) % pf->size];
+   id = ++pf->next_id;
+   item->id = id;
+   pm_strcpy(item->fname, fname);
+   pf->count++;
+   pf->nb_queued++;
+   pthread_cond_signal(&pf->cond);
+   V(pf->mutex);
+   return id;
+}
+
+/*
+ * The job thread has come to this file, a helper would do the
+ *  work a second time.
+ */
+static void prefetch_cancel(prefetch_ctx *pf, uint64_t id)
+{
+   pf_item *item;
+
+   if (id == 0) {
+      return;
+   }
+   P(pf->mutex);
+   item = &pf->items[(id - 1) % pf->size];
+   if (item->id == id) {
+      item->id = 0;
+      pf->nb_canceled++;
+   }
+   V(pf->mutex);
+}
+
+static prefetch_ctx *new_prefetch(JCR *jcr, FF_PKT *ff)
+{
+   prefetch_ctx *pf;
+   int i, stat;
+
+   pf = (prefetch_ctx *)malloc(sizeof(prefetch_ctx));
+   memset(pf, 0, sizeof(prefetch_ctx));
+   pf->jcr = jcr;
+   pf->incremental = ff->incremental;
+   pf->save_time = ff->save_time;
+   pf->size = ff->prefetch_files * PREFETCH_QUEUE_FACTOR;
+   pf->items = (pf_item *)malloc(pf->size * sizeof(pf_item));
+   for (i = 0; i < pf->size; i++) {
+      pf->items[i].id = 0;
+      pf->items[i].fname = get_pool_memory(PM_FNAME);
+   }
+   pthread_mutex_init(&pf->mutex, NULL);
+   pthread_cond_init(&pf->cond, NULL);
+   for (i = 0; i < MIN(ff->prefetch_files, PREFETCH_THREADS); i++) {
+      if ((stat = pthread_create(&pf->threads[i], NULL, prefetch_thread, pf)) != 0) {
+         berrno be;
+         Dmsg1(50, "Unable to start prefetch thread: ERR=%s\n", be.bstrerror(stat));
+         break;
+      }
+      pf->nb_threads++;
+   }
+   Dmsg3(dbglvl, "JobId=%d prefetch %d files with %d threads\n",
+         jcr->JobId, ff->prefetch_files, pf->nb_threads);
+   return pf;
+}
+
+/*
+ * Start to read a directory. Return NULL when the files of the
+ *  directory are not prefetched, prefetch_readdir() then reads
+ *  the directory entries one by one.
+ */
+prefetch_dir *prefetch_opendir(JCR *jcr, FF_PKT *ff, const char *path)
+{
+   prefetch_dir *pd;
+   int i;
+
+   if (ff->prefetch_files <= 0) {
+      return NULL;
+   }
+   ff->prefetch_files = MIN(ff->prefetch_files, PREFETCH_MAX_FILES);
+   if (!ff->prefetch) {
+      ff->prefetch = new_prefetch(jcr, ff);
+   }
+   if (ff->prefetch->nb_threads == 0) {
+      return NULL;
+   }
+   pd = (prefetch_dir *)malloc(sizeof(prefetch_dir));
+   memset(pd, 0, sizeof(prefetch_dir));
+   pd->pf = ff->prefetch;
+   pd->size = ff->prefetch_files;
+   pd->names = (POOLMEM **)malloc(pd->size * sizeof(POOLMEM *));
+   pd->ids = (uint64_t *)malloc(pd->size * sizeof(uint64_t));
+   for (i = 0; i < pd->size; i++) {
+      pd->names[i] = get_pool_memory(PM_FNAME);
+   }
+   pd->path = get_pool_memory(PM_FNAME);
+   pd->plen = pm_strcpy(pd->path, path);
+   return pd;
+}
+
+/*
+ * Return the next entry of the directory, like breaddir(), after
+ *  having read and queued the entries of the window ahead of it.
+ */
+int prefetch_readdir(prefetch_dir *pd, DIR *dirp, POOLMEM *&d_name)
+{
+   char *p;
+   int i;
+
+   if (!pd) {
+      return breaddir(dirp, d_name);
+   }
+   while (pd->status == 0 && pd->count < pd->size) {
+      i = (pd->first + pd->count) % pd->size;
+      pd->status = breaddir(dirp, pd->names[i]);
+      if (pd->status != 0) {
+         break;                       /* error or end of directory */
+      }
+      pd->count++;
+      pd->ids[i] = 0;
+      p = pd->names[i];
+      if (p[0] == '\0' || (p[0] == '.' && (p[1] == '\0' ||
+          (p[1] == '.' && p[2] == '\0')))) {
+         continue;
+      }
+      pd->path = check_pool_memory_size(pd->path, pd->plen + strlen(p) + 1);
+      strcpy(pd->path + pd->plen, p);
+      pd->ids[i] = prefetch_queue(pd->pf, pd->path);
+   }
+   if (pd->count == 0) {
+      return pd->status;
+   }
+   i = pd->first;
+   pm_strcpy(d_name, pd->names[i]);
+   prefetch_cancel(pd->pf, pd->ids[i]);
+   pd->first = (pd->first + 1) % pd->size;
+   pd->count--;
+   return 0;
+}
+
+void prefetch_closedir(prefetch_dir *pd)
+{
+   int i;
+
+   if (!pd) {
+      return;
+   }
+   /* The job may stop before the end of the directory */
+   for (i = 0; i < pd->count; i++) {
+      prefetch_cancel(pd->pf, pd->ids[(pd->first + i) % pd->size]);
+   }
+   for (i = 0; i < pd->size; i++) {
+      free_pool_memory(pd->names[i]);
+   }
+   free_pool_memory(pd->path);
+   free(pd->names);
+   free(pd->ids);
+   free(pd);
+}
+
+/*
+ * Stop the helper threads
+ */
+void term_find_prefetch(FF_PKT *ff)
+{
+   prefetch_ctx *pf = ff->prefetch;
+   int i;
+
+   if (!pf) {
+      return;
+   }
+   P(pf->mutex);
+   pf->quit = true;
+   pthread_cond_broadcast(&pf->cond);
+   V(pf->mutex);
+   for (i = 0; i < pf->nb_threads; i++) {
+      pthread_join(pf->threads[i], NULL);
+   }
+   Dmsg5(dbglvl, "JobId=%d prefetch queued=%lld read=%lld canceled=%lld dropped=%lld\n",
+         pf->jcr->JobId, pf->nb_queued, pf->nb_read, pf->nb_canceled, pf->nb_dropped);
+   for (i = 0; i < pf->size; i++) {
+      free_pool_memory(pf->items[i].fname);
+   }
+   free(pf->items);
+   pthread_cond_destroy(&pf->cond);
+   pthread_mutex_destroy(&pf->mutex);
+   free(pf);
+   ff->prefetch = NULL;
+}
+
+#else /* HAVE_WIN32 */
+
+prefetch_dir *prefetch_opendir(JCR *jcr, FF_PKT *ff, const char *path)
+{
+   return NULL;
+}
+
+int prefetch_readdir(prefetch_dir *pd, DIR *dirp, POOLMEM *&d_name)
+{
+   return breaddir(dirp, d_name);
+}
+
+void prefetch_closedir(prefetch_dir *pd) { }
+
+void term_find_prefetch(FF_PKT *ff) { }
+
+#endif /* HAVE_WIN32 */
@@ -29,6 +29,8 @@ int     decode_stat       (char *buf, struct stat *statp, int stat_size, int32_t
 int32_t decode_LinkFI     (char *buf, struct stat *statp, int stat_size);
 int     encode_attribsEx  (JCR *jcr, char *attribsEx, FF_PKT *ff_pkt);
 bool    set_attributes    (JCR *jcr, ATTR *attr, BFILE *ofd);
+bool    set_unix_attributes(JCR *jcr, ATTR *attr, BFILE *ofd);
+void    check_restored_size(JCR *jcr, ATTR *attr, BFILE *ofd);
 int     select_data_stream(FF_PKT *ff_pkt);
 
 /* from create_file.c */
@@ -40,6 +42,11 @@ void set_find_snapshot_function(FF_PKT *ff,
                                 bool convert_path(JCR *jcr, FF_PKT *ff, dlist *filelist, dlistString *node));
 void  set_find_options(FF_PKT *ff, int incremental, time_t mtime);
 void set_find_changed_function(FF_PKT *ff, bool check_fct(JCR *jcr, FF_PKT *ff));
+void set_find_journal_function(FF_PKT *ff, bool journal_fct(JCR *jcr, FF_PKT *ff, char *top_fname),
+                               void *ctx);
+void set_find_prefetch(FF_PKT *ff, int32_t nb_files);
+int   find_journal_entry(JCR *jcr, FF_PKT *ff, char *top_fname, char *fname,
+                         dev_t top_dev, bool dir_only);
 int   find_files(JCR *jcr, FF_PKT *ff, int file_sub(JCR *, FF_PKT *ff_pkt, bool),
                  int plugin_sub(JCR *, FF_PKT *ff_pkt, bool));
 int   match_files(JCR *jcr, FF_PKT *ff, int sub(JCR *, FF_PKT *ff_pkt, bool));
@@ -64,9 +71,17 @@ int   find_one_file(JCR *jcr, FF_PKT *ff,
 int   term_find_one(FF_PKT *ff);
 bool  has_file_changed(JCR *jcr, FF_PKT *ff_pkt);
 bool check_changes(JCR *jcr, FF_PKT *ff_pkt);
+bool have_ignoredir(FF_PKT *ff_pkt);
 void ff_pkt_set_link_digest(FF_PKT *ff_pkt,
                             int32_t digest_stream, const char *digest, uint32_t len);
 
+/* From prefetch.c */
+struct prefetch_dir;
+prefetch_dir *prefetch_opendir(JCR *jcr, FF_PKT *ff, const char *path);
+int   prefetch_readdir(prefetch_dir *pd, DIR *dirp, POOLMEM *&d_name);
+void  prefetch_closedir(prefetch_dir *pd);
+void  term_find_prefetch(FF_PKT *ff);
+
 /* From get_priv.c */
 int enable_backup_privileges(JCR *jcr, int ignore_errors);
 
@@ -156,11 +156,12 @@ class DedupStoredInterfaceBase;
 
 #ifdef FILE_DAEMON
 class VSSClient;
-class htable;
+class ohtable;
 class BACL;
 class BXATTR;
 class snapshot_manager;
 class bnet_poll_manager;
+struct digest_pipe;
 
 struct CRYPTO_CTX {
    bool pki_sign;                     /* Enable PKI Signatures? */
@@ -173,6 +174,7 @@ struct CRYPTO_CTX {
    POOLMEM *pki_session_encoded;      /* Cached DER-encoded copy of pki_session */
    int32_t pki_session_encoded_size;  /* Size of DER-encoded pki_session */
    POOLMEM *crypto_buf;               /* Encryption/Decryption buffer */
+   digest_pipe *dpipe;                /* Digest helper thread */
 };
 #endif
 
@@ -301,6 +303,7 @@ public:
    bool authenticated;                /* set when client authenticated */
    bool cached_attribute;             /* set if attribute is cached */
    bool batch_started;                /* is batch mode already started ? */
+   bool bvfs_batch_cache;             /* Fill the BVFS cache from the batch table */
    bool cmd_plugin;                   /* Set when processing a command Plugin = */
    bool opt_plugin;                   /* Set when processing an option Plugin = */
    bool keep_path_list;               /* Keep newly created path in a hash */
@@ -482,7 +485,7 @@ public:
    bool got_metadata;                 /* set when found job_metatdata */
    bool multi_restore;                /* Dir can do multiple storage restore */
    bool interactive_session;          /* Use interactive session with the SD */
-   htable *file_list;                 /* Previous file list (accurate mode) */
+   ohtable *file_list;                /* Previous file list (accurate mode) */
    uint64_t base_size;                /* compute space saved with base job */
    utime_t snapshot_retention;        /* Snapshot retention (from director) */
    snapshot_manager *snap_mgr;        /* Snapshot manager */
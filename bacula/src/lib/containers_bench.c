@@ -0,0 +1,673 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *
+ *  Micro-benchmark of the library containers
+ *
+ *  For each container, the same number of items is inserted, looked
+ *   up in a scattered order, walked and freed, and one JSON line is
+ *   printed per operation with the elapsed time, the throughput and
+ *   the memory used per item after the insert. The keys are the
+ *   ones the daemons use: a path like string for htable and ohtable
+ *   (accurate list), a 64 bit integer for htable-int, ohtable-int,
+ *   rblist, dlist and alist, and a file name in a directory of 1000
+ *   files for the restore tree. mem_pool gets and frees PM_FNAME buffers by batches of 1000.
+ *
+ *  The memory is the number of bytes allocated by smartalloc when
+ *   it is enabled, otherwise the growth of the heap, which does not
+ *   see the big buffers obtained with mmap().
+ *
+ *  Example:
+ *   containers_bench -n 10000000 -t htable,rblist -o /tmp/bench.json
+ *
+ */
+
+#include "bacula.h"
+
+/* Fields of each JSON line */
+struct BENCH_RESULT {
+   const char *container;
+   const char *op;
+   uint64_t items;
+   btime_t elapsed;                   /* microseconds */
+   uint64_t mem;                      /* bytes used after insert */
+};
+
+typedef void (BENCH_FUNC)(uint64_t nb);
+
+static FILE *out;
+static int run = 1;
+static uint32_t nb_errors = 0;
+static uint64_t alist_grow = 0;
+
+#define BENCH_BATCH 1000              /* tree directory size and mem_pool batch */
+
+/*
+ * Memory in use by the program
+ */
+static uint64_t mem_used()
+{
+#ifdef SMARTALLOC
+   return sm_bytes;
+#else
+   return heap_used();
+#endif
+}
+
+/*
+ * Spread the keys, this is a bijection on 64 bits, so all
+ *  the keys are different.
+ */
+static inline uint64_t mix_key(uint64_t i)
+{
+   return (i + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+/*
+ * Index of the lookup number i. Visiting i * stride modulo nb
+ *  reaches all the items once when stride and nb are coprime,
+ *  in an order that defeats the CPU caches.
+ */
+static uint64_t get_stride(uint64_t nb)
+{
+   uint64_t stride = nb / 2 + 7919;
+   for (;;) {
+      uint64_t a = stride, b = nb;
+      while (b) {
+         uint64_t t = a % b;
+         a = b;
+         b = t;
+      }
+      if (a == 1) {
+         return stride;
+      }
+      stride++;
+   }
+}
+
+/*
+ * Make a path like key, faster than a printf that would be
+ *  the main part of the lookup time.
+ */
+static int make_path_key(char *buf, uint64_t i)
+{
+   static const char prefix[] = "/home/bench/data/file-";
+   static const char hex[] = "0123456789abcdef";
+   uint64_t key = mix_key(i);
+   char *p = buf + sizeof(prefix) - 1;
+
+   memcpy(buf, prefix, sizeof(prefix) - 1);
+   for (int j = 60; j >= 0; j -= 4) {
+      *p++ = hex[(key >> j) & 0xF];
+   }
+   *p++ = 0;
+   return p - buf;
+}
+
+static void report(BENCH_RESULT *r)
+{
+   double sec = r->elapsed / 1000000.0;
+   fprintf(out, "{\"container\":\"%s\",\"op\":\"%s\",\"run\":%d,\"items\":%llu,"
+           "\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"bytes_per_item\":%.1f}\n",
+           r->container, r->op, run, (unsigned long long)r->items,
+           sec, sec > 0 ? r->items / sec : 0,
+           r->items > 0 ? (double)r->mem / r->items : 0);
+   fflush(out);
+}
+
+/* Time one operation, the memory is kept from the insert */
+#define bench_start(r, name)  do { (r).op = (name); (r).elapsed = get_current_btime(); } while (0)
+#define bench_end(r)          do { (r).elapsed = get_current_btime() - (r).elapsed; report(&(r)); } while (0)
+
+static void check(bool ok, const char *container, const char *what)
+{
+   if (!ok) {
+      Pmsg2(0, _("Error: %s %s\n"), container, what);
+      nb_errors++;
+   }
+}
+
+/* ==================================================================
+ *  htable and ohtable with path keys, as the accurate file list,
+ *   and with integer keys, as the hardlink lists. The items of
+ *   an ohtable do not have an hlink.
+ */
+struct HT_ITEM {
+   hlink link;
+   char *key;
+};
+
+struct OHT_ITEM {
+   char *key;
+};
+
+struct HTI_ITEM {
+   hlink link;
+   uint64_t value;
+};
+
+struct OHTI_ITEM {
+   uint64_t value;
+};
+
+static htable *new_table(HT_ITEM *item, uint64_t nb)
+{
+   return New(htable(item, &item->link, nb));
+}
+
+static ohtable *new_table(OHT_ITEM *item, uint64_t nb)
+{
+   return New(ohtable(item, NULL, nb));
+}
+
+static htable *new_table(HTI_ITEM *item, uint64_t nb)
+{
+   return New(htable(item, &item->link, nb));
+}
+
+static ohtable *new_table(OHTI_ITEM *item, uint64_t nb)
+{
+   return New(ohtable(item, NULL, nb));
+}
+
+template <typename TABLE, typename ITEM>
+static void bench_hash(const char *name, uint64_t nb)
+{
+   BENCH_RESULT r = {name, NULL, nb, 0, 0};
+   uint64_t base, count = 0, stride = get_stride(nb);
+   char key[64];
+   ITEM *item = NULL;
+   TABLE *tbl;
+
+   base = mem_used();
+   bench_start(r, "insert");
+   tbl = new_table(item, nb);
+   for (uint64_t i = 0; i < nb; i++) {
+      int len = make_path_key(key, i);
+      item = (ITEM *)tbl->hash_malloc(sizeof(ITEM));
+      item->key = tbl->hash_malloc(len);
+      memcpy(item->key, key, len);
+      tbl->insert(item->key, item);
+   }
+   r.mem = mem_used() - base;
+   bench_end(r);
+   check(tbl->size() == nb, r.container, "size after insert");
+
+   bench_start(r, "lookup");
+   for (uint64_t i = 0; i < nb; i++) {
+      make_path_key(key, (i * stride) % nb);
+      if (tbl->lookup(key)) {
+         count++;
+      }
+   }
+   bench_end(r);
+   check(count == nb, r.container, "lookup");
+
+   count = 0;
+   bench_start(r, "iterate");
+   foreach_htable(item, tbl) {
+      count++;
+   }
+   bench_end(r);
+   check(count == nb, r.container, "iterate");
+
+   bench_start(r, "free");
+   delete tbl;
+   bench_end(r);
+}
+
+template <typename TABLE, typename ITEM>
+static void bench_hash_int(const char *name, uint64_t nb)
+{
+   BENCH_RESULT r = {name, NULL, nb, 0, 0};
+   uint64_t base, count = 0, stride = get_stride(nb);
+   ITEM *item = NULL;
+   TABLE *tbl;
+
+   base = mem_used();
+   bench_start(r, "insert");
+   tbl = new_table(item, nb);
+   for (uint64_t i = 0; i < nb; i++) {
+      item = (ITEM *)tbl->hash_malloc(sizeof(ITEM));
+      item->value = i;
+      tbl->insert(mix_key(i), item);
+   }
+   r.mem = mem_used() - base;
+   bench_end(r);
+   check(tbl->size() == nb, r.container, "size after insert");
+
+   bench_start(r, "lookup");
+   for (uint64_t i = 0; i < nb; i++) {
+      uint64_t j = (i * stride) % nb;
+      item = (ITEM *)tbl->lookup(mix_key(j));
+      if (item && item->value == j) {
+         count++;
+      }
+   }
+   bench_end(r);
+   check(count == nb, r.container, "lookup");
+
+   count = 0;
+   bench_start(r, "iterate");
+   foreach_htable(item, tbl) {
+      count++;
+   }
+   bench_end(r);
+   check(count == nb, r.container, "iterate");
+
+   bench_start(r, "free");
+   delete tbl;
+   bench_end(r);
+}
+
+static void bench_htable(uint64_t nb)
+{
+   bench_hash<htable, HT_ITEM>("htable", nb);
+}
+
+static void bench_htable_int(uint64_t nb)
+{
+   bench_hash_int<htable, HTI_ITEM>("htable-int", nb);
+}
+
+static void bench_ohtable(uint64_t nb)
+{
+   bench_hash<ohtable, OHT_ITEM>("ohtable", nb);
+}
+
+static void bench_ohtable_int(uint64_t nb)
+{
+   bench_hash_int<ohtable, OHTI_ITEM>("ohtable-int", nb);
+}
+
+/* ==================================================================
+ *  rblist
+ */
+struct RB_ITEM {
+   rblink link;
+   uint64_t key;
+};
+
+static int rb_compare(void *item1, void *item2)
+{
+   uint64_t k1 = ((RB_ITEM *)item1)->key;
+   uint64_t k2 = ((RB_ITEM *)item2)->key;
+   return k1 < k2 ? -1 : (k1 > k2 ? 1 : 0);
+}
+
+static void bench_rblist(uint64_t nb)
+{
+   BENCH_RESULT r = {"rblist", NULL, nb, 0, 0};
+   uint64_t base, count = 0, stride = get_stride(nb);
+   RB_ITEM *item = NULL, search;
+   rblist *tree;
+
+   base = mem_used();
+   bench_start(r, "insert");
+   tree = New(rblist(item, &item->link));
+   for (uint64_t i = 0; i < nb; i++) {
+      item = (RB_ITEM *)malloc(sizeof(RB_ITEM));
+      item->key = mix_key(i);
+      tree->insert(item, rb_compare);
+   }
+   r.mem = mem_used() - base;
+   bench_end(r);
+   check((uint64_t)tree->size() == nb, r.container, "size after insert");
+
+   bench_start(r, "lookup");
+   for (uint64_t i = 0; i < nb; i++) {
+      search.key = mix_key((i * stride) % nb);
+      if (tree->search(&search, rb_compare)) {
+         count++;
+      }
+   }
+   bench_end(r);
+   check(count == nb, r.container, "lookup");
+
+   count = 0;
+   bench_start(r, "iterate");
+   foreach_rblist(item, tree) {
+      count++;
+   }
+   bench_end(r);
+   check(count == nb, r.container, "iterate");
+
+   bench_start(r, "free");
+   delete tree;
+   bench_end(r);
+}
+
+/* ==================================================================
+ *  dlist, a lookup is a walk, so it is not measured
+ */
+struct DL_ITEM {
+   dlink link;
+   uint64_t key;
+};
+
+static void bench_dlist(uint64_t nb)
+{
+   BENCH_RESULT r = {"dlist", NULL, nb, 0, 0};
+   uint64_t base, count = 0;
+   DL_ITEM *item = NULL;
+   dlist *list;
+
+   base = mem_used();
+   bench_start(r, "insert");
+   list = New(dlist(item, &item->link));
+   for (uint64_t i = 0; i < nb; i++) {
+      item = (DL_ITEM *)malloc(sizeof(DL_ITEM));
+      item->key = mix_key(i);
+      list->append(item);
+   }
+   r.mem = mem_used() - base;
+   bench_end(r);
+   check((uint64_t)list->size() == nb, r.container, "size after insert");
+
+   bench_start(r, "iterate");
+   foreach_dlist(item, list) {
+      count++;
+   }
+   bench_end(r);
+   check(count == nb, r.container, "iterate");
+
+   bench_start(r, "free");
+   delete list;
+   bench_end(r);
+}
+
+/* ==================================================================
+ *  alist, grows by a fixed number of slots, see -g
+ */
+static void bench_alist(uint64_t nb)
+{
+   BENCH_RESULT r = {"alist", NULL, nb, 0, 0};
+   uint64_t base, count = 0, stride = get_stride(nb);
+   uint64_t grow = alist_grow ? alist_grow : MAX(nb / 10, 100);
+   uint64_t *item;
+   alist *list;
+
+   base = mem_used();
+   bench_start(r, "insert");
+   list = New(alist(grow, owned_by_alist));
+   for (uint64_t i = 0; i < nb; i++) {
+      item = (uint64_t *)malloc(sizeof(uint64_t));
+      *item = i;
+      list->append(item);
+   }
+   r.mem = mem_used() - base;
+   bench_end(r);
+   check((uint64_t)list->size() == nb, r.container, "size after insert");
+
+   bench_start(r, "lookup");
+   for (uint64_t i = 0; i < nb; i++) {
+      uint64_t j = (i * stride) % nb;
+      item = (uint64_t *)list->get(j);
+      if (item && *item == j) {
+         count++;
+      }
+   }
+   bench_end(r);
+   check(count == nb, r.container, "lookup");
+
+   count = 0;
+   bench_start(r, "iterate");
+   foreach_alist(item, list) {
+      count++;
+   }
+   bench_end(r);
+   check(count == nb, r.container, "iterate");
+
+   bench_start(r, "free");
+   delete list;
+   bench_end(r);
+}
+
+/* ==================================================================
+ *  Restore tree, the lookup is an insert of an existing file
+ *   as done when the same file comes from several jobs
+ */
+static void make_tree_entry(char *path, char *fname, uint64_t i)
+{
+   bsnprintf(path, 64, "/home/bench/d%llx", (unsigned long long)(i / BENCH_BATCH));
+   bsnprintf(fname, 64, "f%llx", (unsigned long long)mix_key(i));
+}
+
+static void bench_tree(uint64_t nb)
+{
+   BENCH_RESULT r = {"tree", NULL, nb, 0, 0};
+   uint64_t base, count = 0, stride = get_stride(nb);
+   char path[64], fname[64];
+   TREE_ROOT *root;
+   TREE_NODE *node;
+
+   base = mem_used();
+   bench_start(r, "insert");
+   root = new_tree(MIN(nb, (uint64_t)INT32_MAX));
+   for (uint64_t i = 0; i < nb; i++) {
+      make_tree_entry(path, fname, i);
+      node = insert_tree_node(path, fname, TN_FILE, root, NULL);
+      if (node && node->inserted) {
+         node->type = TN_FILE;        /* set by the caller, see ua_tree.c */
+         count++;
+      }
+   }
+   r.mem = mem_used() - base;
+   bench_end(r);
+   check(count == nb, r.container, "insert");
+
+   count = 0;
+   bench_start(r, "lookup");
+   for (uint64_t i = 0; i < nb; i++) {
+      make_tree_entry(path, fname, (i * stride) % nb);
+      node = insert_tree_node(path, fname, TN_FILE, root, NULL);
+      if (node && !node->inserted) {
+         count++;
+      }
+   }
+   bench_end(r);
+   check(count == nb, r.container, "lookup");
+
+   count = 0;
+   bench_start(r, "iterate");
+   for (node = first_tree_node(root); node; node = next_tree_node(node)) {
+      if (node->type == TN_FILE) {
+         count++;
+      }
+   }
+   bench_end(r);
+   check(count == nb, r.container, "iterate");
+
+   bench_start(r, "free");
+   free_tree(root);
+   bench_end(r);
+}
+
+/* ==================================================================
+ *  mem_pool, get and free by batches of buffers
+ */
+static void bench_mem_pool(uint64_t nb)
+{
+   BENCH_RESULT r = {"mem_pool", NULL, nb, 0, 0};
+   POOLMEM *bufs[BENCH_BATCH];
+   btime_t get_time = 0, free_time = 0, start;
+   uint64_t base, done;
+   int n = 0;
+
+   base = mem_used();
+   for (done = 0; done < nb; done += n) {
+      n = (int)MIN((uint64_t)BENCH_BATCH, nb - done);
+      start = get_current_btime();
+      for (int i = 0; i < n; i++) {
+         bufs[i] = get_pool_memory(PM_FNAME);
+      }
+      get_time += get_current_btime() - start;
+      if (done == 0) {
+         r.mem = (mem_used() - base) * nb / n;
+      }
+      start = get_current_btime();
+      for (int i = 0; i < n; i++) {
+         free_pool_memory(bufs[i]);
+      }
+      free_time += get_current_btime() - start;
+   }
+   r.op = "get";
+   r.elapsed = get_time;
+   report(&r);
+   r.op = "free";
+   r.elapsed = free_time;
+   report(&r);
+   garbage_collect_memory();
+}
+
+static struct {
+   const char *name;
+   BENCH_FUNC *func;
+   bool selected;
+} benchs[] = {
+   {"htable",     bench_htable,     false},
+   {"htable-int", bench_htable_int, false},
+   {"ohtable",    bench_ohtable,    false},
+   {"ohtable-int", bench_ohtable_int, false},
+   {"rblist",     bench_rblist,     false},
+   {"dlist",      bench_dlist,      false},
+   {"alist",      bench_alist,      false},
+   {"tree",       bench_tree,       false},
+   {"mem_pool",   bench_mem_pool,   false},
+   {NULL,         NULL,             false}
+};
+
+static void usage()
+{
+   fprintf(stderr, _(
+PROG_COPYRIGHT
+"\n%sVersion: %s (%s)\n"
+"Example : containers_bench -n 10000000 -t htable,rblist\n"
+" will insert, lookup, walk and free 10 million items in htable and rblist\n\n"
+"Usage: containers_bench [ options ]\n"
+"       -n <nb>           number of items (default 1000000)\n"
+"       -t <list>         comma separated containers (default all)\n"
+"                         htable, htable-int, ohtable, ohtable-int, rblist,\n"
+"                         dlist, alist, tree, mem_pool\n"
+"       -r <nb>           number of runs (default 1)\n"
+"       -g <nb>           alist grow size (default 10%% of the items)\n"
+"       -o <file>         write the JSON lines to file (default stdout)\n"
+"       -dnn              set debug level to nn\n"
+"       -?                print this message\n\n"), 2022, "", VERSION, BDATE);
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+   int ch, nb_runs = 1;
+   uint64_t nb = 1000000;
+   const char *list = NULL, *output = NULL;
+   bool found;
+
+   setlocale(LC_ALL, "");
+   bindtextdomain("bacula", LOCALEDIR);
+   textdomain("bacula");
+   lmgr_init_thread();
+
+   my_name_is(argc, argv, "containers_bench");
+   init_msg(NULL, NULL);
+
+   while ((ch = getopt(argc, argv, "n:t:r:g:o:d:?")) != -1) {
+      switch (ch) {
+      case 'n':
+         nb = str_to_uint64(optarg);
+         break;
+
+      case 't':
+         list = optarg;
+         break;
+
+      case 'r':
+         nb_runs = atoi(optarg);
+         break;
+
+      case 'g':
+         alist_grow = str_to_uint64(optarg);
+         break;
+
+      case 'o':
+         output = optarg;
+         break;
+
+      case 'd':                    /* debug level */
+         debug_level = atoi(optarg);
+         if (debug_level <= 0) {
+            debug_level = 1;
+         }
+         break;
+
+      case '?':
+      default:
+         usage();
+      }
+   }
+   if (argc - optind != 0 || nb == 0 || nb > INT32_MAX || nb_runs < 1) {
+      usage();
+   }
+
+   /* All the names must be known */
+   if (list) {
+      char *names = bstrdup(list);
+      char *name, *p = names;
+      while ((name = next_name(&p))) {
+         found = false;
+         for (int i = 0; benchs[i].name; i++) {
+            if (strcmp(benchs[i].name, name) == 0) {
+               benchs[i].selected = found = true;
+            }
+         }
+         if (!found) {
+            Pmsg1(0, _("Unknown container: %s\n"), name);
+            usage();
+         }
+      }
+      free(names);
+   } else {
+      for (int i = 0; benchs[i].name; i++) {
+         benchs[i].selected = true;
+      }
+   }
+
+   out = stdout;
+   if (output && !(out = bfopen(output, "w"))) {
+      berrno be;
+      Pmsg2(0, _("Could not open %s. ERR=%s\n"), output, be.bstrerror());
+      exit(1);
+   }
+
+   for (run = 1; run <= nb_runs; run++) {
+      for (int i = 0; benchs[i].name; i++) {
+         if (benchs[i].selected) {
+            benchs[i].func(nb);
+         }
+      }
+   }
+
+   if (out != stdout) {
+      fclose(out);
+   }
+   term_msg();
+   close_memory_pool();
+   return nb_errors ? 1 : 0;
+}
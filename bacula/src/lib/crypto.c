@@ -276,6 +276,7 @@ struct Digest {
    crypto_digest_t type;
    JCR *jcr;
    EVP_MD_CTX *ctx;
+   XXH64Context xxh64;                /* Not provided by OpenSSL */
 };
 
 /* Message Signature Structure */
@@ -601,6 +602,13 @@ DIGEST *crypto_digest_new(JCR *jcr, crypto_digest_t type)
    digest->jcr = jcr;
    Dmsg1(150, "crypto_digest_new jcr=%p\n", jcr);
 
+   /* The fast hash is computed by Bacula, not by OpenSSL */
+   if (type == CRYPTO_DIGEST_XXH64) {
+      digest->ctx = NULL;
+      XXH64Init(&digest->xxh64, 0);
+      return digest;
+   }
+
    /* Initialize the OpenSSL message digest context */
    digest->ctx = EVP_MD_CTX_new();
    if (!digest->ctx) {
@@ -651,6 +659,10 @@ err:
  */
 bool crypto_digest_update(DIGEST *digest, const uint8_t *data, uint32_t length)
 {
+   if (digest->type == CRYPTO_DIGEST_XXH64) {
+      XXH64Update(&digest->xxh64, data, length);
+      return true;
+   }
    if (EVP_DigestUpdate(digest->ctx, data, length) == 0) {
       Dmsg0(150, "digest update failed\n");
       openssl_post_errors(digest->jcr, M_ERROR, _("OpenSSL digest update failed"));
@@ -669,6 +681,12 @@ bool crypto_digest_update(DIGEST *digest, const uint8_t *data, uint32_t length)
  */
 bool crypto_digest_finalize(DIGEST *digest, uint8_t *dest, uint32_t *length)
 {
+   if (digest->type == CRYPTO_DIGEST_XXH64) {
+      assert(*length >= CRYPTO_DIGEST_XXH64_SIZE);
+      *length = CRYPTO_DIGEST_XXH64_SIZE;
+      XXH64Final(&digest->xxh64, dest);
+      return true;
+   }
    if (!EVP_DigestFinal(digest->ctx, dest, (unsigned int *)length)) {
       Dmsg0(150, "digest finalize failed\n");
       openssl_post_errors(digest->jcr, M_ERROR, _("OpenSSL digest finalize failed"));
@@ -683,7 +701,9 @@ bool crypto_digest_finalize(DIGEST *digest, uint8_t *dest, uint32_t *length)
  */
 void crypto_digest_free(DIGEST *digest)
 {
-  EVP_MD_CTX_free(digest->ctx);
+  if (digest->ctx) {
+     EVP_MD_CTX_free(digest->ctx);
+  }
   free(digest);
 }
 
@@ -1385,6 +1405,7 @@ struct Digest {
    union {
       SHA1Context sha1;
       MD5Context md5;
+      XXH64Context xxh64;
    };
 };
 
@@ -1408,6 +1429,9 @@ DIGEST *crypto_digest_new(JCR *jcr, crypto_digest_t type)
    case CRYPTO_DIGEST_SHA1:
       SHA1Init(&digest->sha1);
       break;
+   case CRYPTO_DIGEST_XXH64:
+      XXH64Init(&digest->xxh64, 0);
+      break;
    default:
       Jmsg1(jcr, M_ERROR, 0, _("Unsupported digest type=%d specified\n"), type);
       free(digest);
@@ -1433,6 +1457,9 @@ bool crypto_digest_update(DIGEST *digest, const uint8_t *data, uint32_t length)
          return false;
       }
       break;
+   case CRYPTO_DIGEST_XXH64:
+      XXH64Update(&digest->xxh64, data, length);
+      return true;
    default:
       return false;
    }
@@ -1460,6 +1487,11 @@ bool crypto_digest_finalize(DIGEST *digest, uint8_t *dest, uint32_t *length)
          return false;
       }
       break;
+   case CRYPTO_DIGEST_XXH64:
+      assert(*length >= CRYPTO_DIGEST_XXH64_SIZE);
+      *length = CRYPTO_DIGEST_XXH64_SIZE;
+      XXH64Final(&digest->xxh64, dest);
+      return true;
    default:
       return false;
    }
@@ -1533,6 +1565,8 @@ const char *crypto_digest_name(DIGEST *digest)
       return "SHA256";
    case CRYPTO_DIGEST_SHA512:
       return "SHA512";
+   case CRYPTO_DIGEST_XXH64:
+      return "XXH64";
    case CRYPTO_DIGEST_NONE:
       return "None";
    default:
@@ -1541,6 +1575,14 @@ const char *crypto_digest_name(DIGEST *digest)
 
 }
 
+/*
+ * Returns the type of the digest.
+ */
+crypto_digest_t crypto_digest_type(DIGEST *digest)
+{
+   return digest->type;
+}
+
 /*
  * Given a stream type, returns the associated
  * crypto_digest_t value.
@@ -1556,6 +1598,8 @@ crypto_digest_t crypto_digest_stream_type(int stream)
       return CRYPTO_DIGEST_SHA256;
    case STREAM_SHA512_DIGEST:
       return CRYPTO_DIGEST_SHA512;
+   case STREAM_XXH64_DIGEST:
+      return CRYPTO_DIGEST_XXH64;
    default:
       return CRYPTO_DIGEST_NONE;
    }
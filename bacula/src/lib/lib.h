@@ -42,6 +42,7 @@
 #include "queue.h"
 #include "serial.h"
 #include "message.h"
+#include "tracebuf.h"
 #include "bcollector.h"
 #include "openssl.h"
 #include "lex.h"
@@ -58,6 +59,7 @@
 #endif
 #include "md5.h"
 #include "sha1.h"
+#include "xxhash.h"
 #include "tree.h"
 #include "watchdog.h"
 #include "btimers.h"
@@ -67,6 +69,7 @@
 #include "var.h"
 #include "guid_to_name.h"
 #include "htable.h"
+#include "ohtable.h"
 #include "sellist.h"
 #include "output.h"
 #include "protos.h"
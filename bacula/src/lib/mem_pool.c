@@ -47,8 +47,8 @@ extern "C" int malloc_trim (size_t pad);
 struct s_pool_ctl {
    int32_t size;                      /* default size */
    int32_t max_allocated;             /* max allocated */
-   int32_t max_used;                  /* max buffers used */
-   int32_t in_use;                    /* number in use */
+   int32_t max_used;                  /* max buffers out */
+   int32_t nb_out;                    /* out of the free list, in use or cached */
    struct abufhead *free_buf;         /* pointer to free buffers */
 };
 
@@ -95,38 +95,259 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 #define HEAD_SIZE BALIGN(sizeof(struct abufhead))
 
-#ifdef SMARTALLOC
+/*
+ * Each thread keeps some free buffers of each pool, so most get
+ *  and free calls do not take the global mutex. Buffers move
+ *  between the thread cache and the global free list by batches.
+ *  The cache has its own mutex, it is contended only when another
+ *  thread gives the free buffers back to the free list in the
+ *  garbage collection or in close_memory_pool().
+ *
+ * The buffers of a cache are out of the free list but they are
+ *  not in use, nb_out in pool_ctl counts both.
+ */
+#define POOL_CACHE_MAX    32               /* max free buffers per pool */
+#define POOL_CACHE_BYTES  (256 * 1024)     /* max free bytes per pool */
+#define POOL_CACHE_BATCH  8                /* buffers taken from the free list at once */
+
+struct s_pool_cache {
+   pthread_mutex_t mutex;
+   pthread_t tid;                     /* owner thread */
+   struct s_pool_cache *next;         /* list of the caches, protected by mutex */
+   struct {
+      struct abufhead *free_buf;      /* free buffers of this thread */
+      int32_t count;                  /* number of free buffers */
+      int32_t bytes;                  /* size of the free buffers */
+      uint64_t hits;                  /* get served by the cache */
+      uint64_t misses;                /* get that went to the free list */
+   } pool[PM_MAX+1];
+};
 
-POOLMEM *sm_get_pool_memory(const char *fname, int lineno, int pool)
+static pthread_key_t pool_cache_key;
+static pthread_once_t pool_cache_once = PTHREAD_ONCE_INIT;
+static bool pool_cache_ok = false;
+static struct s_pool_cache *pool_caches = NULL;
+
+/*
+ * Give back the free buffers of a cache, called with mutex.
+ *  The mutexes are taken without the lock manager, at thread exit
+ *  its thread specific data may already be destroyed.
+ */
+static void pool_cache_flush(struct s_pool_cache *cache)
 {
    struct abufhead *buf;
 
-   if (pool > PM_MAX) {
-      Emsg2(M_ABORT, 0, _("MemPool index %d larger than max %d\n"), pool, PM_MAX);
+   lmgr_p(&cache->mutex);
+   for (int i=1; i<=PM_MAX; i++) {
+      while ((buf = cache->pool[i].free_buf) != NULL) {
+         cache->pool[i].free_buf = buf->next;
+         buf->next = pool_ctl[i].free_buf;
+         pool_ctl[i].free_buf = buf;
+         pool_ctl[i].nb_out--;
+      }
+      cache->pool[i].count = 0;
+      cache->pool[i].bytes = 0;
+   }
+   lmgr_v(&cache->mutex);
+}
+
+/* Called when a thread exits */
+static void pool_cache_destroy(void *arg)
+{
+   struct s_pool_cache *cache = (struct s_pool_cache *)arg;
+   struct s_pool_cache **prev;
+
+   lmgr_p(&mutex);
+   for (prev = &pool_caches; *prev; prev = &(*prev)->next) {
+      if (*prev == cache) {
+         *prev = cache->next;
+         break;
+      }
+   }
+   pool_cache_flush(cache);
+   lmgr_v(&mutex);
+   pthread_mutex_destroy(&cache->mutex);
+   actuallyfree(cache);
+}
+
+static void pool_cache_init()
+{
+   pool_cache_ok = pthread_key_create(&pool_cache_key, pool_cache_destroy) == 0;
+}
+
+static struct s_pool_cache *get_pool_cache()
+{
+   struct s_pool_cache *cache;
+
+   pthread_once(&pool_cache_once, pool_cache_init);
+   if (!pool_cache_ok) {
+      return NULL;
+   }
+   cache = (struct s_pool_cache *)pthread_getspecific(pool_cache_key);
+   if (cache) {
+      return cache;
+   }
+   /* Not tracked by smartalloc, the main thread cache is never freed */
+   cache = (struct s_pool_cache *)actuallymalloc(sizeof(struct s_pool_cache));
+   if (!cache) {
+      return NULL;
+   }
+   memset(cache, 0, sizeof(struct s_pool_cache));
+   pthread_mutex_init(&cache->mutex, NULL);
+   cache->tid = pthread_self();
+   if (pthread_setspecific(pool_cache_key, cache) != 0) {
+      pthread_mutex_destroy(&cache->mutex);
+      actuallyfree(cache);
+      return NULL;
+   }
+   P(mutex);
+   cache->next = pool_caches;
+   pool_caches = cache;
+   V(mutex);
+   return cache;
+}
+
+/*
+ * Get a free buffer from the thread cache, refill the cache
+ *  from the free list when it is empty.
+ *  Returns: NULL if a new buffer must be allocated
+ */
+static struct abufhead *pool_cache_get(int pool)
+{
+   struct s_pool_cache *cache = get_pool_cache();
+   struct abufhead *buf, *first = NULL, *last = NULL;
+   int count = 0, bytes = 0;
+
+   if (!cache) {
+      return NULL;
+   }
+   P(cache->mutex);
+   if ((buf = cache->pool[pool].free_buf) != NULL) {
+      cache->pool[pool].free_buf = buf->next;
+      cache->pool[pool].count--;
+      cache->pool[pool].bytes -= buf->ablen;
+      cache->pool[pool].hits++;
+      V(cache->mutex);
+      return buf;
    }
+   cache->pool[pool].misses++;
+   V(cache->mutex);
+
+   /* Take a batch from the free list, keep the first one */
    P(mutex);
-   if (pool_ctl[pool].free_buf) {
+   while (count < POOL_CACHE_BATCH && pool_ctl[pool].free_buf) {
       buf = pool_ctl[pool].free_buf;
       pool_ctl[pool].free_buf = buf->next;
-      pool_ctl[pool].in_use++;
-      if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-         pool_ctl[pool].max_used = pool_ctl[pool].in_use;
+      buf->next = NULL;
+      if (last) {
+         last->next = buf;
+      } else {
+         first = buf;
       }
-      V(mutex);
+      last = buf;
+      bytes += buf->ablen;
+      count++;
+   }
+   pool_ctl[pool].nb_out += count;
+   if (pool_ctl[pool].nb_out > pool_ctl[pool].max_used) {
+      pool_ctl[pool].max_used = pool_ctl[pool].nb_out;
+   }
+   V(mutex);
+   if (!first) {
+      return NULL;
+   }
+   buf = first;
+   if (count > 1) {
+      P(cache->mutex);
+      last->next = cache->pool[pool].free_buf;
+      cache->pool[pool].free_buf = first->next;
+      cache->pool[pool].count += count - 1;
+      cache->pool[pool].bytes += bytes - first->ablen;
+      V(cache->mutex);
+   }
+   return buf;
+}
+
+/*
+ * Keep a free buffer in the thread cache, when the cache is full
+ *  half of it goes back to the free list.
+ *  Returns: false if the buffer must go to the free list
+ */
+static bool pool_cache_put(struct abufhead *buf)
+{
+   struct s_pool_cache *cache = get_pool_cache();
+   struct abufhead *first, *last, *next;
+   int pool = buf->pool;
+   int count = 0, keep;
+
+   if (!cache) {
+      return false;
+   }
+   P(cache->mutex);
+   buf->next = cache->pool[pool].free_buf;
+   cache->pool[pool].free_buf = buf;
+   cache->pool[pool].count++;
+   cache->pool[pool].bytes += buf->ablen;
+   if (cache->pool[pool].count <= POOL_CACHE_MAX &&
+       cache->pool[pool].bytes <= POOL_CACHE_BYTES) {
+      V(cache->mutex);
+      return true;
+   }
+   /* Keep the most recent buffers, they are the hottest */
+   keep = cache->pool[pool].count / 2;
+   if (keep == 0) {
+      first = cache->pool[pool].free_buf;
+      cache->pool[pool].free_buf = NULL;
+   } else {
+      last = cache->pool[pool].free_buf;
+      for (int i=1; i < keep; i++) {
+         last = last->next;
+      }
+      first = last->next;
+      last->next = NULL;
+   }
+   for (last = first; last; last = last->next) {
+      cache->pool[pool].count--;
+      cache->pool[pool].bytes -= last->ablen;
+      count++;
+   }
+   V(cache->mutex);
+
+   P(mutex);
+   for ( ; first; first = next) {
+      next = first->next;
+      first->next = pool_ctl[pool].free_buf;
+      pool_ctl[pool].free_buf = first;
+   }
+   pool_ctl[pool].nb_out -= count;
+   V(mutex);
+   return true;
+}
+
+#ifdef SMARTALLOC
+
+POOLMEM *sm_get_pool_memory(const char *fname, int lineno, int pool)
+{
+   struct abufhead *buf;
+
+   if (pool > PM_MAX) {
+      Emsg2(M_ABORT, 0, _("MemPool index %d larger than max %d\n"), pool, PM_MAX);
+   }
+   if ((buf = pool_cache_get(pool)) != NULL) {
       Dmsg3(dbglvl, "sm_get_pool_memory reuse %p to %s:%d\n", buf, fname, lineno);
       sm_new_owner(fname, lineno, (char *)buf);
       return (POOLMEM *)((char *)buf+HEAD_SIZE);
    }
 
    if ((buf = (struct abufhead *)sm_malloc(fname, lineno, pool_ctl[pool].size+HEAD_SIZE)) == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), pool_ctl[pool].size);
    }
    buf->ablen = pool_ctl[pool].size;
    buf->pool = pool;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
+   P(mutex);
+   pool_ctl[pool].nb_out++;
+   if (pool_ctl[pool].nb_out > pool_ctl[pool].max_used) {
+      pool_ctl[pool].max_used = pool_ctl[pool].nb_out;
    }
    V(mutex);
    Dmsg3(dbglvl, "sm_get_pool_memory give %p to %s:%d\n", buf, fname, lineno);
@@ -146,9 +367,9 @@ POOLMEM *sm_get_memory(const char *fname, int lineno, int32_t size)
    buf->pool = pool;
    buf->next = NULL;
    P(mutex);
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used)
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
+   pool_ctl[pool].nb_out++;
+   if (pool_ctl[pool].nb_out > pool_ctl[pool].max_used)
+      pool_ctl[pool].max_used = pool_ctl[pool].nb_out;
    V(mutex);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
@@ -173,15 +394,14 @@ POOLMEM *sm_realloc_pool_memory(const char *fname, int lineno, POOLMEM *obuf, in
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = sm_realloc(fname, lineno, cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    ((struct abufhead *)buf)->ablen = size;
    pool = ((struct abufhead *)buf)->pool;
+   P(mutex);
    if (size > pool_ctl[pool].max_allocated) {
       pool_ctl[pool].max_allocated = size;
    }
@@ -205,31 +425,36 @@ void sm_free_pool_memory(const char *fname, int lineno, POOLMEM *obuf)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    buf = (struct abufhead *)((char *)obuf - HEAD_SIZE);
    pool = buf->pool;
-   pool_ctl[pool].in_use--;
+   Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
+   if (pool != 0 && pool_cache_put(buf)) {
+      return;
+   }
+   P(mutex);
+   pool_ctl[pool].nb_out--;
    if (pool == 0) {
+      V(mutex);
       free((char *)buf);              /* free nonpooled memory */
-   } else {                           /* otherwise link it to the free pool chain */
+      return;
+   }
+   /* otherwise link it to the free pool chain */
 
    /* Disabled because it hangs in #5507 */
 #ifdef xDEBUG
-      struct abufhead *next;
-      /* Don't let him free the same buffer twice */
-      for (next=pool_ctl[pool].free_buf; next; next=next->next) {
-         if (next == buf) {
-            Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-            Dmsg4(dbglvl, "bad free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-            V(mutex);                 /* unblock the pool */
-            ASSERT(next != buf);      /* attempt to free twice */
-         }
+   struct abufhead *next;
+   /* Don't let him free the same buffer twice */
+   for (next=pool_ctl[pool].free_buf; next; next=next->next) {
+      if (next == buf) {
+         Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
+         Dmsg4(dbglvl, "bad free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
+         V(mutex);                 /* unblock the pool */
+         ASSERT(next != buf);      /* attempt to free twice */
       }
-#endif
-      buf->next = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf;
    }
-   Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
+#endif
+   buf->next = pool_ctl[pool].free_buf;
+   pool_ctl[pool].free_buf = buf;
    V(mutex);
 }
 
@@ -241,24 +466,20 @@ POOLMEM *get_pool_memory(int pool)
 {
    struct abufhead *buf;
 
-   P(mutex);
-   if (pool_ctl[pool].free_buf) {
-      buf = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf->next;
-      V(mutex);
+   if ((buf = pool_cache_get(pool)) != NULL) {
       return (POOLMEM *)((char *)buf+HEAD_SIZE);
    }
 
    if ((buf=(struct abufhead*)malloc(pool_ctl[pool].size+HEAD_SIZE)) == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), pool_ctl[pool].size);
    }
    buf->ablen = pool_ctl[pool].size;
    buf->pool = pool;
    buf->next = NULL;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
+   P(mutex);
+   pool_ctl[pool].nb_out++;
+   if (pool_ctl[pool].nb_out > pool_ctl[pool].max_used) {
+      pool_ctl[pool].max_used = pool_ctl[pool].nb_out;
    }
    V(mutex);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
@@ -276,9 +497,9 @@ POOLMEM *get_memory(int32_t size)
    buf->ablen = size;
    buf->pool = pool;
    buf->next = NULL;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
+   pool_ctl[pool].nb_out++;
+   if (pool_ctl[pool].nb_out > pool_ctl[pool].max_used) {
+      pool_ctl[pool].max_used = pool_ctl[pool].nb_out;
    }
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
@@ -301,15 +522,14 @@ POOLMEM *realloc_pool_memory(POOLMEM *obuf, int32_t size)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = realloc(cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    ((struct abufhead *)buf)->ablen = size;
    pool = ((struct abufhead *)buf)->pool;
+   P(mutex);
    if (size > pool_ctl[pool].max_allocated) {
       pool_ctl[pool].max_allocated = size;
    }
@@ -333,10 +553,13 @@ void free_pool_memory(POOLMEM *obuf)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    buf = (struct abufhead *)((char *)obuf - HEAD_SIZE);
    pool = buf->pool;
-   pool_ctl[pool].in_use--;
+   if (pool != 0 && pool_cache_put(buf)) {
+      return;
+   }
+   P(mutex);
+   pool_ctl[pool].nb_out--;
    if (pool == 0) {
       free((char *)buf);              /* free nonpooled memory */
    } else {                           /* otherwise link it to the free pool chain */
@@ -371,6 +594,10 @@ void garbage_collect_memory_pool()
 
    Dmsg0(200, "garbage collect memory pool\n");
    P(mutex);
+   /* The buffers of idle threads are given to the others */
+   for (struct s_pool_cache *cache = pool_caches; cache; cache = cache->next) {
+      pool_cache_flush(cache);
+   }
    if (last_garbage_collection == 0) {
       last_garbage_collection = time(NULL);
       V(mutex);
@@ -397,6 +624,9 @@ void close_memory_pool()
 
    sm_check(__FILE__, __LINE__, false);
    P(mutex);
+   for (struct s_pool_cache *cache = pool_caches; cache; cache = cache->next) {
+      pool_cache_flush(cache);
+   }
    for (int i=1; i<=PM_MAX; i++) {
       buf = pool_ctl[i].free_buf;
       while (buf) {
@@ -448,11 +678,34 @@ static const char *pool_name(int pool)
  */
 void print_memory_pool_stats()
 {
-   Pmsg0(-1, "Pool   Maxsize  Maxused  Inuse\n");
-   for (int i=0; i<=PM_MAX; i++)
-      Pmsg4(-1, "%5s  %7d  %7d  %5d\n", pool_name(i), pool_ctl[i].max_allocated,
-         pool_ctl[i].max_used, pool_ctl[i].in_use);
+   struct s_pool_cache *cache;
+   int32_t cached[PM_MAX+1];
+   uint64_t hits, misses;
 
+   P(mutex);
+   memset(cached, 0, sizeof(cached));
+   for (cache = pool_caches; cache; cache = cache->next) {
+      for (int i=1; i<=PM_MAX; i++) {
+         cached[i] += cache->pool[i].count;
+      }
+   }
+   Pmsg0(-1, "Pool   Maxsize  Maxused  Inuse  Cached\n");
+   for (int i=0; i<=PM_MAX; i++)
+      Pmsg5(-1, "%5s  %7d  %7d  %5d  %6d\n", pool_name(i), pool_ctl[i].max_allocated,
+         pool_ctl[i].max_used, pool_ctl[i].nb_out - cached[i], cached[i]);
+
+   /* Per thread cache hit rate */
+   Pmsg0(-1, "\nThread                  Hits    Misses  Hit%%\n");
+   for (cache = pool_caches; cache; cache = cache->next) {
+      hits = misses = 0;
+      for (int i=1; i<=PM_MAX; i++) {
+         hits += cache->pool[i].hits;
+         misses += cache->pool[i].misses;
+      }
+      Pmsg4(-1, "%-18p  %8lld  %8lld  %3d\n", (void *)cache->tid, hits, misses,
+         (hits + misses) ? (int)(hits * 100 / (hits + misses)) : 0);
+   }
+   V(mutex);
    Pmsg0(-1, "\n");
 }
 
@@ -666,3 +919,111 @@ int POOL_MEM::strcpy(const char *str)
    memcpy(mem, str, len);
    return len - 1;
 }
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+#define NB_THREADS 8
+#define NB_LOOPS   20000
+#define NB_BUFS    64
+
+static bool thread_ok[NB_THREADS];
+
+/* Each thread gets and frees buffers of all pools, and checks them */
+static void *th_pool(void *arg)
+{
+   intptr_t id = (intptr_t)arg;
+   POOLMEM *bufs[NB_BUFS];
+   bool good = true;
+   int i, j;
+
+   memset(bufs, 0, sizeof(bufs));
+   for (i = 0; i < NB_LOOPS; i++) {
+      j = (i * 7 + id) % NB_BUFS;
+      if (bufs[j]) {
+         if (bufs[j][0] != (char)id || bufs[j][sizeof_pool_memory(bufs[j]) - 1] != (char)j) {
+            good = false;
+         }
+         free_pool_memory(bufs[j]);
+         bufs[j] = NULL;
+      } else {
+         bufs[j] = get_pool_memory(1 + (i % PM_MAX));
+         if (i % 97 == 0) {
+            bufs[j] = check_pool_memory_size(bufs[j], 200000);
+         }
+         bufs[j][0] = (char)id;
+         bufs[j][sizeof_pool_memory(bufs[j]) - 1] = (char)j;
+      }
+   }
+   for (j = 0; j < NB_BUFS; j++) {
+      if (bufs[j]) {
+         free_pool_memory(bufs[j]);
+      }
+   }
+   thread_ok[id] = good;
+   return NULL;
+}
+
+int main(int argc, char **argv)
+{
+   Unittests mem_pool_test("mem_pool_test", true);
+   pthread_t tids[NB_THREADS];
+   POOLMEM *p1, *p2;
+   int32_t nb_out[PM_MAX+1];
+   struct s_pool_cache *cache;
+   int nb, i;
+
+   /* The cache of this thread gives back the last freed buffer */
+   p1 = get_pool_memory(PM_FNAME);
+   free_pool_memory(p1);
+   p2 = get_pool_memory(PM_FNAME);
+   ok(p1 == p2, "Freed buffer is reused by the same thread");
+   cache = get_pool_cache();
+   ok(cache != NULL, "Thread has a cache");
+   ok(cache->pool[PM_FNAME].hits >= 1, "Cache hit is counted");
+
+   /* A big buffer does not stay in the cache */
+   p2 = check_pool_memory_size(p2, 2 * POOL_CACHE_BYTES);
+   free_pool_memory(p2);
+   is(cache->pool[PM_FNAME].count, 0, "Buffer bigger than the cache goes to the free list");
+
+   /* The garbage collection takes back the cached buffers */
+   p1 = get_pool_memory(PM_NAME);
+   free_pool_memory(p1);
+   ok(cache->pool[PM_NAME].count > 0, "Freed buffer is kept in the cache");
+   garbage_collect_memory_pool();
+   is(cache->pool[PM_NAME].count, 0, "Garbage collection empties the caches");
+   ok(pool_ctl[PM_NAME].free_buf != NULL, "Cached buffers are back in the free list");
+
+   for (i = 0; i <= PM_MAX; i++) {
+      nb_out[i] = pool_ctl[i].nb_out;
+   }
+   for (i = 0; i < NB_THREADS; i++) {
+      pthread_create(&tids[i], NULL, th_pool, (void *)(intptr_t)i);
+   }
+   for (i = 0; i < NB_THREADS; i++) {
+      pthread_join(tids[i], NULL);
+   }
+   for (i = 0; i < NB_THREADS; i++) {
+      ok(thread_ok[i], "Buffers are not shared between threads");
+   }
+   nb = 0;
+   for (cache = pool_caches; cache; cache = cache->next) {
+      nb++;
+   }
+   is(nb, 1, "Caches of the threads are released at exit");
+   for (i = 1; i <= PM_MAX; i++) {
+      is(pool_ctl[i].nb_out, nb_out[i], "All buffers are back in the pool");
+   }
+
+   p1 = get_pool_memory(PM_MESSAGE);
+   free_pool_memory(p1);
+   close_memory_pool();
+   cache = get_pool_cache();
+   is(cache->pool[PM_MESSAGE].count, 0, "close_memory_pool() empties the caches");
+   for (i = 1; i <= PM_MAX; i++) {
+      ok(pool_ctl[i].free_buf == NULL, "Free list is empty after close_memory_pool()");
+   }
+   return report();
+}
+#endif /* TEST_PROGRAM */
@@ -68,6 +68,7 @@ bool dbg_thread = false;              /* add thread_id to details */
 bool prt_kaboom = false;              /* Print kaboom output */
 
 /* Forward referenced functions */
+static void pt_out_sync(char *buf);
 
 /* Imported functions */
 void create_jcr_key();
@@ -226,6 +227,15 @@ void set_debug_flags(char *options)
          debug_flags |= DEBUG_PRINT_EVENT;
          break;
 
+      case 'a':
+         /* Debug output written by a separate thread */
+         start_async_trace(pt_out_sync);
+         break;
+
+      case 'A':
+         stop_async_trace();
+         break;
+
       default:
          Dmsg1(000, "Unknown debug flag %c\n", *p);
       }
@@ -787,6 +797,7 @@ void term_msg()
       free(exename);
       exename = NULL;
    }
+   stop_async_trace();
    if (trace_fd) {
       fclose(trace_fd);
       trace_fd = NULL;
@@ -1151,7 +1162,7 @@ void update_trace_file_location(bool safe)
 /*
  * print or write output to trace file
  */
-static void pt_out(char *buf)
+static void pt_out_sync(char *buf)
 {
     /*
      * Used the "trace on" command in the console to turn on
@@ -1173,6 +1184,17 @@ static void pt_out(char *buf)
     fflush(stdout);
 }
 
+/*
+ * In asynchronous mode the message is queued for the trace
+ *  writer thread, see tracebuf.c
+ */
+static void pt_out(char *buf)
+{
+    if (!async_trace_put(buf, strlen(buf))) {
+       pt_out_sync(buf);
+    }
+}
+
 /*********************************************************************
  *
  *  This subroutine prints a debug message if the level number
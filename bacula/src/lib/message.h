@@ -212,6 +212,7 @@ extern DLL_IMP_EXP int64_t       debug_level;
 extern DLL_IMP_EXP int64_t       debug_level_tags;
 extern DLL_IMP_EXP int32_t       debug_flags;
 extern DLL_IMP_EXP bool          dbg_timestamp;          /* print timestamp in debug output */
+extern DLL_IMP_EXP bool          dbg_thread;             /* add thread_id to details */
 extern DLL_IMP_EXP bool          prt_kaboom;             /* Print kaboom output */
 extern DLL_IMP_EXP int           verbose;
 extern DLL_IMP_EXP char          my_name[];
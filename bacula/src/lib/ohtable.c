@@ -0,0 +1,596 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  Bacula open addressing hash table routines
+ *
+ *  ohtable keeps the items in an array of slots (key, item) instead
+ *    of chaining hlinks embedded in the items. A lookup
+ *    reads one control byte per slot: 0x80 when the slot is empty,
+ *    otherwise the 7 top bits of the hash. The control bytes of a
+ *    group of slots are compared at once (16 with SSE2, 8 in a 64
+ *    bit word otherwise), so most lookups touch one line of control
+ *    bytes and one slot. The first group of control bytes is cloned
+ *    after the last one so that a group can start on any slot.
+ *
+ *  Groups are probed in triangular order, which visits all of them
+ *    as the number of slots is a power of two. The table grows by
+ *    doubling when it is 7/8 full. As nothing is ever removed, the
+ *    first empty slot of the probe sequence ends a lookup and is
+ *    where the key is inserted. The hash is not kept in the slot,
+ *    the 7 bits of the control byte filter out all but 1/128 of the
+ *    key compares, and the keys are hashed again when the table grows.
+ *
+ *  The keys are not copied, hash_malloc() provides a big buffer
+ *    arena where the caller keeps its items and keys, as with htable.
+ *
+ */
+
+#include "bacula.h"
+#include "ohtable.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define lli long long int
+static const int dbglvl = 500;
+
+#define OH_EMPTY ((uint8_t)0x80)
+
+/*
+ * Group matching, returns a bit mask of the slots of the group
+ *  that match, use oh_first() to get the first one. In the 64 bit
+ *  version, there can be false positives for h2, the key of the
+ *  slot is always compared.
+ */
+#if defined(__SSE2__)
+typedef uint32_t oh_mask;
+
+static inline oh_mask oh_match(const uint8_t *g, uint8_t h2)
+{
+   __m128i c = _mm_loadu_si128((const __m128i *)g);
+   return (oh_mask)_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8((char)h2)));
+}
+
+static inline oh_mask oh_match_empty(const uint8_t *g)
+{
+   /* Only an empty slot has the top bit set */
+   return (oh_mask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+}
+
+static inline uint32_t oh_first(oh_mask m)
+{
+   return __builtin_ctz(m);
+}
+
+#else
+typedef uint64_t oh_mask;
+
+#define OH_LSB 0x0101010101010101ULL
+#define OH_MSB 0x8080808080808080ULL
+
+static inline oh_mask oh_match(const uint8_t *g, uint8_t h2)
+{
+   uint64_t c, x;
+   memcpy(&c, g, sizeof(c));
+   x = c ^ (OH_LSB * h2);
+   return (x - OH_LSB) & ~x & OH_MSB;
+}
+
+static inline oh_mask oh_match_empty(const uint8_t *g)
+{
+   uint64_t c;
+   memcpy(&c, g, sizeof(c));
+   return c & OH_MSB;
+}
+
+static inline uint32_t oh_first(oh_mask m)
+{
+#if defined(__GNUC__)
+   return __builtin_ctzll(m) >> 3;     /* one bit per byte */
+#else
+   uint32_t i = 0;
+   while (!(m & 0x80)) {
+      m >>= 8;
+      i++;
+   }
+   return i;
+#endif
+}
+#endif
+
+#if defined(__GNUC__)
+#define oh_prefetch(p) __builtin_prefetch(p)
+#else
+#define oh_prefetch(p)
+#endif
+
+/*
+ * Hash of the keys, the low bits select the group and the
+ *  top 7 bits go in the control byte, so all the bits must
+ *  be mixed.
+ */
+static inline uint64_t oh_hash(char *key)
+{
+   return XXH64((const uint8_t *)key, strlen(key), 0);
+}
+
+static inline uint64_t oh_hash(uint64_t ikey)
+{
+   ikey ^= ikey >> 33;
+   ikey *= 0xff51afd7ed558ccdULL;
+   ikey ^= ikey >> 33;
+   ikey *= 0xc4ceb9fe1a85ec53ULL;
+   ikey ^= ikey >> 33;
+   return ikey;
+}
+
+static inline uint8_t oh_h2(uint64_t hash)
+{
+   return (uint8_t)(hash >> 57);
+}
+
+/* ===================================================================
+ *    ohtable
+ */
+
+#ifdef BIG_MALLOC
+/*
+ * This subroutine gets a big buffer.
+ */
+void ohtable::malloc_big_buf(int size)
+{
+   struct h_mem *hmem;
+
+   hmem = (struct h_mem *)malloc(size);
+   total_size += size;
+   blocks++;
+   hmem->next = mem_block;
+   mem_block = hmem;
+   hmem->mem = mem_block->first;
+   hmem->rem = (char *)hmem + size - hmem->mem;
+   Dmsg3(100, "malloc buf=%p size=%d rem=%d\n", hmem, size, hmem->rem);
+}
+
+/* This routine frees the whole tree */
+void ohtable::hash_big_free()
+{
+   struct h_mem *hmem, *rel;
+
+   for (hmem=mem_block; hmem; ) {
+      rel = hmem;
+      hmem = hmem->next;
+      Dmsg1(100, "free malloc buf=%p\n", rel);
+      free(rel);
+   }
+   mem_block = NULL;
+}
+
+#endif
+
+/*
+ * Normal hash malloc routine that gets a
+ *  "small" buffer from the big buffer. The first buffer
+ *  is allocated on the first call, so an unused table
+ *  costs only its slots.
+ */
+char *ohtable::hash_malloc(int size)
+{
+#ifdef BIG_MALLOC
+   char *buf;
+   int asize = BALIGN(size);
+
+   if (!mem_block || mem_block->rem < asize) {
+      uint32_t mb_size;
+      if (total_size >= 1000000) {
+         mb_size = 1000000;
+      } else {
+         mb_size = 100000;
+      }
+      if (mb_size < asize + sizeof(struct h_mem)) {
+         mb_size = asize + sizeof(struct h_mem);
+      }
+      malloc_big_buf(mb_size);
+   }
+   mem_block->rem -= asize;
+   buf = mem_block->mem;
+   mem_block->mem += asize;
+   return buf;
+#else
+   total_size += size;
+   blocks++;
+   return (char *)malloc(size);
+#endif
+}
+
+/*
+ * tsize is the estimated number of entries in the hash table
+ */
+ohtable::ohtable(void *item, void *link, int tsize)
+{
+   init(item, link, tsize);
+}
+
+void ohtable::init(void *item, void *link, int tsize)
+{
+   uint32_t nb = OH_GROUP * 2;
+
+   bmemzero(this, sizeof(ohtable));
+   /* Room for tsize items without growing */
+   while (nb < 0x80000000 && (uint64_t)nb * 7 / 8 < (uint64_t)MAX(tsize, 0)) {
+      nb <<= 1;
+   }
+   alloc_table(nb);
+}
+
+/*
+ * Allocate nb empty slots, nb is a power of two
+ */
+void ohtable::alloc_table(uint32_t nb)
+{
+   buckets = nb;
+   mask = nb - 1;
+   max_items = nb / 8 * 7;
+   ctrl = (uint8_t *)malloc(nb + OH_GROUP);
+   memset(ctrl, OH_EMPTY, nb + OH_GROUP);
+   slots = (struct oh_slot *)malloc(nb * sizeof(struct oh_slot));
+}
+
+uint32_t ohtable::size()
+{
+   return num_items;
+}
+
+/*
+ * Hash of the key of a slot, used when the table grows
+ */
+uint64_t ohtable::slot_hash(struct oh_slot *s)
+{
+   return is_ikey ? oh_hash(s->key.ikey) : oh_hash(s->key.key);
+}
+
+/*
+ * Return the slot of the key with found set, or the
+ *  first empty slot of its probe sequence.
+ */
+uint32_t ohtable::find_slot(uint64_t hash, char *key, uint64_t ikey, bool *found)
+{
+   uint8_t h2 = oh_h2(hash);
+   uint32_t pos = hash & mask;
+   uint32_t step = 0;
+   oh_mask m;
+
+   /* The slot is most often the first of the group, load it with the
+    *  control bytes rather than after them
+    */
+   oh_prefetch(&slots[pos]);
+   for ( ;; ) {
+      for (m = oh_match(ctrl + pos, h2); m; m &= m - 1) {
+         uint32_t i = (pos + oh_first(m)) & mask;
+         struct oh_slot *s = &slots[i];
+         if (key ? strcmp(key, s->key.key) == 0 : ikey == s->key.ikey) {
+            *found = true;
+            return i;
+         }
+      }
+      m = oh_match_empty(ctrl + pos);
+      if (m) {
+         *found = false;
+         return (pos + oh_first(m)) & mask;
+      }
+      /* Next group, triangular probing */
+      step += OH_GROUP;
+      pos = (pos + step) & mask;
+   }
+}
+
+/*
+ * Return the first empty slot of the probe sequence of hash
+ */
+uint32_t ohtable::find_empty(uint64_t hash)
+{
+   uint32_t pos = hash & mask;
+   uint32_t step = 0;
+   oh_mask m;
+
+   while (!(m = oh_match_empty(ctrl + pos))) {
+      step += OH_GROUP;
+      pos = (pos + step) & mask;
+   }
+   return (pos + oh_first(m)) & mask;
+}
+
+void ohtable::put_slot(uint32_t index, uint64_t hash, void *item)
+{
+   uint8_t h2 = oh_h2(hash);
+   ctrl[index] = h2;
+   if (index < OH_GROUP) {
+      ctrl[buckets + index] = h2;     /* clone of the first group */
+   }
+   slots[index].item = item;
+}
+
+void ohtable::grow_table()
+{
+   uint8_t *old_ctrl = ctrl;
+   struct oh_slot *old_slots = slots;
+   uint32_t old_buckets = buckets;
+
+   Dmsg1(100, "Grow called old size = %d\n", buckets);
+   alloc_table(buckets * 2);
+   /* All the keys are different, just find an empty slot */
+   for (uint32_t i = 0; i < old_buckets; i++) {
+      if (old_ctrl[i] != OH_EMPTY) {
+         struct oh_slot *s = &old_slots[i];
+         uint64_t hash = slot_hash(s);
+         uint32_t index = find_empty(hash);
+         put_slot(index, hash, s->item);
+         slots[index].key = s->key;
+      }
+   }
+   free(old_ctrl);
+   free(old_slots);
+   Dmsg0(100, "Exit grow.\n");
+}
+
+bool ohtable::insert(char *key, void *item)
+{
+   bool found;
+   uint64_t hash = oh_hash(key);
+   uint32_t index;
+
+   ASSERT(num_items == 0 || !is_ikey);
+   index = find_slot(hash, key, 0, &found);
+   if (found) {
+      return false;                   /* already exists */
+   }
+   put_slot(index, hash, item);
+   slots[index].key.key = key;
+   is_ikey = false;
+   Dmsg3(dbglvl, "Insert hash=0x%llx index=%d key=%s\n", (lli)hash, index, key);
+   if (++num_items >= max_items) {
+      Dmsg2(dbglvl, "num_items=%d max_items=%d\n", num_items, max_items);
+      grow_table();
+   }
+   return true;
+}
+
+void *ohtable::lookup(char *key)
+{
+   bool found;
+   uint32_t index = find_slot(oh_hash(key), key, 0, &found);
+   return found ? slots[index].item : NULL;
+}
+
+bool ohtable::insert(uint64_t ikey, void *item)
+{
+   bool found;
+   uint64_t hash = oh_hash(ikey);
+   uint32_t index;
+
+   ASSERT(num_items == 0 || is_ikey);
+   index = find_slot(hash, NULL, ikey, &found);
+   if (found) {
+      return false;                   /* already exists */
+   }
+   put_slot(index, hash, item);
+   slots[index].key.ikey = ikey;
+   is_ikey = true;
+   Dmsg3(dbglvl, "Insert hash=0x%llx index=%d key=%lld\n", (lli)hash, index, (lli)ikey);
+   if (++num_items >= max_items) {
+      Dmsg2(dbglvl, "num_items=%d max_items=%d\n", num_items, max_items);
+      grow_table();
+   }
+   return true;
+}
+
+void *ohtable::lookup(uint64_t ikey)
+{
+   bool found;
+   uint32_t index = find_slot(oh_hash(ikey), NULL, ikey, &found);
+   return found ? slots[index].item : NULL;
+}
+
+void *ohtable::next()
+{
+   while (walk_index < buckets) {
+      uint32_t i = walk_index++;
+      if (ctrl[i] != OH_EMPTY) {
+         return slots[i].item;
+      }
+   }
+   return NULL;
+}
+
+void *ohtable::first()
+{
+   walk_index = 0;
+   return ctrl ? next() : NULL;
+}
+
+/*
+ * Print the number of groups probed by a lookup of
+ *  each item, the lower the better.
+ */
+#define MAX_COUNT 20
+void ohtable::stats()
+{
+   int hits[MAX_COUNT];
+   int max = 0;
+   uint32_t i;
+   int j;
+
+   printf("\n\nNumItems=%d\nTotal slots=%d\n", num_items, buckets);
+   printf("Groups probed: items\n");
+   for (j=0; j < MAX_COUNT; j++) {
+      hits[j] = 0;
+   }
+   for (i=0; i < buckets; i++) {
+      if (ctrl[i] == OH_EMPTY) {
+         continue;
+      }
+      /* Walk the probe sequence up to this slot */
+      uint32_t pos = slot_hash(&slots[i]) & mask, step = 0;
+      for (j = 1; ((i - pos) & mask) >= OH_GROUP; j++) {
+         step += OH_GROUP;
+         pos = (pos + step) & mask;
+      }
+      if (j > max) {
+         max = j;
+      }
+      if (j < MAX_COUNT) {
+         hits[j]++;
+      }
+   }
+   for (j=1; j < MAX_COUNT; j++) {
+      printf("%2d:           %d\n", j, hits[j]);
+   }
+   printf("slots=%d num_items=%d max_items=%d\n", buckets, num_items, max_items);
+   printf("max groups probed = %d\n", max);
+   printf("slot bytes = %lld\n", (lli)buckets * (sizeof(struct oh_slot) + 1));
+#ifdef BIG_MALLOC
+   printf("total bytes malloced = %lld\n", (lli)total_size);
+   printf("total blocks malloced = %d\n", blocks);
+#endif
+}
+
+/* Destroy the table and its contents */
+void ohtable::destroy()
+{
+#ifdef BIG_MALLOC
+   hash_big_free();
+#else
+   void *ni;
+   void *li = first();
+
+   while (li) {
+      ni = next();
+      free(li);
+      li=ni;
+   }
+#endif
+
+   if (ctrl) {
+      free(ctrl);
+      free(slots);
+   }
+   ctrl = NULL;
+   slots = NULL;
+   buckets = mask = num_items = max_items = 0;
+   Dmsg0(100, "Done destroy.\n");
+}
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+struct MYJCR {
+   char *key;
+};
+
+#define NITEMS 5000000
+
+int main()
+{
+   Unittests ohtable_test("ohtable_test");
+   char mkey[30];
+   ohtable *jcrtbl;
+   MYJCR *save_jcr = NULL, *item;
+   MYJCR *jcr = NULL;
+   uint64_t *ikey;
+   int count = 0;
+   int i;
+   int len;
+   bool check_cont;
+
+   Pmsg0(0, "Initialize tests ...\n");
+   jcrtbl = (ohtable *)malloc(sizeof(ohtable));
+   jcrtbl->init(jcr, NULL, 100);    /* small, must grow */
+   ok(jcrtbl && jcrtbl->size() == 0, "Default initialization");
+   ok(jcrtbl->first() == NULL, "Walk empty table");
+
+   Pmsg1(0, "Inserting %d items\n", NITEMS);
+   for (i = 0; i < NITEMS; i++) {
+      len = sprintf(mkey, "This is htable item %d", i) + 1;
+
+      jcr = (MYJCR *)jcrtbl->hash_malloc(sizeof(MYJCR));
+      jcr->key = (char *)jcrtbl->hash_malloc(len);
+      memcpy(jcr->key, mkey, len);
+
+      jcrtbl->insert(jcr->key, jcr);
+      if (i == 10) {
+         save_jcr = jcr;
+      }
+   }
+   ok(jcrtbl->size() == NITEMS, "Checking size");
+   item = (MYJCR *)jcrtbl->lookup(save_jcr->key);
+   ok(item != NULL, "Checking saved key lookup");
+   ok(item != NULL && strcmp(save_jcr->key, item->key) == 0, "Checking key");
+   ok(!jcrtbl->insert(save_jcr->key, save_jcr), "Checking duplicate insert");
+   ok(jcrtbl->size() == NITEMS, "Checking size after duplicate");
+   ok(jcrtbl->lookup((char *)"This is not an htable item") == NULL, "Checking unknown key");
+
+   /* some stats for human to consider */
+   jcrtbl->stats();
+
+   Pmsg0(0, "Walk the hash table\n");
+   check_cont = true;
+   for (i = 0; i < NITEMS; i++) {
+      sprintf(mkey, "This is htable item %d", i);
+      item = (MYJCR *)jcrtbl->lookup(mkey);
+      if (!item || strcmp(item->key, mkey) != 0) {
+         check_cont = false;
+      }
+   }
+   ok(check_cont, "Checking ohtable content");
+
+   foreach_htable (jcr, jcrtbl) {
+      count++;
+   }
+   ok(count == NITEMS, "Checking number of items");
+   printf("Calling destroy\n");
+   jcrtbl->destroy();
+   free(jcrtbl);
+
+   Pmsg0(0, "Integer keys\n");
+   jcrtbl = New(ohtable(NULL, NULL));
+   for (i = 0; i < NITEMS; i++) {
+      ikey = (uint64_t *)jcrtbl->hash_malloc(sizeof(uint64_t));
+      *ikey = ((uint64_t)i) << 32;    /* keys as JobId << 32 | FileIndex */
+      jcrtbl->insert(*ikey, ikey);
+   }
+   ok(jcrtbl->size() == NITEMS, "Checking size");
+   check_cont = true;
+   for (i = 0; i < NITEMS; i++) {
+      ikey = (uint64_t *)jcrtbl->lookup(((uint64_t)i) << 32);
+      if (!ikey || *ikey != ((uint64_t)i) << 32) {
+         check_cont = false;
+      }
+   }
+   ok(check_cont, "Checking ohtable integer content");
+   ok(jcrtbl->lookup((uint64_t)1) == NULL, "Checking unknown integer key");
+   count = 0;
+   foreach_htable (ikey, jcrtbl) {
+      count++;
+   }
+   ok(count == NITEMS, "Checking number of integer items");
+   delete jcrtbl;
+
+   return report();
+}
+#endif
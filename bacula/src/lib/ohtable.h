@@ -0,0 +1,91 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+
+#ifndef _OHTABLE_H_
+#define _OHTABLE_H_
+
+#include "htable.h"
+
+/* ========================================================================
+ *
+ *   Open addressing hash table class -- ohtable
+ *
+ *   Same interface as htable, but the items do not need an hlink,
+ *    the key and the item pointer are kept in an array of slots,
+ *    with one control byte per slot that is compared a group at
+ *    a time. The link argument of the constructor and
+ *    of init() is ignored. Items cannot be removed, as with htable.
+ *
+ *   Use foreach_htable() to walk the table.
+ */
+
+/* Number of control bytes compared at once */
+#if defined(__SSE2__)
+#define OH_GROUP 16
+#else
+#define OH_GROUP 8
+#endif
+
+struct oh_slot {
+   union key_val key;                 /* key value */
+   void *item;                        /* item of this key */
+};
+
+class ohtable : public SMARTALLOC {
+   uint8_t *ctrl;                     /* control byte of each slot */
+   struct oh_slot *slots;             /* slots */
+   uint64_t total_size;               /* total bytes malloced */
+   uint32_t num_items;                /* current number of items */
+   uint32_t max_items;                /* maximum items before growing */
+   uint32_t buckets;                  /* number of slots -- power of two */
+   uint32_t mask;                     /* "remainder" mask */
+   uint32_t walk_index;               /* table walk index */
+   uint32_t blocks;                   /* blocks malloced */
+   bool is_ikey;                      /* set if integer keys */
+#ifdef BIG_MALLOC
+   struct h_mem *mem_block;           /* malloc'ed memory block chain */
+   void malloc_big_buf(int size);     /* Get a big buffer */
+#endif
+   void alloc_table(uint32_t nb);     /* allocate nb empty slots */
+   uint32_t find_slot(uint64_t hash, char *key, uint64_t ikey, bool *found);
+   uint32_t find_empty(uint64_t hash);
+   uint64_t slot_hash(struct oh_slot *s);
+   void put_slot(uint32_t index, uint64_t hash, void *item);
+   void grow_table();                 /* grow the table */
+
+public:
+   ohtable(void *item, void *link, int tsize = 31);
+   ~ohtable() { destroy(); }
+   void  init(void *item, void *link, int tsize = 31);
+   bool  insert(char *key, void *item);      /* char key */
+   bool  insert(uint64_t ikey, void *item);  /* 64 bit key */
+   void *lookup(char *key);                  /* char key */
+   void *lookup(uint64_t ikey);              /* 64 bit key */
+   void *first();                     /* get first item in table */
+   void *next();                      /* get next item in table */
+   void  destroy();
+   void  stats();                     /* print stats about the table */
+   uint32_t size();                   /* return size of table */
+   char *hash_malloc(int size);       /* malloc bytes for a hash entry */
+#ifdef BIG_MALLOC
+   void hash_big_free();              /* free all hash allocated big buffers */
+#endif
+};
+
+#endif
@@ -101,6 +101,9 @@ int       bsnprintf              (char *str, int32_t size, const char *format, .
 int       bvsnprintf             (char *str, int32_t size, const char *format, va_list ap);
 int       pool_sprintf           (char *pool_buf, const char *fmt, ...);
 int       create_lock_file       (char *fname, const char *progname, const char *filetype, POOLMEM **errmsg, int *fd);
+#ifdef HAVE_FCNTL_LOCK
+int       fcntl_lock             (int fd, int code);
+#endif
 void      create_pid_file        (char *dir, const char *progname, int port);
 int       delete_pid_file        (char *dir, const char *progname, int port);
 void      drop                   (char *uid, char *gid, bool keep_readall_caps);
@@ -211,6 +214,7 @@ int                crypto_keypair_load_key     (X509_KEYPAIR *keypair, const cha
 void               crypto_keypair_free         (X509_KEYPAIR *keypair);
 int                crypto_default_pem_callback (char *buf, int size, const void *userdata);
 const char *       crypto_digest_name          (DIGEST *digest);
+crypto_digest_t    crypto_digest_type          (DIGEST *digest);
 crypto_digest_t    crypto_digest_stream_type   (int stream);
 const char *       crypto_strerror             (crypto_error_t error);
 
@@ -415,6 +419,7 @@ void             set_working_directory   (const char *wd);
 const char *     last_path_separator     (const char *str);
 int xattr_list_append(POOLMEM *&list, int len, const char *str, int str_len);
 bool is_offset_stream(int stream);
+bool is_file_data_stream(int stream);
 
 
 /* watchdog.c */
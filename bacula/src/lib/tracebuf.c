@@ -0,0 +1,646 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Asynchronous delivery of the debug and trace output
+ *
+ *  With a high debug level, every Dmsg() of every thread writes
+ *  and flushes the trace file. In asynchronous mode (setdebug
+ *  options=a) the message is only copied into a buffer owned by
+ *  the thread. Each thread has two buffers, the writer thread
+ *  swaps them every TRACEBUF_INTERVAL ms or when one is half full,
+ *  sorts the collected messages by time and writes them.
+ *
+ *  The buffer mutex is shared only by the thread and the writer.
+ *  When a buffer is full, the thread waits up to TRACEBUF_WAIT
+ *  seconds for the writer, then the message is dropped and counted,
+ *  and so are the next ones until the writer takes the buffer.
+ *
+ *  A tracepoint (Tpt0..Tpt4) records the location, the format and
+ *  up to four integers. The format is applied by the writer, so
+ *  the cost for the job thread is a copy of a few words. The
+ *  format must use %lld, %llu or %llx for all the arguments. When
+ *  the asynchronous mode is off, tracepoints are printed as Dmsg().
+ *
+ *  Messages still in the buffers are lost if the daemon crashes.
+ */
+
+#include "bacula.h"
+#include "jcr.h"
+
+#define TB_TEXT   1
+#define TB_POINT  2
+
+/* Header of all the records of a buffer */
+struct tb_hdr {
+   int32_t len;                       /* record length, multiple of 8 */
+   int32_t type;                      /* TB_TEXT or TB_POINT */
+   btime_t stamp;                     /* time of the message */
+};
+
+/* Tracepoint, the format is applied by the writer */
+struct tb_point {
+   struct tb_hdr hdr;
+   const char *file;
+   const char *fmt;
+   int64_t level;
+   intptr_t tid;
+   int32_t line;
+   uint32_t jobid;
+   int64_t args[4];
+};
+
+struct tb_thread {
+   pthread_mutex_t mutex;
+   pthread_cond_t  cond;              /* signaled when the writer takes buf */
+   struct tb_thread *next;            /* protected by tb_mutex */
+   char *buf;                         /* buffer being filled */
+   char *spare;                       /* NULL while the writer owns it */
+   int32_t len;                       /* bytes used in buf */
+   uint64_t dropped;                  /* messages lost, buffer full */
+   uint64_t waits;                    /* waits on a full buffer */
+   bool exited;                       /* thread gone, protected by tb_mutex */
+};
+
+/* Message collected by the writer */
+struct tb_item {
+   struct tb_hdr *rec;
+   int32_t seq;
+};
+
+static pthread_mutex_t tb_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tb_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_key_t tb_key;
+static pthread_once_t tb_once = PTHREAD_ONCE_INIT;
+static bool tb_key_ok = false;
+static struct tb_thread *tb_threads = NULL;   /* protected by tb_mutex */
+static bool tb_running = false;               /* producers may queue */
+static bool tb_writer_alive = false;          /* the writer owns the buffers */
+static pthread_t tb_writer_id;
+static void (*tb_output)(char *buf) = NULL;
+
+/* Statistics, protected by tb_mutex */
+static uint64_t tb_written = 0;
+static uint64_t tb_dropped = 0;
+static uint64_t tb_waits = 0;
+
+static void tb_free_thread(struct tb_thread *t)
+{
+   pthread_mutex_destroy(&t->mutex);
+   pthread_cond_destroy(&t->cond);
+   actuallyfree(t->buf);
+   actuallyfree(t->spare);
+   actuallyfree(t);
+}
+
+/*
+ * Called when a thread exits, the writer frees the buffers when it
+ *  is done. The mutex is taken without the lock manager, at thread
+ *  exit its thread specific data may already be destroyed.
+ */
+static void tb_thread_exit(void *arg)
+{
+   struct tb_thread *t = (struct tb_thread *)arg;
+   struct tb_thread **prev;
+
+   lmgr_p(&tb_mutex);
+   if (tb_writer_alive) {
+      t->exited = true;
+      lmgr_v(&tb_mutex);
+      return;
+   }
+   for (prev = &tb_threads; *prev; prev = &(*prev)->next) {
+      if (*prev == t) {
+         *prev = t->next;
+         break;
+      }
+   }
+   lmgr_v(&tb_mutex);
+   tb_free_thread(t);
+}
+
+static void tb_init()
+{
+   tb_key_ok = pthread_key_create(&tb_key, tb_thread_exit) == 0;
+}
+
+static struct tb_thread *get_tb_thread()
+{
+   struct tb_thread *t;
+
+   pthread_once(&tb_once, tb_init);
+   if (!tb_key_ok) {
+      return NULL;
+   }
+   t = (struct tb_thread *)pthread_getspecific(tb_key);
+   if (t) {
+      return t;
+   }
+   /* Not tracked by smartalloc, the buffers of the main thread are never freed */
+   t = (struct tb_thread *)actuallymalloc(sizeof(struct tb_thread));
+   if (!t) {
+      return NULL;
+   }
+   memset(t, 0, sizeof(struct tb_thread));
+   t->buf = (char *)actuallymalloc(TRACEBUF_SIZE);
+   t->spare = (char *)actuallymalloc(TRACEBUF_SIZE);
+   pthread_mutex_init(&t->mutex, NULL);
+   pthread_cond_init(&t->cond, NULL);
+   if (!t->buf || !t->spare || pthread_setspecific(tb_key, t) != 0) {
+      tb_free_thread(t);
+      return NULL;
+   }
+   P(tb_mutex);
+   t->next = tb_threads;
+   tb_threads = t;
+   V(tb_mutex);
+   return t;
+}
+
+static void tb_signal_writer()
+{
+   P(tb_mutex);
+   pthread_cond_signal(&tb_wakeup);
+   V(tb_mutex);
+}
+
+/*
+ * Copy a record and its text into the buffer of the thread.
+ *  Returns false if the caller must write the message itself.
+ */
+static bool tb_put(struct tb_hdr *rec, int reclen, const char *text, int textlen)
+{
+   struct tb_thread *t;
+   struct timespec timeout;
+   struct timeval tv;
+   int32_t size, old_len;
+
+   if (!tb_running || pthread_equal(pthread_self(), tb_writer_id)) {
+      return false;
+   }
+   size = reclen + (text ? textlen + 1 : 0);
+   size = (size + 7) & ~7;
+   if (size > TRACEBUF_SIZE || (t = get_tb_thread()) == NULL) {
+      return false;
+   }
+   rec->len = size;
+   rec->stamp = get_current_btime();
+
+   P(t->mutex);
+   if (!tb_running) {               /* stopped, the writer will not come back */
+      V(t->mutex);
+      return false;
+   }
+   if (t->len + size > TRACEBUF_SIZE && t->dropped > 0) {
+      t->dropped++;                 /* already waited for this buffer */
+      V(t->mutex);
+      return true;
+   }
+   if (t->len + size > TRACEBUF_SIZE) {
+      t->waits++;
+      tb_signal_writer();
+      gettimeofday(&tv, NULL);
+      timeout.tv_sec = tv.tv_sec + TRACEBUF_WAIT;
+      timeout.tv_nsec = tv.tv_usec * 1000;
+      while (tb_running && t->len + size > TRACEBUF_SIZE) {
+         if (pthread_cond_timedwait(&t->cond, &t->mutex, &timeout) == ETIMEDOUT) {
+            break;
+         }
+      }
+      if (!tb_running) {
+         V(t->mutex);
+         return false;
+      }
+      if (t->len + size > TRACEBUF_SIZE) {
+         t->dropped++;
+         V(t->mutex);
+         return true;
+      }
+   }
+   memcpy(t->buf + t->len, rec, reclen);
+   if (text) {
+      memcpy(t->buf + t->len + reclen, text, textlen);
+      t->buf[t->len + reclen + textlen] = 0;
+   }
+   old_len = t->len;
+   t->len += size;
+   V(t->mutex);
+
+   if (old_len < TRACEBUF_SIZE/2 && old_len + size >= TRACEBUF_SIZE/2) {
+      tb_signal_writer();
+   }
+   return true;
+}
+
+/* Queue a formatted message, returns false if it must be written now */
+bool async_trace_put(const char *buf, int len)
+{
+   struct tb_hdr rec;
+   rec.type = TB_TEXT;
+   return tb_put(&rec, sizeof(rec), buf, len);
+}
+
+/* Edit a tracepoint the way vd_msg() does */
+static void tb_format_point(struct tb_point *p, char *buf, int buf_len)
+{
+   int len = 0;
+   int64_t level = p->level;
+
+   if (dbg_timestamp) {
+      bstrftimes(buf, buf_len, btime_to_utime(p->hdr.stamp));
+      len = strlen(buf);
+      buf[len++] = ' ';
+   }
+   if (level >= 0) {
+      if (dbg_thread) {
+         len += bsnprintf(buf+len, buf_len-len, "%s[%lld]: %s:%d-%u ",
+                          my_name, (int64_t)p->tid, get_basename(p->file),
+                          p->line, p->jobid);
+      } else {
+         len += bsnprintf(buf+len, buf_len-len, "%s: %s:%d-%u ",
+                          my_name, get_basename(p->file), p->line, p->jobid);
+      }
+   }
+   bsnprintf(buf+len, buf_len-len, (char *)p->fmt, p->args[0], p->args[1],
+             p->args[2], p->args[3]);
+}
+
+/*
+ * Tracepoint, called by the Tpt0..Tpt4 macros when the level
+ *  and the tags match.
+ */
+void tp_msg(const char *file, int line, int64_t level, const char *fmt,
+            int64_t a1, int64_t a2, int64_t a3, int64_t a4)
+{
+   struct tb_point p;
+   char buf[5000];
+
+   p.hdr.type = TB_POINT;
+   p.file = file;
+   p.fmt = fmt;
+   p.level = level;
+   p.line = line;
+   p.args[0] = a1;
+   p.args[1] = a2;
+   p.args[2] = a3;
+   p.args[3] = a4;
+   if (tb_running) {
+      p.tid = dbg_thread ? bthread_get_thread_id() : 0;
+      p.jobid = get_jobid_from_tsd();
+      if (tb_put(&p.hdr, sizeof(p), NULL, 0)) {
+         return;
+      }
+   }
+   bsnprintf(buf, sizeof(buf), fmt, a1, a2, a3, a4);
+   d_msg(file, line, level, "%s", buf);
+}
+
+static int tb_compare(const void *a, const void *b)
+{
+   const struct tb_item *i1 = (const struct tb_item *)a;
+   const struct tb_item *i2 = (const struct tb_item *)b;
+
+   if (i1->rec->stamp != i2->rec->stamp) {
+      return i1->rec->stamp < i2->rec->stamp ? -1 : 1;
+   }
+   return i1->seq - i2->seq;
+}
+
+/*
+ * Take the filled buffer of each thread, write the messages in
+ *  time order, then give the buffers back. Called by the writer
+ *  without any lock.
+ */
+static void tb_drain()
+{
+   struct tb_thread *t, **prev;
+   struct tb_thread **list;
+   char **bufs;
+   int32_t *lens;
+   struct tb_item *items = NULL;
+   int nthreads = 0, nitems = 0, max_items = 0;
+   uint64_t dropped = 0, waits = 0;
+   char buf[5000];
+
+   /* Threads are added at the head, and only the writer removes them */
+   P(tb_mutex);
+   for (t = tb_threads; t; t = t->next) {
+      nthreads++;
+   }
+   list = (struct tb_thread **)malloc((nthreads + 1) * sizeof(struct tb_thread *));
+   nthreads = 0;
+   for (t = tb_threads; t; t = t->next) {
+      list[nthreads++] = t;
+   }
+   V(tb_mutex);
+
+   bufs = (char **)malloc((nthreads + 1) * sizeof(char *));
+   lens = (int32_t *)malloc((nthreads + 1) * sizeof(int32_t));
+   for (int i = 0; i < nthreads; i++) {
+      t = list[i];
+      P(t->mutex);
+      bufs[i] = t->buf;
+      lens[i] = t->len;
+      dropped += t->dropped;
+      waits += t->waits;
+      t->dropped = t->waits = 0;
+      if (t->len > 0) {
+         t->buf = t->spare;
+         t->spare = NULL;
+         t->len = 0;
+         pthread_cond_broadcast(&t->cond);
+      }
+      V(t->mutex);
+   }
+
+   for (int i = 0; i < nthreads; i++) {
+      for (int32_t pos = 0; pos < lens[i]; ) {
+         struct tb_hdr *rec = (struct tb_hdr *)(bufs[i] + pos);
+         if (nitems == max_items) {
+            max_items = max_items ? max_items * 2 : 256;
+            items = (struct tb_item *)realloc(items, max_items * sizeof(struct tb_item));
+         }
+         items[nitems].rec = rec;
+         items[nitems].seq = nitems;
+         nitems++;
+         pos += rec->len;
+      }
+   }
+   if (nitems > 0) {
+      qsort(items, nitems, sizeof(struct tb_item), tb_compare);
+   }
+   for (int i = 0; i < nitems; i++) {
+      if (items[i].rec->type == TB_POINT) {
+         tb_format_point((struct tb_point *)items[i].rec, buf, sizeof(buf));
+         tb_output(buf);
+      } else {
+         tb_output((char *)(items[i].rec + 1));
+      }
+   }
+
+   /* Give back the buffers, then free the threads that are gone */
+   for (int i = 0; i < nthreads; i++) {
+      t = list[i];
+      if (lens[i] > 0) {
+         P(t->mutex);
+         t->spare = bufs[i];
+         V(t->mutex);
+      }
+   }
+   P(tb_mutex);
+   for (prev = &tb_threads; *prev; ) {
+      t = *prev;
+      if (t->exited && t->len == 0) {
+         *prev = t->next;
+         tb_free_thread(t);
+      } else {
+         prev = &t->next;
+      }
+   }
+   tb_written += nitems;
+   tb_waits += waits;
+   tb_dropped += dropped;
+   V(tb_mutex);
+   if (dropped > 0) {
+      bsnprintf(buf, sizeof(buf), _("%s: Async trace dropped %lld messages\n"),
+                my_name, dropped);
+      tb_output(buf);
+   }
+   if (items) {
+      free(items);
+   }
+   free(lens);
+   free(bufs);
+   free(list);
+}
+
+extern "C" void *tb_writer(void *arg)
+{
+   struct timespec timeout;
+   struct timeval tv;
+   bool running = true;
+
+   set_jcr_in_tsd(INVALID_JCR);
+   while (running) {
+      P(tb_mutex);
+      if (tb_running) {
+         gettimeofday(&tv, NULL);
+         tv.tv_usec += TRACEBUF_INTERVAL * 1000;
+         timeout.tv_sec = tv.tv_sec + tv.tv_usec / 1000000;
+         timeout.tv_nsec = (tv.tv_usec % 1000000) * 1000;
+         pthread_cond_timedwait(&tb_wakeup, &tb_mutex, &timeout);
+      }
+      running = tb_running;
+      V(tb_mutex);
+      tb_drain();                    /* the last pass sees tb_running false */
+   }
+   return NULL;
+}
+
+/*
+ * Start the writer thread, output() writes one message, it
+ *  is called only by the writer.
+ */
+bool start_async_trace(void (*output)(char *buf))
+{
+   int stat;
+
+   P(tb_mutex);
+   if (tb_writer_alive) {
+      V(tb_mutex);
+      return true;
+   }
+   tb_output = output;
+   tb_running = true;
+   tb_writer_alive = true;
+   if ((stat = pthread_create(&tb_writer_id, NULL, tb_writer, NULL)) != 0) {
+      tb_running = false;
+      tb_writer_alive = false;
+      V(tb_mutex);
+      berrno be;
+      Dmsg1(10, "Unable to start the async trace thread: ERR=%s\n", be.bstrerror(stat));
+      return false;
+   }
+   V(tb_mutex);
+   return true;
+}
+
+/* Write the pending messages and stop the writer thread */
+void stop_async_trace()
+{
+   struct tb_thread *t, **prev;
+
+   P(tb_mutex);
+   if (!tb_writer_alive) {
+      V(tb_mutex);
+      return;
+   }
+   tb_running = false;
+   pthread_cond_signal(&tb_wakeup);
+   V(tb_mutex);
+
+   pthread_join(tb_writer_id, NULL);
+
+   P(tb_mutex);
+   tb_writer_alive = false;
+   /* Threads that exited after the last pass of the writer */
+   for (prev = &tb_threads; *prev; ) {
+      t = *prev;
+      if (t->exited) {
+         *prev = t->next;
+         tb_free_thread(t);
+      } else {
+         prev = &t->next;
+      }
+   }
+   V(tb_mutex);
+}
+
+void async_trace_stats(uint64_t *written, uint64_t *dropped, uint64_t *waits)
+{
+   P(tb_mutex);
+   *written = tb_written;
+   *dropped = tb_dropped;
+   *waits = tb_waits;
+   V(tb_mutex);
+}
+
+/* Status line for the daemon status, returns 0 when nothing to print */
+int async_trace_status(POOL_MEM &msg)
+{
+   char ed1[50], ed2[50], ed3[50];
+   uint64_t written, dropped, waits;
+   int nthreads = 0;
+
+   P(tb_mutex);
+   if (!tb_writer_alive && tb_written == 0) {
+      V(tb_mutex);
+      return 0;
+   }
+   for (struct tb_thread *t = tb_threads; t; t = t->next) {
+      nthreads++;
+   }
+   written = tb_written;
+   dropped = tb_dropped;
+   waits = tb_waits;
+   V(tb_mutex);
+   return Mmsg(msg, _(" Trace: async=%d threads=%d written=%s waits=%s dropped=%s\n"),
+               tb_writer_alive, nthreads, edit_uint64_with_commas(written, ed1),
+               edit_uint64_with_commas(waits, ed2), edit_uint64_with_commas(dropped, ed3));
+}
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+#define NB_THREADS 8
+#define NB_MSGS    20000
+
+static int last_seen[NB_THREADS];
+static bool in_order = true;
+static int nb_msgs = 0;
+static int nb_points = 0;
+static int nb_others = 0;               /* output of the unittests */
+static bool point_ok = false;
+static pthread_mutex_t block_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Called by the writer only */
+static void test_output(char *buf)
+{
+   int th, n;
+
+   P(block_mutex);                    /* held by main() to stall the writer */
+   V(block_mutex);
+   if (sscanf(buf, "T%d %d", &th, &n) == 2 && th >= 0 && th < NB_THREADS) {
+      if (n <= last_seen[th]) {
+         in_order = false;
+      }
+      last_seen[th] = n;
+      nb_msgs++;
+   } else if (strstr(buf, "point 1 -2 0x10")) {
+      point_ok = strstr(buf, "tracebuf.c:") != NULL;
+      nb_points++;
+   } else if (!strstr(buf, "Async trace dropped")) {
+      nb_others++;
+   }
+}
+
+static void *th_trace(void *arg)
+{
+   intptr_t id = (intptr_t)arg;
+   char buf[100];
+   int len;
+
+   for (int i = 0; i < NB_MSGS; i++) {
+      len = bsnprintf(buf, sizeof(buf), "T%d %d message from the test\n", (int)id, i);
+      async_trace_put(buf, len);
+   }
+   return NULL;
+}
+
+int main(int argc, char **argv)
+{
+   Unittests tracebuf_test("tracebuf_test", true);
+   pthread_t tids[NB_THREADS];
+   uint64_t written, dropped, waits;
+   int i;
+
+   init_msg(NULL, NULL);              /* the writer looks for the JobId */
+   nok(async_trace_put("T0 0\n", 5), "Messages are not queued without the writer");
+
+   ok(start_async_trace(test_output), "Start the writer");
+   for (i = 0; i < NB_THREADS; i++) {
+      last_seen[i] = -1;
+      pthread_create(&tids[i], NULL, th_trace, (void *)(intptr_t)i);
+   }
+   debug_level = 100;
+   Tpt3(50, "point %lld %lld 0x%llx\n", 1, -2, 16);
+   Tpt1(150, "hidden %lld\n", 1);
+   debug_level = 0;
+   for (i = 0; i < NB_THREADS; i++) {
+      pthread_join(tids[i], NULL);
+   }
+   stop_async_trace();
+   async_trace_stats(&written, &dropped, &waits);
+   is(nb_msgs, NB_THREADS * NB_MSGS, "All the messages are written");
+   ok(in_order, "Messages of a thread are written in order");
+   is(nb_points, 1, "Only the tracepoint enabled by the level is written");
+   ok(point_ok, "Tracepoint is edited with its location");
+   is(written, (uint64_t)(nb_msgs + nb_points + nb_others), "Written messages are counted");
+   is(dropped, 0, "No message is dropped");
+
+   /* The writer is stalled, the thread buffer fills up */
+   uint64_t written0 = written;
+   nb_msgs = nb_others = 0;
+   last_seen[0] = -1;
+   ok(start_async_trace(test_output), "Restart the writer");
+   P(block_mutex);
+   th_trace((void *)0);
+   V(block_mutex);
+   stop_async_trace();
+   async_trace_stats(&written, &dropped, &waits);
+   ok(waits > 0, "Thread waited on a full buffer");
+   ok(dropped > 0, "Messages are dropped when the writer is stalled");
+   is(nb_msgs + dropped, (uint64_t)NB_MSGS, "Messages are either written or dropped");
+   is(written - written0, (uint64_t)(nb_msgs + nb_others), "Only the written messages are counted");
+   ok(in_order, "Messages are still written in order");
+
+   nok(async_trace_put("T0 0\n", 5), "Messages are not queued after stop");
+   term_msg();
+   return report();
+}
+#endif /* TEST_PROGRAM */
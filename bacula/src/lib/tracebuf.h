@@ -0,0 +1,44 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Asynchronous delivery of the debug and trace output
+ *
+ *  Each thread appends its messages to its own buffer, a single
+ *  writer thread collects the buffers and writes them to the
+ *  trace file or stdout. Tracepoints (Tpt0..Tpt4) store their
+ *  integer arguments in binary, the writer formats them.
+ */
+
+#ifndef TRACEBUF_H
+#define TRACEBUF_H
+
+#define TRACEBUF_SIZE      (32 * 1024)    /* per thread, there are two of them */
+#define TRACEBUF_WAIT      1              /* seconds a thread waits on a full buffer */
+#define TRACEBUF_INTERVAL  100            /* ms between two passes of the writer */
+
+bool start_async_trace(void (*output)(char *buf));
+void stop_async_trace();
+bool async_trace_put(const char *buf, int len);
+void async_trace_stats(uint64_t *written, uint64_t *dropped, uint64_t *waits);
+int async_trace_status(POOL_MEM &msg);
+
+void tp_msg(const char *file, int line, int64_t level, const char *fmt,
+            int64_t a1, int64_t a2, int64_t a3, int64_t a4);
+
+#endif /* TRACEBUF_H */
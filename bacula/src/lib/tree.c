@@ -95,7 +95,7 @@ TREE_ROOT *new_tree(int count)
    root->fname = "";
    root->can_access = 1;
    HL_ENTRY* entry = NULL;
-   root->hardlinks.init(entry, &entry->link, 0);
+   root->hardlinks.init(entry, NULL, 0);
    return root;
 }
 
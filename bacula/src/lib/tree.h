@@ -23,7 +23,7 @@
  *
 */
 
-#include "htable.h"
+#include "ohtable.h"
 
 struct s_mem {
    struct s_mem *next;                /* next buffer */
@@ -110,14 +110,13 @@ struct s_tree_root {
    int cached_path_len;               /* length of cached path */
    char *cached_path;                 /* cached current path */
    TREE_NODE *cached_parent;          /* cached parent for above path */
-   htable hardlinks;                  /* references to first occurrence of hardlinks */
+   ohtable hardlinks;                 /* references to first occurrence of hardlinks */
 };
 typedef struct s_tree_root TREE_ROOT;
 
 /* hardlink hashtable entry */
 struct s_hl_entry {
    uint64_t key;
-   hlink link;
    TREE_NODE *node;
 };
 typedef struct s_hl_entry HL_ENTRY;
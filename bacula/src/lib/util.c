@@ -1118,3 +1118,29 @@ bool is_offset_stream(int stream)
    }
    return false;
 }
+
+/* Does the rec of this stream hold the data of the file */
+bool is_file_data_stream(int stream)
+{
+   switch (stream & STREAMMASK_TYPE) {
+   case STREAM_FILE_DATA:
+   case STREAM_SPARSE_DATA:
+   case STREAM_WIN32_DATA:
+   case STREAM_MACOS_FORK_DATA:
+   case STREAM_GZIP_DATA:
+   case STREAM_SPARSE_GZIP_DATA:
+   case STREAM_WIN32_GZIP_DATA:
+   case STREAM_COMPRESSED_DATA:
+   case STREAM_SPARSE_COMPRESSED_DATA:
+   case STREAM_WIN32_COMPRESSED_DATA:
+   case STREAM_ENCRYPTED_FILE_DATA:
+   case STREAM_ENCRYPTED_WIN32_DATA:
+   case STREAM_ENCRYPTED_FILE_GZIP_DATA:
+   case STREAM_ENCRYPTED_WIN32_GZIP_DATA:
+   case STREAM_ENCRYPTED_FILE_COMPRESSED_DATA:
+   case STREAM_ENCRYPTED_WIN32_COMPRESSED_DATA:
+      return true;
+   default:
+      return false;
+   }
+}
@@ -0,0 +1,272 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * XXH64 hash function
+ *
+ *  This is an implementation of the XXH64 algorithm of Yann Collet
+ *  (BSD 2-clause), written from the published specification. The
+ *  input is consumed by 32 bytes stripes split on four independent
+ *  accumulators, the compiler can keep them in registers and the
+ *  CPU can execute the four lanes in parallel, this is why it is
+ *  an order of magnitude faster than SHA-256 on the same data.
+ *
+ *  The digest is stored in big endian (canonical) form, so it is
+ *  the same on all platforms.
+ */
+
+#include "bacula.h"
+#include "xxhash.h"
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+/* Read a little endian value, the compiler turns it into a single load */
+static inline uint64_t read64(const uint8_t *p)
+{
+   return (uint64_t)p[0]         | ((uint64_t)p[1] << 8)  |
+          ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+          ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+          ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+   return (uint32_t)p[0]         | ((uint32_t)p[1] << 8)  |
+          ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+   acc += input * PRIME64_2;
+   acc = rotl64(acc, 31);
+   return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+{
+   acc ^= xxh64_round(0, val);
+   return acc * PRIME64_1 + PRIME64_4;
+}
+
+/* Consume as many 32 bytes stripes as possible, returns the number of bytes used */
+static uint32_t xxh64_stripes(uint64_t v[4], const uint8_t *p, uint32_t len)
+{
+   const uint8_t *start = p;
+   const uint8_t *limit = p + len - 32;
+   uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+
+   if (len < 32) {
+      return 0;
+   }
+   do {
+      v1 = xxh64_round(v1, read64(p));
+      v2 = xxh64_round(v2, read64(p + 8));
+      v3 = xxh64_round(v3, read64(p + 16));
+      v4 = xxh64_round(v4, read64(p + 24));
+      p += 32;
+   } while (p <= limit);
+
+   v[0] = v1; v[1] = v2; v[2] = v3; v[3] = v4;
+   return p - start;
+}
+
+void XXH64Init(XXH64Context *ctx, uint64_t seed)
+{
+   memset(ctx, 0, sizeof(XXH64Context));
+   ctx->seed = seed;
+   ctx->v[0] = seed + PRIME64_1 + PRIME64_2;
+   ctx->v[1] = seed + PRIME64_2;
+   ctx->v[2] = seed;
+   ctx->v[3] = seed - PRIME64_1;
+}
+
+void XXH64Update(XXH64Context *ctx, const uint8_t *buf, uint32_t len)
+{
+   uint32_t used;
+
+   ctx->total_len += len;
+
+   /* Not enough data for a stripe, keep it for later */
+   if (ctx->memsize + len < 32) {
+      memcpy(ctx->mem + ctx->memsize, buf, len);
+      ctx->memsize += len;
+      return;
+   }
+
+   /* Complete the pending stripe */
+   if (ctx->memsize) {
+      used = 32 - ctx->memsize;
+      memcpy(ctx->mem + ctx->memsize, buf, used);
+      xxh64_stripes(ctx->v, ctx->mem, 32);
+      buf += used;
+      len -= used;
+      ctx->memsize = 0;
+   }
+
+   used = xxh64_stripes(ctx->v, buf, len);
+   if (used < len) {
+      memcpy(ctx->mem, buf + used, len - used);
+      ctx->memsize = len - used;
+   }
+}
+
+uint64_t XXH64Final(XXH64Context *ctx, uint8_t digest[XXH64HashSize])
+{
+   const uint8_t *p = ctx->mem;
+   const uint8_t *end = ctx->mem + ctx->memsize;
+   uint64_t h;
+
+   if (ctx->total_len >= 32) {
+      h = rotl64(ctx->v[0], 1) + rotl64(ctx->v[1], 7) +
+          rotl64(ctx->v[2], 12) + rotl64(ctx->v[3], 18);
+      h = xxh64_merge_round(h, ctx->v[0]);
+      h = xxh64_merge_round(h, ctx->v[1]);
+      h = xxh64_merge_round(h, ctx->v[2]);
+      h = xxh64_merge_round(h, ctx->v[3]);
+   } else {
+      h = ctx->seed + PRIME64_5;
+   }
+   h += ctx->total_len;
+
+   while (p + 8 <= end) {
+      h ^= xxh64_round(0, read64(p));
+      h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+      p += 8;
+   }
+   if (p + 4 <= end) {
+      h ^= (uint64_t)read32(p) * PRIME64_1;
+      h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+   }
+   while (p < end) {
+      h ^= (*p) * PRIME64_5;
+      h = rotl64(h, 11) * PRIME64_1;
+      p++;
+   }
+
+   /* Avalanche */
+   h ^= h >> 33;
+   h *= PRIME64_2;
+   h ^= h >> 29;
+   h *= PRIME64_3;
+   h ^= h >> 32;
+
+   if (digest) {
+      for (int i = 0; i < XXH64HashSize; i++) {
+         digest[i] = (uint8_t)(h >> (56 - 8 * i));
+      }
+   }
+   return h;
+}
+
+/* One shot version */
+uint64_t XXH64(const uint8_t *buf, uint32_t len, uint64_t seed)
+{
+   XXH64Context ctx;
+   XXH64Init(&ctx, seed);
+   XXH64Update(&ctx, buf, len);
+   return XXH64Final(&ctx, NULL);
+}
+
+#ifdef TEST_PROGRAM
+#include "unittests.h"
+
+/* Reference values from the XXH64 specification test suite */
+static struct {
+   const char *data;
+   uint64_t seed;
+   uint64_t result;
+} tests[] = {
+   { "",    0, 0xEF46DB3751D8E999ULL },
+   { "a",   0, 0xD24EC4F1A98C6E5BULL },
+   { "abc", 0, 0x44BC2CF5AD770999ULL },
+   /* 32 bytes and more use the four lanes */
+   { "abcdefghijklmnopqrstuvwxyz012345",        0, 0xBF2CD639B4143B80ULL },
+   { "Nobody inspects the spammish repetition", 0, 0xFBCEA83C8A378BF1ULL },
+   { NULL,  0, 0 }
+};
+
+/* Reference values for buffers filled with (i * 7 + 3) */
+static struct {
+   uint32_t len;
+   uint64_t seed;
+   uint64_t result;
+} buf_tests[] = {
+   { 100,         0, 0xA61F8D4C170FE531ULL },
+   { 100,        42, 0x7DD00BE8513C25A2ULL },
+   { 1000,       42, 0xD776E8028586FF61ULL },
+   { 1024*1024,   0, 0x989560CE899D661BULL },
+   { 1024*1024,  42, 0x8F6CF7F5B6414307ULL },
+   { 0,           0, 0 }
+};
+
+int main()
+{
+   Unittests xxhash_test("xxhash_test");
+   XXH64Context ctx;
+   uint8_t buf[1000], digest[XXH64HashSize];
+   uint8_t *big;
+   uint64_t h;
+   int i;
+
+   for (i = 0; tests[i].data; i++) {
+      h = XXH64((const uint8_t *)tests[i].data, strlen(tests[i].data), tests[i].seed);
+      ok(h == tests[i].result, "Checking reference value");
+   }
+
+   big = (uint8_t *)malloc(1024*1024);
+   for (i = 0; i < 1024*1024; i++) {
+      big[i] = (uint8_t)(i * 7 + 3);
+   }
+   for (i = 0; buf_tests[i].len; i++) {
+      h = XXH64(big, buf_tests[i].len, buf_tests[i].seed);
+      ok(h == buf_tests[i].result, "Checking reference value of a buffer");
+   }
+   free(big);
+
+   /* The streaming interface must give the same result for any split */
+   for (i = 0; i < (int)sizeof(buf); i++) {
+      buf[i] = (uint8_t)(i * 7 + 3);
+   }
+   h = XXH64(buf, sizeof(buf), 42);
+   bool same = true;
+   for (int split = 1; split < 100; split++) {
+      XXH64Init(&ctx, 42);
+      for (uint32_t pos = 0; pos < sizeof(buf); pos += split) {
+         XXH64Update(&ctx, buf + pos, MIN((uint32_t)split, sizeof(buf) - pos));
+      }
+      if (XXH64Final(&ctx, digest) != h) {
+         same = false;
+      }
+   }
+   ok(same, "Checking streaming interface");
+   ok(digest[0] == (uint8_t)(h >> 56) && digest[7] == (uint8_t)h,
+      "Checking canonical digest format");
+
+   return report();
+}
+#endif /* TEST_PROGRAM */
@@ -0,0 +1,47 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Bacula XXH64 definitions
+ *
+ *  XXH64 is a fast non-cryptographic hash function, it is used
+ *  to detect changes in the file data when a cryptographic
+ *  digest is not required (Signature = XXH64).
+ */
+
+#ifndef __BXXHASH_H
+#define __BXXHASH_H
+
+#define XXH64HashSize 8
+
+struct XXH64Context {
+   uint64_t total_len;                /* Total number of bytes hashed */
+   uint64_t v[4];                     /* Accumulators */
+   uint8_t  mem[32];                  /* Pending input, less than a stripe */
+   uint32_t memsize;                  /* Number of bytes in mem */
+   uint64_t seed;
+};
+
+typedef struct XXH64Context XXH64Context;
+
+extern void XXH64Init(XXH64Context *ctx, uint64_t seed);
+extern void XXH64Update(XXH64Context *ctx, const uint8_t *buf, uint32_t len);
+extern uint64_t XXH64Final(XXH64Context *ctx, uint8_t digest[XXH64HashSize]);
+extern uint64_t XXH64(const uint8_t *buf, uint32_t len, uint64_t seed);
+
+#endif /* !__BXXHASH_H */
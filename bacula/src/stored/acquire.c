@@ -667,6 +667,7 @@ DCR *new_dcr(JCR *jcr, DCR *dcr, DEVICE *dev, bool writing)
          dcr->max_job_spool_size = dev->device->max_job_spool_size;
       }
       dcr->device = dev->device;
+      dcr->max_index_size = dev->device->max_file_index;
       dcr->set_dev(dev);
       Dmsg2(100, "Attach 0x%x to dev %s\n", dcr, dev->print_name());
       dev->attach_dcr_to_dev(dcr);
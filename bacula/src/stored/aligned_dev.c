@@ -19,3 +19,306 @@
 /*
  *  Written by: Kern Sibbald, March MMXIII
  */
+/*
+ * Aligned device: the Volume file holds the metadata and a
+ *  second file holds the file data on FileAlignment boundaries.
+ *  The record level write/read code is in aligned_write.c and
+ *  aligned_read.c
+ */
+
+#include "bacula.h"
+#include "stored.h"
+
+static const int dbglvl = 100;
+
+/* Imported functions */
+const char *mode_to_str(int mode);
+
+#define ADATA_HDR_LENGTH  512       /* serialized adata volume header */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DEVICE *BaculaSDdriver(JCR *jcr, DEVRES *device)
+{
+   DEVICE *dev = New(aligned_dev);
+   return dev;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+aligned_dev::aligned_dev()
+{
+   adata_fd = -1;
+   no_reflink = false;
+}
+
+aligned_dev::~aligned_dev()
+{
+   if (adata_fd >= 0) {
+      ::close(adata_fd);
+      adata_fd = -1;
+   }
+}
+
+int aligned_dev::device_specific_init(JCR *jcr, DEVRES *device)
+{
+   if (file_dev::device_specific_init(jcr, device) != 0) {
+      return -1;
+   }
+   /* The data must at least be on sector boundaries */
+   if (file_alignment < ADATA_MIN_ALIGNMENT) {
+      file_alignment = ADATA_MIN_ALIGNMENT;
+   }
+   if (padding_size == 0) {
+      padding_size = file_alignment;
+   }
+   adata_size = MAX(ADATA_BLOCK_SIZE, max_block_size);
+   return 0;
+}
+
+/*
+ * Name of the aligned data file, follows what file_dev::open_device()
+ *  does for the Volume file.
+ */
+void aligned_dev::get_adata_name(POOLMEM *&fname)
+{
+   pm_strcpy(fname, dev_name);
+   if (!device->changer_res || device->changer_command[0] == 0 ||
+        strcmp(device->changer_command, "/dev/null") == 0) {
+      if (!IsPathSeparator(fname[strlen(fname)-1])) {
+         pm_strcat(fname, "/");
+      }
+      pm_strcat(fname, getVolCatName());
+   }
+   pm_strcat(fname, ADATA_EXTENSION);
+}
+
+boffset_t aligned_dev::align_adata_addr(boffset_t addr)
+{
+   return ((addr + file_alignment - 1) / file_alignment) * file_alignment;
+}
+
+/*
+ * Open both files of the Volume
+ */
+bool aligned_dev::open_device(DCR *dcr, int omode)
+{
+   POOL_MEM fname(PM_FNAME);
+
+   if (!file_dev::open_device(dcr, omode)) {
+      return false;
+   }
+   if (adata_fd >= 0) {
+      return true;                    /* already open in the same mode */
+   }
+   get_adata_name(fname.addr());
+   Dmsg2(dbglvl, "open adata: mode=%s open(%s)\n", mode_to_str(omode), fname.c_str());
+   if ((adata_fd = ::open(fname.c_str(), mode|O_CLOEXEC, 0640)) < 0) {
+      berrno be;
+      dev_errno = errno;
+      Mmsg3(errmsg, _("Could not open(%s,%s,0640): ERR=%s\n"),
+            fname.c_str(), mode_to_str(omode), be.bstrerror());
+      Dmsg1(40, "open failed: %s", errmsg);
+      if (dcr->jcr) {
+         pm_strcpy(dcr->jcr->errmsg, errmsg);
+      }
+      file_dev::device_specific_close(dcr);
+      return false;
+   }
+   return true;
+}
+
+int aligned_dev::device_specific_close(DCR *dcr)
+{
+   if (adata_fd >= 0) {
+      ::close(adata_fd);
+      adata_fd = -1;
+   }
+   return file_dev::device_specific_close(dcr);
+}
+
+bool aligned_dev::close(DCR *dcr)
+{
+   bool ok = true;
+
+   if (adata_fd >= 0) {
+      if (::close(adata_fd) != 0) {
+         berrno be;
+         dev_errno = errno;
+         Mmsg(errmsg, _("Error closing aligned volume \"%s\" device %s. ERR=%s.\n"),
+              VolHdr.VolumeName, print_name(), be.bstrerror());
+         ok = false;
+      }
+      adata_fd = -1;
+   }
+   return file_dev::close(dcr) && ok;
+}
+
+bool aligned_dev::truncate(DCR *dcr)
+{
+   if (!file_dev::truncate(dcr)) {
+      return false;
+   }
+   if (adata_fd >= 0 && ftruncate(adata_fd, 0) != 0) {
+      berrno be;
+      Mmsg2(errmsg, _("Unable to truncate aligned data of device %s. ERR=%s\n"),
+            print_name(), be.bstrerror());
+      return false;
+   }
+   adata_addr = 0;
+   return true;
+}
+
+boffset_t aligned_dev::get_adata_size(DCR *dcr)
+{
+   struct stat statp;
+
+   if (adata_fd < 0 || fstat(adata_fd, &statp) != 0) {
+      return (boffset_t)0;
+   }
+   return (boffset_t)statp.st_size;
+}
+
+/*
+ * Position both files at the end. The next adata block goes
+ *  to the first aligned address after the end of the data.
+ */
+bool aligned_dev::eod(DCR *dcr)
+{
+   if (!file_dev::eod(dcr)) {
+      return false;
+   }
+   adata_addr = align_adata_addr(get_adata_size(dcr));
+   Dmsg1(dbglvl, "eod adata_addr=%lld\n", adata_addr);
+   return true;
+}
+
+const char *aligned_dev::print_type()
+{
+   return "Aligned";
+}
+
+/*
+ * Virtual Full and Copy jobs can clone the aligned data of the
+ *  read Volumes when they are on the same filesystem as ours.
+ */
+bool aligned_dev::can_clone_adata(DEVICE *src)
+{
+   struct stat st1, st2;
+
+   if (src == this || !src->is_aligned()) {
+      return false;
+   }
+   if (stat(dev_name, &st1) != 0 || stat(src->dev_name, &st2) != 0) {
+      return false;
+   }
+   return st1.st_dev == st2.st_dev;
+}
+
+void aligned_dev::new_dcr_blocks(DCR *dcr)
+{
+   DEVICE::new_dcr_blocks(dcr);
+   dcr->adata_block = new_block(dcr, adata_size);
+   dcr->adata_block->adata = true;
+   empty_block(dcr->adata_block);
+}
+
+/*
+ * The aligned data file starts with a small header that
+ *  ties it to its Volume, the data starts at FirstData.
+ */
+bool aligned_dev::write_adata_volume_header(DCR *dcr)
+{
+   ser_declare;
+   uint32_t len = align_adata_addr(ADATA_HDR_LENGTH);
+   POOLMEM *buf = get_memory(len);
+   bool ok = true;
+
+   memset(buf, 0, len);
+   ser_begin(buf, ADATA_HDR_LENGTH);
+   ser_string(BaculaAlignedDataId);
+   ser_uint32(BaculaAlignedDataVersion);
+   ser_string(VolHdr.VolumeName);
+   ser_uint32(file_alignment);
+   ser_end(buf, ADATA_HDR_LENGTH);
+
+   if (ftruncate(adata_fd, 0) != 0 || pwrite(adata_fd, buf, len, 0) != (ssize_t)len) {
+      berrno be;
+      dev_errno = errno;
+      Mmsg2(errmsg, _("Unable to write the aligned data label on device %s. ERR=%s\n"),
+            print_name(), be.bstrerror());
+      Jmsg(dcr->jcr, M_ERROR, 0, "%s", errmsg);
+      ok = false;
+   } else {
+      adata_addr = len;
+      Lock_VolCatInfo();
+      VolCatInfo.VolCatAdataBytes = len;
+      VolCatInfo.VolCatBytes = VolCatInfo.VolCatAmetaBytes + len;
+      Unlock_VolCatInfo();
+   }
+   free_pool_memory(buf);
+   return ok;
+}
+
+bool aligned_dev::check_adata_volume_header(DCR *dcr)
+{
+   ser_declare;
+   char buf[ADATA_HDR_LENGTH];
+   char Id[MAX_NAME_LENGTH];
+   char VolName[MAX_NAME_LENGTH];
+   uint32_t VerNum;
+
+   memset(buf, 0, sizeof(buf));
+   if (pread(adata_fd, buf, sizeof(buf), 0) < 0) {
+      berrno be;
+      Mmsg2(dcr->jcr->errmsg, _("Unable to read the aligned data label on device %s. ERR=%s\n"),
+            print_name(), be.bstrerror());
+      return false;
+   }
+   unser_begin(buf, ADATA_HDR_LENGTH);
+   unser_string(Id);
+   unser_uint32(VerNum);
+   unser_string(VolName);
+   if (strcmp(Id, BaculaAlignedDataId) != 0 || VerNum != BaculaAlignedDataVersion ||
+       strcmp(VolName, VolHdr.VolumeName) != 0) {
+      Mmsg2(dcr->jcr->errmsg, _("The aligned data of Volume \"%s\" on device %s is missing or does not belong to the Volume.\n"),
+            VolHdr.VolumeName, print_name());
+      return false;
+   }
+   return true;
+}
+
+int aligned_dev::read_dev_volume_label(DCR *dcr)
+{
+   int stat = file_dev::read_dev_volume_label(dcr);
+
+   if (stat == VOL_OK && !check_adata_volume_header(dcr)) {
+      Dmsg1(dbglvl, "%s", dcr->jcr->errmsg);
+      stat = VOL_LABEL_ERROR;
+   }
+   return stat;
+}
+
+bool aligned_dev::write_volume_label_to_dev(DCR *dcr, const char *VolName,
+              const char *PoolName, bool relabel, bool no_prelabel)
+{
+   if (!file_dev::write_volume_label_to_dev(dcr, VolName, PoolName, relabel, no_prelabel)) {
+      return false;
+   }
+   return write_adata_volume_header(dcr);
+}
+
+/*
+ * Used when a prelabeled or recycled Volume gets its real label
+ */
+bool aligned_dev::write_volume_label_to_block(DCR *dcr)
+{
+   if (!file_dev::write_volume_label_to_block(dcr)) {
+      return false;
+   }
+   return write_adata_volume_header(dcr);
+}
@@ -17,128 +17,74 @@
    Bacula(R) is a registered trademark of Kern Sibbald.
 */
 /*
- * Inspired by vtape.h
+ * Aligned volumes
+ *
+ *  An aligned Volume is made of two files. The Volume file holds
+ *  the normal Bacula blocks (the metadata, or ameta), and the file
+ *  with the ADATA_EXTENSION holds the file data (the adata) of the
+ *  big data records, with each record starting on a FileAlignment
+ *  boundary and with no header in between. The same file data
+ *  is then stored at the same alignment as on the client, so the
+ *  filesystem block sharing (reflink, dedup) can work on it.
+ *
+ *  For each ameta block that references adata, the records of the
+ *  block are grouped into one adata block that is written just
+ *  before the ameta block. The ameta block contains one adata block
+ *  header (address, length, checksum) followed by an adata record
+ *  header (offset in the adata block, original Stream) per record.
  */
 
 #ifndef _ALIGNED_DEV_H_
 #define _ALIGNED_DEV_H_
 
+#define ADATA_BLOCK_SIZE   (1024 * 1024)   /* default adata block size */
+#define ADATA_MIN_ALIGNMENT 512            /* smallest FileAlignment used */
+
 class aligned_dev : public file_dev {
-public:
+   int adata_fd;                        /* fd of the aligned data file */
+   bool no_reflink;                     /* FICLONERANGE is not supported */
+
+   void get_adata_name(POOLMEM *&fname);
+   boffset_t align_adata_addr(boffset_t addr);
+   bool write_adata_volume_header(DCR *dcr);
+   bool check_adata_volume_header(DCR *dcr);
+   bool adata_pending(DCR *dcr);
+   bool add_clone(DEV_BLOCK *ablock, DEV_RECORD *rec, uint32_t off, uint32_t len);
+   bool read_clone_data(DCR *dcr, DEV_RECORD *rec);
+   uint32_t clone_range(int fd, boffset_t src, boffset_t dst, uint32_t len);
+   bool pwrite_adata(const char *buf, uint32_t len, boffset_t addr);
 
+public:
    aligned_dev();
    ~aligned_dev();
 
-   aligned_dev *paired_dev;                /* Paired meta data or aligned data device */
-
-   boffset_t get_adata_size(DCR *dcr);
-   boffset_t align_adata_addr(DCR *dcr, boffset_t addr);
-   boffset_t get_adata_addr(DCR *dcr);
-   void set_adata_addr(DCR *dcr);
-   void clear_adata_addr();
-
    /* DEVICE virtual functions that we redefine */
-   void setVolCatName(const char *name);
-   void setVolCatStatus(const char *status);
-   void free_dcr_blocks(DCR *dcr);
-   void new_dcr_blocks(DCR *dcr);
-   void updateVolCatBytes(uint64_t);
-   void updateVolCatBlocks(uint32_t);
-   void updateVolCatWrites(uint32_t);
-   void updateVolCatReads(uint32_t);
-   void updateVolCatReadBytes(uint64_t);
-   void updateVolCatPadding(uint64_t);
-   bool setVolCatAdataBytes(uint64_t bytes);
-   void updateVolCatHoleBytes(uint64_t bytes);
-   void device_specific_open(DCR *dcr);
-   void set_volcatinfo_from_dcr(DCR *dcr);
-   bool allow_maxbytes_concurrency(DCR *dcr);
-   bool flush_before_eos(DCR *dcr);
-   void set_nospace();
-   void set_append();
-   void set_read();
-   void clear_nospace();
-   void clear_append();
-   void clear_read();
    int device_specific_init(JCR *jcr, DEVRES *device);
    int device_specific_close(DCR *dcr);
-   int d_close(int fd);
-   int d_open(const char *pathname, int flags);
-   int d_ioctl(int fd, ioctl_req_t request, char *mt_com);
-   ssize_t d_read(int fd, void *buffer, size_t count);
-   ssize_t d_write(int, const void *buffer, size_t count);
-   boffset_t lseek(DCR *dcr, off_t offset, int whence);
-   bool rewind(DCR *dcr);
-   bool reposition(DCR *dcr, uint64_t raddr);
+   void new_dcr_blocks(DCR *dcr);
+   boffset_t get_adata_size(DCR *dcr);
    bool open_device(DCR *dcr, int omode);
-   bool truncate(DCR *dcr);
    bool close(DCR *dcr);
-   void term(DCR *dcr);
+   bool truncate(DCR *dcr);
    bool eod(DCR *dcr);
-   bool update_pos(DCR *dcr);
-   bool mount_file(int mount, int dotimeout);
-   bool is_indexed() { return !adata; };
-   int read_dev_volume_label(DCR *dcr);
    const char *print_type();
-   DEVICE *get_dev(DCR *dcr);
-   uint32_t get_hi_addr();
-   uint32_t get_low_addr();
-   uint64_t get_full_addr();
-   uint64_t get_full_addr(boffset_t addr);
-   bool do_size_checks(DCR *dcr, DEV_BLOCK *block);
+   int read_dev_volume_label(DCR *dcr);
    bool write_volume_label_to_block(DCR *dcr);
    bool write_volume_label_to_dev(DCR *dcr,
           const char *VolName, const char *PoolName,
           bool relabel, bool no_prelabel);
-   bool write_adata_label(DCR *dcr, DEV_RECORD *rec);
-   void write_adata(DCR *dcr, DEV_RECORD *rec);
-   void write_cont_adata(DCR *dcr, DEV_RECORD *rec);
+
+   /* aligned_write.c */
+   void select_data_stream(DCR *dcr, DEV_RECORD *rec);
    int  write_adata_rechdr(DCR *dcr, DEV_RECORD *rec);
-   bool read_adata_record_header(DCR *dcr, DEV_BLOCK *block, DEV_RECORD *rec, bool *firstcall);
-   void read_adata_block_header(DCR *dcr);
-   int read_adata(DCR *dcr, DEV_RECORD *rec);
+   bool write_adata_block(DCR *dcr);
+   bool can_clone_adata(DEVICE *src);
+
+   /* aligned_read.c */
    bool have_adata_header(DCR *dcr, DEV_RECORD *rec, int32_t  FileIndex,
                         int32_t  Stream, uint32_t VolSessionId);
-   void select_data_stream(DCR *dcr, DEV_RECORD *rec);
-   bool flush_block(DCR *dcr);
-   bool do_pre_write_checks(DCR *dcr, DEV_RECORD *rec);
-
-
-
-   /*
-    * Locking and blocking calls
-    */
-#ifdef DEV_DEBUG_LOCK
-   void dbg_Lock(const char *, int);
-   void dbg_Unlock(const char *, int);
-   void dbg_rLock(const char *, int, bool locked=false);
-   void dbg_rUnlock(const char *, int);
-#else
-   void Lock();
-   void Unlock();
-   void rLock(bool locked=false);
-   void rUnlock();
-#endif
-
-#ifdef  SD_DEBUG_LOCK
-   void dbg_Lock_acquire(const char *, int);
-   void dbg_Unlock_acquire(const char *, int);
-   void dbg_Lock_read_acquire(const char *, int);
-   void dbg_Unlock_read_acquire(const char *, int);
-   void dbg_Lock_VolCatInfo(const char *, int);
-   void dbg_Unlock_VolCatInfo(const char *, int);
-#else
-   void Lock_acquire();
-   void Unlock_acquire();
-   void Lock_read_acquire();
-   void Unlock_read_acquire();
-   void Lock_VolCatInfo();
-   void Unlock_VolCatInfo();
-#endif
-
-   void dblock(int why);                  /* in lock.c */
-   void dunblock(bool locked=false);
-
+   void read_adata_block_header(DCR *dcr);
+   int read_adata(DCR *dcr, DEV_RECORD *rec);
 };
 
 #endif /* _ALIGNED_DEV_H_ */
@@ -18,8 +18,193 @@
 */
 /*
  *
- *   record_read.c -- Volume (tape/disk) record read functions
+ *   aligned_read.c -- Aligned Volume record read functions
  *
- *            Kern Sibbald, April MMI
- *              added BB02 format October MMII
+ *     The ameta block headers written by aligned_write.c are
+ *     turned back into normal data records.
  */
+
+#include "bacula.h"
+#include "stored.h"
+
+static const int dbglvl = 200;
+
+/* Imported functions */
+bool unser_block_header(DCR *dcr, DEVICE *dev, DEV_BLOCK *block);
+
+/*
+ * Called by read_header() with the first part of each record
+ *  header unserialized. The block header gives the location of
+ *  the adata block, the record header the location of the data
+ *  in it.
+ *
+ *  Returns: true  if we had an adata header, rec->rstate is set
+ *           false if this is a normal record
+ */
+bool aligned_dev::have_adata_header(DCR *dcr, DEV_RECORD *rec,
+        int32_t FileIndex, int32_t Stream, uint32_t VolSessionId)
+{
+   unser_declare;
+   DEV_BLOCK *block = dcr->ameta_block;
+   DEV_BLOCK *ablock = dcr->adata_block;
+   uint32_t hdrlen, reclen;
+   int32_t oStream;
+   uint64_t FileOffset;
+
+   if (Stream == STREAM_ADATA_BLOCK_HEADER) {
+      hdrlen = WRITE_ADATA_BLKHDR_LENGTH;
+      if (rec->remlen < hdrlen) {
+         goto bad_header;
+      }
+      unser_begin(block->bufp + 3*sizeof(int32_t), hdrlen);
+      unser_uint32(ablock->CheckSum);
+      unser_uint32(ablock->VolSessionId);
+      unser_uint32(ablock->VolSessionTime);
+      unser_uint64(ablock->BlockAddr);
+      ablock->BlockNumber = FileIndex;
+      ablock->block_len = rec->data_bytes;
+      ablock->block_read = false;
+      rec->rstate = st_adata_blkhdr;
+
+   } else if (Stream == STREAM_ADATA_RECORD_HEADER) {
+      hdrlen = WRITE_ADATA_RECHDR_LENGTH;
+      if (rec->remlen < hdrlen) {
+         goto bad_header;
+      }
+      unser_begin(block->bufp + 3*sizeof(int32_t), WRITE_ADATA_RECHDR_LENGTH_MAX);
+      unser_uint32(reclen);
+      unser_int32(oStream);
+      rec->data = check_pool_memory_size(rec->data, rec->data_bytes + OFFSET_FADDR_SIZE);
+      rec->data_len = 0;
+      if (is_offset_stream(oStream)) {
+         hdrlen += OFFSET_FADDR_SIZE;
+         if (rec->remlen < hdrlen) {
+            goto bad_header;
+         }
+         unser_uint64(FileOffset);
+         /* The offset goes in front of the data, as in the original record */
+         ser_begin(rec->data, OFFSET_FADDR_SIZE);
+         ser_uint64(FileOffset);
+         rec->data_len = OFFSET_FADDR_SIZE;
+      }
+      ablock->reclen = reclen;
+      rec->remainder = 0;
+      rec->Stream = oStream;
+      rec->maskedStream = rec->Stream & STREAMMASK_TYPE;
+      rec->VolSessionId = VolSessionId;
+      rec->VolSessionTime = block->VolSessionTime;
+      rec->FileIndex = FileIndex;
+      if (FileIndex > 0) {
+         if (block->FirstIndex == 0) {
+            block->FirstIndex = FileIndex;
+         }
+         block->LastIndex = FileIndex;
+      }
+      rec->rstate = st_adata;
+
+   } else {
+      return false;
+   }
+   block->bufp += hdrlen;
+   block->binbuf -= hdrlen;
+   rec->remlen -= hdrlen;
+   return true;
+
+bad_header:
+   Jmsg2(dcr->jcr, M_WARNING, 0, _("Truncated adata header in block %u. Stream=%d. Block discarded.\n"),
+         block->BlockNumber, Stream);
+   rec->state_bits |= (REC_NO_HEADER | REC_BLOCK_EMPTY);
+   empty_block(block);
+   rec->rstate = st_header;
+   return true;
+}
+
+/*
+ * Read the adata block described by the block header we just
+ *  got from the ameta block.
+ */
+void aligned_dev::read_adata_block_header(DCR *dcr)
+{
+   DEV_BLOCK *ablock = dcr->adata_block;
+   ssize_t stat = 0;
+   uint32_t done;
+
+   if (dcr->clone_adata) {
+      /* Virtual Full or Copy, the writer clones the data */
+      ablock->read_len = 0;
+      ablock->block_read = true;
+      return;
+   }
+   if (ablock->block_len > ablock->buf_len) {
+      ablock->buf = check_pool_memory_size(ablock->buf, ablock->block_len);
+      ablock->buf_len = ablock->block_len;
+   }
+   for (done = 0; done < ablock->block_len; done += stat) {
+      stat = pread(adata_fd, ablock->buf + done, ablock->block_len - done,
+                   ablock->BlockAddr + done);
+      if (stat <= 0) {
+         if (stat < 0 && errno == EINTR) {
+            stat = 0;
+            continue;
+         }
+         break;
+      }
+   }
+   if (done != ablock->block_len) {
+      berrno be;
+      dev_errno = (stat < 0) ? errno : EIO;
+      Mmsg4(errmsg, _("Read error on adata Volume \"%s\" at %lld len=%u. ERR=%s\n"),
+            getVolCatName(), ablock->BlockAddr, ablock->block_len,
+            stat < 0 ? be.bstrerror(dev_errno) : _("short read"));
+      Jmsg(dcr->jcr, M_ERROR, 0, "%s", errmsg);
+      ablock->read_errors++;
+      return;
+   }
+   ablock->read_len = done;
+   ablock->binbuf = done;
+   if (!unser_block_header(dcr, this, ablock)) {
+      return;
+   }
+   Lock_VolCatInfo();
+   VolCatInfo.VolCatAdataReads++;
+   VolCatInfo.VolCatAdataRBytes += done;
+   VolCatInfo.VolCatReads++;
+   VolCatInfo.VolCatRBytes += done;
+   Unlock_VolCatInfo();
+   ablock->block_read = true;
+   Dmsg3(dbglvl, "Read adata block at %lld len=%u Vol=%s\n", ablock->BlockAddr,
+      ablock->block_len, getVolCatName());
+}
+
+/*
+ * Copy the data of the record from the adata block, or only
+ *  tell where it is when it will be cloned.
+ *
+ *  Returns: -1 on error
+ *            1 the record is complete
+ */
+int aligned_dev::read_adata(DCR *dcr, DEV_RECORD *rec)
+{
+   DEV_BLOCK *ablock = dcr->adata_block;
+
+   if (!ablock->block_read) {
+      Dmsg1(dbglvl, "No adata block for FI=%d\n", rec->FileIndex);
+      return -1;
+   }
+   if (ablock->reclen + rec->data_bytes > ablock->block_len) {
+      Jmsg4(dcr->jcr, M_ERROR, 0, _("Bad adata record FI=%d off=%u len=%u in block of %u bytes.\n"),
+            rec->FileIndex, ablock->reclen, rec->data_bytes, ablock->block_len);
+      return -1;
+   }
+   if (dcr->clone_adata) {
+      rec->state_bits |= REC_ADATA_CLONE;
+      rec->clone_fd = adata_fd;
+      rec->clone_addr = ablock->BlockAddr + ablock->reclen;
+   } else {
+      memcpy(rec->data + rec->data_len, ablock->buf + ablock->reclen, rec->data_bytes);
+   }
+   rec->data_len += rec->data_bytes;
+   rec->remainder = 0;
+   rec->rstate = st_header;
+   return 1;
+}
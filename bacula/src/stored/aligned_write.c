@@ -18,9 +18,438 @@
 */
 /*
  *
- *   record_write.c -- Volume (tape/disk) record write functions
+ *   aligned_write.c -- Aligned Volume record write functions
  *
- *            Kern Sibbald, April MMI
- *              added BB02 format October MMII
- *              added aligned format November MMXII
+ *     The data of the big data records goes to the aligned data
+ *     file, the ameta block gets the headers that point to it.
  */
+
+#include "bacula.h"
+#include "stored.h"
+
+#ifdef HAVE_LINUX_OS
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#endif
+
+static const int dbglvl = 200;
+
+/*
+ * Read len bytes at addr, returns the number of bytes read
+ */
+static uint32_t read_full(int fd, char *buf, uint32_t len, boffset_t addr)
+{
+   ssize_t stat;
+   uint32_t done;
+
+   for (done = 0; done < len; done += stat) {
+      stat = pread(fd, buf + done, len - done, addr + done);
+      if (stat <= 0) {
+         if (stat < 0 && errno == EINTR) {
+            stat = 0;
+            continue;
+         }
+         break;
+      }
+   }
+   return done;
+}
+
+/*
+ * Only the file data goes to the aligned data file, and only
+ *  when the record is at least one alignment unit. Compressed
+ *  or encrypted data would not share blocks with anything, but
+ *  it costs nothing to keep it aligned as well.
+ */
+void aligned_dev::select_data_stream(DCR *dcr, DEV_RECORD *rec)
+{
+   uint32_t prefix = is_offset_stream(rec->Stream) ? OFFSET_FADDR_SIZE : 0;
+
+   rec->wstate = st_header;
+   if (rec->FileIndex > 0 && rec->data_len >= prefix + file_alignment &&
+       !(rec->Stream & STREAM_BIT_DEDUPLICATION_DATA) &&
+       is_file_data_stream(rec->Stream)) {
+      rec->wstate = st_adata_rechdr;
+   }
+   /* A cloned record that goes to the ameta block needs its data */
+   if (rec->wstate == st_header && rec->state_bits & REC_ADATA_CLONE) {
+      read_clone_data(dcr, rec);
+   }
+}
+
+/*
+ * The data of a record from a Virtual Full or Copy job is not read
+ *  when we can clone it, see can_clone_adata(). Read it when we
+ *  cannot.
+ */
+bool aligned_dev::read_clone_data(DCR *dcr, DEV_RECORD *rec)
+{
+   uint32_t prefix = is_offset_stream(rec->Stream) ? OFFSET_FADDR_SIZE : 0;
+   uint32_t len = rec->data_len - prefix;
+   char ed1[50];
+
+   rec->state_bits &= ~REC_ADATA_CLONE;
+   rec->data = check_pool_memory_size(rec->data, rec->data_len);
+   if (read_full(rec->clone_fd, rec->data + prefix, len, rec->clone_addr) != len) {
+      berrno be;
+      Jmsg(dcr->jcr, M_FATAL, 0, _("Read error on aligned data at %s len=%u. ERR=%s\n"),
+           edit_uint64(rec->clone_addr, ed1), len, be.bstrerror());
+      return false;
+   }
+   return true;
+}
+
+/*
+ * Remember that the data at off in the adata block is in the read
+ *  Volume. Records that follow each other on both Volumes make one
+ *  part, the gap is then the padding of the first one, which is
+ *  smaller than any adata record.
+ *
+ *  Returns: false if the data must be read
+ */
+bool aligned_dev::add_clone(DEV_BLOCK *ablock, DEV_RECORD *rec, uint32_t off, uint32_t len)
+{
+   struct stat st1, st2;
+   adata_clone *c;
+
+   /* The reader may have changed Volume since the last record */
+   if (ablock->clone_fd >= 0) {
+      if (fstat(ablock->clone_fd, &st1) != 0 || fstat(rec->clone_fd, &st2) != 0 ||
+          st1.st_dev != st2.st_dev || st1.st_ino != st2.st_ino) {
+         if (ablock->nclones > 0) {
+            return false;             /* one source per adata block */
+         }
+         ::close(ablock->clone_fd);
+         ablock->clone_fd = -1;
+      }
+   }
+   /* Our own descriptor, the data is cloned when the block is written */
+   if (ablock->clone_fd < 0 &&
+       (ablock->clone_fd = fcntl(rec->clone_fd, F_DUPFD_CLOEXEC, 0)) < 0) {
+      return false;
+   }
+   if (ablock->nclones > 0) {
+      c = &ablock->clones[ablock->nclones - 1];
+      if (rec->clone_addr >= c->src + c->len &&
+          off - (c->off + c->len) == rec->clone_addr - (c->src + c->len) &&
+          off - (c->off + c->len) < ADATA_MIN_ALIGNMENT) {
+         c->len = off + len - c->off;
+         return true;
+      }
+   }
+   if (ablock->nclones == ablock->max_clones) {
+      ablock->max_clones = ablock->max_clones ? 2 * ablock->max_clones : 32;
+      ablock->clones = (adata_clone *)realloc(ablock->clones,
+                          ablock->max_clones * sizeof(adata_clone));
+   }
+   c = &ablock->clones[ablock->nclones++];
+   c->off = off;
+   c->len = len;
+   c->src = rec->clone_addr;
+   return true;
+}
+
+/*
+ * The adata block belongs to the ameta block that holds its
+ *  block header. Once that ameta block is written, the block
+ *  number changes and the adata block can be reused.
+ */
+bool aligned_dev::adata_pending(DCR *dcr)
+{
+   DEV_BLOCK *ablock = dcr->adata_block;
+
+   return ablock->binbuf > 0 &&
+          ablock->BlockNumber == dcr->ameta_block->BlockNumber &&
+          ablock->reclen < dcr->ameta_block->binbuf;
+}
+
+/*
+ * Put the record data into the adata block, and the headers that
+ *  point to it into the ameta block.
+ *
+ *  Returns: -1 the blocks must be written first
+ *            0 the record goes to the ameta block, continue
+ *            1 the record is written
+ */
+int aligned_dev::write_adata_rechdr(DCR *dcr, DEV_RECORD *rec)
+{
+   ser_declare;
+   DEV_BLOCK *block = dcr->ameta_block;
+   DEV_BLOCK *ablock = dcr->adata_block;
+   bool offset_stream = is_offset_stream(rec->Stream);
+   uint32_t prefix = offset_stream ? OFFSET_FADDR_SIZE : 0;
+   uint32_t len = rec->data_len - prefix;
+   uint32_t hdrlen, reclen;
+   uint64_t FileOffset = 0;
+
+   if (!adata_pending(dcr)) {
+      empty_block(ablock);
+      ablock->nclones = 0;
+   }
+   /* A single record bigger than the adata block gets a bigger block */
+   if (ablock->binbuf == 0 && len > ablock->buf_len) {
+      ablock->buf_len = align_adata_addr(len);
+      ablock->buf = check_pool_memory_size(ablock->buf, ablock->buf_len);
+      ablock->bufp = ablock->buf;
+   }
+   hdrlen = WRITE_ADATA_RECHDR_LENGTH + prefix;
+   if (ablock->binbuf == 0) {
+      hdrlen += WRITE_ADATA_BLKHDR_LENGTH;
+   }
+   reclen = align_adata_addr(ablock->binbuf);     /* offset of the data */
+   if (block->binbuf + hdrlen > block->buf_len || reclen + len > ablock->buf_len) {
+      if (is_block_empty(block)) {
+         /* Ameta block too small for the headers, write it inline */
+         rec->wstate = st_header;
+         if (rec->state_bits & REC_ADATA_CLONE) {
+            read_clone_data(dcr, rec);
+         }
+         return 0;
+      }
+      Dmsg3(dbglvl, "adata full binbuf=%d reclen=%d len=%d\n", ablock->binbuf, reclen, len);
+      return -1;
+   }
+
+   if (ablock->binbuf == 0) {
+      /* Block address, length and checksum are set by write_adata_block() */
+      ablock->reclen = block->binbuf;
+      ablock->BlockNumber = block->BlockNumber;
+      ser_begin(block->bufp, WRITE_ADATA_BLKHDR_LENGTH);
+      ser_uint32(block->BlockNumber);
+      ser_int32(STREAM_ADATA_BLOCK_HEADER);
+      ser_uint32(0);
+      ser_uint32(0);
+      ser_uint32(rec->VolSessionId);
+      ser_uint32(rec->VolSessionTime);
+      ser_uint64(0);
+      block->bufp += WRITE_ADATA_BLKHDR_LENGTH;
+      block->binbuf += WRITE_ADATA_BLKHDR_LENGTH;
+   }
+   memset(ablock->buf + ablock->binbuf, 0, reclen - ablock->binbuf);
+   if (rec->state_bits & REC_ADATA_CLONE && !add_clone(ablock, rec, reclen, len)) {
+      read_clone_data(dcr, rec);
+   }
+   if (!(rec->state_bits & REC_ADATA_CLONE)) {
+      memcpy(ablock->buf + reclen, rec->data + prefix, len);
+   }
+   ablock->binbuf = reclen + len;
+   ablock->bufp = ablock->buf + ablock->binbuf;
+
+   block->VolSessionId = rec->VolSessionId;
+   block->VolSessionTime = rec->VolSessionTime;
+   create_filemedia(dcr, block, rec);
+
+   if (offset_stream) {
+      /* The offset is in front of the data, it goes in the header */
+      unser_begin(rec->data, OFFSET_FADDR_SIZE);
+      unser_uint64(FileOffset);
+   }
+   ser_begin(block->bufp, WRITE_ADATA_RECHDR_LENGTH_MAX);
+   ser_int32(rec->FileIndex);
+   ser_int32(STREAM_ADATA_RECORD_HEADER);
+   ser_uint32(len);
+   ser_uint32(reclen);
+   ser_int32(rec->Stream);
+   if (offset_stream) {
+      ser_uint64(FileOffset);
+   }
+   block->bufp += WRITE_ADATA_RECHDR_LENGTH + prefix;
+   block->binbuf += WRITE_ADATA_RECHDR_LENGTH + prefix;
+   block->RecNum++;
+   if (block->FirstIndex == 0) {
+      block->FirstIndex = rec->FileIndex;
+   }
+   block->LastIndex = rec->FileIndex;
+   block->extra_bytes += rec->extra_bytes;
+
+   Dmsg5(dbglvl, "adata rec FI=%d Strm=%d len=%d off=%d blkhdr=%d\n",
+      rec->FileIndex, rec->Stream, len, reclen, ablock->reclen);
+   rec->remainder = 0;
+   rec->wstate = st_none;
+   return 1;
+}
+
+/*
+ * Let the filesystem copy a cloned part. With a reflink the blocks
+ *  are shared and nothing is copied, copy_file_range() copies in
+ *  the kernel and may share the blocks as well.
+ *
+ *  Returns: the number of bytes done, the rest must be copied
+ */
+uint32_t aligned_dev::clone_range(int fd, boffset_t src, boffset_t dst, uint32_t len)
+{
+   uint32_t done = 0;
+#ifdef HAVE_LINUX_OS
+#ifdef FICLONERANGE
+   uint32_t blen = len - len % file_alignment;
+
+   /* Whole alignment units only, the tail is copied below */
+   if (!no_reflink && blen > 0 && src % file_alignment == 0 && dst % file_alignment == 0) {
+      struct file_clone_range fcr;
+      fcr.src_fd = fd;
+      fcr.src_offset = src;
+      fcr.src_length = blen;
+      fcr.dest_offset = dst;
+      if (ioctl(adata_fd, FICLONERANGE, &fcr) == 0) {
+         done = blen;
+      } else if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EXDEV) {
+         Dmsg1(dbglvl, "No reflink on device %s\n", print_name());
+         no_reflink = true;
+      }
+   }
+#endif
+#ifdef __NR_copy_file_range
+   while (done < len) {
+      loff_t off_in = src + done;
+      loff_t off_out = dst + done;
+      ssize_t stat = syscall(__NR_copy_file_range, fd, &off_in, adata_fd, &off_out,
+                             (size_t)(len - done), 0);
+      if (stat <= 0) {
+         if (stat < 0 && errno == EINTR) {
+            continue;
+         }
+         break;
+      }
+      done += stat;
+   }
+#endif
+#endif
+   return done;
+}
+
+bool aligned_dev::pwrite_adata(const char *buf, uint32_t len, boffset_t addr)
+{
+   ssize_t stat;
+   uint32_t done;
+
+   for (done = 0; done < len; done += stat) {
+      stat = pwrite(adata_fd, buf + done, len - done, addr + done);
+      if (stat <= 0) {
+         if (stat < 0 && errno == EINTR) {
+            stat = 0;
+            continue;
+         }
+         if (stat == 0) {
+            errno = ENOSPC;
+         }
+         return false;
+      }
+   }
+   return true;
+}
+
+/*
+ * Called with the device locked just before the ameta block is
+ *  written. The adata block goes to the next aligned address of
+ *  the data file, then its address, length and checksum are put
+ *  into the block header in the ameta block. If the ameta block
+ *  has to go to the next Volume, we are called again and the data
+ *  is written again there.
+ *
+ * The cloned parts are not in the buffer, they are copied from the
+ *  read Volume. When we use checksums, they are read back from the
+ *  new Volume so that the checksum covers what is really there.
+ */
+bool aligned_dev::write_adata_block(DCR *dcr)
+{
+   ser_declare;
+   DEV_BLOCK *block = dcr->block;
+   DEV_BLOCK *ablock = dcr->adata_block;
+   adata_clone *c = NULL;
+   uint32_t wlen, pad, pos, end, done, CheckSum = 0;
+   boffset_t addr;
+   bool ok = true;
+   int i;
+   char ed1[50];
+
+   if (!ablock || block != dcr->ameta_block || !adata_pending(dcr)) {
+      return true;
+   }
+   wlen = ((ablock->binbuf + padding_size - 1) / padding_size) * padding_size;
+   if (wlen > ablock->buf_len) {
+      ablock->buf = check_pool_memory_size(ablock->buf, wlen);
+      ablock->buf_len = wlen;
+   }
+   pad = wlen - ablock->binbuf;
+   memset(ablock->buf + ablock->binbuf, 0, pad);
+
+   addr = align_adata_addr(adata_addr);
+   for (i = 0, pos = 0; ok && i <= ablock->nclones; i++) {
+      end = (i < ablock->nclones) ? ablock->clones[i].off : wlen;
+      if (end > pos) {
+         ok = pwrite_adata(ablock->buf + pos, end - pos, addr + pos);
+      }
+      if (!ok || i == ablock->nclones) {
+         break;
+      }
+      c = &ablock->clones[i];
+      done = clone_range(ablock->clone_fd, c->src, addr + c->off, c->len);
+      dcr->clone_bytes += done;
+      if (done > 0 && do_checksum() &&
+          read_full(adata_fd, ablock->buf + c->off, done, addr + c->off) != done) {
+         berrno be;
+         Jmsg(dcr->jcr, M_FATAL, 0, _("Read error on aligned data at %s len=%u. ERR=%s\n"),
+              edit_uint64(addr + c->off, ed1), done, be.bstrerror());
+         return false;
+      }
+      if (done < c->len) {
+         /* Not supported by the filesystem, copy it ourself */
+         if (read_full(ablock->clone_fd, ablock->buf + c->off + done, c->len - done,
+                       c->src + done) != c->len - done) {
+            berrno be;
+            Jmsg(dcr->jcr, M_FATAL, 0, _("Read error on aligned data at %s len=%u. ERR=%s\n"),
+                 edit_uint64(c->src + done, ed1), c->len - done, be.bstrerror());
+            return false;
+         }
+         ok = pwrite_adata(ablock->buf + c->off + done, c->len - done, addr + c->off + done);
+      }
+      pos = c->off + c->len;
+   }
+   if (!ok) {
+      berrno be;
+      dev_errno = errno;
+      if (dev_errno == ENOSPC) {
+         Jmsg(dcr->jcr, M_INFO, 0, _("End of Volume \"%s\" at adata addr=%s on device %s. Write of %u bytes failed.\n"),
+              getVolCatName(), edit_uint64(addr, ed1), print_name(), wlen);
+         terminate_writing_volume(dcr);
+      } else {
+         VolCatInfo.VolCatErrors++;
+         Jmsg(dcr->jcr, M_FATAL, 0, _("Adata write error at %s on device %s Vol=%s. ERR=%s.\n"),
+              edit_uint64(addr, ed1), print_name(), getVolCatName(),
+              be.bstrerror(dev_errno));
+      }
+      return false;
+   }
+   if (do_checksum()) {
+      CheckSum = bcrc32((uint8_t *)ablock->buf, wlen);
+   }
+
+   /* Now the ameta block can point to the data */
+   ser_begin(block->buf + ablock->reclen + 2*sizeof(int32_t), WRITE_ADATA_BLKHDR_LENGTH);
+   ser_uint32(wlen);
+   ser_uint32(CheckSum);
+   ser_uint32(block->VolSessionId);
+   ser_uint32(block->VolSessionTime);
+   ser_uint64(addr);
+
+   Dmsg4(dbglvl, "Wrote adata block len=%d pad=%d at %lld Vol=%s\n", wlen, pad, addr,
+      getVolCatName());
+   adata_addr = addr + wlen;
+   Lock_VolCatInfo();
+   if ((uint64_t)addr > VolCatInfo.VolCatAdataBytes) {
+      VolCatInfo.VolCatHoleBytes += addr - VolCatInfo.VolCatAdataBytes;
+   }
+   if ((uint64_t)adata_addr > VolCatInfo.VolCatAdataBytes) {
+      VolCatInfo.VolCatBytes += adata_addr - VolCatInfo.VolCatAdataBytes;
+      VolCatInfo.VolCatAdataBytes = adata_addr;
+   }
+   VolCatInfo.VolCatAdataPadding += pad;
+   VolCatInfo.VolCatPadding += pad;
+   VolCatInfo.VolCatAdataBlocks++;
+   VolCatInfo.VolCatAdataWrites++;
+   VolCatInfo.BytesWritten += wlen;
+   setVolCatInfo(false);
+   Unlock_VolCatInfo();
+   return true;
+}
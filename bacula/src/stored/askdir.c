@@ -644,6 +644,12 @@ bool flush_jobmedia_queue(JCR *jcr)
  */
 bool dir_create_jobmedia_record(DCR *dcr, bool zero)
 {
+   /* The queued blocks must be on the Volume before they are indexed */
+   if (dcr->dev && dcr->dev->block_writer && !flush_block_writer(dcr->dev) &&
+       dcr->writer_lost) {
+      Dmsg1(50, "Blocks of the Job lost, no JobMedia for Vol=%s\n", dcr->VolumeName);
+      return false;
+   }
    if (askdir_handler) {
       return askdir_handler->dir_create_jobmedia_record(dcr, zero);
    }
@@ -682,6 +682,7 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
    case STREAM_SHA1_DIGEST:
    case STREAM_SHA256_DIGEST:
    case STREAM_SHA512_DIGEST:
+   case STREAM_XXH64_DIGEST:
       break;
 
    case STREAM_SIGNED_DIGEST:
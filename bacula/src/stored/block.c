@@ -101,6 +101,16 @@ bool DCR::write_block_to_device(bool final)
          }
       }
    }
+   if (final && dev->block_writer) {
+      /* The data of the job must be on the Volume when it terminates */
+      flush_block_writer(dev);
+   }
+   if (dcr->writer_lost) {
+      dcr->writer_lost = false;
+      Jmsg(jcr, M_FATAL, 0, _("Blocks of this Job could not be written to Volume \"%s\" on device %s.\n"),
+         dev->getVolCatName(), dev->print_name());
+      ok = false;
+   }
    if (ok && final && !dir_create_jobmedia_record(dcr)) {
       Jmsg(jcr, M_FATAL, 0, _("[SF0202] Error writing final JobMedia record to catalog.\n"));
    }
@@ -171,6 +181,15 @@ bool DCR::write_block_to_dev()
       return false;
    }
 
+   /*
+    * On aligned devices, the data of the records must be on
+    *  the Volume before the ameta block that references it.
+    */
+   if (!block->adata && !dev->write_adata_block(dcr)) {
+      Dmsg0(50, "Adata write failed. Cannot write block.\n");
+      return false;
+   }
+
    wlen = get_len_and_clear_block(block, dev, pad);
    block->block_len = wlen;
    dev->updateVolCatPadding(pad);
@@ -222,29 +241,40 @@ bool DCR::write_block_to_dev()
     *  I/O errors, or from the OS telling us it is busy.
     */
    int retry = 0;
+   bool queued = dev->block_writer && !block->adata && !debug_io_error &&
+                 block_writer_can_queue(dcr, wlen);
    errno = 0;
    stat = 0;
    /* ***FIXME**** remove next line debug */
    pos =  dev->lseek(dcr, 0, SEEK_CUR);
-   do {
-      if (retry > 0 && stat == -1 && errno == EBUSY) {
-         berrno be;
-         Dmsg4(100, "===== write retry=%d stat=%d errno=%d: ERR=%s\n",
-               retry, stat, errno, be.bstrerror());
-         bmicrosleep(5, 0);    /* pause a bit if busy or lots of errors */
-         dev->clrerror(-1);
-      }
-      stat = dev->write(block->buf, (size_t)wlen);
-      Dmsg4(100, "%s write() BlockAddr=%lld wlen=%d Vol=%s wlen=%d\n",
-         block->adata?"Adata":"Ameta", block->BlockAddr, wlen,
-         dev->VolHdr.VolumeName);
-   } while (stat == -1 && (errno == EBUSY || errno == EIO) && retry++ < 3);
+   if (queued) {
+      /* The Device thread writes it, the block gets a new buffer */
+      stat = block_writer_submit(dcr, block, wlen);
+   } else {
+      do {
+         if (retry > 0 && stat == -1 && errno == EBUSY) {
+            berrno be;
+            Dmsg4(100, "===== write retry=%d stat=%d errno=%d: ERR=%s\n",
+                  retry, stat, errno, be.bstrerror());
+            bmicrosleep(5, 0);    /* pause a bit if busy or lots of errors */
+            dev->clrerror(-1);
+         }
+         stat = dev->write(block->buf, (size_t)wlen);
+         Dmsg4(100, "%s write() BlockAddr=%lld wlen=%d Vol=%s wlen=%d\n",
+            block->adata?"Adata":"Ameta", block->BlockAddr, wlen,
+            dev->VolHdr.VolumeName);
+      } while (stat == -1 && (errno == EBUSY || errno == EIO) && retry++ < 3);
+   }
 
    /* ***FIXME*** remove 2 lines debug */
    Dmsg2(100, "Wrote %d bytes at %s\n", wlen, dev->print_addr(ed1, sizeof(ed1), pos));
-   dump_block(dev, block, "After write");
+   Tpt4(DT_VOLUME|50, "write_block adata=%lld addr=%lld len=%lld stat=%lld\n",
+        block->adata, pos, wlen, stat);
+   if (!queued) {
+      dump_block(dev, block, "After write");
+   }
 
-   if (debug_block_checksum) {
+   if (debug_block_checksum && !queued) {
       uint32_t achecksum = ser_block_header(block, dev->do_checksum());
       if (checksum != achecksum) {
          Jmsg2(jcr, M_ERROR, 0, _("[SA0201] Block checksum changed during write: before=%u after=%u\n"),
@@ -544,6 +574,8 @@ reread:
 
    Dmsg4(110, "Read() adata=%d vol=%s nbytes=%d pos=%lld\n",
       block->adata, dev->VolHdr.VolumeName, stat < 0 ? stat : data_len, pos);
+   Tpt4(DT_VOLUME|50, "read_block adata=%lld addr=%lld len=%lld stat=%lld\n",
+        block->adata, pos, data_len, stat);
    if (stat < 0) {
       berrno be;
       dev->clrerror(-1);
@@ -131,6 +131,13 @@ class DEVICE;                         /* for forward reference */
  *
  *  This is the memory structure for a device block.
  */
+/* Part of an adata block that is cloned from another aligned Volume */
+struct adata_clone {
+   uint32_t off;                      /* offset in the adata block */
+   uint32_t len;                      /* length of the part */
+   uint64_t src;                      /* address in the source data file */
+};
+
 struct DEV_BLOCK {
    DEV_BLOCK *next;                   /* pointer to next one */
    DEVICE    *dev;                    /* pointer to device */
@@ -166,6 +173,10 @@ struct DEV_BLOCK {
    POOLMEM *rechdr_queue;             /* record header queue */
    POOLMEM *buf;                      /* actual data buffer */
    alist   *filemedia;                /* Filemedia attached to the current block */
+   adata_clone *clones;               /* adata parts cloned from clone_fd */
+   int32_t  nclones;                  /* number of cloned parts */
+   int32_t  max_clones;               /* size of the clones array */
+   int      clone_fd;                 /* dup of the source data file, or -1 */
 };
 
 #define block_is_empty(block) ((block)->read_len == 0)
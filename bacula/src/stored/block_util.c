@@ -121,7 +121,7 @@ void dump_block(DEVICE *dev, DEV_BLOCK *b, const char *msg, bool force)
          unser_uint32(reclen);
          unser_int32(Stream);
          p += WRITE_ADATA_RECHDR_LENGTH;
-         if (Stream & STREAM_BIT_OFFSETS) {
+         if (is_offset_stream(Stream)) {
             p += OFFSET_FADDR_SIZE;
          }
       } else {
@@ -169,6 +169,7 @@ DEV_BLOCK *DEVICE::new_block(DCR *dcr, int size)
    Dmsg2(510, "Rechdr len=%d max_items=%d\n", sizeof_pool_memory(block->rechdr_queue),
       sizeof_pool_memory(block->rechdr_queue)/WRITE_ADATA_RECHDR_LENGTH);
    block->filemedia = New(alist(1, owned_by_alist));
+   block->clone_fd = -1;
    empty_block(block);
    block->BlockVer = BLOCK_VER;       /* default write version */
    Dmsg3(150, "New block adata=%d len=%d block=%p\n", block->adata, len, block);
@@ -199,6 +200,10 @@ DEV_BLOCK *dup_block(DEV_BLOCK *eblock)
       memcpy(fm2, fm, sizeof(FILEMEDIA_ITEM));
       block->filemedia->append(fm2);
    }
+   /* The cloned parts belong to the original block */
+   block->clones = NULL;
+   block->nclones = block->max_clones = 0;
+   block->clone_fd = -1;
 
 
    /* bufp might point inside buf */
@@ -286,6 +291,8 @@ void DEVICE::free_dcr_blocks(DCR *dcr)
    dcr->block = NULL;
    free_block(dcr->ameta_block);
    dcr->ameta_block = NULL;
+   free_block(dcr->adata_block);
+   dcr->adata_block = NULL;
 }
 
 /*
@@ -302,6 +309,12 @@ void free_block(DEV_BLOCK *block)
          free_memory(block->rechdr_queue);
       }
       delete block->filemedia;
+      if (block->clones) {
+         free(block->clones);
+      }
+      if (block->clone_fd >= 0) {
+         close(block->clone_fd);
+      }
       Dmsg1(999, "=== free_block block %p\n", block);
       free_memory((POOLMEM *)block);
    }
@@ -400,8 +413,9 @@ bool unser_block_header(DCR *dcr, DEVICE *dev, DEV_BLOCK *block)
    int bhl;
 
    if (block->adata) {
-      /* Checksum the whole block */
-      if (block->block_len <= block->read_len && dev->do_checksum()) {
+      /* Checksum the whole block, zero means it was written without */
+      if (block->block_len <= block->read_len && dev->do_checksum() &&
+          block->CheckSum != 0) {
          BlockCheckSum = dcr->crc32((uint8_t *)block->buf, block->block_len, block->CheckSum);
          if (BlockCheckSum != block->CheckSum) {
             dev->dev_errno = EIO;
@@ -0,0 +1,479 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Asynchronous writer of the blocks of a disk Device
+ *
+ *  With "Write Queue Blocks = n" on a File Device, the jobs do not
+ *  wait for the write() of their blocks while holding the Device
+ *  lock. write_block_to_dev() does all the bookkeeping as usual
+ *  (Volume position, FileMedia), reserves the place of the block
+ *  in the Volume file, and gives the buffer to the writer thread
+ *  of the Device. The DEV_BLOCK gets a free buffer in exchange, so
+ *  the job can fill it with the next records right away. Up to n
+ *  blocks can be waiting, after that the jobs wait for a free buffer.
+ *
+ *  Near the maximum size of the Volume or the end of the free space,
+ *  the blocks are written synchronously, so the End of Volume is
+ *  seen by the job that writes the block as usual, with nothing
+ *  queued behind it. A JobMedia record is created only once the
+ *  queued blocks are written, see dir_create_jobmedia_record().
+ *
+ *  The thread writes the blocks that follow each other in the
+ *  Volume with a single pwritev(). With "Drop Volume Cache", it
+ *  also drops the written data from the page cache.
+ *
+ *  Any other access to the Volume file (sync write, read, seek,
+ *  close, truncate, fsync) waits until all the queued blocks are
+ *  written. A write error is returned by the next write on the
+ *  Device, and the jobs that had blocks queued after the error
+ *  are failed, see flush_block_writer().
+ */
+
+#include "bacula.h"
+#include "stored.h"
+
+#ifdef HAVE_PWRITEV
+#include <sys/uio.h>
+#endif
+
+static const int dbglvl = 150;
+
+static void *block_writer_thread(void *arg);
+static void add_dev_counters(DEVICE *dev, BLOCK_WRITER *w);
+
+/*
+ * Start the writer thread of a Device, called at init time
+ */
+bool init_block_writer(DEVICE *dev)
+{
+   BLOCK_WRITER *w;
+   BLOCK_WRITER_ITEM *item = NULL;
+   int stat;
+
+   w = (BLOCK_WRITER *)malloc(sizeof(BLOCK_WRITER));
+   memset(w, 0, sizeof(BLOCK_WRITER));
+   w->max_items = dev->device->write_queue_blocks;
+   w->queue = New(dlist(item, &item->link));
+   w->free_items = New(dlist(item, &item->link));
+   pthread_mutex_init(&w->mutex, NULL);
+   pthread_cond_init(&w->cond, NULL);
+   dev->block_writer = w;
+   if ((stat = pthread_create(&w->tid, NULL, block_writer_thread, dev)) != 0) {
+      berrno be;
+      Jmsg2(NULL, M_ERROR, 0, _("Unable to start the block writer of device %s. ERR=%s\n"),
+            dev->print_name(), be.bstrerror(stat));
+      dev->block_writer = NULL;
+      pthread_cond_destroy(&w->cond);
+      pthread_mutex_destroy(&w->mutex);
+      delete w->queue;
+      delete w->free_items;
+      free(w);
+      return false;
+   }
+   Dmsg2(dbglvl, "Block writer started on %s with %d blocks\n",
+         dev->print_name(), w->max_items);
+   return true;
+}
+
+/*
+ * Write the queued blocks and stop the thread
+ */
+void term_block_writer(DEVICE *dev)
+{
+   BLOCK_WRITER *w = dev->block_writer;
+   BLOCK_WRITER_ITEM *item;
+
+   if (!w) {
+      return;
+   }
+   P(w->mutex);
+   w->quit = true;
+   pthread_cond_broadcast(&w->cond);
+   V(w->mutex);
+   pthread_join(w->tid, NULL);
+
+   add_dev_counters(dev, w);
+   dev->block_writer = NULL;
+   foreach_dlist(item, w->free_items) {
+      free_memory(item->buf);
+   }
+   w->free_items->destroy();
+   delete w->free_items;
+   delete w->queue;
+   pthread_cond_destroy(&w->cond);
+   pthread_mutex_destroy(&w->mutex);
+   free(w);
+}
+
+/*
+ * Tell if the block can be given to the writer thread, called by
+ *  write_block_to_dev() with the Device locked. The blocks queued
+ *  must not bring the Volume to its maximum size nor fill the disk,
+ *  the free space is checked again after each window of blocks.
+ */
+bool block_writer_can_queue(DCR *dcr, uint32_t wlen)
+{
+   DEVICE *dev = dcr->dev;
+   BLOCK_WRITER *w = dev->block_writer;
+   uint64_t window, size;
+
+   /* What can be waiting in the queue, with this block */
+   window = (uint64_t)(w->max_items + 1) * wlen;
+   size = dev->VolCatInfo.VolCatBytes + window;
+   if ((dev->max_volume_size > 0 && size >= dev->max_volume_size) ||
+       (dev->VolCatInfo.VolCatMaxBytes > 0 && size >= dev->VolCatInfo.VolCatMaxBytes)) {
+      Dmsg1(dbglvl, "Near the maximum size of Vol=%s, write directly\n",
+            dev->getVolCatName());
+      return false;
+   }
+   if (w->space_left < window) {
+      /* The queued blocks are not counted in the free space yet */
+      if (!dev->get_os_device_freespace() ||
+          dev->free_space < dev->min_free_space + 2 * window) {
+         Dmsg1(dbglvl, "Near the end of the free space of %s, write directly\n",
+               dev->print_name());
+         w->space_left = 0;
+         return false;
+      }
+      w->space_left = dev->free_space - dev->min_free_space - window;
+   }
+   w->space_left -= wlen;
+   return true;
+}
+
+/*
+ * Give the block to the writer thread, called by write_block_to_dev()
+ *  with the Device locked, instead of dev->write().
+ *
+ * Returns: wlen on success
+ *          -1 with errno set on error
+ */
+ssize_t block_writer_submit(DCR *dcr, DEV_BLOCK *block, uint32_t wlen)
+{
+   DEVICE *dev = dcr->dev;
+   BLOCK_WRITER *w = dev->block_writer;
+   BLOCK_WRITER_ITEM *item;
+   POOLMEM *buf;
+   boffset_t pos;
+   int32_t size = sizeof_pool_memory(block->buf);
+
+   /* A previous write failed, report it for this block */
+   if (w->error_seq && !flush_block_writer(dev)) {
+      errno = clear_block_writer_error(dev);
+      return -1;
+   }
+
+   /* Reserve the place of the block in the Volume */
+   pos = dev->lseek(dcr, (boffset_t)wlen, SEEK_CUR);
+   if (pos < 0) {
+      return -1;
+   }
+
+   P(w->mutex);
+   while (w->free_items->empty() && w->nb_items >= w->max_items) {
+      w->nb_waits++;
+      pthread_cond_wait(&w->cond, &w->mutex);
+   }
+   item = (BLOCK_WRITER_ITEM *)w->free_items->first();
+   if (item) {
+      w->free_items->remove(item);
+   } else {
+      item = (BLOCK_WRITER_ITEM *)malloc(sizeof(BLOCK_WRITER_ITEM));
+      memset(item, 0, sizeof(BLOCK_WRITER_ITEM));
+      w->nb_items++;
+   }
+   V(w->mutex);
+
+   /* The block keeps a buffer of the same size */
+   buf = item->buf;
+   if (!buf || sizeof_pool_memory(buf) < size) {
+      if (buf) {
+         free_memory(buf);
+      }
+      buf = get_memory(size);
+   }
+   item->buf = block->buf;
+   block->buf = buf;
+   block->bufp = block->buf + block->binbuf;
+   item->len = wlen;
+   item->fd = dev->fd();
+   item->addr = pos - wlen;
+
+   P(w->mutex);
+   item->seq = ++w->seq;
+   dcr->writer_seq = item->seq;
+   w->queue->append(item);
+   w->nb_queued++;
+   if (w->nb_queued > w->max_queued) {
+      w->max_queued = w->nb_queued;
+   }
+   add_dev_counters(dev, w);
+   pthread_cond_broadcast(&w->cond);
+   V(w->mutex);
+
+   Dmsg3(dbglvl+50, "Queue block seq=%lld addr=%lld len=%d\n", item->seq,
+         item->addr, wlen);
+   return wlen;
+}
+
+/*
+ * Wait until all the queued blocks are written, called before any
+ *  other access to the Volume file. If a write failed, the jobs
+ *  that had blocks queued after it are marked, they are failed by
+ *  write_block_to_device(). The error stays set, the next write on
+ *  the Device returns it, see clear_block_writer_error().
+ *
+ * Returns: true if all the blocks were written
+ */
+bool flush_block_writer(DEVICE *dev)
+{
+   BLOCK_WRITER *w = dev->block_writer;
+   uint64_t error_seq;
+   DCR *mdcr;
+
+   if (!w) {
+      return true;
+   }
+   P(w->mutex);
+   while (w->nb_queued > 0 || w->busy) {
+      pthread_cond_wait(&w->cond, &w->mutex);
+   }
+   error_seq = w->error_seq;
+   add_dev_counters(dev, w);
+   V(w->mutex);
+
+   if (error_seq == 0) {
+      return true;
+   }
+   dev->Lock_dcrs();
+   foreach_dlist(mdcr, dev->attached_dcrs) {
+      if (mdcr->writer_seq >= error_seq) {
+         mdcr->writer_lost = true;
+      }
+   }
+   dev->Unlock_dcrs();
+   return false;
+}
+
+/*
+ * The write error was reported, clear it
+ *
+ * Returns: errno of the failed write
+ */
+int clear_block_writer_error(DEVICE *dev)
+{
+   BLOCK_WRITER *w = dev->block_writer;
+   int error;
+
+   P(w->mutex);
+   error = w->error;
+   w->error = 0;
+   w->error_seq = 0;
+   V(w->mutex);
+   return error;
+}
+
+/*
+ * Device status line
+ *
+ * Returns: length of the message, 0 if no writer
+ */
+int block_writer_status(DEVICE *dev, POOL_MEM &msg)
+{
+   BLOCK_WRITER *w = dev->block_writer;
+   char b1[50], b2[50], b3[50], b4[50];
+   int len;
+
+   if (!w) {
+      return 0;
+   }
+   P(w->mutex);
+   len = Mmsg(msg, _("    Write queue: Queued=%d/%d MaxQueued=%d Blocks=%s Writes=%s Bytes=%s Waits=%s\n"),
+              w->nb_queued, w->max_items, w->max_queued,
+              edit_uint64_with_commas(w->nb_blocks, b1),
+              edit_uint64_with_commas(w->nb_writes, b2),
+              edit_uint64_with_commas(w->nb_bytes, b3),
+              edit_uint64_with_commas(w->nb_waits, b4));
+   V(w->mutex);
+   return len;
+}
+
+/*
+ * Add what the thread wrote to the counters of the Device. They are
+ *  only changed with the Device locked, the caller holds the lock
+ *  and the writer mutex.
+ */
+static void add_dev_counters(DEVICE *dev, BLOCK_WRITER *w)
+{
+   if (w->write_ops == 0) {
+      return;
+   }
+   dev->DevWriteTime += w->write_time;
+   dev->DevWriteBytes += w->write_bytes;
+   dev->DevWriteOps += w->write_ops;
+   if (w->write_max_time > dev->DevWriteMaxTime) {
+      dev->DevWriteMaxTime = w->write_max_time;
+   }
+   collector_update_add2_value_int64(dev->devstatcollector,
+      dev->devstatmetrics.bacula_storage_device_writebytes, w->write_bytes,
+      dev->devstatmetrics.bacula_storage_device_writetime, w->write_time);
+   w->write_time = w->write_max_time = 0;
+   w->write_bytes = w->write_ops = 0;
+}
+
+/*
+ * Write contiguous blocks at their place in the Volume
+ *
+ * Returns: 0 on success
+ *          errno on error
+ */
+static int write_items(BLOCK_WRITER_ITEM **items, int nb, uint32_t len)
+{
+   int fd = items[0]->fd;
+   boffset_t addr = items[0]->addr;
+   uint32_t done = 0;
+   ssize_t stat;
+#ifdef HAVE_PWRITEV
+   struct iovec iov[BLOCK_WRITER_MAX_IOV];
+   struct iovec *vp = iov;
+
+   for (int i = 0; i < nb; i++) {
+      iov[i].iov_base = items[i]->buf;
+      iov[i].iov_len = items[i]->len;
+   }
+   while (done < len) {
+      stat = pwritev(fd, vp, nb, addr + done);
+      if (stat < 0 && errno == EINTR) {
+         continue;
+      }
+      if (stat <= 0) {
+         return stat < 0 ? errno : ENOSPC;
+      }
+      done += stat;
+      /* Skip what was written, a short write is rare */
+      while (nb > 0 && (size_t)stat >= vp->iov_len) {
+         stat -= vp->iov_len;
+         vp++;
+         nb--;
+      }
+      if (nb > 0) {
+         vp->iov_base = (char *)vp->iov_base + stat;
+         vp->iov_len -= stat;
+      }
+   }
+#else
+   while (done < len) {
+      stat = pwrite(fd, items[0]->buf + done, len - done, addr + done);
+      if (stat < 0 && errno == EINTR) {
+         continue;
+      }
+      if (stat <= 0) {
+         return stat < 0 ? errno : ENOSPC;
+      }
+      done += stat;
+   }
+#endif
+   return 0;
+}
+
+/*
+ * Write the queued blocks in order. The blocks that follow each
+ *  other in the Volume are written with one call. After an error,
+ *  the blocks are dropped until the error is cleared.
+ */
+static void *block_writer_thread(void *arg)
+{
+   DEVICE *dev = (DEVICE *)arg;
+   BLOCK_WRITER *w = dev->block_writer;
+   BLOCK_WRITER_ITEM *items[BLOCK_WRITER_MAX_IOV];
+   BLOCK_WRITER_ITEM *item, *next;
+   uint32_t len;
+   btime_t start, elapsed = 0;
+   bool skip;
+   int error, nb;
+
+   set_jcr_in_tsd(INVALID_JCR);
+   P(w->mutex);
+   for ( ;; ) {
+      while (!w->quit && w->queue->empty()) {
+         pthread_cond_wait(&w->cond, &w->mutex);
+      }
+      item = (BLOCK_WRITER_ITEM *)w->queue->first();
+      if (!item) {
+         break;                       /* quit and nothing left */
+      }
+      nb = 0;
+      len = 0;
+      do {
+         next = (BLOCK_WRITER_ITEM *)w->queue->next(item);
+         w->queue->remove(item);
+         items[nb++] = item;
+         len += item->len;
+         item = next;
+      } while (item && nb < BLOCK_WRITER_MAX_IOV && item->fd == items[0]->fd &&
+               item->addr == items[nb-1]->addr + items[nb-1]->len);
+      w->busy = true;
+      skip = w->error_seq != 0;
+      V(w->mutex);
+
+      error = 0;
+      if (!skip) {
+         start = get_current_btime();
+         error = write_items(items, nb, len);
+         elapsed = get_current_btime() - start;
+         if (error) {
+            berrno be;
+            Dmsg5(50, "Write error seq=%lld addr=%lld blocks=%d len=%d ERR=%s\n",
+                  items[0]->seq, items[0]->addr, nb, len, be.bstrerror(error));
+         } else if (dev->drop_cache()) {
+            w->cache_bytes += len;
+            if (w->cache_bytes >= VOLUME_CACHE_WINDOW) {
+               drop_volume_cache(items[0]->fd, items[0]->addr + len, true);
+               w->cache_bytes = 0;
+            }
+         }
+      }
+
+      P(w->mutex);
+      if (error) {
+         if (!w->error_seq) {
+            w->error_seq = items[0]->seq;
+            w->error = error;
+         }
+      } else if (!skip) {
+         w->nb_blocks += nb;
+         w->nb_bytes += len;
+         w->nb_writes++;
+         w->write_time += elapsed;
+         w->write_bytes += len;
+         w->write_ops++;
+         if (elapsed > w->write_max_time) {
+            w->write_max_time = elapsed;
+         }
+      }
+      w->busy = false;
+      w->nb_queued -= nb;
+      for (int i = 0; i < nb; i++) {
+         w->free_items->append(items[i]);
+      }
+      pthread_cond_broadcast(&w->cond);
+   }
+   V(w->mutex);
+   return NULL;
+}
@@ -0,0 +1,79 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Asynchronous writer of the blocks of a disk Device
+ *   see block_writer.c
+ */
+
+#ifndef __BLOCK_WRITER_H
+#define __BLOCK_WRITER_H 1
+
+/* Blocks written by one call */
+#ifdef HAVE_PWRITEV
+#define BLOCK_WRITER_MAX_IOV 64
+#else
+#define BLOCK_WRITER_MAX_IOV 1
+#endif
+
+/*
+ * A block waiting to be written. The buffer was swapped with the
+ *  one of the DEV_BLOCK, it goes back to the free list once written.
+ */
+struct BLOCK_WRITER_ITEM {
+   dlink link;
+   POOLMEM *buf;                      /* data of the block */
+   uint32_t len;                      /* bytes to write */
+   int fd;                            /* Volume file descriptor */
+   boffset_t addr;                    /* position in the Volume file */
+   uint64_t seq;                      /* submission number */
+};
+
+/*
+ * One per Device with "Write Queue Blocks" set
+ */
+struct BLOCK_WRITER {
+   pthread_t tid;                     /* writer thread */
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;               /* signaled when an item is queued or written */
+   dlist *queue;                      /* blocks to write in Volume order */
+   dlist *free_items;                 /* written blocks, buffers to reuse */
+   uint32_t max_items;                /* Write Queue Blocks */
+   uint32_t nb_items;                 /* items allocated */
+   uint32_t nb_queued;                /* items in the queue */
+   bool busy;                         /* the thread is writing an item */
+   bool quit;                         /* set to stop the thread */
+   int error;                         /* errno of the first failed write */
+   uint64_t seq;                      /* last submitted item */
+   uint64_t error_seq;                /* first item not written, 0 if none */
+   uint64_t cache_bytes;              /* written since the page cache was dropped */
+   uint64_t space_left;               /* can be queued before the free space is checked */
+   /* Written since the Device counters were updated, see add_dev_counters() */
+   btime_t write_time;
+   btime_t write_max_time;
+   uint64_t write_bytes;
+   uint64_t write_ops;
+   /* Statistics */
+   uint64_t nb_blocks;                /* blocks written */
+   uint64_t nb_writes;                /* write calls */
+   uint64_t nb_bytes;                 /* bytes written */
+   uint64_t nb_waits;                 /* submissions that waited for a free buffer */
+   uint32_t max_queued;               /* highest number of items in the queue */
+};
+
+#endif /* __BLOCK_WRITER_H */
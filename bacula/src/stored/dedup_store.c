@@ -0,0 +1,1258 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Local deduplication store for File devices, see dedup_store.h
+ *
+ *  Files in the Dedup Directory:
+ *    container-NNNNNNNN.bdc  chunks, each one with a 48 bytes header
+ *    index-NNNNNNNN.bdi      sorted run of the fingerprint index
+ *    lock                    prevents two daemons to use the directory
+ *
+ *  Layout of an index run:
+ *    header page, entry pages (85 entries of 48 bytes each), page
+ *    directory (first hash of each page) and bloom filter.
+ */
+
+#include "bacula.h"
+#include "stored.h"
+#include "dedup_store.h"
+
+static const int dbglvl = DT_DEDUP|200;
+
+#define CHUNK_MAGIC    0x42444331      /* BDC1 */
+#define RUN_MAGIC      0x42444931      /* BDI1 */
+#define REF_MAGIC      0x42445231      /* BDR1 */
+#define CHUNK_HDR_SIZE (4 + 4 + 8 + DEDUP_HASH_SIZE)
+#define BLOOM_BITS_PER_ENTRY 10
+#define BLOOM_K        7
+
+/* Mask for the part before and after the average chunk size (FastCDC) */
+#define CDC_MASK_S     0x0003590703530000ULL   /* 15 bits */
+#define CDC_MASK_L     0x0000d90003530000ULL   /* 11 bits */
+
+static uint64_t gear[256];
+static pthread_once_t gear_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t stores_mutex = PTHREAD_MUTEX_INITIALIZER;
+static alist *stores = NULL;
+
+/*
+ * The gear table must never change, the chunk boundaries of
+ *  the data already stored depend on it.
+ */
+static void init_gear()
+{
+   uint64_t x = 0x6261637562616C61ULL;   /* "bacubala" */
+   for (int i=0; i < 256; i++) {
+      uint64_t z = (x += 0x9E3779B97F4A7C15ULL);   /* splitmix64 */
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      gear[i] = z ^ (z >> 31);
+   }
+}
+
+uint32_t dedup_chunk_len(const uint8_t *buf, uint32_t len)
+{
+   uint64_t fp = 0;
+   uint32_t i, n, normal;
+
+   pthread_once(&gear_once, init_gear);
+   if (len <= DEDUP_CHUNK_MIN) {
+      return len;
+   }
+   n = MIN(len, DEDUP_CHUNK_MAX);
+   normal = MIN(n, DEDUP_CHUNK_AVG);
+   for (i = DEDUP_CHUNK_MIN; i < normal; i++) {
+      fp = (fp << 1) + gear[buf[i]];
+      if (!(fp & CDC_MASK_S)) {
+         return i + 1;
+      }
+   }
+   for ( ; i < n; i++) {
+      fp = (fp << 1) + gear[buf[i]];
+      if (!(fp & CDC_MASK_L)) {
+         return i + 1;
+      }
+   }
+   return n;
+}
+
+static void ser_entry(uint8_t *p, dedup_entry *e)
+{
+   ser_declare;
+   ser_begin(p, DEDUP_ENTRY_SIZE);
+   ser_bytes(e->hash, DEDUP_HASH_SIZE);
+   ser_uint32(e->container);
+   ser_uint32(e->len);
+   ser_uint64(e->offset);
+}
+
+static void unser_entry(uint8_t *p, dedup_entry *e)
+{
+   unser_declare;
+   unser_begin(p, DEDUP_ENTRY_SIZE);
+   unser_bytes(e->hash, DEDUP_HASH_SIZE);
+   unser_uint32(e->container);
+   unser_uint32(e->len);
+   unser_uint64(e->offset);
+}
+
+static uint64_t hash_word(const uint8_t *hash, int i)
+{
+   uint64_t v;
+   memcpy(&v, hash + i * sizeof(v), sizeof(v));
+   return v;
+}
+
+static bool bloom_test(dedup_run *r, const uint8_t *hash)
+{
+   uint64_t h1 = hash_word(hash, 0), h2 = hash_word(hash, 1) | 1;
+   for (int i=0; i < BLOOM_K; i++) {
+      uint64_t bit = (h1 + i * h2) % r->bloom_bits;
+      if (!(r->bloom[bit >> 3] & (1 << (bit & 7)))) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static void bloom_set(uint8_t *bloom, uint64_t bits, const uint8_t *hash)
+{
+   uint64_t h1 = hash_word(hash, 0), h2 = hash_word(hash, 1) | 1;
+   for (int i=0; i < BLOOM_K; i++) {
+      uint64_t bit = (h1 + i * h2) % bits;
+      bloom[bit >> 3] |= 1 << (bit & 7);
+   }
+}
+
+static char *run_name(const char *dir, uint32_t id, POOLMEM *&fname)
+{
+   Mmsg(fname, "%s/index-%08u.bdi", dir, id);
+   return fname;
+}
+
+char *dedup_store::container_name(uint32_t id, POOLMEM *&fname)
+{
+   Mmsg(fname, "%s/container-%08u.bdc", dir, id);
+   return fname;
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+   return memcmp(((dedup_entry *)a)->hash, ((dedup_entry *)b)->hash, DEDUP_HASH_SIZE);
+}
+
+/*
+ * Write a new index run from n sorted entries given by the
+ *  callback, the run is visible only when it is complete.
+ */
+typedef bool (next_entry_t)(void *ctx, dedup_entry *e);
+
+static bool write_run_file(const char *dir, uint32_t id, uint64_t n,
+                           next_entry_t *next, void *ctx, POOLMEM *&errmsg)
+{
+   POOL_MEM tmp, fname;
+   uint8_t page[DEDUP_PAGE_SIZE];
+   uint32_t npages = (n + DEDUP_ENTRIES_PER_PAGE - 1) / DEDUP_ENTRIES_PER_PAGE;
+   uint64_t bits = ((n * BLOOM_BITS_PER_ENTRY + 63) / 64) * 64;
+   uint8_t *pagedir = (uint8_t *)malloc(MAX(npages, 1) * DEDUP_HASH_SIZE);
+   uint8_t *bloom;
+   dedup_entry e;
+   uint32_t in_page = 0, p = 0;
+   bool ok = false;
+   int fd;
+   ser_declare;
+
+   if (bits == 0) {
+      bits = 64;
+   }
+   bloom = (uint8_t *)malloc(bits / 8);
+   memset(bloom, 0, bits / 8);
+
+   Mmsg(tmp, "%s/index-%08u.tmp", dir, id);
+   fd = ::open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0640);
+   if (fd < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot create dedup index %s. ERR=%s\n"), tmp.c_str(), be.bstrerror());
+      goto bail_out;
+   }
+   memset(page, 0, sizeof(page));
+   ser_begin(page, DEDUP_PAGE_SIZE);
+   ser_uint32(RUN_MAGIC);
+   ser_uint32(1);                      /* version */
+   ser_uint64(n);
+   ser_uint32(npages);
+   ser_uint64(bits);
+   ser_uint32(BLOOM_K);
+   ser_uint32(DEDUP_HASH_SIZE);
+   if (write(fd, page, sizeof(page)) != (ssize_t)sizeof(page)) {
+      goto write_error;
+   }
+
+   memset(page, 0, sizeof(page));
+   for (uint64_t i=0; i < n; i++) {
+      if (!next(ctx, &e)) {
+         Mmsg(errmsg, _("Cannot read dedup index entries for %s\n"), tmp.c_str());
+         goto bail_out;
+      }
+      if (in_page == 0) {
+         memcpy(pagedir + p * DEDUP_HASH_SIZE, e.hash, DEDUP_HASH_SIZE);
+      }
+      ser_entry(page + in_page * DEDUP_ENTRY_SIZE, &e);
+      bloom_set(bloom, bits, e.hash);
+      if (++in_page == DEDUP_ENTRIES_PER_PAGE || i == n - 1) {
+         if (write(fd, page, sizeof(page)) != (ssize_t)sizeof(page)) {
+            goto write_error;
+         }
+         memset(page, 0, sizeof(page));
+         in_page = 0;
+         p++;
+      }
+   }
+   if (write(fd, pagedir, npages * DEDUP_HASH_SIZE) != (ssize_t)(npages * DEDUP_HASH_SIZE) ||
+       write(fd, bloom, bits / 8) != (ssize_t)(bits / 8)) {
+      goto write_error;
+   }
+   if (fsync(fd) < 0) {
+      goto write_error;
+   }
+   ::close(fd);
+   fd = -1;
+   if (rename(tmp.c_str(), run_name(dir, id, fname.addr())) < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot rename dedup index %s. ERR=%s\n"), tmp.c_str(), be.bstrerror());
+      goto bail_out;
+   }
+   ok = true;
+   goto bail_out;
+
+write_error:
+   {
+      berrno be;
+      Mmsg(errmsg, _("Error writing dedup index %s. ERR=%s\n"), tmp.c_str(), be.bstrerror());
+   }
+bail_out:
+   if (fd >= 0) {
+      ::close(fd);
+   }
+   if (!ok) {
+      unlink(tmp.c_str());
+   }
+   free(pagedir);
+   free(bloom);
+   return ok;
+}
+
+dedup_store::dedup_store(const char *a_dir):
+   mem_count(0),
+   runs(NULL),
+   nruns(0),
+   next_run_id(1),
+   lock_fd(-1),
+   readonly(false),
+   merging(false),
+   cont_fd(-1),
+   cont_id(0),
+   cont_size(0),
+   use_count(0),
+   nb_chunks(0),
+   nb_new_chunks(0),
+   ref_bytes(0),
+   new_bytes(0)
+{
+   dir = bstrdup(a_dir);
+   pthread_mutex_init(&mutex, NULL);
+   memtable = (dedup_entry *)malloc(DEDUP_MEMTABLE_SLOTS * sizeof(dedup_entry));
+   memset(memtable, 0, DEDUP_MEMTABLE_SLOTS * sizeof(dedup_entry));
+   wbuf = get_pool_memory(PM_FNAME);
+}
+
+dedup_store::~dedup_store()
+{
+   for (int i=0; i < nruns; i++) {
+      free_run(&runs[i]);
+   }
+   if (runs) {
+      free(runs);
+   }
+   if (cont_fd >= 0) {
+      ::close(cont_fd);
+   }
+   if (lock_fd >= 0) {
+      ::close(lock_fd);
+   }
+   free(memtable);
+   free_pool_memory(wbuf);
+   pthread_mutex_destroy(&mutex);
+   free(dir);
+}
+
+void dedup_store::free_run(dedup_run *r)
+{
+   if (r->fd >= 0) {
+      ::close(r->fd);
+   }
+   if (r->pagedir) {
+      free(r->pagedir);
+   }
+   if (r->bloom) {
+      free(r->bloom);
+   }
+   memset(r, 0, sizeof(dedup_run));
+   r->fd = -1;
+}
+
+/* Load the header, the page directory and the bloom filter of a run */
+bool dedup_store::load_run(uint32_t id, dedup_run &r, POOLMEM *&errmsg)
+{
+   POOL_MEM fname;
+   uint8_t page[DEDUP_PAGE_SIZE];
+   uint32_t magic, version, k, hsize;
+   off_t pos;
+   unser_declare;
+
+   memset(&r, 0, sizeof(r));
+   r.id = id;
+   r.fd = ::open(run_name(dir, id, fname.addr()), O_RDONLY|O_CLOEXEC);
+   if (r.fd < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot open dedup index %s. ERR=%s\n"), fname.c_str(), be.bstrerror());
+      return false;
+   }
+   if (pread(r.fd, page, sizeof(page), 0) != (ssize_t)sizeof(page)) {
+      goto bad_run;
+   }
+   unser_begin(page, DEDUP_PAGE_SIZE);
+   unser_uint32(magic);
+   unser_uint32(version);
+   unser_uint64(r.nentries);
+   unser_uint32(r.npages);
+   unser_uint64(r.bloom_bits);
+   unser_uint32(k);
+   unser_uint32(hsize);
+   if (magic != RUN_MAGIC || version != 1 || k != BLOOM_K ||
+       hsize != DEDUP_HASH_SIZE || r.bloom_bits == 0 || r.bloom_bits % 8) {
+      goto bad_run;
+   }
+   pos = (off_t)(r.npages + 1) * DEDUP_PAGE_SIZE;
+   r.pagedir = (uint8_t *)malloc(MAX(r.npages, 1) * DEDUP_HASH_SIZE);
+   r.bloom = (uint8_t *)malloc(r.bloom_bits / 8);
+   if (pread(r.fd, r.pagedir, r.npages * DEDUP_HASH_SIZE, pos) != (ssize_t)(r.npages * DEDUP_HASH_SIZE) ||
+       pread(r.fd, r.bloom, r.bloom_bits / 8, pos + r.npages * DEDUP_HASH_SIZE) != (ssize_t)(r.bloom_bits / 8)) {
+      goto bad_run;
+   }
+   Dmsg3(dbglvl, "Open dedup index %s entries=%lld pages=%d\n", fname.c_str(),
+         r.nentries, r.npages);
+   return true;
+
+bad_run:
+   Mmsg(errmsg, _("Dedup index %s is corrupted\n"), fname.c_str());
+   free_run(&r);
+   return false;
+}
+
+/* Add a run as the most recent one, called with the mutex locked */
+bool dedup_store::open_run(uint32_t id, POOLMEM *&errmsg)
+{
+   dedup_run r;
+
+   if (!load_run(id, r, errmsg)) {
+      return false;
+   }
+   runs = (dedup_run *)realloc(runs, (nruns + 1) * sizeof(dedup_run));
+   runs[nruns++] = r;
+   if (id >= next_run_id) {
+      next_run_id = id + 1;
+   }
+   return true;
+}
+
+bool dedup_store::open_container(uint32_t id, POOLMEM *&errmsg)
+{
+   POOL_MEM fname;
+   struct stat statp;
+
+   if (cont_fd >= 0) {
+      ::close(cont_fd);
+   }
+   cont_fd = ::open(container_name(id, fname.addr()), O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC, 0640);
+   if (cont_fd < 0 || fstat(cont_fd, &statp) < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot open dedup container %s. ERR=%s\n"), fname.c_str(), be.bstrerror());
+      return false;
+   }
+   cont_id = id;
+   cont_size = statp.st_size;
+   return true;
+}
+
+static int uint32_cmp(const void *a, const void *b)
+{
+   uint32_t x = *(uint32_t *)a, y = *(uint32_t *)b;
+   return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+bool dedup_store::open(POOLMEM *&errmsg)
+{
+   POOL_MEM fname;
+   DIR *dp;
+   struct dirent *de;
+   uint32_t id, last_container = 1;
+   uint32_t *ids = NULL;
+   int nids = 0;
+   bool ok = false;
+
+   Mmsg(fname, "%s/lock", dir);
+   lock_fd = ::open(fname.c_str(), O_RDWR|O_CREAT|O_CLOEXEC, 0640);
+   if (lock_fd < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot open %s. ERR=%s\n"), fname.c_str(), be.bstrerror());
+      return false;
+   }
+#ifdef HAVE_FCNTL_LOCK
+   if (fcntl_lock(lock_fd, F_WRLCK) < 0) {
+      /* bls or bextract while the SD is running, we can still read */
+      Dmsg1(dbglvl, "Dedup directory %s is locked, open it read only\n", dir);
+      readonly = true;
+   }
+#endif
+
+   if ((dp = opendir(dir)) == NULL) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot open dedup directory %s. ERR=%s\n"), dir, be.bstrerror());
+      return false;
+   }
+   while ((de = readdir(dp)) != NULL) {
+      if (sscanf(de->d_name, "container-%u.bdc", &id) == 1) {
+         last_container = MAX(last_container, id);
+      } else if (sscanf(de->d_name, "index-%u.bdi", &id) == 1) {
+         ids = (uint32_t *)realloc(ids, (nids + 1) * sizeof(uint32_t));
+         ids[nids++] = id;
+      }
+   }
+   closedir(dp);
+
+   if (nids > 0) {
+      qsort(ids, nids, sizeof(uint32_t), uint32_cmp);
+   }
+   for (int i=0; i < nids; i++) {
+      if (!open_run(ids[i], errmsg)) {
+         goto bail_out;
+      }
+   }
+   if (!readonly && !open_container(last_container, errmsg)) {
+      goto bail_out;
+   }
+   ok = true;
+
+bail_out:
+   if (ids) {
+      free(ids);
+   }
+   return ok;
+}
+
+/* Look for e->hash, fill the chunk location if found */
+bool dedup_store::lookup_locked(dedup_entry *e)
+{
+   uint32_t slot = hash_word(e->hash, 0) & (DEDUP_MEMTABLE_SLOTS - 1);
+   uint8_t page[DEDUP_PAGE_SIZE];
+
+   while (memtable[slot].len) {
+      if (memcmp(memtable[slot].hash, e->hash, DEDUP_HASH_SIZE) == 0) {
+         *e = memtable[slot];
+         return true;
+      }
+      slot = (slot + 1) & (DEDUP_MEMTABLE_SLOTS - 1);
+   }
+
+   /* Most recent runs first */
+   for (int i=nruns-1; i >= 0; i--) {
+      dedup_run *r = &runs[i];
+      int lo, hi, mid, nb;
+
+      if (r->nentries == 0 || !bloom_test(r, e->hash)) {
+         continue;
+      }
+      /* Last page whose first hash is <= e->hash */
+      lo = 0;
+      hi = r->npages - 1;
+      while (lo < hi) {
+         mid = (lo + hi + 1) / 2;
+         if (memcmp(r->pagedir + mid * DEDUP_HASH_SIZE, e->hash, DEDUP_HASH_SIZE) <= 0) {
+            lo = mid;
+         } else {
+            hi = mid - 1;
+         }
+      }
+      if (pread(r->fd, page, sizeof(page), (off_t)(lo + 1) * DEDUP_PAGE_SIZE) != (ssize_t)sizeof(page)) {
+         continue;
+      }
+      nb = MIN((uint64_t)DEDUP_ENTRIES_PER_PAGE, r->nentries - (uint64_t)lo * DEDUP_ENTRIES_PER_PAGE);
+      lo = 0;
+      hi = nb - 1;
+      while (lo <= hi) {
+         int c;
+         mid = (lo + hi) / 2;
+         c = memcmp(page + mid * DEDUP_ENTRY_SIZE, e->hash, DEDUP_HASH_SIZE);
+         if (c == 0) {
+            unser_entry(page + mid * DEDUP_ENTRY_SIZE, e);
+            return true;
+         }
+         if (c < 0) {
+            lo = mid + 1;
+         } else {
+            hi = mid - 1;
+         }
+      }
+   }
+   return false;
+}
+
+struct mem_iter {
+   dedup_entry *entries;
+   uint64_t pos;
+};
+
+static bool next_mem_entry(void *ctx, dedup_entry *e)
+{
+   mem_iter *it = (mem_iter *)ctx;
+   *e = it->entries[it->pos++];
+   return true;
+}
+
+/* Write the memtable as a new run, the containers are synced first */
+bool dedup_store::flush_memtable(POOLMEM *&errmsg)
+{
+   dedup_entry *entries;
+   mem_iter it;
+   uint32_t n = 0;
+   uint32_t id = next_run_id;
+
+   if (mem_count == 0) {
+      return true;
+   }
+   if (fdatasync(cont_fd) < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot sync dedup container %u. ERR=%s\n"), cont_id, be.bstrerror());
+      return false;
+   }
+   entries = (dedup_entry *)malloc(mem_count * sizeof(dedup_entry));
+   for (uint32_t i=0; i < DEDUP_MEMTABLE_SLOTS; i++) {
+      if (memtable[i].len) {
+         entries[n++] = memtable[i];
+      }
+   }
+   qsort(entries, n, sizeof(dedup_entry), entry_cmp);
+   it.entries = entries;
+   it.pos = 0;
+   if (!write_run_file(dir, id, n, next_mem_entry, &it, errmsg)) {
+      free(entries);
+      return false;
+   }
+   free(entries);
+   if (!open_run(id, errmsg)) {
+      return false;
+   }
+   memset(memtable, 0, DEDUP_MEMTABLE_SLOTS * sizeof(dedup_entry));
+   mem_count = 0;
+   Dmsg2(dbglvl, "Flushed %u entries to dedup index %u\n", n, id);
+   return true;
+}
+
+struct merge_cursor {
+   dedup_run *r;
+   uint64_t pos;
+   int64_t page_no;
+   uint8_t page[DEDUP_PAGE_SIZE];
+};
+
+struct merge_iter {
+   merge_cursor *c;
+   int nb;
+};
+
+static uint8_t *cursor_entry(merge_cursor *c)
+{
+   int64_t p = c->pos / DEDUP_ENTRIES_PER_PAGE;
+   if (p != c->page_no) {
+      if (pread(c->r->fd, c->page, DEDUP_PAGE_SIZE, (off_t)(p + 1) * DEDUP_PAGE_SIZE) != DEDUP_PAGE_SIZE) {
+         return NULL;
+      }
+      c->page_no = p;
+   }
+   return c->page + (c->pos % DEDUP_ENTRIES_PER_PAGE) * DEDUP_ENTRY_SIZE;
+}
+
+static bool next_merge_entry(void *ctx, dedup_entry *e)
+{
+   merge_iter *it = (merge_iter *)ctx;
+   uint8_t *best = NULL, *p;
+   int bi = -1;
+
+   for (int i=0; i < it->nb; i++) {
+      if (it->c[i].pos >= it->c[i].r->nentries) {
+         continue;
+      }
+      if ((p = cursor_entry(&it->c[i])) == NULL) {
+         return false;
+      }
+      if (!best || memcmp(p, best, DEDUP_HASH_SIZE) < 0) {
+         best = p;
+         bi = i;
+      }
+   }
+   if (bi < 0) {
+      return false;
+   }
+   unser_entry(best, e);
+   it->c[bi].pos++;
+   return true;
+}
+
+/*
+ * Should the runs be merged, called with the mutex locked. Only one
+ *  merge is done at a time.
+ */
+bool dedup_store::need_merge()
+{
+   if (merging || nruns <= DEDUP_MAX_RUNS) {
+      return false;
+   }
+   merging = true;
+   return true;
+}
+
+/*
+ * Merge the current runs into a single one to keep lookups cheap.
+ *  The runs are read only, so the new run is written without the
+ *  mutex, the lookups and the flushes of the memtable go on. The new
+ *  run then replaces the runs it contains, the runs flushed in the
+ *  meantime are kept after it.
+ */
+bool dedup_store::merge_runs(POOLMEM *&errmsg)
+{
+   POOL_MEM fname;
+   merge_iter it;
+   dedup_run *old, *tab, r;
+   uint64_t n = 0;
+   uint32_t id;
+   int nold;
+   bool ok = false;
+
+   P(mutex);
+   id = next_run_id++;
+   nold = nruns;
+   old = (dedup_run *)malloc(nold * sizeof(dedup_run));
+   memcpy(old, runs, nold * sizeof(dedup_run)); /* the runs are freed only here */
+   V(mutex);
+
+   it.nb = nold;
+   it.c = (merge_cursor *)malloc(nold * sizeof(merge_cursor));
+   for (int i=0; i < nold; i++) {
+      it.c[i].r = &old[i];
+      it.c[i].pos = 0;
+      it.c[i].page_no = -1;
+      n += old[i].nentries;
+   }
+   if (!write_run_file(dir, id, n, next_merge_entry, &it, errmsg)) {
+      goto bail_out;
+   }
+   if (!load_run(id, r, errmsg)) {
+      /* Keep the old runs, they are still valid */
+      unlink(run_name(dir, id, fname.addr()));
+      goto bail_out;
+   }
+
+   P(mutex);
+   tab = (dedup_run *)malloc((nruns - nold + 1) * sizeof(dedup_run));
+   tab[0] = r;
+   memcpy(tab + 1, runs + nold, (nruns - nold) * sizeof(dedup_run));
+   for (int i=0; i < nold; i++) {
+      free_run(&runs[i]);
+   }
+   free(runs);
+   runs = tab;
+   nruns = nruns - nold + 1;
+   merging = false;
+   V(mutex);
+
+   for (int i=0; i < nold; i++) {
+      unlink(run_name(dir, old[i].id, fname.addr()));
+   }
+   Dmsg2(dbglvl, "Merged %d dedup index runs into %u\n", nold, id);
+   ok = true;
+
+bail_out:
+   if (!ok) {
+      P(mutex);
+      merging = false;
+      V(mutex);
+   }
+   free(it.c);
+   free(old);
+   return ok;
+}
+
+/*
+ * Store a chunk if we do not already have it, and return its location.
+ *  The fingerprint is computed outside of the lock.
+ */
+bool dedup_store::store_chunk(JCR *jcr, const char *buf, uint32_t len,
+                              dedup_entry *e, POOLMEM *&errmsg)
+{
+   DIGEST *digest;
+   uint32_t size = DEDUP_HASH_SIZE;
+   uint64_t xxh;
+   bool ok = false, merge = false;
+   ser_declare;
+
+   digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA256);
+   if (!digest) {
+      Mmsg(errmsg, _("Deduplication needs SHA256 support\n"));
+      return false;
+   }
+   crypto_digest_update(digest, (const uint8_t *)buf, len);
+   crypto_digest_finalize(digest, e->hash, &size);
+   crypto_digest_free(digest);
+   xxh = XXH64((const uint8_t *)buf, len, 0);
+
+   P(mutex);
+   if (readonly) {
+      Mmsg(errmsg, _("Dedup directory %s is used by another daemon\n"), dir);
+      goto get_out;
+   }
+   nb_chunks++;
+   ref_bytes += len;
+   if (lookup_locked(e)) {
+      ok = true;
+      goto get_out;
+   }
+
+   if (cont_size >= DEDUP_CONTAINER_SIZE) {
+      if (fdatasync(cont_fd) < 0 || !open_container(cont_id + 1, errmsg)) {
+         goto get_out;
+      }
+   }
+   wbuf = check_pool_memory_size(wbuf, CHUNK_HDR_SIZE + len);
+   ser_begin(wbuf, CHUNK_HDR_SIZE);
+   ser_uint32(CHUNK_MAGIC);
+   ser_uint32(len);
+   ser_uint64(xxh);
+   ser_bytes(e->hash, DEDUP_HASH_SIZE);
+   memcpy(wbuf + CHUNK_HDR_SIZE, buf, len);
+   if (write(cont_fd, wbuf, CHUNK_HDR_SIZE + len) != (ssize_t)(CHUNK_HDR_SIZE + len)) {
+      berrno be;
+      Mmsg(errmsg, _("Error writing dedup container %u. ERR=%s\n"), cont_id, be.bstrerror());
+      /* Do not reuse a partially written offset */
+      struct stat statp;
+      if (fstat(cont_fd, &statp) == 0) {
+         cont_size = statp.st_size;
+      }
+      goto get_out;
+   }
+   e->container = cont_id;
+   e->len = len;
+   e->offset = cont_size;
+   cont_size += CHUNK_HDR_SIZE + len;
+   nb_new_chunks++;
+   new_bytes += len;
+
+   {
+      uint32_t slot = hash_word(e->hash, 0) & (DEDUP_MEMTABLE_SLOTS - 1);
+      while (memtable[slot].len) {
+         slot = (slot + 1) & (DEDUP_MEMTABLE_SLOTS - 1);
+      }
+      memtable[slot] = *e;
+      mem_count++;
+   }
+   ok = true;
+   if (mem_count >= DEDUP_MEMTABLE_SLOTS / 4 * 3) {
+      ok = flush_memtable(errmsg);
+      merge = ok && need_merge();
+   }
+
+get_out:
+   V(mutex);
+   if (merge) {
+      ok = merge_runs(errmsg);
+   }
+   return ok;
+}
+
+/* Make the chunks and the index durable, called at the end of a Job */
+bool dedup_store::commit(POOLMEM *&errmsg)
+{
+   bool ok, merge = false;
+   P(mutex);
+   ok = readonly || flush_memtable(errmsg);
+   merge = ok && !readonly && need_merge();
+   V(mutex);
+   if (merge) {
+      ok = merge_runs(errmsg);
+   }
+   return ok;
+}
+
+int dedup_store::get_status(POOL_MEM &msg)
+{
+   char ed1[50], ed2[50], ed3[50];
+   uint64_t entries = 0;
+
+   P(mutex);
+   for (int i=0; i < nruns; i++) {
+      entries += runs[i].nentries;
+   }
+   entries += mem_count;
+   int len = Mmsg(msg, _("   Dedup Directory=%s Chunks=%s Referenced=%sB Stored=%sB Ratio=%.2f IndexRuns=%d\n"),
+                  dir, edit_uint64_with_commas(entries, ed1),
+                  edit_uint64_with_suffix(ref_bytes, ed2),
+                  edit_uint64_with_suffix(new_bytes, ed3),
+                  new_bytes ? (double)ref_bytes / new_bytes : 1.0, nruns);
+   V(mutex);
+   return len;
+}
+
+/*
+ * The stores are shared by all the devices that use the same
+ *  directory.
+ */
+dedup_store *get_dedup_store(const char *dir, POOLMEM *&errmsg)
+{
+   dedup_store *store;
+
+   P(stores_mutex);
+   if (!stores) {
+      stores = New(alist(5, not_owned_by_alist));
+   }
+   foreach_alist(store, stores) {
+      if (strcmp(store->dir, dir) == 0) {
+         store->use_count++;
+         V(stores_mutex);
+         return store;
+      }
+   }
+   store = New(dedup_store(dir));
+   if (!store->open(errmsg)) {
+      delete store;
+      V(stores_mutex);
+      return NULL;
+   }
+   store->use_count = 1;
+   stores->append(store);
+   V(stores_mutex);
+   return store;
+}
+
+void release_dedup_store(dedup_store *store)
+{
+   POOLMEM *errmsg;
+
+   P(stores_mutex);
+   if (--store->use_count > 0) {
+      V(stores_mutex);
+      return;
+   }
+   for (int i=0; i < stores->size(); i++) {
+      if (stores->get(i) == store) {
+         stores->remove(i);
+         break;
+      }
+   }
+   if (stores->size() == 0) {
+      delete stores;
+      stores = NULL;
+   }
+   V(stores_mutex);
+
+   errmsg = get_pool_memory(PM_MESSAGE);
+   if (!store->commit(errmsg)) {
+      Emsg1(M_ERROR, 0, "%s", errmsg);
+   }
+   free_pool_memory(errmsg);
+   delete store;
+}
+
+/*
+ * Message queue used during a backup, it replaces the data of each
+ *  record by the references of its chunks.
+ */
+class dedup_msg_queue: public GetMsg {
+   dedup_store *store;
+   POOLMEM *refbuf;
+public:
+   dedup_msg_queue(JCR *a_jcr, BSOCK *a_bsock, int32_t a_bufsize, dedup_store *a_store):
+      GetMsg(a_jcr, a_bsock, NULL, a_bufsize), store(a_store) {
+      refbuf = get_pool_memory(PM_MESSAGE);
+   };
+   ~dedup_msg_queue() {
+      free_pool_memory(refbuf);
+   };
+   int commit(POOLMEM *&errmsg, uint32_t jobid);
+   bool dedup_store_chunk(DEV_RECORD *rec, const char *rbuf, int rbuflen,
+                          char *dedup_ref_buf, char *wdedup_ref_buf, POOLMEM *&errmsg);
+};
+
+int dedup_msg_queue::commit(POOLMEM *&errmsg, uint32_t jobid)
+{
+   Dmsg1(dbglvl, "Commit dedup store for JobId=%u\n", jobid);
+   return store->commit(errmsg) ? 0 : -1;
+}
+
+bool dedup_msg_queue::dedup_store_chunk(DEV_RECORD *rec, const char *rbuf, int rbuflen,
+                          char *dedup_ref_buf, char *wdedup_ref_buf, POOLMEM *&errmsg)
+{
+   /* The offset of sparse streams was already copied in dedup_ref_buf */
+   uint32_t prefix = wdedup_ref_buf - dedup_ref_buf;
+   uint32_t max_refs = rbuflen / DEDUP_CHUNK_MIN + 1;
+   uint32_t count = 0, pos = 0, len;
+   uint8_t *p;
+   dedup_entry e;
+   ser_declare;
+
+   refbuf = check_pool_memory_size(refbuf, prefix + DEDUP_REF_HEADER_SIZE +
+                                   max_refs * DEDUP_ENTRY_SIZE);
+   memcpy(refbuf, dedup_ref_buf, prefix);
+   p = (uint8_t *)refbuf + prefix + DEDUP_REF_HEADER_SIZE;
+   while (pos < (uint32_t)rbuflen) {
+      len = dedup_chunk_len((const uint8_t *)rbuf + pos, rbuflen - pos);
+      if (!store->store_chunk(jcr, rbuf + pos, len, &e, errmsg)) {
+         return false;
+      }
+      ser_entry(p, &e);
+      p += DEDUP_ENTRY_SIZE;
+      pos += len;
+      count++;
+   }
+   ser_begin(refbuf + prefix, DEDUP_REF_HEADER_SIZE);
+   ser_uint32(REF_MAGIC);
+   ser_uint32(count);
+   ser_uint32(rbuflen);
+
+   rec->data = refbuf;
+   rec->data_len = (char *)p - refbuf;
+   Dmsg3(dbglvl|100, "FI=%d %d bytes deduplicated in %u chunks\n", rec->FileIndex,
+         rbuflen, count);
+   return true;
+}
+
+GetMsg *new_dedup_msg_queue(JCR *jcr, BSOCK *sock, int32_t bufsize, dedup_store *store)
+{
+   return New(dedup_msg_queue(jcr, sock, bufsize, store));
+}
+
+/*
+ * Rehydration of the records read from a Volume, the data is
+ *  always rebuilt by the Storage Daemon.
+ */
+#define NB_CACHED_FD 8
+
+class dedup_rehydration: public DedupStoredInterfaceBase {
+   dedup_store *store;
+   POOLMEM *msgbuf;
+   POOLMEM *cbuf;
+   int fds[NB_CACHED_FD];
+   uint32_t ids[NB_CACHED_FD];
+   int next_fd;
+   int get_fd(uint32_t id, POOLMEM *&errmsg);
+public:
+   dedup_rehydration(JCR *jcr, dedup_store *a_store);
+   ~dedup_rehydration();
+   int record_rehydration(DCR *dcr, DEV_RECORD *rec, char *buf, POOLMEM *&errmsg,
+                          bool despite_of_error, int *chunk_size);
+   POOLMEM *get_msgbuf() { return msgbuf; };
+   bool is_rehydration_srvside() { return true; };
+   bool do_flowcontrol_rehydration(int free_rec_count, int retry_timeoutms=250) { return true; };
+   bool wait_flowcontrol_rehydration(int free_rec_count, int timeoutms) { return true; };
+};
+
+dedup_rehydration::dedup_rehydration(JCR *jcr, dedup_store *a_store):
+   DedupStoredInterfaceBase(jcr, NULL),
+   store(a_store),
+   next_fd(0)
+{
+   msgbuf = get_pool_memory(PM_MESSAGE);
+   cbuf = get_pool_memory(PM_MESSAGE);
+   for (int i=0; i < NB_CACHED_FD; i++) {
+      fds[i] = -1;
+      ids[i] = 0;
+   }
+}
+
+dedup_rehydration::~dedup_rehydration()
+{
+   for (int i=0; i < NB_CACHED_FD; i++) {
+      if (fds[i] >= 0) {
+         ::close(fds[i]);
+      }
+   }
+   free_pool_memory(msgbuf);
+   free_pool_memory(cbuf);
+}
+
+int dedup_rehydration::get_fd(uint32_t id, POOLMEM *&errmsg)
+{
+   POOL_MEM fname;
+   int i;
+
+   for (i=0; i < NB_CACHED_FD; i++) {
+      if (fds[i] >= 0 && ids[i] == id) {
+         return fds[i];
+      }
+   }
+   i = next_fd;
+   next_fd = (next_fd + 1) % NB_CACHED_FD;
+   if (fds[i] >= 0) {
+      ::close(fds[i]);
+   }
+   ids[i] = id;
+   fds[i] = ::open(store->container_name(id, fname.addr()), O_RDONLY|O_CLOEXEC);
+   if (fds[i] < 0) {
+      berrno be;
+      Mmsg(errmsg, _("Cannot open dedup container %s. ERR=%s\n"), fname.c_str(), be.bstrerror());
+   }
+   return fds[i];
+}
+
+/*
+ * Rebuild the data of a record in msgbuf from its chunk references.
+ *  Returns: 0 on success
+ *           1 if some chunks were bad and replaced by zeros (despite_of_error)
+ *          -1 on error
+ */
+int dedup_rehydration::record_rehydration(DCR *dcr, DEV_RECORD *rec, char *buf,
+                          POOLMEM *&errmsg, bool despite_of_error, int *chunk_size)
+{
+   uint32_t prefix = is_offset_stream(rec->Stream) ? OFFSET_FADDR_SIZE : 0;
+   uint32_t magic, count, total, pos = 0;
+   uint8_t *p = (uint8_t *)rec->data + prefix;
+   uint8_t hash[DEDUP_HASH_SIZE];
+   uint32_t clen;
+   uint64_t xxh;
+   dedup_entry e;
+   int ret = 0;
+   unser_declare;
+
+   *chunk_size = 0;
+   if (rec->data_len < prefix + DEDUP_REF_HEADER_SIZE) {
+      Mmsg(errmsg, _("Invalid dedup reference record, length=%d\n"), rec->data_len);
+      return -1;
+   }
+   unser_begin(p, DEDUP_REF_HEADER_SIZE);
+   unser_uint32(magic);
+   unser_uint32(count);
+   unser_uint32(total);
+   if (magic != REF_MAGIC ||
+       rec->data_len != prefix + DEDUP_REF_HEADER_SIZE + (uint64_t)count * DEDUP_ENTRY_SIZE) {
+      Mmsg(errmsg, _("Invalid dedup reference record, length=%d\n"), rec->data_len);
+      return -1;
+   }
+   p += DEDUP_REF_HEADER_SIZE;
+
+   /* buf is msgbuf, it is given back by get_msgbuf() after this call */
+   msgbuf = check_pool_memory_size(msgbuf, prefix + total);
+   memcpy(msgbuf, rec->data, prefix);
+   for (uint32_t i=0; i < count; i++, p += DEDUP_ENTRY_SIZE) {
+      int fd;
+      unser_entry(p, &e);
+      if (pos + e.len > total) {
+         Mmsg(errmsg, _("Invalid dedup reference record, length=%d\n"), rec->data_len);
+         return -1;
+      }
+      cbuf = check_pool_memory_size(cbuf, CHUNK_HDR_SIZE + e.len);
+      fd = get_fd(e.container, errmsg);
+      if (fd < 0) {
+         return -1;
+      }
+      if (pread(fd, cbuf, CHUNK_HDR_SIZE + e.len, e.offset) != (ssize_t)(CHUNK_HDR_SIZE + e.len)) {
+         berrno be;
+         Mmsg(errmsg, _("Error reading dedup container %u at %llu. ERR=%s\n"),
+              e.container, e.offset, be.bstrerror());
+         return -1;
+      }
+      unser_begin(cbuf, CHUNK_HDR_SIZE);
+      unser_uint32(magic);
+      unser_uint32(clen);
+      unser_uint64(xxh);
+      unser_bytes(hash, DEDUP_HASH_SIZE);
+      if (magic != CHUNK_MAGIC || clen != e.len ||
+          memcmp(hash, e.hash, DEDUP_HASH_SIZE) != 0 ||
+          XXH64((const uint8_t *)cbuf + CHUNK_HDR_SIZE, e.len, 0) != xxh) {
+         Mmsg(errmsg, _("Bad dedup chunk in container %u at %llu\n"), e.container, e.offset);
+         if (!despite_of_error) {
+            return -1;
+         }
+         memset(msgbuf + prefix + pos, 0, e.len);
+         ret = 1;
+      } else {
+         memcpy(msgbuf + prefix + pos, cbuf + CHUNK_HDR_SIZE, e.len);
+      }
+      pos += e.len;
+   }
+   if (pos != total) {
+      Mmsg(errmsg, _("Invalid dedup reference record, length=%d\n"), rec->data_len);
+      return -1;
+   }
+   rec->Stream &= ~STREAM_BIT_DEDUPLICATION_DATA;
+   *chunk_size = prefix + total;
+   return ret;
+}
+
+DedupStoredInterfaceBase *new_dedup_rehydration(JCR *jcr, dedup_store *store)
+{
+   return new dedup_rehydration(jcr, store);
+}
+
+#ifdef TEST_PROGRAM
+#include "lib/unittests.h"
+
+int main(int argc, char *argv[])
+{
+   Unittests dedup_test("dedup_store_test", true);
+   char dir[] = "/tmp/dedup_store_testXXXXXX";
+   POOLMEM *errmsg = get_pool_memory(PM_MESSAGE);
+   uint32_t len = 1024*1024, pos, n, nb = 0;
+   uint8_t *buf = (uint8_t *)malloc(len);
+   uint64_t x = 1;
+   dedup_entry e;
+   bool ok1;
+
+   for (uint32_t i=0; i < len; i++) {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+      buf[i] = x >> 56;
+   }
+
+   /* Boundaries must be in the limits and depend only on the data */
+   ok1 = true;
+   for (pos = 0; pos < len; pos += n, nb++) {
+      n = dedup_chunk_len(buf + pos, len - pos);
+      if (n == 0 || n > DEDUP_CHUNK_MAX || (n < DEDUP_CHUNK_MIN && pos + n != len)) {
+         ok1 = false;
+      }
+   }
+   ok(ok1, "Checking chunk sizes");
+   ok(nb > len / DEDUP_CHUNK_MAX && nb < len / DEDUP_CHUNK_MIN, "Checking number of chunks");
+   n = dedup_chunk_len(buf + 100000, len - 100000);
+   ok(n == dedup_chunk_len(buf + 100000, n + DEDUP_CHUNK_MAX), "Checking chunk boundary stability");
+
+   ok(mkdtemp(dir) != NULL, "Creating the dedup directory");
+   dedup_store *store = get_dedup_store(dir, errmsg);
+   ok(store != NULL, "Opening the dedup store");
+   ok(get_dedup_store(dir, errmsg) == store, "Sharing the dedup store");
+   release_dedup_store(store);
+
+   /* Store all the chunks twice, the second time nothing is written */
+   for (int loop = 0; loop < 2; loop++) {
+      ok1 = true;
+      for (pos = 0; pos < len; pos += n) {
+         n = dedup_chunk_len(buf + pos, len - pos);
+         ok1 = ok1 && store->store_chunk(NULL, (char *)buf + pos, n, &e, errmsg);
+      }
+      ok(ok1, "Storing chunks");
+   }
+   is((int64_t)store->nb_chunks, 2 * nb, "Checking referenced chunks");
+   is((int64_t)store->nb_new_chunks, nb, "Checking new chunks");
+   is((int64_t)store->new_bytes, len, "Checking stored bytes");
+   ok(store->commit(errmsg), "Committing the dedup store");
+
+   /* Rebuild a record from its references */
+   {
+      DEV_RECORD rec;
+      POOLMEM *ref = get_pool_memory(PM_MESSAGE);
+      uint32_t count = 0;
+      uint8_t *p;
+      int size = 0;
+      ser_declare;
+
+      ref = check_pool_memory_size(ref, DEDUP_REF_HEADER_SIZE + nb * DEDUP_ENTRY_SIZE);
+      p = (uint8_t *)ref + DEDUP_REF_HEADER_SIZE;
+      for (pos = 0; pos < 200000; pos += n, count++) {
+         n = dedup_chunk_len(buf + pos, 200000 - pos);
+         store->store_chunk(NULL, (char *)buf + pos, n, &e, errmsg);
+         ser_entry(p, &e);
+         p += DEDUP_ENTRY_SIZE;
+      }
+      ser_begin(ref, DEDUP_REF_HEADER_SIZE);
+      ser_uint32(REF_MAGIC);
+      ser_uint32(count);
+      ser_uint32(200000);
+      memset(&rec, 0, sizeof(rec));
+      rec.Stream = STREAM_FILE_DATA | STREAM_BIT_DEDUPLICATION_DATA;
+      rec.data = ref;
+      rec.data_len = (char *)p - ref;
+
+      DedupStoredInterfaceBase *rh = new_dedup_rehydration(NULL, store);
+      is(rh->record_rehydration(NULL, &rec, rh->get_msgbuf(), errmsg, false, &size), 0,
+         "Rehydrating a record");
+      is(size, 200000, "Checking rehydrated size");
+      ok(memcmp(rh->get_msgbuf(), buf, 200000) == 0, "Checking rehydrated data");
+      ok(rec.Stream == STREAM_FILE_DATA, "Checking rehydrated stream");
+
+      /* Corrupt the last reference */
+      p[-DEDUP_ENTRY_SIZE] ^= 1;
+      rec.Stream |= STREAM_BIT_DEDUPLICATION_DATA;
+      ok(rh->record_rehydration(NULL, &rec, rh->get_msgbuf(), errmsg, false, &size) < 0,
+         "Detecting a bad chunk");
+      delete rh;
+      free_pool_memory(ref);
+   }
+   release_dedup_store(store);
+
+   /* The index on disk must find all the chunks */
+   store = get_dedup_store(dir, errmsg);
+   ok(store != NULL, "Reopening the dedup store");
+   ok1 = true;
+   for (pos = 0; pos < len; pos += n) {
+      n = dedup_chunk_len(buf + pos, len - pos);
+      ok1 = ok1 && store->store_chunk(NULL, (char *)buf + pos, n, &e, errmsg);
+   }
+   ok(ok1, "Storing chunks again");
+   is((int64_t)store->nb_new_chunks, 0, "Checking that the index is persistent");
+
+   /* One run per commit, they are merged above DEDUP_MAX_RUNS */
+   ok1 = true;
+   for (int i=0; i < 2 * DEDUP_MAX_RUNS; i++) {
+      buf[i * DEDUP_CHUNK_MAX] ^= 0xFF;
+      ok1 = ok1 && store->store_chunk(NULL, (char *)buf + i * DEDUP_CHUNK_MAX, DEDUP_CHUNK_MIN, &e, errmsg);
+      ok1 = ok1 && store->commit(errmsg);
+   }
+   ok(ok1, "Committing many index runs");
+   for (int i=0; i < 2 * DEDUP_MAX_RUNS; i++) {
+      ok1 = ok1 && store->store_chunk(NULL, (char *)buf + i * DEDUP_CHUNK_MAX, DEDUP_CHUNK_MIN, &e, errmsg);
+   }
+   for (pos = 0; pos < len; pos += n) {
+      n = dedup_chunk_len(buf + pos, len - pos);
+      ok1 = ok1 && store->store_chunk(NULL, (char *)buf + pos, n, &e, errmsg);
+   }
+   ok(ok1, "Storing chunks after the merge");
+   /* Only the small chunks and the chunks with a modified byte are new */
+   is((int64_t)store->nb_new_chunks, 2 * DEDUP_MAX_RUNS + 2 * DEDUP_MAX_RUNS,
+      "Checking the merged index");
+   release_dedup_store(store);
+
+   {
+      POOL_MEM cmd;
+      Mmsg(cmd, "rm -rf %s", dir);
+      ok(system(cmd.c_str()) == 0, "Removing the dedup directory");
+   }
+   free(buf);
+   free_pool_memory(errmsg);
+   return report();
+}
+#endif /* TEST_PROGRAM */
@@ -0,0 +1,126 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Local deduplication store for File devices
+ *
+ *  Data records are cut into chunks with a content defined (gear
+ *  hash) chunker, each chunk is identified by its SHA256 and stored
+ *  once in append only container files. The record written to the
+ *  Volume only contains the list of chunk references.
+ *
+ *  The fingerprint index is made of an in memory table for the
+ *  new chunks, and of sorted runs on disk. Each run has a bloom
+ *  filter and a directory with the first fingerprint of each index
+ *  page, so a lookup costs at most one page read per run.
+ *
+ *  The chunks are never reclaimed. There is no reference count, a
+ *  container is kept even when the Volumes that use its chunks are
+ *  recycled, so the directory only grows. New data is deduplicated
+ *  only when the Device sets AllowDedupWithoutReclaim = yes, the
+ *  Volumes already written can always be read.
+ */
+
+#ifndef DEDUP_STORE_H
+#define DEDUP_STORE_H
+
+#define DEDUP_HASH_SIZE           32          /* SHA256 */
+#define DEDUP_CHUNK_MIN           (2*1024)
+#define DEDUP_CHUNK_AVG           (8*1024)
+#define DEDUP_CHUNK_MAX           (64*1024)
+#define DEDUP_CONTAINER_SIZE      ((uint64_t)1024*1024*1024)
+#define DEDUP_ENTRY_SIZE          48          /* hash + container + len + offset */
+#define DEDUP_PAGE_SIZE           4096
+#define DEDUP_ENTRIES_PER_PAGE    (DEDUP_PAGE_SIZE / DEDUP_ENTRY_SIZE)
+#define DEDUP_MEMTABLE_SLOTS      (1<<18)     /* flushed when 3/4 full */
+#define DEDUP_MAX_RUNS            8           /* runs are merged above this */
+#define DEDUP_REF_HEADER_SIZE     12          /* magic + count + length */
+
+/* Location of a chunk, also the format of a reference in a Volume */
+struct dedup_entry {
+   uint8_t  hash[DEDUP_HASH_SIZE];
+   uint32_t container;
+   uint32_t len;                      /* zero means free slot in the memtable */
+   uint64_t offset;                   /* offset of the chunk header */
+};
+
+/* Sorted run of the fingerprint index on disk */
+struct dedup_run {
+   uint32_t id;
+   int fd;
+   uint64_t nentries;
+   uint32_t npages;
+   uint8_t *pagedir;                  /* first hash of each page */
+   uint8_t *bloom;
+   uint64_t bloom_bits;
+};
+
+class dedup_store: public SMARTALLOC {
+   pthread_mutex_t mutex;
+   dedup_entry *memtable;             /* new chunks, open addressing */
+   uint32_t mem_count;
+   dedup_run *runs;                   /* oldest first */
+   int nruns;
+   uint32_t next_run_id;
+   int lock_fd;                       /* one SD per directory */
+   bool readonly;                     /* locked by another program */
+   bool merging;                      /* merge_runs() is running */
+   int cont_fd;                       /* container being written */
+   uint32_t cont_id;
+   uint64_t cont_size;
+   POOLMEM *wbuf;
+
+   bool lookup_locked(dedup_entry *e);
+   bool open_container(uint32_t id, POOLMEM *&errmsg);
+   bool load_run(uint32_t id, dedup_run &r, POOLMEM *&errmsg);
+   bool open_run(uint32_t id, POOLMEM *&errmsg);
+   bool flush_memtable(POOLMEM *&errmsg);
+   bool need_merge();
+   bool merge_runs(POOLMEM *&errmsg);
+   void free_run(dedup_run *r);
+
+public:
+   char *dir;
+   int use_count;
+
+   /* Statistics since the store was opened */
+   uint64_t nb_chunks;                /* chunks referenced */
+   uint64_t nb_new_chunks;            /* chunks written to containers */
+   uint64_t ref_bytes;                /* bytes referenced */
+   uint64_t new_bytes;                /* bytes written to containers */
+
+   dedup_store(const char *a_dir);
+   ~dedup_store();
+   bool open(POOLMEM *&errmsg);
+   bool store_chunk(JCR *jcr, const char *buf, uint32_t len, dedup_entry *e, POOLMEM *&errmsg);
+   bool commit(POOLMEM *&errmsg);
+   int get_status(POOL_MEM &msg);
+   char *container_name(uint32_t id, POOLMEM *&fname);
+};
+
+/* Find the length of the next chunk in buf */
+uint32_t dedup_chunk_len(const uint8_t *buf, uint32_t len);
+
+dedup_store *get_dedup_store(const char *dir, POOLMEM *&errmsg);
+void release_dedup_store(dedup_store *store);
+
+/* Used by the File device to deduplicate and rehydrate records */
+GetMsg *new_dedup_msg_queue(JCR *jcr, BSOCK *sock, int32_t bufsize, dedup_store *store);
+DedupStoredInterfaceBase *new_dedup_rehydration(JCR *jcr, dedup_store *store);
+
+#endif /* DEDUP_STORE_H */
@@ -286,6 +286,7 @@ bool DEVICE::sync_data(DCR *dcr)
       return true;                    /* already closed */
    }
 
+   flush_block_writer(this);          /* the error is reported by the next write */
    while ((ret = fsync(m_fd)) < 0 && errno == EINTR) {
       bmicrosleep(0, 5000);
    }
@@ -320,6 +321,19 @@ bool DEVICE::close(DCR *dcr)
       return true;                    /* already closed */
    }
 
+   /* The Volume is going away, nobody will write on it again */
+   if (block_writer && !flush_block_writer(this)) {
+      berrno be;
+      dev_errno = clear_block_writer_error(this);
+      Jmsg3(dcr ? dcr->jcr : NULL, M_ERROR, 0, _("Write error on Volume \"%s\" device %s. ERR=%s.\n"),
+            VolHdr.VolumeName, print_name(), be.bstrerror(dev_errno));
+      ok = false;
+   }
+   if (drop_cache() && is_file()) {
+      drop_volume_cache(m_fd, 0, can_append());
+      cache_bytes = 0;
+   }
+
    switch (dev_type) {
    case B_VTL_DEV:
    case B_VTAPE_DEV:
@@ -486,6 +500,7 @@ ssize_t DEVICE::read(void *buf, size_t len)
    ssize_t read_len;
    ssize_t stat_read_len = 0;
 
+   flush_block_writer(this);          /* read what was queued */
    get_timer_count();
 
    read_len = d_read(m_fd, buf, len);
@@ -495,10 +510,16 @@ ssize_t DEVICE::read(void *buf, size_t len)
    DevReadTime += last_tick;
    VolCatInfo.VolReadTime += last_tick;
 
+   DevReadOps++;
+   if (last_tick > DevReadMaxTime) {
+      DevReadMaxTime = last_tick;
+   }
+
    if (read_len > 0) {          /* skip error */
       DevReadBytes += read_len;
       stat_read_len = read_len;
    }
+   update_volume_cache(read_len, false);
 
    collector_update_add2_value_int64(devstatcollector, devstatmetrics.bacula_storage_device_readbytes, stat_read_len,
          devstatmetrics.bacula_storage_device_readtime, last_tick);
@@ -512,6 +533,11 @@ ssize_t DEVICE::write(const void *buf, size_t len)
    ssize_t write_len;
    ssize_t stat_write_len = 0;
 
+   /* Queued blocks go first, an error on them is returned here */
+   if (block_writer && !flush_block_writer(this)) {
+      errno = clear_block_writer_error(this);
+      return -1;
+   }
    get_timer_count();
 
    write_len = d_write(m_fd, buf, len);
@@ -521,10 +547,16 @@ ssize_t DEVICE::write(const void *buf, size_t len)
    DevWriteTime += last_tick;
    VolCatInfo.VolWriteTime += last_tick;
 
+   DevWriteOps++;
+   if (last_tick > DevWriteMaxTime) {
+      DevWriteMaxTime = last_tick;
+   }
+
    if (write_len > 0) {         /* skip error */
       DevWriteBytes += write_len;
       stat_write_len = write_len;
    }
+   update_volume_cache(write_len, true);
 
    collector_update_add2_value_int64(devstatcollector, devstatmetrics.bacula_storage_device_writebytes, stat_write_len,
          devstatmetrics.bacula_storage_device_writetime, last_tick);
@@ -611,6 +643,7 @@ DEVICE::notify_newfile_in_attached_dcrs()
 void DEVICE::term(DCR *dcr)
 {
    Dmsg1(900, "term dev: %s\n", print_name());
+   term_block_writer(this);           /* writes the queued blocks */
    if (!dcr) {
       d_close(m_fd);
    } else {
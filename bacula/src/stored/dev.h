@@ -109,6 +109,9 @@ typedef struct {
 /* Aligned Data Disk Volume extension */
 #define ADATA_EXTENSION ".add"
 
+/* Bytes read or written between two drops of the Volume page cache */
+#define VOLUME_CACHE_WINDOW (8 * 1024 * 1024)
+
 /* Generic status bits returned from status_dev() */
 #define BMT_TAPE           (1<<0)     /* is tape device */
 #define BMT_EOF            (1<<1)     /* just read EOF */
@@ -150,6 +153,7 @@ typedef struct {
 #define CAP_LSEEK          (1<<24)    /* Has lseek function defined i.e. basically File storage */
 #define CAP_SYNCONCLOSE    (1<<25)    /* Need to call fsync() when releasing/closing the device */
 #define CAP_LINTAPE        (1<<26)    /* If has the Lintape interface */
+#define CAP_DROPCACHE      (1<<27)    /* Drop the Volume data from the page cache */
 
 /* Test state */
 #define dev_state(dev, st_state) ((dev)->state & (st_state))
@@ -242,6 +246,7 @@ struct VOLUME_CAT_INFO {
 
 class DEVRES;                         /* Device resource defined in stored_conf.h */
 class DCR;                            /* forward reference */
+struct BLOCK_WRITER;                  /* forward reference */
 class VOLRES;                         /* forward reference */
 class STATUS_PKT;                     /* forward reference */
 /*
@@ -322,6 +327,8 @@ public:
    uint64_t volume_capacity;          /* advisory capacity */
    uint64_t max_spool_size;           /* maximum spool file size */
    uint64_t spool_size;               /* current spool size for this device */
+   uint64_t burst_count;              /* bursts written, see Burst Size */
+   uint64_t burst_rate;               /* bytes/second of the last burst */
    uint32_t max_rewind_wait;          /* max secs to allow for rewind */
    uint32_t max_open_wait;            /* max secs to allow for open */
    uint32_t padding_size;             /* adata block padding -- bytes */
@@ -370,6 +377,11 @@ public:
    btime_t  DevWriteTime;
    uint64_t DevWriteBytes;
    uint64_t DevReadBytes;
+   uint64_t DevWriteOps;       /* write() calls, for the average latency */
+   uint64_t DevReadOps;
+   btime_t  DevWriteMaxTime;   /* longest write() (usec) */
+   btime_t  DevReadMaxTime;
+   uint64_t cache_bytes;       /* read or written since the page cache was dropped */
    uint64_t usage;             /* Drive usage read+write bytes */
 
    uint64_t last_stat_DevWriteBytes;
@@ -377,6 +389,7 @@ public:
 
    devstatmetrics_t devstatmetrics;    /* these are a device metrics for every device */
    bstatcollect *devstatcollector;        /* a pointer to daemon's statcollector */
+   BLOCK_WRITER *block_writer;        /* set with Write Queue Blocks, see block_writer.c */
 
    /* Methods */
    btime_t get_timer_count(); /* return the last timer interval (ms) */
@@ -389,6 +402,7 @@ public:
    bool do_checksum() const { return (capabilities & CAP_BLOCKCHECKSUM) != 0; }
    int is_autochanger() const { return capabilities & CAP_AUTOCHANGER; }
    int requires_mount() const { return capabilities & CAP_REQMOUNT; }
+   int drop_cache() const { return capabilities & CAP_DROPCACHE; }
    int is_removable() const { return capabilities & CAP_REM; }
    bool is_tape() const { return (dev_type == B_TAPE_DEV ||
                                  dev_type == B_VTAPE_DEV); }
@@ -499,6 +513,7 @@ public:
    void clear_volhdr();          /* in dev.c */
    ssize_t read(void *buf, size_t len); /* in dev.c */
    ssize_t write(const void *buf, size_t len);  /* in dev.c */
+   void update_volume_cache(ssize_t len, bool written); /* in file_dev.c */
    void edit_mount_codes(POOL_MEM &omsg, const char *imsg); /* in dev.c */
    bool offline_or_rewind(DCR *dcr); /* in dev.c */
    bool fsr(int num);            /* in dev.c */
@@ -637,6 +652,8 @@ public:
    virtual int read_adata(DCR *dcr, DEV_RECORD *rec) { return -1; };
    virtual void select_data_stream(DCR *dcr, DEV_RECORD *rec) { return; };
    virtual bool flush_block(DCR *dcr);    /* in block_util.c */
+   virtual bool write_adata_block(DCR *dcr) { return true; }; /* before an ameta block */
+   virtual bool can_clone_adata(DEVICE *src) { return false; };
    virtual bool do_pre_write_checks(DCR *dcr, DEV_RECORD *rec) { return true; };
    virtual void register_metrics(bstatcollect *collector);
 
@@ -765,6 +782,9 @@ public:
    bool spooling;                     /* set when actually spooling */
    bool despooling;                   /* set when despooling */
    bool despool_wait;                 /* waiting for despooling */
+   bool interleaving;                 /* spooling to write extents, see Interleave Size */
+   bool burst;                        /* spooling in memory, see Burst Size */
+   bool writer_lost;                  /* blocks dropped by the block writer */
    bool NewVol;                       /* set if new Volume mounted */
    bool WroteVol;                     /* set if Volume written */
    bool NewFile;                      /* set when EOF written */
@@ -778,10 +798,15 @@ public:
    bool force_update_volume_info;     /* update the volume information, no matter the job type */
    bool session_interactive;          /* set if we allow to seek in the restore stream */
    bool do_interactive_reposition;    /* Set if we want to seek */
+   bool clone_adata;                  /* set if adata is cloned by the writer, not read */
    int32_t FileMedia_FI;              /* Last File Index used to generate a FileMedia record */
-   uint64_t FileMedia_Off;            /* Last File Offset used to generate a FileMedia record */
+   uint64_t FileMedia_Off;            /* Bytes of data records of the current file */
    uint64_t max_index_size;           /* Max amount of data between two indexes */
    uint64_t index_size;               /* Amount of data without index */
+   uint64_t clone_bytes;              /* adata bytes cloned from the read Volume */
+   uint32_t reposition_count;         /* Repositions done by read_records() */
+   uint64_t skipped_bytes;            /* Bytes not read thanks to the repositions */
+   uint64_t read_bytes;               /* Bytes read by read_records() */
 
 
    uint32_t VolFirstIndex;            /* First file index this Volume */
@@ -792,6 +817,8 @@ public:
    int64_t  VolMediaId;               /* MediaId */
    int64_t job_spool_size;            /* Current job spool size */
    int64_t max_job_spool_size;        /* Max job spool size */
+   int64_t burst_memory;              /* reserved in Maximum Burst Memory */
+   uint64_t writer_seq;               /* last block given to the block writer */
    char VolumeName[MAX_NAME_LENGTH];  /* Volume name */
    char pool_name[MAX_NAME_LENGTH];   /* pool name */
    char pool_type[MAX_NAME_LENGTH];   /* pool type */
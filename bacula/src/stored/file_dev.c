@@ -27,6 +27,7 @@
 
 #include "bacula.h"
 #include "stored.h"
+#include "dedup_store.h"
 
 static const int dbglvl = 100;
 
@@ -64,6 +65,50 @@ ssize_t DEVICE::d_write(int fd, const void *buffer, size_t count)
    return ::write(fd, buffer, count);
 }
 
+/*
+ * Write back the Volume data before pos and drop it from the
+ *  page cache, a backup or a restore does not read it again.
+ *  pos=0 is the whole file. Called with "Drop Volume Cache = yes".
+ */
+void drop_volume_cache(int fd, boffset_t pos, bool written)
+{
+   if (written) {
+#ifdef SYNC_FILE_RANGE_WRITE
+      sync_file_range(fd, 0, pos, SYNC_FILE_RANGE_WAIT_BEFORE |
+                      SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#elif defined(HAVE_FDATASYNC)
+      fdatasync(fd);                  /* dirty pages cannot be dropped */
+#endif
+   }
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+   posix_fadvise(fd, 0, pos, POSIX_FADV_DONTNEED);
+#endif
+}
+
+/*
+ * Count the bytes read or written by read() and write(), and
+ *  drop the cache of the Volume every VOLUME_CACHE_WINDOW bytes.
+ *  The blocks of the block writer are counted by its thread.
+ */
+void DEVICE::update_volume_cache(ssize_t len, bool written)
+{
+#ifndef HAVE_WIN32
+   boffset_t pos;
+
+   if (len <= 0 || !drop_cache() || !is_file()) {
+      return;
+   }
+   cache_bytes += len;
+   if (cache_bytes < VOLUME_CACHE_WINDOW) {
+      return;
+   }
+   cache_bytes = 0;
+   if ((pos = ::lseek(m_fd, 0, SEEK_CUR)) > 0) {
+      drop_volume_cache(m_fd, pos, written);
+   }
+#endif
+}
+
 /* Rewind file device */
 bool DEVICE::rewind(DCR *dcr)
 
@@ -120,6 +165,10 @@ bool DEVICE::reposition(DCR *dcr, uint64_t raddr)
 /* Seek to specified place */
 boffset_t DEVICE::lseek(DCR *dcr, boffset_t offset, int whence)
 {
+   /* The blocks are written at their place, only reads need them */
+   if (whence != SEEK_CUR) {
+      flush_block_writer(this);
+   }
 #if defined(HAVE_WIN32)
   return ::_lseeki64(m_fd, (__int64)offset, whence);
 #else
@@ -198,6 +247,12 @@ bool file_dev::open_device(DCR *dcr, int omode)
       dev_errno = 0;
       file = 0;
       file_addr = 0;
+      cache_bytes = 0;
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+      if (drop_cache()) {
+         posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      }
+#endif
 
       /* Refresh the underline device id */
       if (fstat(m_fd, &sp) == 0) {
@@ -236,6 +291,9 @@ bool DEVICE::truncate(DCR *dcr)
    }
 
    Dmsg2(100, "Truncate adata=%d fd=%d\n", dev->adata, dev->m_fd);
+   if (block_writer && !flush_block_writer(this)) {
+      clear_block_writer_error(this);     /* the Volume is emptied */
+   }
    if (ftruncate(dev->m_fd, 0) != 0) {
       berrno be;
       Mmsg2(errmsg, _("Unable to truncate device %s. ERR=%s\n"),
@@ -544,5 +602,66 @@ int file_dev::device_specific_init(JCR *jcr, DEVRES *device)
 {
    // Called by child to get the CAP_LSEEK
    capabilities |= CAP_LSEEK;
+   if (device->interleave_size > 0) {
+      Jmsg1(jcr, M_WARNING, 0, _("Interleave Size is ignored on device %s, "
+            "a restore can seek over the data of the other jobs.\n"), print_name());
+   }
+   if (device->dedup_dir && dev_type == B_FILE_DEV) {
+      POOL_MEM err(PM_MESSAGE);
+      dstore = get_dedup_store(device->dedup_dir, err.addr());
+      if (!dstore) {
+         Jmsg2(jcr, M_ERROR, 0, _("Unable to use Dedup Directory on device %s. %s"),
+               print_name(), err.c_str());
+         return -1;
+      }
+      /* The chunks are never reclaimed, the administrator must agree */
+      dedup_writes = device->dedup_no_reclaim;
+      if (!dedup_writes) {
+         Jmsg1(jcr, M_WARNING, 0, _("Dedup Directory on device %s is used only to read Volumes. "
+               "The chunks are never reclaimed, set AllowDedupWithoutReclaim = yes "
+               "to deduplicate the new data.\n"), print_name());
+      }
+   }
    return 0;
 }
+
+void file_dev::term(DCR *dcr)
+{
+   if (dstore) {
+      release_dedup_store(dstore);
+      dstore = NULL;
+   }
+   DEVICE::term(dcr);
+}
+
+/*
+ * With a Dedup Directory, the data records are replaced by the
+ *  references of their chunks before being written to the Volume.
+ */
+GetMsg *file_dev::get_msg_queue(JCR *jcr, BSOCK *sock, int32_t bufsize)
+{
+   if (dstore && dedup_writes) {
+      return new_dedup_msg_queue(jcr, sock, bufsize, dstore);
+   }
+   return DEVICE::get_msg_queue(jcr, sock, bufsize);
+}
+
+/* Called for each record to rehydrate, the interface is kept in the jcr */
+bool file_dev::setup_dedup_rehydration_interface(DCR *dcr)
+{
+   if (!dstore) {
+      return false;
+   }
+   if (!dcr->jcr->dedup) {
+      dcr->jcr->dedup = new_dedup_rehydration(dcr->jcr, dstore);
+   }
+   return true;
+}
+
+void file_dev::free_dedup_rehydration_interface(DCR *dcr)
+{
+   if (dstore && dcr->jcr->dedup) {
+      delete dcr->jcr->dedup;
+      dcr->jcr->dedup = NULL;
+   }
+}
@@ -23,16 +23,25 @@
 #ifndef __FILE_DEV_
 #define __FILE_DEV_
 
+class dedup_store;
+
 class file_dev : public DEVICE {
+   dedup_store *dstore;               /* set with the Dedup Directory directive */
 public:
 
-   file_dev() { };
+   bool dedup_writes;                 /* new data is deduplicated */
+   file_dev(): dstore(NULL), dedup_writes(false) { };
    ~file_dev() { m_fd = -1; };
    bool is_eod_valid(DCR *dcr);
    bool eod(DCR *dcr);
    bool open_device(DCR *dcr, int omode);
    const char *print_type();
    virtual int device_specific_init(JCR *jcr, DEVRES *device);
+   void term(DCR *dcr);
+   GetMsg *get_msg_queue(JCR *jcr, BSOCK *sock, int32_t bufsize);
+   bool setup_dedup_rehydration_interface(DCR *dcr);
+   void free_dedup_rehydration_interface(DCR *dcr);
+   void *dedup_get_dedupengine() { return dedup_writes ? dstore : NULL; };
 };
 
 #endif /* __FILE_DEV_ */
@@ -247,6 +247,14 @@ DEVICE *init_dev(JCR *jcr, DEVRES *device, bool adata, bstatcollect *statcollect
       goto bailout;
    }
 
+#ifndef HAVE_WIN32
+   /* Blocks written by a dedicated thread, only for plain disk Volumes */
+   if (device->write_queue_blocks > 0 && dev->dev_type == B_FILE_DEV &&
+       !adata && !cloning) {
+      init_block_writer(dev);
+   }
+#endif
+
    dev->register_metrics(statcollector);
 
    if (!cloning) {
@@ -598,6 +598,8 @@ static int match_voladdr(BSR *bsr, BSR_VOLADDR *voladdr, DEV_RECORD *rec, bool d
       voladdr->done = true;              /* set local done */
       if (!voladdr->next) {              /* done with everything? */
          bsr->done = true;               /*  yes  */
+      } else {
+         bsr->root->reposition = true;   /* we can skip to the next range */
       }
    }
    if (voladdr->next) {
@@ -703,12 +705,16 @@ static int match_findex(BSR *bsr, DEV_RECORD *rec, bool done)
    }
 }
 
+/*
+ * Get the address of the first part of the bsr still to be read,
+ *  the ranges already done are skipped
+ */
 uint64_t get_bsr_start_addr(BSR *bsr)
 {
    uint64_t bsr_addr = 0;
 
    if (bsr) {
-      if (bsr->voladdr) {
+      if (bsr->voladdr && !get_smallest_voladdr(bsr->voladdr, &bsr_addr)) {
          bsr_addr = bsr->voladdr->saddr;
       }
    }
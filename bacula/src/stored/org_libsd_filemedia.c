@@ -20,21 +20,140 @@
 #include "bacula.h"
 #include "stored.h"
 
+static const int dbglvl = 150;
+
+static char Create_filemedia[] = "CatReq JobId=%ld CreateFileMedia\n";
+static char OK_create_filemedia[] = "1000 OK CreateFileMedia\n";
+
+/*
+ * Send the queued FileMedia records to the Director. They are
+ *  flushed together with the JobMedia records so that the Director
+ *  socket is only used by the thread that writes the Volume.
+ */
 bool flush_filemedia_queue(JCR *jcr)
 {
+   FILEMEDIA_ITEM *fm;
+   BSOCK *dir = jcr->dir_bsock;
+
+   if (!jcr->filemedia_queue || jcr->filemedia_queue->size() == 0) {
+      return true;
+   }
+   Dmsg1(400, "=== Flush filemedia queue = %d\n", jcr->filemedia_queue->size());
+
+   dir->fsend(Create_filemedia, jcr->JobId);
+   foreach_dlist(fm, jcr->filemedia_queue) {
+      if (jcr->is_JobStatus(JS_Incomplete) &&
+          fm->FileIndex >= (uint32_t)dir->get_lastFileIndex()) {
+         continue;
+      }
+      dir->fsend("%lld %u %llu %u %llu\n", fm->VolMediaId, fm->FileIndex,
+                 fm->BlockAddr, fm->RecordNo, fm->FileOffset);
+   }
+   dir->signal(BNET_EOD);
+   jcr->filemedia_queue->destroy();
+
+   if (dir->recv() <= 0) {
+      Dmsg0(dbglvl, "create_filemedia error bnet_recv\n");
+      Jmsg(jcr, M_FATAL, 0, _("Error creating FileMedia records: ERR=%s\n"),
+           dir->bstrerror());
+      return false;
+   }
+   Dmsg1(210, "<dird %s", dir->msg);
+   if (strcmp(dir->msg, OK_create_filemedia) != 0) {
+      Dmsg1(dbglvl, "Bad response from Dir: %s\n", dir->msg);
+      Jmsg(jcr, M_FATAL, 0, _("Error creating FileMedia records: %s\n"), dir->msg);
+      return false;
+   }
    return true;
 }
 
+static void add_filemedia(DCR *dcr, DEV_BLOCK *block, DEV_RECORD *rec)
+{
+   FILEMEDIA_ITEM *fm = (FILEMEDIA_ITEM *)malloc(sizeof(FILEMEDIA_ITEM));
+   memset(fm, 0, sizeof(FILEMEDIA_ITEM));
+   fm->FileIndex = rec->FileIndex;
+   fm->RecordNo = block->RecNum;
+   fm->FileOffset = dcr->FileMedia_Off;
+   block->filemedia->append(fm);
+   dcr->index_size = 0;
+   Dmsg3(dbglvl, "Add FileMedia FI=%d RecNo=%u Off=%llu\n", fm->FileIndex,
+         fm->RecordNo, fm->FileOffset);
+}
+
+/*
+ * Called for each new record put into a block. Once the Device
+ *  MaximumFileIndex bytes have been written since the last index,
+ *  an index is added at the first record of the next file, this is
+ *  where the restore bsr can start to read a file (FileOffset=0).
+ *  A file that alone holds twice that amount is also indexed on
+ *  its data records, FileOffset is then the number of bytes of
+ *  data records of the file before the index. The block address
+ *  is not known yet, it is filled in by dir_create_filemedia_record()
+ *  when the block is written to the Volume.
+ */
 void create_filemedia(DCR *dcr, DEV_BLOCK *block, DEV_RECORD *rec)
 {
+   bool data = is_file_data_stream(rec->Stream);
+
+   if (dcr->max_index_size == 0 || rec->FileIndex <= 0 || block->adata) {
+      return;
+   }
+   if (rec->FileIndex != dcr->FileMedia_FI) {
+      dcr->FileMedia_FI = rec->FileIndex;
+      dcr->FileMedia_Off = 0;
+      if (dcr->index_size >= dcr->max_index_size) {
+         add_filemedia(dcr, block, rec);
+      }
+   } else if (data && dcr->FileMedia_Off > 0 &&
+              dcr->index_size >= 2 * dcr->max_index_size) {
+      add_filemedia(dcr, block, rec);
+   }
+   dcr->index_size += rec->data_len;
+   if (data) {
+      dcr->FileMedia_Off += rec->data_len;
+   }
 }
 
+/*
+ * The block is being written to the Volume, set the Volume address
+ *  of the FileMedia records attached to it and queue them for the
+ *  Director.
+ */
 bool dir_create_filemedia_record(DCR *dcr)
 {
    AskDirHandler *askdir_handler = get_askdir_handler();
    if (askdir_handler) {
       return askdir_handler->dir_create_filemedia_record(dcr);
    }
+
+   JCR *jcr = dcr->jcr;
+   DEV_BLOCK *block = dcr->block;
+   FILEMEDIA_ITEM *fm, *item;
+   uint64_t addr;
+
+   if (!block->filemedia || block->filemedia->size() == 0) {
+      return true;
+   }
+   if (!jcr->filemedia_queue || jcr->getJobType() == JT_SYSTEM) {
+      block->filemedia->destroy();
+      return true;
+   }
+   /* For a tape, block_num was already incremented */
+   addr = dcr->dev->get_full_addr();
+   if (dcr->dev->is_tape()) {
+      addr--;
+   }
+   foreach_alist(fm, block->filemedia) {
+      item = (FILEMEDIA_ITEM *)malloc(sizeof(FILEMEDIA_ITEM));
+      memcpy(item, fm, sizeof(FILEMEDIA_ITEM));
+      item->BlockAddr = addr;
+      item->VolMediaId = dcr->VolMediaId;
+      jcr->filemedia_queue->append(item);
+   }
+   block->filemedia->destroy();
+   /* Flush at queue size of 1000 filemedia records */
+   if (jcr->filemedia_queue->size() >= 1000) {
+      return flush_filemedia_queue(jcr);
+   }
    return true;
 }
-
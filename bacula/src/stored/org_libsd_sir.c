@@ -17,12 +17,42 @@
    Bacula(R) is a registered trademark of Kern Sibbald.
 */
 
+/*
+ * Single item restore
+ *
+ *  With per-file addressing in the bsr (VolAddr sections written from
+ *  the FileMedia records), the restore does not need to read the
+ *  Volume between two selected files. When a section is done, the
+ *  device is repositioned to the start of the next one: lseek() on
+ *  disk, fsf/fsr on tape (see DEVICE::reposition()).
+ *
+ *  A position can also be requested with set_interactive_reposition(),
+ *  the read loop stops at the end of the current record and the seek
+ *  is done by sir_init_loop() before the next block is read.
+ *
+ *  The bytes skipped and read are counted in the DCR and reported at
+ *  the end of read_records().
+ */
+
 #include "bacula.h"
 #include "stored.h"
 
+static const int dbglvl = 150;
+
+/*
+ * Called at the start of read_records()
+ *   Returns: true if a position was requested, the read loop
+ *            will do it instead of position_to_first_file()
+ */
 bool sir_init(DCR *dcr)
 {
-   return false;
+   dcr->reposition_count = 0;
+   dcr->skipped_bytes = 0;
+   dcr->read_bytes = 0;
+   if (dcr->jcr->interactive_session) {
+      dcr->set_session_interactive();
+   }
+   return dcr->need_to_reposition();
 }
 
 /* Return: SIR_OK       nothing to do
@@ -34,23 +64,109 @@ int sir_init_loop(DCR *dcr,
                   bool record_cb(DCR *dcr, DEV_RECORD *rec),
                   bool mount_cb(DCR *dcr))
 {
-   return SIR_OK;
+   BSR *bsr;
+   uint64_t addr;
+   char ed1[50];
+
+   if (!dcr->need_to_reposition()) {
+      return SIR_OK;
+   }
+   bsr = dcr->clear_interactive_reposition();
+   if (!bsr) {
+      return SIR_OK;
+   }
+   if (bsr->volume && strcmp(bsr->volume->VolumeName, (*dev)->VolHdr.VolumeName) != 0) {
+      Jmsg(dcr->jcr, M_WARNING, 0, _("Cannot reposition to Volume \"%s\", Volume \"%s\" is mounted.\n"),
+           bsr->volume->VolumeName, (*dev)->VolHdr.VolumeName);
+      return SIR_OK;
+   }
+   addr = get_bsr_start_addr(bsr);
+   Dmsg2(dbglvl, "Interactive reposition on %s to %s\n", (*dev)->print_name(),
+         (*dev)->print_addr(ed1, sizeof(ed1), addr));
+   (*dev)->clear_eot();
+   if (!sir_reposition(dcr, addr, true)) {
+      Jmsg(dcr->jcr, M_ERROR, 0, _("Unable to reposition %s. ERR=%s"),
+           (*dev)->print_name(), (*dev)->bstrerror());
+      return SIR_BREAK;
+   }
+   return SIR_CONTINUE;
+}
+
+/*
+ * Move forward on the Volume and count the bytes we did not read.
+ *  A position behind the current one is refused unless backward
+ *  is set (interactive requests).
+ *
+ *   Returns: true if the device was repositioned
+ */
+bool sir_reposition(DCR *dcr, uint64_t addr, bool backward)
+{
+   DEVICE *dev = dcr->dev;
+   uint64_t dev_addr = dev->get_full_addr();
+
+   if (dev_addr > addr && !backward) {
+      return false;
+   }
+   if (!dev->reposition(dcr, addr)) {
+      return false;
+   }
+   dcr->reposition_count++;
+   /* Tape addresses are file:block, only disk addresses are bytes */
+   if (!dev->is_tape() && addr > dev_addr) {
+      dcr->skipped_bytes += addr - dev_addr;
+   }
+   Tpt3(DT_VOLUME|50, "reposition from=%lld to=%lld count=%lld\n",
+        dev_addr, addr, dcr->reposition_count);
+   return true;
+}
+
+/* Called at the end of read_records() */
+void sir_term(DCR *dcr)
+{
+   char ed1[50], ed2[50];
+
+   if (dcr->reposition_count == 0) {
+      return;
+   }
+   if (dcr->dev->is_tape()) {
+      Jmsg(dcr->jcr, M_INFO, 0, _("Repositioned %d times on %s, read %s bytes.\n"),
+           dcr->reposition_count, dcr->dev->print_name(),
+           edit_uint64_with_commas(dcr->read_bytes, ed1));
+   } else {
+      Jmsg(dcr->jcr, M_INFO, 0, _("Repositioned %d times on %s, skipped %s bytes, read %s bytes.\n"),
+           dcr->reposition_count, dcr->dev->print_name(),
+           edit_uint64_with_commas(dcr->skipped_bytes, ed1),
+           edit_uint64_with_commas(dcr->read_bytes, ed2));
+   }
 }
 
 bool DCR::need_to_reposition()
 {
-   return false;
+   return do_interactive_reposition;
 }
 
-void DCR::set_interactive_reposition(BSR *)
+/* Ask the read loop to go to the start of this bsr, may be called by another thread */
+void DCR::set_interactive_reposition(BSR *bsr)
 {
+   jcr->lock();
+   dest_position = bsr;
+   do_interactive_reposition = (bsr != NULL);
+   jcr->unlock();
 }
 
 BSR *DCR::clear_interactive_reposition()
 {
-   return NULL;
+   BSR *bsr;
+
+   jcr->lock();
+   bsr = dest_position;
+   dest_position = NULL;
+   do_interactive_reposition = false;
+   jcr->unlock();
+   return bsr;
 }
 
 void DCR::set_session_interactive()
 {
+   session_interactive = true;
 }
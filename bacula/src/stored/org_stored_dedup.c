@@ -20,14 +20,35 @@
 #include "bacula.h"
 #include "stored.h"
 
+/*
+ * File devices with a Dedup Directory deduplicate the data streams
+ *  themselves, the File daemon sends the data as usual.
+ */
 bool is_dedup_server_side(DEVICE *dev, int32_t stream, uint64_t stream_len)
 {
-   return false;
+   if (!dev->dedup_get_dedupengine() || dev->is_dedup()) {
+      return false;
+   }
+   if (stream & STREAM_BIT_DEDUPLICATION_DATA) {
+      return false;                   /* already references */
+   }
+   switch (stream & STREAMMASK_TYPE) {
+   case STREAM_FILE_DATA:
+   case STREAM_SPARSE_DATA:
+   case STREAM_WIN32_DATA:
+      return true;
+   default:
+      return false;
+   }
 }
 
+/*
+ * A small reference record must not be split across blocks,
+ *  the big ones are reassembled before the rehydration anyway.
+ */
 bool is_dedup_ref(DEV_RECORD *rec, bool lazy)
 {
-   return false;
+   return (rec->Stream & STREAM_BIT_DEDUPLICATION_DATA) && rec->data_len < 4096;
 }
 
 
@@ -133,6 +133,15 @@ void    reread_last_block(DCR *dcr);
 
 bool is_pool_size_reached(DCR *dcr, bool quiet);
 
+/* From block_writer.c */
+bool    init_block_writer(DEVICE *dev);
+void    term_block_writer(DEVICE *dev);
+bool    block_writer_can_queue(DCR *dcr, uint32_t wlen);
+ssize_t block_writer_submit(DCR *dcr, DEV_BLOCK *block, uint32_t wlen);
+bool    flush_block_writer(DEVICE *dev);
+int     clear_block_writer_error(DEVICE *dev);
+int     block_writer_status(DEVICE *dev, POOL_MEM &msg);
+
 /* From butil.c -- utilities for SD tool programs */
 void    setup_me();
 void    print_ls_output(const char *fname, const char *link, int type, struct stat *statp);
@@ -173,6 +182,9 @@ void     do_fd_commands(JCR *jcr);
 bool     do_handle_command(JCR *jcr);
 void     do_client_commands(JCR *jcr);
 
+/* From file_dev.c */
+void     drop_volume_cache(int fd, boffset_t pos, bool written);
+
 /* From job.c */
 void     stored_free_jcr(JCR *jcr);
 
@@ -341,6 +353,8 @@ int sir_init_loop(DCR *dcr,
                   bool mount_cb(DCR *dcr));
 
 bool sir_init(DCR *dcr);
+bool sir_reposition(DCR *dcr, uint64_t addr, bool backward);
+void sir_term(DCR *dcr);
 
 /* from BEE */
 #if BEEF
@@ -155,10 +155,10 @@ static bool read_record_cb(DCR *dcr, DEV_RECORD *rec)
       }
       Dmsg2(DT_DEDUP|640, "stream 0x%x is_rehydration_srvside=%d\n", rec->Stream, jcr->dedup->is_rehydration_srvside());
       if (jcr->dedup->is_rehydration_srvside()) {
-         wbuf = jcr->dedup->get_msgbuf();
          bool despite_of_error = forge_on;
          int size;
-         int err = jcr->dedup->record_rehydration(dcr, rec, wbuf, jcr->errmsg, despite_of_error, &size);
+         int err = jcr->dedup->record_rehydration(dcr, rec, jcr->dedup->get_msgbuf(), jcr->errmsg, despite_of_error, &size);
+         wbuf = jcr->dedup->get_msgbuf();   /* can be reallocated by the call */
          if (err) {
             /* cannot read data from DDE */
             if (!despite_of_error) {
@@ -279,10 +279,10 @@ static bool mac_record_cb(DCR *dcr, DEV_RECORD *rec)
       }
       Dmsg2(DT_DEDUP|640, "stream 0x%x is_rehydration_srvside=%d\n", rec->Stream, jcr->dedup->is_rehydration_srvside());
       if (jcr->dedup->is_rehydration_srvside()) {
-         wbuf = jcr->dedup->get_msgbuf();
          bool despite_of_error = false; /* the destination SD will check the data, don't try to cheat */
          int size;
-         int err = jcr->dedup->record_rehydration(dcr, rec, wbuf, jcr->errmsg, despite_of_error, &size);
+         int err = jcr->dedup->record_rehydration(dcr, rec, jcr->dedup->get_msgbuf(), jcr->errmsg, despite_of_error, &size);
+         wbuf = jcr->dedup->get_msgbuf();   /* can be reallocated by the call */
          if (err < 0) {
             /* cannot read data from DSE */
             Jmsg1(jcr, M_FATAL, 0, "%s", jcr->errmsg);
@@ -183,7 +183,8 @@ bool read_records(DCR *dcr,
                break;
             }
          }
-             Dmsg1(dbglvl, "Read new block at pos=%s\n", dev->print_addr(ed1, sizeof(ed1)));
+         dcr->read_bytes += block->read_len;
+         Dmsg1(dbglvl, "Read new block at pos=%s\n", dev->print_addr(ed1, sizeof(ed1)));
       }
       first_block = false;
 #ifdef if_and_when_FAST_BLOCK_REJECTION_is_working
@@ -393,6 +394,7 @@ bool read_records(DCR *dcr,
    }
    delete recs;
    print_block_read_errors(jcr, block);
+   sir_term(dcr);
    return ok;
 }
 
@@ -437,7 +439,7 @@ static bool try_repositioning(JCR *jcr, DEV_RECORD *rec, DCR *dcr)
       }
       Dmsg2(dbglvl, "Try_Reposition from addr=%llu to %llu\n",
             dev_addr, bsr_addr);
-      dev->reposition(dcr, bsr_addr);
+      sir_reposition(dcr, bsr_addr, false);
       rec->Addr = 0;
       return true;              /* We want the next block */
    }
@@ -469,7 +471,7 @@ BSR *position_to_first_file(JCR *jcr, DCR *dcr, BSR *bsr)
          Dmsg2(dbglvl, "pos_to_first_file from addr=%s to %s\n",
                dev->print_addr(ed1, sizeof(ed1)),
                dev->print_addr(ed2, sizeof(ed2), bsr_addr));
-         dev->reposition(dcr, bsr_addr);
+         sir_reposition(dcr, bsr_addr, true);
       }
    }
    Leave(150);
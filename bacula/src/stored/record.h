@@ -84,6 +84,7 @@ enum rec_state {
 #define REC_ISTAPE           (1<<5)   /* Set if device is tape */
 #define REC_ADATA_EMPTY      (1<<6)   /* Not enough adata in block */
 #define REC_NO_SPLIT         (1<<7)   /* Do not split this record */
+#define REC_ADATA_CLONE      (1<<8)   /* Data not read, at clone_addr in clone_fd */
 
 #define is_partial_record(r) ((r)->state_bits & REC_PARTIAL_RECORD)
 #define is_block_marked_empty(r) ((r)->state_bits & (REC_BLOCK_EMPTY|REC_ADATA_EMPTY))
@@ -131,6 +132,8 @@ struct DEV_RECORD {
    uint32_t last_VolSessionId;        /* used in sequencing FI for Vbackup */
    uint32_t last_VolSessionTime;
    int32_t  last_FileIndex;
+   int      clone_fd;                 /* aligned data file of the read Volume */
+   uint64_t clone_addr;               /* address of the data in clone_fd */
 };
 
 
@@ -137,6 +137,8 @@ const char *stream_to_ascii(char *buf, int stream, int fi)
          return "contSHA256";
       case STREAM_SHA512_DIGEST:
          return "contSHA512";
+      case STREAM_XXH64_DIGEST:
+         return "contXXH64";
       case STREAM_SIGNED_DIGEST:
          return "contSIGNED-DIGEST";
       case STREAM_ENCRYPTED_SESSION_DATA:
@@ -217,6 +219,8 @@ const char *stream_to_ascii(char *buf, int stream, int fi)
       return "SHA256";
    case STREAM_SHA512_DIGEST:
       return "SHA512";
+   case STREAM_XXH64_DIGEST:
+      return "XXH64";
    case STREAM_SIGNED_DIGEST:
       return "SIGNED-DIGEST";
    case STREAM_ENCRYPTED_SESSION_DATA:
@@ -26,10 +26,18 @@
 #include "bacula.h"
 #include "stored.h"
 
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+
 /* Forward referenced subroutines */
 static void make_unique_data_spool_filename(DCR *dcr, POOLMEM **name);
 static bool open_data_spool_file(DCR *dcr);
 static bool close_data_spool_file(DCR *dcr);
+#ifdef HAVE_MEMFD_CREATE
+static bool reserve_burst_memory(DCR *dcr);
+#endif
+static void release_burst_memory(DCR *dcr);
 static bool despool_data(DCR *dcr, bool commit);
 static int  read_block_from_spool_file(DCR *dcr);
 static bool open_attr_spool_file(JCR *jcr, BSOCK *bs);
@@ -48,6 +56,7 @@ struct spool_stats_t {
    int64_t max_attr_size;
    int64_t data_size;                 /* current data size (all jobs running) */
    int64_t attr_size;
+   int64_t burst_memory;              /* reserved by the jobs writing in bursts */
 };
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -84,6 +93,13 @@ void list_spool_stats(void sendit(const char *msg, int len, void *sarg), void *a
 
       sendit(msg.c_str(), len, arg);
    }
+   if (spool_stats.burst_memory) {
+      len = Mmsg(msg, _("Burst memory: %s bytes reserved, %s max bytes.\n"),
+         edit_uint64_with_commas(spool_stats.burst_memory, ed1),
+         edit_uint64_with_commas(me->max_burst_memory, ed2));
+
+      sendit(msg.c_str(), len, arg);
+   }
    if (spool_stats.attr_jobs || spool_stats.max_attr_size) {
       len = Mmsg(msg, _("Attr spooling: %u active jobs, %s bytes; %u total jobs, %s max bytes.\n"),
          spool_stats.attr_jobs, edit_uint64_with_commas(spool_stats.attr_size, ed1),
@@ -94,19 +110,65 @@ void list_spool_stats(void sendit(const char *msg, int len, void *sarg), void *a
    }
 }
 
+/*
+ * When the Device has an Interleave Size and can be shared by
+ *  several jobs, the data of a job that is not spooled is spooled
+ *  anyway, and written to the Volume each time Interleave Size
+ *  bytes are in the spool file. The records of the concurrent
+ *  jobs are then in large contiguous extents, with one JobMedia
+ *  record per extent, and the restore of one job does not need to
+ *  read the blocks of the others. A File device is not concerned,
+ *  the restore seeks over the blocks of the other jobs, and the
+ *  spool file would only write all the data twice on the disks.
+ *
+ * When the Device has a Burst Size, the data of a job that is not
+ *  spooled is kept in memory, and written each time Burst Size
+ *  bytes are there. A tape drive gets the data at its own speed
+ *  and keeps streaming when the clients send slowly. The jobs of
+ *  all the Devices share Maximum Burst Memory, when it is used the
+ *  bursts of a new job are kept in a spool file.
+ */
 bool begin_data_spool(DCR *dcr)
 {
    bool stat = true;
+   char ec1[50];
+   int64_t interleave_size = dcr->dev->device->interleave_size;
+   int64_t burst_size = dcr->dev->device->burst_size;
+
    if (dcr->dev->is_aligned() || dcr->dev->is_dedup()) {
       dcr->jcr->spool_data = false;
+
+   } else if (!dcr->jcr->spool_data) {
+      if (interleave_size > 0 && dcr->dev->device->max_concurrent_jobs != 1 &&
+          !dcr->dev->is_file()) {
+         dcr->interleaving = true;
+         if (dcr->max_job_spool_size == 0 || dcr->max_job_spool_size > interleave_size) {
+            dcr->max_job_spool_size = interleave_size;
+         }
+      }
+      if (burst_size > 0) {
+         dcr->burst = true;
+         if (dcr->max_job_spool_size == 0 || dcr->max_job_spool_size > burst_size) {
+            dcr->max_job_spool_size = burst_size;
+         }
+      }
    }
-   if (dcr->jcr->spool_data) {
-      Dmsg0(100, "Turning on data spooling\n");
+   if (dcr->jcr->spool_data || dcr->interleaving || dcr->burst) {
+      Dmsg2(100, "Turning on data spooling interleaving=%d burst=%d\n",
+            dcr->interleaving, dcr->burst);
       dcr->spool_data = true;
       stat = open_data_spool_file(dcr);
       if (stat) {
          dcr->spooling = true;
-         Jmsg(dcr->jcr, M_INFO, 0, _("Spooling data ...\n"));
+         if (dcr->interleaving) {
+            Jmsg(dcr->jcr, M_INFO, 0, _("Writing data in extents of %s bytes ...\n"),
+                 edit_uint64_with_suffix(dcr->max_job_spool_size, ec1));
+         } else if (dcr->burst) {
+            Jmsg(dcr->jcr, M_INFO, 0, _("Writing data in bursts of %s bytes ...\n"),
+                 edit_uint64_with_suffix(dcr->max_job_spool_size, ec1));
+         } else {
+            Jmsg(dcr->jcr, M_INFO, 0, _("Spooling data ...\n"));
+         }
          P(mutex);
          spool_stats.data_jobs++;
          V(mutex);
@@ -160,6 +222,21 @@ static bool open_data_spool_file(DCR *dcr)
    int spool_fd;
 
    make_unique_data_spool_filename(dcr, &name);
+#ifdef HAVE_MEMFD_CREATE
+   /* The bursts are kept in memory, the memory is freed by ftruncate() */
+   if (dcr->burst && reserve_burst_memory(dcr)) {
+      if ((spool_fd = memfd_create(last_path_separator(name) + 1, MFD_CLOEXEC)) >= 0) {
+         dcr->spool_fd = spool_fd;
+         dcr->jcr->spool_attributes = true;
+         Dmsg1(100, "Created memory spool file: %s\n", name);
+         free_pool_memory(name);
+         return true;
+      }
+      berrno be;
+      Dmsg1(100, "memfd_create() failed, using a spool file. ERR=%s\n", be.bstrerror());
+      release_burst_memory(dcr);
+   }
+#endif
    if ((spool_fd = open(name, O_CREAT|O_TRUNC|O_RDWR|O_BINARY|O_CLOEXEC, 0640)) >= 0) {
       dcr->spool_fd = spool_fd;
       dcr->jcr->spool_attributes = true;
@@ -175,6 +252,45 @@ static bool open_data_spool_file(DCR *dcr)
    return true;
 }
 
+#ifdef HAVE_MEMFD_CREATE
+/*
+ * Reserve the memory of the bursts of the job in Maximum Burst
+ *  Memory. The memory spool file holds at most one block more.
+ *
+ * Returns: true if the bursts can be kept in memory
+ */
+static bool reserve_burst_memory(DCR *dcr)
+{
+   char ed1[50];
+   bool ok;
+
+   P(mutex);
+   ok = spool_stats.burst_memory + dcr->max_job_spool_size <= me->max_burst_memory;
+   if (ok) {
+      spool_stats.burst_memory += dcr->max_job_spool_size;
+      dcr->burst_memory = dcr->max_job_spool_size;
+   }
+   V(mutex);
+   if (!ok) {
+      Jmsg(dcr->jcr, M_INFO, 0, _("Maximum Burst Memory of %s bytes is used, the bursts are kept in a spool file.\n"),
+           edit_uint64_with_commas(me->max_burst_memory, ed1));
+   }
+   return ok;
+}
+#endif
+
+/* Give back the memory reserved for the bursts of the job */
+static void release_burst_memory(DCR *dcr)
+{
+   if (dcr->burst_memory == 0) {
+      return;
+   }
+   P(mutex);
+   spool_stats.burst_memory -= dcr->burst_memory;
+   V(mutex);
+   dcr->burst_memory = 0;
+}
+
 static const char *spool_name = "*spool*";
 
 /*
@@ -206,6 +322,10 @@ static bool despool_data(DCR *dcr, bool commit)
          jcr->dcr->VolumeName,
          edit_uint64_with_commas(jcr->dcr->job_spool_size, ec1));
       jcr->setJobStatus(JS_DataCommitting);
+   } else if (dcr->interleaving || dcr->burst) {
+      Dmsg1(100, "Writing extent of %s bytes\n",
+         edit_uint64_with_commas(jcr->dcr->job_spool_size, ec1));
+      jcr->setJobStatus(JS_DataDespooling);
    } else {
       Jmsg(jcr, M_INFO, 0, _("Writing spooled data to Volume. Despooling %s bytes ...\n"),
          edit_uint64_with_commas(jcr->dcr->job_spool_size, ec1));
@@ -250,6 +370,7 @@ static bool despool_data(DCR *dcr, bool commit)
 
    /* Add run time, to get current wait time */
    int32_t despool_start = time(NULL) - jcr->run_time;
+   btime_t burst_start = get_current_btime();
 
    set_new_file_parameters(dcr);
 
@@ -298,9 +419,21 @@ static bool despool_data(DCR *dcr, bool commit)
       despool_elapsed = 1;
    }
 
-   Jmsg(jcr, M_INFO, 0, _("Despooling elapsed time = %02d:%02d:%02d, Transfer rate = %s Bytes/second\n"),
-         despool_elapsed / 3600, despool_elapsed % 3600 / 60, despool_elapsed % 60,
-         edit_uint64_with_suffix(jcr->dcr->job_spool_size / despool_elapsed, ec1));
+   /* Speed of the device when it gets the data at once */
+   if (dcr->burst) {
+      btime_t burst_elapsed = get_current_btime() - burst_start;
+      dcr->dev->burst_count++;
+      if (burst_elapsed > 0) {
+         dcr->dev->burst_rate = (uint64_t)(dcr->job_spool_size * 1000000.0 / burst_elapsed);
+      }
+   }
+
+   /* One extent is one despool, do not fill the job log with them */
+   if (commit || !(dcr->interleaving || dcr->burst)) {
+      Jmsg(jcr, M_INFO, 0, _("Despooling elapsed time = %02d:%02d:%02d, Transfer rate = %s Bytes/second\n"),
+            despool_elapsed / 3600, despool_elapsed % 3600 / 60, despool_elapsed % 60,
+            edit_uint64_with_suffix(jcr->dcr->job_spool_size / despool_elapsed, ec1));
+   }
 
    dcr->block = block;                /* reset block */
 
@@ -456,7 +589,11 @@ bool write_block_to_spool_file(DCR *dcr)
    V(mutex);
    if (despool) {
       char ec1[30], ec2[30];
-      if (dcr->max_job_spool_size > 0) {
+      if (dcr->interleaving || dcr->burst) {
+         Dmsg2(100, "Extent size reached: JobSpoolSize=%s MaxJobSpoolSize=%s\n",
+            edit_uint64_with_commas(dcr->job_spool_size, ec1),
+            edit_uint64_with_commas(dcr->max_job_spool_size, ec2));
+      } else if (dcr->max_job_spool_size > 0) {
          Jmsg(dcr->jcr, M_INFO, 0, _("User specified Job spool size reached: "
             "JobSpoolSize=%s MaxJobSpoolSize=%s\n"),
             edit_uint64_with_commas(dcr->job_spool_size, ec1),
@@ -477,7 +614,9 @@ bool write_block_to_spool_file(DCR *dcr)
       dcr->job_spool_size += hlen + wlen;
       dcr->dev->spool_size += hlen + wlen;
       V(dcr->dev->spool_mutex);
-      Jmsg(dcr->jcr, M_INFO, 0, _("Spooling data again ...\n"));
+      if (!(dcr->interleaving || dcr->burst)) {
+         Jmsg(dcr->jcr, M_INFO, 0, _("Spooling data again ...\n"));
+      }
    }
 
    if (!write_spool_block(dcr)) {
@@ -639,6 +778,7 @@ static bool close_data_spool_file(DCR *dcr)
    close(dcr->spool_fd);
    dcr->spool_fd = -1;
    dcr->spooling = false;
+   release_burst_memory(dcr);
    unlink(name);
    Dmsg1(100, "Deleted spool file: %s\n", name);
    free_pool_memory(name);
@@ -28,6 +28,7 @@
 #include "stored.h"
 #include "lib/status.h"
 #include "sd_plugins.h"
+#include "dedup_store.h"
 
 /* Imported functions */
 extern void dbg_print_plugin(FILE *fp);
@@ -308,9 +309,27 @@ static void api_list_one_device(char *name, DEVICE *dev, STATUS_PKT *sp)
 }
 
 
+/*
+ * Device throughput and latency of the read() or write() calls
+ */
+static int dev_io_status(POOL_MEM &msg, const char *what, uint64_t ops,
+                         uint64_t bytes, btime_t usec, btime_t max_usec)
+{
+   char b1[50], b2[50], b3[50], b4[50], b5[50];
+   uint64_t rate = usec > 0 ? (uint64_t)(bytes * 1000000.0 / usec) : 0;
+
+   return Mmsg(msg, _("    %s=%s Bytes=%s Speed=%sB/s Latency avg=%sus max=%sus\n"),
+               what, edit_uint64_with_commas(ops, b1),
+               edit_uint64_with_commas(bytes, b2),
+               edit_uint64_with_suffix(rate, b3),
+               edit_uint64_with_commas(usec / ops, b4),
+               edit_uint64_with_commas(max_usec, b5));
+}
+
+
 static void list_one_device(char *name, DEVICE *dev, STATUS_PKT *sp)
 {
-   char b1[35], b2[35], b3[35];
+   char b1[35], b2[35], b3[35], b4[35];
    POOL_MEM msg(PM_MESSAGE);
    int len;
    int bpb;
@@ -382,6 +401,27 @@ static void list_one_device(char *name, DEVICE *dev, STATUS_PKT *sp)
                  dev->print_full_type(), dev->print_name());
       sendit(msg, len, sp);
    }
+   if (dev->DevWriteOps > 0) {
+      len = dev_io_status(msg, _("Writes"), dev->DevWriteOps, dev->DevWriteBytes,
+                          dev->DevWriteTime, dev->DevWriteMaxTime);
+      sendit(msg, len, sp);
+   }
+   if (dev->DevReadOps > 0) {
+      len = dev_io_status(msg, _("Reads"), dev->DevReadOps, dev->DevReadBytes,
+                          dev->DevReadTime, dev->DevReadMaxTime);
+      sendit(msg, len, sp);
+   }
+   if ((len = block_writer_status(dev, msg)) > 0) {
+      sendit(msg, len, sp);
+   }
+   if (dev->device->burst_size > 0) {
+      len = Mmsg(msg, _("    Burst buffer: Size=%s Buffered=%s Bursts=%s Speed=%sB/s\n"),
+                 edit_uint64_with_suffix(dev->device->burst_size, b1),
+                 edit_uint64_with_suffix(dev->spool_size, b2),
+                 edit_uint64_with_commas(dev->burst_count, b3),
+                 edit_uint64_with_suffix(dev->burst_rate, b4));
+      sendit(msg, len, sp);
+   }
    send_blocked_status(dev, sp);
 
    /* TODO: We need to check with Mount command, maybe we can
@@ -403,6 +443,11 @@ static void list_one_device(char *name, DEVICE *dev, STATUS_PKT *sp)
       sendit(msg, len, sp);
    }
 
+   if (dev->dedup_get_dedupengine() && !dev->is_dedup()) {
+      len = ((dedup_store *)dev->dedup_get_dedupengine())->get_status(msg);
+      sendit(msg, len, sp);
+   }
+
    dev->show_tape_alerts((DCR *)sp, list_short, list_all, status_alert_callback);
 
    if (!sp->api) sendit("==\n", 4, sp);
@@ -614,6 +659,9 @@ static void list_status_header(STATUS_PKT *sp)
       ((rblist *)res_head[R_DEVICE-r_first]->res_list)->size(),
       ((rblist *)res_head[R_AUTOCHANGER-r_first]->res_list)->size());
    sendit(msg, len, sp);
+   if ((len = async_trace_status(msg)) > 0) {
+      sendit(msg, len, sp);
+   }
    list_plugins(sp);
 }
 
@@ -718,7 +766,7 @@ void send_device_status(DEVICE *dev, STATUS_PKT *sp)
    if (chk_dbglvl(5)) {
       len = Mmsg(msg, _("Configured device capabilities:\n"));
       sendit(msg, len, sp);
-      len = Mmsg(msg, "   %sEOF %sBSR %sBSF %sFSR %sFSF %sEOM %sREM %sRACCESS %sAUTOMOUNT %sLABEL %sANONVOLS %sALWAYSOPEN %sSYNCONCLOSE\n",
+      len = Mmsg(msg, "   %sEOF %sBSR %sBSF %sFSR %sFSF %sEOM %sREM %sRACCESS %sAUTOMOUNT %sLABEL %sANONVOLS %sALWAYSOPEN %sSYNCONCLOSE %sDROPCACHE\n",
          dev->capabilities & CAP_EOF ? "" : "!",
          dev->capabilities & CAP_BSR ? "" : "!",
          dev->capabilities & CAP_BSF ? "" : "!",
@@ -731,7 +779,8 @@ void send_device_status(DEVICE *dev, STATUS_PKT *sp)
          dev->capabilities & CAP_LABEL ? "" : "!",
          dev->capabilities & CAP_ANONVOLS ? "" : "!",
          dev->capabilities & CAP_ALWAYSOPEN ? "" : "!",
-         dev->capabilities & CAP_SYNCONCLOSE ? "" : "!");
+         dev->capabilities & CAP_SYNCONCLOSE ? "" : "!",
+         dev->capabilities & CAP_DROPCACHE ? "" : "!");
       sendit(msg, len, sp);
    }
 
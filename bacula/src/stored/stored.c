@@ -744,6 +744,7 @@ void *device_initialization(void *arg)
       if (device->cap_bits & CAP_SYNCONCLOSE) {
          device->cap_bits &= ~CAP_SYNCONCLOSE; /* Not available on windows */
       }
+      device->cap_bits &= ~CAP_DROPCACHE;   /* Not available on windows */
 #endif
       /*
        * Note: be careful setting the slot here. If the drive
@@ -67,6 +67,7 @@ const int sd_dbglvl = 300;
 #include "block.h"
 #include "record.h"
 #include "dev.h"
+#include "block_writer.h"
 #include "stored_conf.h"
 #include "bsr.h"
 #include "jcr.h"
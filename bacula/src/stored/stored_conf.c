@@ -77,6 +77,7 @@ static RES_ITEM store_items[] = {
    {"MaximumConcurrentJobs", store_pint32, ITEM(res_store.max_concurrent_jobs), 0, ITEM_DEFAULT, 20},
    {"ClientConnectTimeout",  store_time, ITEM(res_store.ClientConnectTimeout), 0, ITEM_DEFAULT, 60 * 30},
    {"HeartbeatInterval",     store_time, ITEM(res_store.heartbeat_interval), 0, ITEM_DEFAULT, 5 * 60},
+   {"MaximumBurstMemory",    store_size64, ITEM(res_store.max_burst_memory), 0, ITEM_DEFAULT, 1024*1024*1024},
 #if BEEF
    {"FipsRequire",            store_bool, ITEM(res_store.require_fips), 0, 0, 0},
 #endif
@@ -177,13 +178,18 @@ static RES_ITEM dev_items[] = {
    {"MinimumAlignedSize",    store_size32, ITEM(res_dev.min_aligned_size), 0, ITEM_DEFAULT, 4096},
    {"MaximumVolumeSize",     store_size64, ITEM(res_dev.max_volume_size), 0, 0, 0},
    {"MaximumFileSize",       store_size64, ITEM(res_dev.max_file_size), 0, ITEM_DEFAULT, 1000000000},
-   {"MaximumFileIndex",      store_size64, ITEM(res_dev.max_file_index), 0, ITEM_DEFAULT, 100000000}, /* ***BEEF*** */
+   {"MaximumFileIndex",      store_size64, ITEM(res_dev.max_file_index), 0, ITEM_DEFAULT, 100000000},
    {"VolumeCapacity",        store_size64, ITEM(res_dev.volume_capacity), 0, 0, 0},
    {"MinimumFeeSpace",       store_size64, ITEM(res_dev.min_free_space), 0, ITEM_DEFAULT, 5000000},
    {"MaximumConcurrentJobs", store_pint32, ITEM(res_dev.max_concurrent_jobs), 0, 0, 0},
    {"SpoolDirectory",        store_dir,    ITEM(res_dev.spool_directory), 0, 0, 0},
+   {"DedupDirectory",        store_dir,    ITEM(res_dev.dedup_dir), 0, 0, 0},
+   {"AllowDedupWithoutReclaim", store_bool, ITEM(res_dev.dedup_no_reclaim), 0, ITEM_DEFAULT, false},
    {"MaximumSpoolSize",      store_size64, ITEM(res_dev.max_spool_size), 0, 0, 0},
    {"MaximumJobSpoolSize",   store_size64, ITEM(res_dev.max_job_spool_size), 0, 0, 0},
+   {"InterleaveSize",        store_size64, ITEM(res_dev.interleave_size), 0, 0, 0},
+   {"BurstSize",             store_size64, ITEM(res_dev.burst_size), 0, 0, 0},
+   {"WriteQueueBlocks",      store_pint32, ITEM(res_dev.write_queue_blocks), 0, 0, 0},
    {"DriveIndex",            store_pint32, ITEM(res_dev.drive_index), 0, 0, 0},
    {"MaximumPartSize",       store_size64, ITEM(res_dev.max_part_size), 0, ITEM_DEFAULT, 0},
    {"MountPoint",            store_strname,ITEM(res_dev.mount_point), 0, 0, 0},
@@ -197,6 +203,7 @@ static RES_ITEM dev_items[] = {
    {"Dedupengine",           store_res,    ITEM(res_dev.dedup), R_DEDUP, 0, 0},
 #endif
    {"SyncOnClose",           store_bit,    ITEM(res_dev.cap_bits), CAP_SYNCONCLOSE, ITEM_DEFAULT, 0},
+   {"DropVolumeCache",       store_bit,    ITEM(res_dev.cap_bits), CAP_DROPCACHE, ITEM_DEFAULT, 0},
    {NULL, NULL, {0}, 0, 0, 0}
 };
 
@@ -673,6 +680,10 @@ void dump_resource(int type, RES *rres, void sendit(const char *msg, int len, ST
       len = Mmsg(msg, "        max_spool_size=%lld max_job_spool_size=%lld\n",
          res->res_dev.max_spool_size, res->res_dev.max_job_spool_size);
       sendit(msg.c_str(), len, sp);
+      len = Mmsg(msg, "        interleave_size=%lld burst_size=%lld write_queue_blocks=%d\n",
+         res->res_dev.interleave_size, res->res_dev.burst_size,
+         res->res_dev.write_queue_blocks);
+      sendit(msg.c_str(), len, sp);
       if (res->res_dev.worm_command) {
          len = Mmsg(msg, "         worm command=%s\n", res->res_dev.worm_command);
          sendit(msg.c_str(), len, sp);
@@ -999,6 +1010,9 @@ void free_resource(RES *sres, int type)
       if (res->res_dev.spool_directory) {
          free(res->res_dev.spool_directory);
       }
+      if (res->res_dev.dedup_dir) {
+         free(res->res_dev.dedup_dir);
+      }
       if (res->res_dev.mount_point) {
          free(res->res_dev.mount_point);
       }
@@ -168,6 +168,7 @@ public:
    utime_t ClientConnectTimeout;      /* Max time to wait to connect client */
    utime_t heartbeat_interval;        /* Interval to send hb to FD */
    utime_t client_wait;               /* Time to wait for FD to connect */
+   int64_t max_burst_memory;          /* Memory of all the jobs writing in bursts */
    bool comm_compression;             /* Set to allow comm line compression */
    bool require_fips;                  /* Check for FIPS module */
    bool tls_authenticate;             /* Authenticate with TLS */
@@ -240,13 +241,18 @@ public:
    int64_t max_volume_files;          /* max files to put on one volume */
    int64_t max_volume_size;           /* max bytes to put on one volume */
    int64_t max_file_size;             /* max file size in bytes */
-   int64_t max_file_index;            /* max file size between two FileMedia in bytes */ /* ***BEEF*** */
+   int64_t max_file_index;            /* max data size between two FileMedia in bytes */
    int64_t volume_capacity;           /* advisory capacity */
    int64_t min_free_space;            /* Minimum disk free space */
    int64_t max_spool_size;            /* Max spool size for all jobs */
    int64_t max_job_spool_size;        /* Max spool size for any single job */
+   int64_t interleave_size;           /* Data of a job written in one piece */
+   int64_t burst_size;                /* Data of a job kept in memory before a write */
+   uint32_t write_queue_blocks;       /* Blocks given to the writer thread */
 
    int64_t max_part_size;             /* Max part size */
+   char *dedup_dir;                   /* Local deduplication store directory */
+   bool dedup_no_reclaim;             /* Deduplicate even if chunks are never reclaimed */
    char *mount_point;                 /* Mount point for require mount devices */
    char *mount_command;               /* Mount command */
    char *unmount_command;             /* Unmount command */
@@ -96,6 +96,12 @@ bool do_vbackup(JCR *jcr)
    }
    jcr->dcr->dev->start_of_job(jcr->dcr);
 
+   /* Aligned data can be cloned between Volumes of the same filesystem */
+   jcr->read_dcr->clone_adata = jcr->dcr->dev->can_clone_adata(jcr->read_dcr->dev);
+   if (jcr->read_dcr->clone_adata) {
+      Dmsg0(100, "Aligned data will be cloned\n");
+   }
+
    Dmsg2(200, "===== After acquire pos %u:%u\n", jcr->dcr->dev->file, jcr->dcr->dev->block_num);
    jcr->sendJobStatus(JS_Running);
 
@@ -162,6 +168,10 @@ ok_out:
       Jmsg(jcr, M_INFO, 0, _("Elapsed time=%02d:%02d:%02d, Transfer rate=%s Bytes/second\n"),
             job_elapsed / 3600, job_elapsed % 3600 / 60, job_elapsed % 60,
             edit_uint64_with_suffix(jcr->JobBytes / job_elapsed, ec1));
+      if (jcr->dcr->clone_bytes > 0) {
+         Jmsg(jcr, M_INFO, 0, _("Aligned data cloned from the read Volumes: %s bytes\n"),
+              edit_uint64_with_commas(jcr->dcr->clone_bytes, ec1));
+      }
 
       /* Release the device -- and send final Vol info to DIR */
       release_device(jcr->dcr);
@@ -256,9 +266,13 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
     * this option.
     */
 
-   /* Do rehydration if the write device doesn't support deduplication */
+   /* Do rehydration if the write device doesn't support deduplication,
+    *  references to a local dedup store are kept when both devices use it.
+    */
    if (jcr->dcr->device->dev_type != B_DEDUP_DEV &&
-       rec->Stream & STREAM_BIT_DEDUPLICATION_DATA) {
+       rec->Stream & STREAM_BIT_DEDUPLICATION_DATA &&
+       !(dev->dedup_get_dedupengine() &&
+         dev->dedup_get_dedupengine() == jcr->read_dcr->dev->dedup_get_dedupengine())) {
       if (!jcr->read_dcr->dev->setup_dedup_rehydration_interface(jcr->read_dcr)) {
          Jmsg0(jcr, M_FATAL, 0, _("Cannot do rehydration, device is not dedup aware\n"));
          goto bail_out;
@@ -59,6 +59,7 @@
  *   STREAM_SHA1_DIGEST
  *   STREAM_SHA256_DIGEST
  *   STREAM_SHA512_DIGEST
+ *   STREAM_XXH64_DIGEST
  */
 #define STREAM_NONE                         0    /* Reserved Non-Stream */
 #define STREAM_UNIX_ATTRIBUTES              1    /* Generic Unix attributes */
@@ -105,6 +106,7 @@
 #define STREAM_PLUGIN_META_BLOB                35    /* Plugin metadata (blob) for file being backed up */
 #define STREAM_PLUGIN_META_CATALOG             36    /* Plugin metadata (to be stored in catalog) for file being backed up */
 #define STREAM_UNIX_ATTRIBUTE_UPDATE           37    /* File's updated metadata */
+#define STREAM_XXH64_DIGEST                    38    /* XXH64 hash of the file (not cryptographic) */
 
 #define STREAM_ADATA_BLOCK_HEADER             200    /* Adata block header */
 #define STREAM_ADATA_RECORD_HEADER            201    /* Adata record header */
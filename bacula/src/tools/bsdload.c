@@ -0,0 +1,865 @@
+/*
+   Bacula(R) - The Network Backup Solution
+
+   Copyright (C) 2000-2022 Kern Sibbald
+
+   The original author of Bacula is Kern Sibbald, with contributions
+   from many others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   This notice must be preserved when any source code is
+   conveyed and/or propagated.
+
+   Bacula(R) is a registered trademark of Kern Sibbald.
+*/
+/*
+ *
+ *  Program to load a Storage daemon with synthetic backup jobs
+ *
+ *  bsdload plays both the Director and the File daemon of many
+ *   concurrent backup jobs. Each session connects to the SD as the
+ *   Director, reserves the Device and starts a Job, then connects
+ *   again as the File daemon and sends files generated from memory
+ *   with the normal FD->SD protocol (see filed/backup.c). The
+ *   catalog requests of the SD are answered from a small in-memory
+ *   Volume list, no Director or catalog is needed.
+ *
+ *  The SD configuration must have a Director resource with the name
+ *   and the password given on the command line, and a Device that
+ *   can label its Volumes (LabelMedia = yes).
+ *
+ *  Example:
+ *   bsdload -a localhost -D mydir-dir -P secret -N FileStorage \
+ *           -m File -c 100 -j 5 -f 1000 -s 1M
+ *   runs 100 sessions of 5 jobs of 1000 files of 1MB each.
+ *
+ */
+
+#include "bacula.h"
+#include "findlib/find.h"
+
+/* Same as the Director, see dird/authenticate.c */
+#define LOAD_DIR_VERSION 10002
+
+/* Commands sent to the Storage daemon as the Director */
+static char hello_dir[] = "Hello SD: Bacula Director %s calling %d tlspsk=%d\n";
+static char jobcmd[] = "JobId=%s job=%s job_name=%s client_name=%s "
+   "type=%d level=%d FileSet=%s NoAttr=%d SpoolAttr=%d FileSetMD5=%s "
+   "SpoolData=%d WritePartAfterJob=%d PreferMountedVols=%d SpoolSize=%s "
+   "rerunning=%d VolSessionId=%d VolSessionTime=%d sd_client=%d "
+   "Authorization=%s\n";
+static char use_storage[] = "use storage=%s media_type=%s pool_name=%s "
+   "pool_type=%s append=%d copy=%d stripe=%d wait=%d\n";
+static char use_device[] = "use device=%s\n";
+
+/* Responses from the Storage daemon to the Director */
+static char OKjob[]      = "3000 OK Job SDid=%d SDtime=%d Authorization=%100s\n";
+static char OK_device[]  = "3000 OK use device device=%s\n";
+static char Job_end[]    =
+   "3099 Job %127s end JobStatus=%d JobFiles=%d JobBytes=%lld JobErrors=%u ErrMsg=%256s\n";
+
+/* Catalog requests of the Storage daemon, see dird/catreq.c */
+static char Find_media[] = "CatReq JobId=%ld FindMedia=%d pool_name=%127s media_type=%127s vol_type=%d create=%d\n";
+static char Get_Vol_Info[] = "CatReq JobId=%ld GetVolInfo VolName=%127s write=%d\n";
+static char Update_media[] = "CatReq JobId=%ld UpdateMedia VolName=%127s"
+   " VolJobs=%u VolFiles=%u VolBlocks=%u VolBytes=%lld VolABytes=%lld"
+   " VolHoleBytes=%lld VolHoles=%u VolMounts=%u"
+   " VolErrors=%u VolWrites=%lld MaxVolBytes=%lld EndTime=%lld VolStatus=%19s"
+   " Slot=%d relabel=%d InChanger=%d VolReadTime=%llu VolWriteTime=%llu"
+   " VolFirstWritten=%lld VolType=%u VolParts=%d VolCloudParts=%d"
+   " LastPartBytes=%lld Enabled=%d Recycle=%d\n";
+static char Create_jobmedia[] = "CatReq JobId=%ld CreateJobMedia\n";
+static char Create_filemedia[] = "CatReq JobId=%ld CreateFileMedia\n";
+
+/* Responses sent to the Storage daemon */
+static char OK_media[] = "1000 OK VolName=%s VolJobs=%u VolFiles=%u"
+   " VolBlocks=%u VolBytes=%s VolABytes=%s VolHoleBytes=%s VolHoles=%u"
+   " VolMounts=%u VolErrors=%u VolWrites=%s"
+   " MaxVolBytes=%s VolCapacityBytes=%s VolStatus=%s Slot=%d"
+   " MaxVolJobs=%u MaxVolFiles=%u InChanger=%d VolReadTime=%s"
+   " VolWriteTime=%s EndFile=%u EndBlock=%u VolType=%u LabelType=%d"
+   " MediaId=%s ScratchPoolId=%s VolParts=%d VolCloudParts=%d"
+   " LastPartBytes=%lld Enabled=%d MaxPoolBytes=%s PoolBytes=%s Recycle=%d\n";
+static char OK_create[] = "1000 OK CreateJobMedia\n";
+static char OK_create_filemedia[] = "1000 OK CreateFileMedia\n";
+
+/* Commands sent to the Storage daemon as the File daemon */
+static char hello_sd[]     = "Hello Bacula SD: Start Job %s %d tlspsk=%d\n";
+static char append_open[]  = "append open session\n";
+static char append_data[]  = "append data %d\n";
+static char append_end[]   = "append end session %d\n";
+static char append_close[] = "append close session %d\n";
+
+/* Responses from the Storage daemon to the File daemon */
+static char OK_open[]      = "3000 OK open ticket = %d\n";
+static char OK_data[]      = "3000 OK data\n";
+static char OK_append[]    = "3000 OK append data\n";
+static char OK_end[]       = "3000 OK end\n";
+static char OK_close[]     = "3000 OK close Status = %d\n";
+
+/* A Volume known by our small catalog */
+struct LOAD_VOL {
+   char VolumeName[MAX_NAME_LENGTH];
+   char VolStatus[20];
+   uint32_t VolJobs;
+   uint32_t VolFiles;
+   uint32_t VolBlocks;
+   uint32_t VolHoles;
+   uint32_t VolMounts;
+   uint32_t VolErrors;
+   uint32_t VolType;
+   uint64_t VolBytes;
+   uint64_t VolABytes;
+   uint64_t VolHoleBytes;
+   uint64_t VolWrites;
+   uint64_t VolReadTime;
+   uint64_t VolWriteTime;
+   int32_t Slot;
+   int32_t InChanger;
+   int64_t MediaId;
+};
+
+/* One backup job, played by a session thread (Director) and a FD thread */
+struct LOAD_JOB {
+   JCR *jcr;
+   BSOCK *dir;                        /* connection as the Director */
+   BSOCK *fd;                         /* connection as the File daemon */
+   char Job[MAX_NAME_LENGTH];
+   char auth_key[200];
+   uint32_t JobId;
+   int JobStatus;                     /* from the end of Job message */
+   uint32_t JobFiles;
+   uint64_t JobBytes;
+   bool fd_ok;                        /* the FD side sent all its data */
+};
+
+/* Local variables */
+static const char *sd_address = "localhost";
+static int sd_port = 9103;
+static const char *dir_name = NULL;
+static char *dir_password = NULL;
+static const char *storage_name = "File";
+static const char *device_name = "FileStorage";
+static const char *media_type = "File";
+static const char *pool_name = "Default";
+static const char *job_name = "bsdload";
+static char vol_prefix[MAX_NAME_LENGTH];
+static uint32_t nb_sessions = 1;
+static uint32_t nb_jobs = 1;          /* per session */
+static uint32_t nb_files = 1000;      /* per job */
+static uint64_t file_size = 1024 * 1024;
+static uint32_t buf_size = 64 * 1024;
+static uint64_t max_vol_bytes = 0;
+static uint32_t first_jobid = 1;
+
+static char *data_pattern;            /* copied in each FD buffer */
+static alist *volumes;
+static int64_t last_media_id = 0;
+static uint32_t next_jobid;
+static uint32_t nb_ok = 0, nb_failed = 0;
+static uint64_t total_files = 0, total_bytes = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t vol_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * cram-md5 and TLS negotiation as a client of the SD. TLS is not
+ *  used, the SD must not require it.
+ */
+class LoadAuthenticate: public AuthenticateBase
+{
+public:
+   LoadAuthenticate(JCR *jcr, BSOCK *bs, int local_class):
+   AuthenticateBase(jcr, bs, dtCli, local_class, dcSD)
+   {
+   }
+   virtual ~LoadAuthenticate() {};
+   bool authenticate(const char *password) {
+      CalcLocalTLSNeedFromRes(false, false, false, false, NULL, NULL,
+            false, NULL, password);
+      StartAuthTimeout();
+      if (!ClientCramMD5Authenticate(password)) {
+         return false;
+      }
+      return HandleTLS();
+   }
+};
+
+static void usage()
+{
+   fprintf(stderr, _(
+PROG_COPYRIGHT
+"\n%sVersion: %s (%s)\n"
+"Example : bsdload -D mydir-dir -P password -N FileStorage -c 100 -j 5\n"
+" will run 100 concurrent sessions of 5 backup jobs on FileStorage\n\n"
+"Usage: bsdload [ options ] -D director -P password\n"
+"       -a <address>      address of the Storage daemon (default localhost)\n"
+"       -p <port>         port of the Storage daemon (default 9103)\n"
+"       -D <director>     Director name known by the Storage daemon\n"
+"       -P <password>     password of this Director in the Storage daemon\n"
+"       -S <storage>      Storage name sent to the Storage daemon (default File)\n"
+"       -N <device>       Device to write (default FileStorage)\n"
+"       -m <media_type>   Media Type of the Device (default File)\n"
+"       -o <pool>         Pool name (default Default)\n"
+"       -V <prefix>       Volume name prefix (default Load<time>-)\n"
+"       -M <size>         Maximum Volume Bytes (default unlimited)\n"
+"       -c <nb>           number of concurrent sessions (default 1)\n"
+"       -j <nb>           number of jobs run by each session (default 1)\n"
+"       -J <jobid>        first JobId (default 1)\n"
+"       -f <nb>           number of files per job (default 1000)\n"
+"       -s <size>         size of each file (default 1M)\n"
+"       -b <size>         size of the data messages (default 64K)\n"
+"       -dnn              set debug level to nn\n"
+"       -dt               print timestamp in debug output\n"
+"       -v                verbose, print each job and the SD messages\n"
+"       -?                print this message\n\n"), 2022, "", VERSION, BDATE);
+   exit(1);
+}
+
+static uint64_t get_size(const char *arg)
+{
+   uint64_t val;
+   if (!size_to_uint64((char *)arg, strlen(arg), &val)) {
+      Pmsg1(0, _("Invalid size: %s\n"), arg);
+      usage();
+   }
+   return val;
+}
+
+/*
+ * Volume list, the SD asks for an appendable Volume, updates it
+ *  after each write and labels the new ones itself.
+ */
+/*
+ * The configured passwords are used as the MD5 of the string,
+ *  see store_password()
+ */
+static char *hash_password(const char *password)
+{
+   struct MD5Context md5c;
+   unsigned char digest[CRYPTO_DIGEST_MD5_SIZE];
+   char sig[100];
+
+   MD5Init(&md5c);
+   MD5Update(&md5c, (unsigned char *)password, strlen(password));
+   MD5Final(digest, &md5c);
+   for (unsigned int i = 0, j = 0; i < sizeof(digest); i++, j += 2) {
+      sprintf(&sig[j], "%02x", digest[i]);
+   }
+   return bstrdup(sig);
+}
+
+static LOAD_VOL *find_volume(const char *name)
+{
+   LOAD_VOL *vol;
+   foreach_alist(vol, volumes) {
+      if (strcmp(vol->VolumeName, name) == 0) {
+         return vol;
+      }
+   }
+   return NULL;
+}
+
+static LOAD_VOL *new_volume()
+{
+   LOAD_VOL *vol = (LOAD_VOL *)malloc(sizeof(LOAD_VOL));
+   memset(vol, 0, sizeof(LOAD_VOL));
+   vol->MediaId = ++last_media_id;
+   bsnprintf(vol->VolumeName, sizeof(vol->VolumeName), "%s%04lld",
+             vol_prefix, vol->MediaId);
+   bstrncpy(vol->VolStatus, "Append", sizeof(vol->VolStatus));
+   volumes->append(vol);
+   Dmsg1(50, "New Volume %s\n", vol->VolumeName);
+   return vol;
+}
+
+static bool send_volume_info(BSOCK *dir, LOAD_VOL *vol)
+{
+   char ed1[50], ed2[50], ed3[50], ed4[50], ed5[50], ed6[50], ed7[50], ed8[50];
+
+   return dir->fsend(OK_media, vol->VolumeName, vol->VolJobs,
+      vol->VolFiles, vol->VolBlocks, edit_uint64(vol->VolBytes, ed1),
+      edit_uint64(vol->VolABytes, ed2),
+      edit_uint64(vol->VolHoleBytes, ed3),
+      vol->VolHoles, vol->VolMounts, vol->VolErrors,
+      edit_uint64(vol->VolWrites, ed4),
+      edit_uint64(max_vol_bytes, ed5), "0",
+      vol->VolStatus, vol->Slot, 0, 0, vol->InChanger,
+      edit_uint64(vol->VolReadTime, ed6),
+      edit_uint64(vol->VolWriteTime, ed7),
+      0, 0, vol->VolType, 0,
+      edit_int64(vol->MediaId, ed8), "0",
+      0, 0, (int64_t)0, 1, "0", "0", 0);
+}
+
+/*
+ * Answer the catalog requests of the SD, the way dird/catreq.c does
+ */
+static void catalog_request(LOAD_JOB *job)
+{
+   BSOCK *dir = job->dir;
+   LOAD_VOL *vol, upd;
+   char pname[MAX_NAME_LENGTH], mtype[MAX_NAME_LENGTH];
+   int32_t JobId, index, vol_type, can_create, writing, label, parts, cparts;
+   int32_t enabled, recycle;
+   int64_t end_time, first_written, last_part_bytes, max_bytes;
+   int n;
+
+   Dmsg1(100, "<stored: %s", dir->msg);
+   if (sscanf(dir->msg, Find_media, &JobId, &index, pname, mtype,
+              &vol_type, &can_create) == 6) {
+      P(vol_mutex);
+      vol = NULL;
+      foreach_alist(vol, volumes) {
+         if (strcmp(vol->VolStatus, "Append") == 0 && --index <= 0) {
+            break;
+         }
+      }
+      if (!vol) {
+         vol = new_volume();
+      }
+      send_volume_info(dir, vol);
+      V(vol_mutex);
+      return;
+   }
+
+   if (sscanf(dir->msg, Get_Vol_Info, &JobId, upd.VolumeName, &writing) == 3) {
+      unbash_spaces(upd.VolumeName);
+      P(vol_mutex);
+      vol = find_volume(upd.VolumeName);
+      if (!vol) {
+         dir->fsend(_("1997 Volume \"%s\" not in catalog.\n"), upd.VolumeName);
+      } else if (writing && strcmp(vol->VolStatus, "Append") != 0) {
+         dir->fsend(_("1998 Volume \"%s\" catalog status is %s, not Append.\n"),
+                    vol->VolumeName, vol->VolStatus);
+      } else {
+         send_volume_info(dir, vol);
+      }
+      V(vol_mutex);
+      return;
+   }
+
+   memset(&upd, 0, sizeof(upd));
+   n = sscanf(dir->msg, Update_media, &JobId, upd.VolumeName,
+      &upd.VolJobs, &upd.VolFiles, &upd.VolBlocks, &upd.VolBytes,
+      &upd.VolABytes, &upd.VolHoleBytes, &upd.VolHoles,
+      &upd.VolMounts, &upd.VolErrors, &upd.VolWrites, &max_bytes,
+      &end_time, upd.VolStatus, &upd.Slot, &label, &upd.InChanger,
+      &upd.VolReadTime, &upd.VolWriteTime, &first_written,
+      &upd.VolType, &parts, &cparts, &last_part_bytes, &enabled, &recycle);
+   if (n == 27) {
+      unbash_spaces(upd.VolumeName);
+      P(vol_mutex);
+      vol = find_volume(upd.VolumeName);
+      if (!vol) {
+         dir->fsend(_("1991 Catalog Request for vol=%s failed: not in catalog\n"),
+                    upd.VolumeName);
+      } else {
+         upd.MediaId = vol->MediaId;
+         *vol = upd;                  /* structure assignment */
+         send_volume_info(dir, vol);
+      }
+      V(vol_mutex);
+      return;
+   }
+
+   /* Nothing to record, read the records up to the EOD */
+   if (sscanf(dir->msg, Create_jobmedia, &JobId) == 1) {
+      while (dir->recv() >= 0) { }
+      dir->fsend(OK_create);
+      return;
+   }
+   if (sscanf(dir->msg, Create_filemedia, &JobId) == 1) {
+      while (dir->recv() >= 0) { }
+      dir->fsend(OK_create_filemedia);
+      return;
+   }
+   dir->fsend(_("1990 Invalid Catalog Request: %s"), dir->msg);
+}
+
+/*
+ * Read the Director socket up to the next response of the SD,
+ *  answering the catalog requests and printing the job messages
+ *  in the meantime. Simplified version of dird/getmsg.c.
+ */
+static int get_dir_msg(LOAD_JOB *job)
+{
+   BSOCK *dir = job->dir;
+   int32_t n, type;
+   char *msg;
+
+   for ( ; !dir->is_stop() && !dir->is_timed_out(); ) {
+      n = dir->recv();
+      if (dir->is_stop() || dir->is_timed_out()) {
+         return n;
+      }
+      if (n == BNET_SIGNAL) {
+         if (dir->msglen == BNET_EOD || dir->msglen == BNET_TERMINATE) {
+            return n;
+         }
+         continue;                    /* heartbeat, ... */
+      }
+      if (n > 0 && B_ISDIGIT(dir->msg[0])) {
+         return n;                    /* response */
+      }
+      switch (dir->msg[0]) {
+      case 'C':                       /* catalog request */
+         catalog_request(job);
+         break;
+      case 'J':                       /* job message */
+         if (sscanf(dir->msg, "Jmsg JobId=%*d type=%d", &type) == 1 ||
+             sscanf(dir->msg, "Jmsg Job=%*s type=%d", &type) == 1) {
+            /* Skip "Jmsg JobId=nn type=nn level=nn " */
+            msg = dir->msg;
+            for (int i = 0; i < 4 && msg; i++) {
+               msg = strchr(msg, ' ');
+               if (msg) {
+                  msg++;
+               }
+            }
+            if (msg && (verbose || type == M_FATAL || type == M_ERROR ||
+                        type == M_ERROR_TERM || type == M_WARNING)) {
+               printf("%s: %s", job->Job, msg);
+            }
+         }
+         break;
+      default:                        /* status, events, attributes */
+         Dmsg1(200, "<stored: %s", dir->msg);
+         break;
+      }
+   }
+   return BNET_HARDEOF;
+}
+
+/* Send the file attributes and the data of one synthetic file */
+static bool send_file(LOAD_JOB *job, POOLMEM *buf, uint32_t file_index,
+                      struct stat *statp)
+{
+   BSOCK *fd = job->fd;
+   char attribs[MAXSTRING];
+   char fname[200];
+   POOLMEM *msgsave;
+   uint64_t remain;
+   bool ok = true;
+
+   bsnprintf(fname, sizeof(fname), "/%s/s%u/d%04u/f%07u", job_name,
+             job->JobId, file_index / 1000, file_index);
+   encode_stat(attribs, statp, sizeof(struct stat), 0, STREAM_FILE_DATA);
+   if (!fd->fsend("%ld %d 0", file_index, STREAM_UNIX_ATTRIBUTES) ||
+       !fd->fsend("%ld %d %s%c%s%c%c%s%c%d%c", file_index, FT_REG,
+                  fname, 0, attribs, 0, 0, "", 0, 0, 0) ||
+       !fd->signal(BNET_EOD)) {
+      return false;
+   }
+   if (!fd->fsend("%ld %d %lld", file_index, STREAM_FILE_DATA,
+                  (int64_t)statp->st_size)) {
+      return false;
+   }
+   msgsave = fd->msg;
+   fd->msg = buf;                     /* send from our buffer */
+   for (remain = statp->st_size; ok && remain > 0; ) {
+      fd->msglen = (int32_t)MIN(remain, (uint64_t)buf_size);
+      ok = fd->send();
+      remain -= fd->msglen;
+   }
+   fd->msg = msgsave;
+   return ok && fd->signal(BNET_EOD);
+}
+
+static bool fd_response(BSOCK *fd, const char *resp)
+{
+   if (fd->recv() <= 0) {
+      return false;
+   }
+   if (strcmp(fd->msg, resp) != 0) {
+      Dmsg2(50, "Bad response expected %s got: %s", resp, fd->msg);
+      return false;
+   }
+   return true;
+}
+
+/*
+ * File daemon side of a job: connect to the SD, authenticate with
+ *  the key given to the Director, and send the files.
+ */
+static void *fd_session(void *arg)
+{
+   LOAD_JOB *job = (LOAD_JOB *)arg;
+   BSOCK *fd;
+   POOLMEM *buf = NULL;
+   int32_t ticket, status;
+   struct stat statp;
+   bool ok = false;
+
+   fd = job->fd = new_bsock();
+   if (!fd->connect(job->jcr, 5, 60, 0, _("Storage daemon"),
+                    (char *)sd_address, NULL, sd_port, verbose)) {
+      free_bsock(job->fd);
+      return NULL;
+   }
+   fd->clear_compress();
+   {
+      LoadAuthenticate auth(job->jcr, fd, AuthenticateBase::dcFD);
+      fd->fsend(hello_sd, job->Job, FD_VERSION, 0);
+      /* Capabilities, no dedup */
+      if (fd->recv() <= 0 || strncmp(fd->msg, "sdcaps:", 7) != 0) {
+         goto bail_out;
+      }
+      fd->fsend("fdcaps: dedup=0 rehydration=0 proxy=0\n");
+      if (!auth.authenticate(job->auth_key) || fd->recv() <= 0 ||
+          strncmp(fd->msg, "3000 OK Hello", 13) != 0) {
+         Pmsg1(0, _("%s: Authorization problem with the Storage daemon\n"), job->Job);
+         goto bail_out;
+      }
+   }
+
+   fd->fsend(append_open);
+   if (fd->recv() <= 0 || sscanf(fd->msg, OK_open, &ticket) != 1) {
+      goto bail_out;
+   }
+   fd->fsend(append_data, ticket);
+   if (!fd_response(fd, OK_data)) {
+      goto bail_out;
+   }
+
+   buf = get_memory(buf_size);
+   memcpy(buf, data_pattern, buf_size);
+   memset(&statp, 0, sizeof(statp));
+   statp.st_mode = S_IFREG | 0644;
+   statp.st_nlink = 1;
+   statp.st_uid = getuid();
+   statp.st_gid = getgid();
+   statp.st_size = file_size;
+   statp.st_atime = statp.st_mtime = statp.st_ctime = time(NULL);
+   for (uint32_t i = 1; i <= nb_files; i++) {
+      if (!send_file(job, buf, i, &statp)) {
+         Pmsg2(0, _("%s: Network send error to SD. ERR=%s\n"), job->Job,
+               fd->bstrerror());
+         goto bail_out;
+      }
+   }
+   fd->signal(BNET_EOD);              /* end of data */
+   if (!fd_response(fd, OK_append)) {
+      goto bail_out;
+   }
+   fd->fsend(append_end, ticket);
+   if (!fd_response(fd, OK_end)) {
+      goto bail_out;
+   }
+   fd->fsend(append_close, ticket);
+   while (fd->recv() >= 0) {
+      if (sscanf(fd->msg, OK_close, &status) == 1) {
+         ok = true;
+      }
+   }
+
+bail_out:
+   job->fd_ok = ok;
+   if (buf) {
+      free_pool_memory(buf);
+   }
+   fd->signal(BNET_TERMINATE);
+   free_bsock(job->fd);
+   return NULL;
+}
+
+/*
+ * Director side of a job: start the Job, reserve the Device, then
+ *  answer the SD while the FD thread sends the data.
+ */
+static bool run_job(LOAD_JOB *job)
+{
+   BSOCK *dir;
+   char ed1[50], dt[50], name[MAX_NAME_LENGTH];
+   char errmsg[257];
+   int32_t SDid, SDtime, JobFiles;
+   uint32_t JobErrors;
+   int64_t JobBytes;
+   pthread_t fd_tid;
+   time_t now;
+   struct tm tm;
+   bool job_end = false;
+   bool ok = false;
+   int n;
+
+   /* Same form as the Director, name.YYYY-MM-DD_HH.MM.SS_nn */
+   now = time(NULL);
+   localtime_r(&now, &tm);
+   strftime(dt, sizeof(dt), "%Y-%m-%d_%H.%M.%S", &tm);
+   bsnprintf(job->Job, sizeof(job->Job), "%s.%s_%02u", job_name, dt, job->JobId);
+   job->jcr->JobId = job->JobId;
+   bstrncpy(job->jcr->Job, job->Job, sizeof(job->jcr->Job));
+
+   dir = job->dir = new_bsock();
+   if (!dir->connect(job->jcr, 5, 60, 0, _("Storage daemon"),
+                     (char *)sd_address, NULL, sd_port, verbose)) {
+      free_bsock(job->dir);
+      return false;
+   }
+   dir->clear_compress();
+   {
+      LoadAuthenticate auth(job->jcr, dir, AuthenticateBase::dcDIR);
+      bstrncpy(name, dir_name, sizeof(name));
+      bash_spaces(name);
+      dir->fsend(hello_dir, name, LOAD_DIR_VERSION, 0);
+      if (!auth.authenticate(dir_password) || dir->recv() <= 0 ||
+          strncmp(dir->msg, "3000 OK Hello", 13) != 0) {
+         Pmsg1(0, _("Director \"%s\" rejected by the Storage daemon\n"), dir_name);
+         goto bail_out;
+      }
+   }
+
+   dir->fsend(jobcmd, edit_uint64(job->JobId, ed1), job->Job, job_name,
+              job_name, JT_BACKUP, L_FULL, job_name, 1 /* NoAttr */,
+              0, "x", 0, 0, 1, "0", 0, 0, 0, 0, "dummy");
+   if (get_dir_msg(job) <= 0 ||
+       sscanf(dir->msg, OKjob, &SDid, &SDtime, job->auth_key) != 3) {
+      Pmsg2(0, _("%s: Bad response to Job command: %s"), job->Job, dir->msg);
+      goto bail_out;
+   }
+
+   {
+      POOL_MEM sname, mtype, pname, dname;
+      pm_strcpy(sname, storage_name);
+      bash_spaces(sname);
+      pm_strcpy(mtype, media_type);
+      bash_spaces(mtype);
+      pm_strcpy(pname, pool_name);
+      bash_spaces(pname);
+      pm_strcpy(dname, device_name);
+      bash_spaces(dname);
+      dir->fsend(use_storage, sname.c_str(), mtype.c_str(), pname.c_str(),
+                 "Backup", 1, 0, 0, 1);
+      dir->fsend(use_device, dname.c_str());
+      dir->signal(BNET_EOD);          /* end of Devices */
+      dir->signal(BNET_EOD);          /* end of Storages */
+      if (get_dir_msg(job) <= 0 || sscanf(dir->msg, OK_device, name) != 1) {
+         Pmsg2(0, _("%s: Device not reserved: %s"), job->Job, dir->msg);
+         goto bail_out;
+      }
+   }
+
+   dir->fsend("run");
+   pthread_create(&fd_tid, NULL, fd_session, job);
+
+   /* Serve the SD until the end of the Job, followed by an EOD */
+   for ( ;; ) {
+      n = get_dir_msg(job);
+      if (n > 0) {
+         if (sscanf(dir->msg, Job_end, name, &job->JobStatus, &JobFiles,
+                    &JobBytes, &JobErrors, errmsg) == 6) {
+            job->JobFiles = JobFiles;
+            job->JobBytes = JobBytes;
+            job_end = true;
+         }
+         continue;
+      }
+      if (job_end || n != BNET_SIGNAL || dir->msglen != BNET_EOD) {
+         break;
+      }
+   }
+   pthread_join(fd_tid, NULL);
+   ok = job_end && job->fd_ok && job->JobStatus == JS_Terminated;
+
+bail_out:
+   dir->signal(BNET_TERMINATE);
+   free_bsock(job->dir);
+   return ok;
+}
+
+static void *do_session(void *arg)
+{
+   LOAD_JOB job;
+   btime_t start;
+   char ed1[50], ed2[50];
+
+   for (uint32_t i = 0; i < nb_jobs; i++) {
+      memset(&job, 0, sizeof(job));
+      job.jcr = new_jcr(sizeof(JCR), NULL);
+      job.jcr->setJobType(JT_BACKUP);
+      job.jcr->setJobLevel(L_FULL);
+      job.jcr->JobStatus = JS_Running;
+      P(mutex);
+      job.JobId = next_jobid++;
+      V(mutex);
+      start = get_current_btime();
+      bool ok = run_job(&job);
+      if (verbose) {
+         printf(_("%s: JobStatus=%c Files=%s Bytes=%s Elapsed=%.3fs\n"),
+                job.Job, job.JobStatus ? job.JobStatus : '?',
+                edit_uint64_with_commas(job.JobFiles, ed1),
+                edit_uint64_with_commas(job.JobBytes, ed2),
+                (get_current_btime() - start) / 1000000.0);
+      }
+      P(mutex);
+      if (ok) {
+         nb_ok++;
+      } else {
+         nb_failed++;
+      }
+      total_files += job.JobFiles;
+      total_bytes += job.JobBytes;
+      V(mutex);
+      free_jcr(job.jcr);
+   }
+   return NULL;
+}
+
+int main (int argc, char *argv[])
+{
+   int ch;
+   pthread_t *tids;
+   btime_t start, elapsed;
+   char ed1[50], ed2[50], ed3[50];
+
+   setlocale(LC_ALL, "");
+   bindtextdomain("bacula", LOCALEDIR);
+   textdomain("bacula");
+   init_stack_dump();
+   lmgr_init_thread();
+
+   my_name_is(argc, argv, "bsdload");
+   init_msg(NULL, NULL);
+
+   OSDependentInit();
+
+   bsnprintf(vol_prefix, sizeof(vol_prefix), "Load%lld-", (int64_t)time(NULL));
+
+   while ((ch = getopt(argc, argv, "a:p:D:P:S:N:d:m:o:V:M:c:j:J:f:s:b:v?")) != -1) {
+      switch (ch) {
+      case 'a':
+         sd_address = optarg;
+         break;
+
+      case 'p':
+         sd_port = atoi(optarg);
+         break;
+
+      case 'D':
+         dir_name = optarg;
+         break;
+
+      case 'P':
+         dir_password = hash_password(optarg);
+         break;
+
+      case 'S':
+         storage_name = optarg;
+         break;
+
+      case 'd':                    /* debug level */
+         if (*optarg == 't') {
+            dbg_timestamp = true;
+         } else {
+            debug_level = atoi(optarg);
+            if (debug_level <= 0) {
+               debug_level = 1;
+            }
+         }
+         break;
+
+      case 'N':
+         device_name = optarg;
+         break;
+
+      case 'm':
+         media_type = optarg;
+         break;
+
+      case 'o':
+         pool_name = optarg;
+         break;
+
+      case 'V':
+         bstrncpy(vol_prefix, optarg, sizeof(vol_prefix));
+         break;
+
+      case 'M':
+         max_vol_bytes = get_size(optarg);
+         break;
+
+      case 'c':
+         nb_sessions = atoi(optarg);
+         break;
+
+      case 'j':
+         nb_jobs = atoi(optarg);
+         break;
+
+      case 'J':
+         first_jobid = atoi(optarg);
+         break;
+
+      case 'f':
+         nb_files = atoi(optarg);
+         break;
+
+      case 's':
+         file_size = get_size(optarg);
+         break;
+
+      case 'b':
+         buf_size = (uint32_t)get_size(optarg);
+         break;
+
+      case 'v':
+         verbose++;
+         break;
+
+      case '?':
+      default:
+         usage();
+
+      }
+   }
+   argc -= optind;
+   argv += optind;
+
+   if (argc != 0 || !dir_name || !dir_password) {
+      Pmsg0(0, _("The Director name and password are required\n"));
+      usage();
+   }
+   if (nb_sessions < 1 || nb_jobs < 1 || buf_size < 1 || buf_size > 1024 * 1024) {
+      Pmsg0(0, _("Invalid number of sessions, jobs or message size\n"));
+      usage();
+   }
+
+   /* Random data, not compressible nor deduplicable within a buffer */
+   data_pattern = (char *)malloc(buf_size);
+   srandom(time(NULL));
+   for (uint32_t i = 0; i < buf_size; i++) {
+      data_pattern[i] = (char)random();
+   }
+   volumes = New(alist(10, owned_by_alist));
+   next_jobid = first_jobid;
+
+   start_watchdog();
+   start = get_current_btime();
+   tids = (pthread_t *)malloc(nb_sessions * sizeof(pthread_t));
+   for (uint32_t i = 0; i < nb_sessions; i++) {
+      pthread_create(&tids[i], NULL, do_session, NULL);
+   }
+   for (uint32_t i = 0; i < nb_sessions; i++) {
+      pthread_join(tids[i], NULL);
+   }
+   elapsed = get_current_btime() - start;
+   stop_watchdog();
+
+   printf(_("Sessions=%u Jobs=%u Errors=%u Files=%s Bytes=%s Elapsed=%.3fs Rate=%sB/s\n"),
+          nb_sessions, nb_ok, nb_failed,
+          edit_uint64_with_commas(total_files, ed1),
+          edit_uint64_with_commas(total_bytes, ed2),
+          elapsed / 1000000.0,
+          edit_uint64_with_suffix(elapsed > 0 ? (uint64_t)(total_bytes * 1000000.0 / elapsed) : 0, ed3));
+
+   free(tids);
+   free(data_pattern);
+   free(dir_password);
+   delete volumes;
+   term_msg();
+   return nb_failed ? 1 : 0;
+}
@@ -57,6 +57,7 @@ PROG_COPYRIGHT
 "       -p <path>         specify path\n"
 "       -f <file>         specify file\n"
 "       -l <limit>        maximum tuple to fetch\n"
+"       -b <nb>           benchmark db_get_file_list() with <nb> files\n"
 "       -q                print only errors\n"
 "       -v                verbose\n"
 "       -?                print this message\n\n"), 2011, "", VERSION, BDATE);
@@ -199,6 +200,12 @@ static int list_files(void *ctx, int nb_col, char **row)
    return 1;
 }
 
+static int count_rows(void *ctx, int nb_col, char **row)
+{
+   (*((uint64_t*) ctx))++;
+   return 0;
+}
+
 static int count_col(void *ctx, int nb_col, char **row)
 {
    *((int32_t*) ctx) = nb_col;
@@ -212,6 +219,7 @@ int main (int argc, char *argv[])
    int ch;
    char *path=NULL, *client=NULL;
    uint64_t limit=0;
+   uint64_t bench=0;
    bool clean=false;
    bool full_test=false;
    int dbtype;
@@ -234,11 +242,15 @@ int main (int argc, char *argv[])
 
    OSDependentInit();
 
-   while ((ch = getopt(argc, argv, "qh:c:l:d:n:P:Su:vFw:?p:f:T")) != -1) {
+   while ((ch = getopt(argc, argv, "qb:h:c:l:d:n:P:Su:vFw:?p:f:T")) != -1) {
       switch (ch) {
       case 'q':
          print_ok = false;
          break;
+      case 'b':
+         bench = str_to_uint64(optarg);
+         break;
+
       case 'd':                    /* debug level */
          if (*optarg == 't') {
             dbg_timestamp = true;
@@ -533,6 +545,37 @@ int main (int argc, char *argv[])
    ok(db_get_file_list(jcr, jcr->db_batch, buf, DBL_NONE, list_files, &j),
       "List files with db_get_file_list()");
    ok(j == 1, "Check db_get_file_list results");
+
+   if (bench > 0) {
+      /* Big restore tree, the rows must be sent to the handler as
+       * they come, see bdb_big_sql_query()
+       */
+      uint64_t nb_rows = 0;
+      btime_t start, end;
+
+      Pmsg1(0, PLINE "Doing db_get_file_list() benchmark with %lld files" PLINE, bench);
+      start = get_current_btime();
+      for (uint64_t b = 0; b < bench; b++) {
+         Mmsg(buf2, aPATH "/%lld/" aFILE "%lld.txt", b / 1000, b);
+         ar.fname = buf2;
+         ar.FileIndex = 11 + b;
+         if (!db_create_attributes_record(jcr, db, &ar)) {
+            break;
+         }
+      }
+      ok(db_write_batch_file_records(jcr), "Commit benchmark files");
+      end = get_current_btime();
+      Pmsg2(0, "Inserted %lld files in %.3fs\n", bench, (end - start) / 1000000.0);
+
+      start = get_current_btime();
+      ok(db_get_file_list(jcr, jcr->db_batch, buf, DBL_NONE, count_rows, &nb_rows),
+         "List files with db_get_file_list()");
+      end = get_current_btime();
+      ok(nb_rows == bench + 1, "Check db_get_file_list results");
+      Pmsg3(0, "Read %lld files in %.3fs, %.0f files/s\n", nb_rows,
+            (end - start) / 1000000.0,
+            nb_rows * 1000000.0 / MAX(end - start, 1));
+   }
    /* ---------------------------------------------------------------- */
 
    Pmsg0(0, PLINE "Doing Client tests" PLINE);
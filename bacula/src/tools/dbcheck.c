@@ -40,14 +40,6 @@ typedef struct s_id_ctx {
    int tot_ids;                       /* total to process */
 } ID_LIST;
 
-typedef struct s_name_ctx {
-   char **name;                       /* list of names */
-   int num_ids;                       /* ids stored */
-   int max_ids;                       /* size of array */
-   int num_del;                       /* number deleted */
-   int tot_ids;                       /* total to process */
-} NAME_LIST;
-
 /* Global variables */ 
 
 static bool fix = false;
@@ -55,7 +47,6 @@ static bool batch = false;
 static bool timestamps = false;
 static BDB *db;
 static ID_LIST id_list;
-static NAME_LIST name_list;
 static char buf[20000];
 static bool quit = false;
 static CONFIG *config;
@@ -67,9 +58,6 @@ static uint64_t nb_changes = 300000;
 /* Forward referenced functions */ 
 static int make_id_list(const char *query, ID_LIST *id_list);
 static int delete_id_list(const char *query, ID_LIST *id_list);
-static int make_name_list(const char *query, NAME_LIST *name_list);
-static void print_name_list(NAME_LIST *name_list);
-static void free_name_list(NAME_LIST *name_list);
 static char *get_cmd(const char *prompt);
 static void eliminate_duplicate_paths();
 static void eliminate_orphaned_jobmedia_records();
@@ -118,7 +106,7 @@ PROG_COPYRIGHT
 "       -c              Director conf filename\n"
 "       -B              print catalog configuration and exit\n"
 "       -d <nn>         set debug level to <nn>\n"
-"       -n <nn>         custom number of records selected at a time for large pruning operations done in a loop (orphan paths/files, ...)\n"
+"       -n <nn>         custom number of records processed at a time for large operations done by chunks (orphan paths/files, duplicate paths, ...)\n"
 "       -dt             print a timestamp in debug output\n"
 "       -t              print a timestamp for each log line\n"
 "       -f              fix inconsistencies\n"
@@ -150,7 +138,6 @@ int main (int argc, char *argv[])
    init_msg(NULL, NULL);             /* setup message handler */
 
    memset(&id_list, 0, sizeof(id_list));
-   memset(&name_list, 0, sizeof(name_list));
 
    while ((ch = getopt(argc, argv, "bc:C:d:fvB?n:t")) != -1) {
       switch (ch) {
@@ -598,207 +585,291 @@ static int delete_id_list(const char *query, ID_LIST *id_list)
 }
 
 /*
- * Called here with each name to be added to the list
+ * Display the progress of a chunked operation every 10 seconds,
+ *  or after each chunk in verbose mode. A negative "found" is not
+ *  displayed.
  */
-static int name_list_handler(void *ctx, int num_fields, char **row)
+static void print_chunk_progress(const char *what, int64_t key, int64_t max_key,
+                                 int64_t found, time_t *last_report)
 {
-   NAME_LIST *name = (NAME_LIST *)ctx;
+   char ed1[50], ed2[50], ed3[50];
+   time_t now = time(NULL);
+   int pct = 100;
 
-   if (name->num_ids == MAX_ID_LIST_LEN) {
-      return 1;
+   if (!verbose && (now - *last_report) < 10) {
+      return;
    }
-   if (name->num_ids == name->max_ids) {
-      if (name->max_ids == 0) {
-         name->max_ids = 10000;
-         name->name = (char **)bmalloc(sizeof(char *) * name->max_ids);
-      } else {
-         name->max_ids = (name->max_ids * 3) / 2;
-         name->name = (char **)brealloc(name->name, sizeof(char *) * name->max_ids);
-      }
+   *last_report = now;
+   if (max_key > 0 && key < max_key) {
+      pct = (int)((key * 100) / max_key);
+   }
+   if (found < 0) {
+      printf_tstamp(_("%s: %d%% done (key %s/%s).\n"),
+                    what, pct, edit_int64(key, ed1), edit_int64(max_key, ed2));
+   } else {
+      printf_tstamp(_("%s: %d%% done (key %s/%s), %s record(s) found so far.\n"),
+                    what, pct, edit_int64(key, ed1), edit_int64(max_key, ed2),
+                    edit_int64(found, ed3));
    }
-   name->name[name->num_ids++] = bstrdup(row[0]);
-   return 0;
 }
 
 /*
- * Construct name list
+ * Get the highest value of a key in a table, used to report the progress
  */
-static int make_name_list(const char *query, NAME_LIST *name_list)
+static int64_t get_max_key(const char *table, const char *key)
 {
-   name_list->num_ids = 0;
-   name_list->num_del = 0;
-   name_list->tot_ids = 0;
+   db_int64_ctx lctx;
 
-   if (!db_sql_query(db, query, name_list_handler, (void *)name_list)) {
-      printf_tstamp("%s", db_strerror(db));
-      return 0;
+   bsnprintf(buf, sizeof(buf), "SELECT MAX(%s) FROM %s", key, table);
+   if (verbose > 2) {
+      printf_tstamp("%s\n", buf);
    }
-   return 1;
+   if (!db_sql_query(db, buf, db_int64_handler, &lctx)) {
+      printf_tstamp("%s\n", db_strerror(db));
+      exit(1);
+   }
+   return lctx.value;
 }
 
 /*
- * Print names in the list
+ * Keyset pagination: compute the upper bound of the next chunk of at
+ *  most nb_changes rows of the table located after the key value "last".
+ *  Returns false when there is nothing left to process.
  */
-static void print_name_list(NAME_LIST *name_list)
+static bool get_next_chunk(const char *table, const char *key, int64_t last,
+                           int64_t *next)
 {
-   for (int i=0; i < name_list->num_ids; i++) {
-      printf_tstamp("%s\n", name_list->name[i]);
+   db_int64_ctx lctx;
+   char ed1[50], ed2[50];
+
+   bsnprintf(buf, sizeof(buf),
+      "SELECT MAX(%s) FROM (SELECT %s FROM %s WHERE %s > %s ORDER BY %s LIMIT %s) AS T",
+      key, key, table, key, edit_int64(last, ed1), key, edit_uint64(nb_changes, ed2));
+   if (verbose > 2) {
+      printf_tstamp("%s\n", buf);
    }
+   if (!db_sql_query(db, buf, db_int64_handler, &lctx)) {
+      printf_tstamp("%s\n", db_strerror(db));
+      exit(1);
+   }
+   if (lctx.count == 0) {
+      return false;
+   }
+   *next = lctx.value;
+   return true;
 }
 
 /*
- * Free names in the list
+ * Walk a table by chunks of at most nb_changes rows using keyset
+ *  pagination on its primary key, and count (or delete when the fix
+ *  flag is set) the rows matching the "where" condition in each chunk.
+ *  The two %s of the condition are replaced by the bounds of the chunk.
+ *
+ * Only one chunk is handled at a time by the SQL engine, so the memory
+ *  used and the size of each transaction do not depend on the size of
+ *  the table. Returns the number of records found.
  */
-static void free_name_list(NAME_LIST *name_list)
+static int64_t process_chunks(const char *what, const char *table, const char *key,
+                              const char *where, const char *print_query,
+                              DB_RESULT_HANDLER *print_handler)
 {
-   for (int i=0; i < name_list->num_ids; i++) {
-      free(name_list->name[i]);
+   POOL_MEM cond, query;
+   int64_t last = 0, next, max_key, found = 0;
+   time_t last_report = time(NULL);
+   bool ask = (print_query && verbose);
+   bool print = false;
+   char ed1[50], ed2[50];
+
+   max_key = get_max_key(table, key);
+
+   while (!quit && get_next_chunk(table, key, last, &next)) {
+      db_int64_ctx lctx;
+
+      Mmsg(cond, where, edit_int64(last, ed1), edit_int64(next, ed2));
+      Mmsg(query, "SELECT COUNT(*) FROM %s WHERE %s", table, cond.c_str());
+      if (verbose > 1) {
+         printf_tstamp("%s\n", query.c_str());
+      }
+      if (!db_sql_query(db, query.c_str(), db_int64_handler, &lctx)) {
+         printf_tstamp("%s\n", db_strerror(db));
+         exit(1);
+      }
+      if (lctx.value > 0) {
+         found += lctx.value;
+         if (ask) {              /* Ask only once, when we have something */
+            print = yes_no(_("Print them? (yes/no): "));
+            ask = false;
+         }
+         if (print) {
+            Mmsg(query, print_query, cond.c_str());
+            if (!db_sql_query(db, query.c_str(), print_handler, NULL)) {
+               printf_tstamp("%s\n", db_strerror(db));
+            }
+         }
+         if (fix) {
+            printf_tstamp(_("Deleting %s %s.\n"), edit_int64(lctx.value, ed1), what);
+            Mmsg(query, "DELETE FROM %s WHERE %s", table, cond.c_str());
+            if (verbose > 1) {
+               printf_tstamp("%s\n", query.c_str());
+            }
+            db_start_transaction(NULL, db);
+            if (!db_sql_query(db, query.c_str(), NULL, NULL)) {
+               printf_tstamp("%s\n", db_strerror(db));
+            }
+            db_end_transaction(NULL, db);
+         }
+      }
+      last = next;
+      print_chunk_progress(what, last, max_key, found, &last_report);
+   }
+   if (fix) {
+      printf_tstamp(_("Deleted %s %s.\n"), edit_int64(found, ed1), what);
+   } else {
+      printf_tstamp(_("Found %s %s.\n"), edit_int64(found, ed1), what);
    }
-   name_list->num_ids = 0;
+   return found;
 }
 
 static void eliminate_duplicate_paths()
 {
+   db_int64_ctx lctx;
+   int64_t last = 0, next, max_key;
+   time_t last_report = time(NULL);
    const char *query;
-   char esc_name[5000];
+   char ed1[50], ed2[50];
+   bool ok = true;
 
    printf_tstamp(_("Checking for duplicate Path entries.\n"));
 
-   /* Make list of duplicated names */
-   query = "SELECT Path, count(Path) as Count FROM Path "
-           "GROUP BY Path HAVING count(Path) > 1";
-
-   if (!make_name_list(query, &name_list)) {
+   /* Count the duplicated names, the list itself stays in the database */
+   query = "SELECT COUNT(*) FROM (SELECT Path FROM Path "
+           "GROUP BY Path HAVING count(Path) > 1) AS T";
+   if (verbose > 1) {
+      printf_tstamp("%s\n", query);
+   }
+   if (!db_sql_query(db, query, db_int64_handler, &lctx)) {
+      printf_tstamp("%s\n", db_strerror(db));
       exit(1);
    }
-   printf_tstamp(_("Found %d duplicate Path records.\n"), name_list.num_ids);
-   if (name_list.num_ids && verbose && yes_no(_("Print them? (yes/no): "))) {
-      print_name_list(&name_list);
+   printf_tstamp(_("Found %s duplicate Path records.\n"), edit_int64(lctx.value, ed1));
+   if (lctx.value && verbose && yes_no(_("Print them? (yes/no): "))) {
+      query = "SELECT Path FROM Path GROUP BY Path HAVING count(Path) > 1";
+      if (!db_sql_query(db, query, print_name_handler, NULL)) {
+         printf_tstamp("%s\n", db_strerror(db));
+      }
    }
-   if (quit) {
+   if (quit || !fix || lctx.value == 0) {
       return;
    }
-   if (fix) {
-      /* Loop through list of duplicate names */
-      for (int i=0; i<name_list.num_ids; i++) {
-         /* Get all the Ids of each name */
-         db_escape_string(NULL, db,  esc_name, name_list.name[i], strlen(name_list.name[i]));
-         bsnprintf(buf, sizeof(buf), "SELECT PathId FROM Path WHERE Path='%s'", esc_name);
-         if (verbose > 1) {
-            printf_tstamp("%s\n", buf);
-         }
-         if (!make_id_list(buf, &id_list)) {
-            exit(1);
-         }
-         if (verbose) {
-            printf_tstamp(_("Found %d for: %s\n"), id_list.num_ids, name_list.name[i]);
-         }
-         /* Force all records to use the first id then delete the other ids */
-         for (int j=1; j<id_list.num_ids; j++) {
-            char ed1[50], ed2[50];
-            bsnprintf(buf, sizeof(buf), "UPDATE File SET PathId=%s WHERE PathId=%s",
-               edit_int64(id_list.Id[0], ed1), edit_int64(id_list.Id[j], ed2));
-            if (verbose > 1) {
-               printf_tstamp("%s\n", buf);
-            }
-            db_sql_query(db, buf, NULL, NULL);
-            bsnprintf(buf, sizeof(buf), "DELETE FROM Path WHERE PathId=%s", ed2);
-            if (verbose > 2) {
-               printf_tstamp("%s\n", buf);
-            }
-            db_sql_query(db, buf, NULL, NULL);
-         }
-      }
-   }
-   free_name_list(&name_list);
-}
-
-static void eliminate_orphaned_jobmedia_records()
-{
-   POOL_MEM query;
-   const char *q = "SELECT JobMedia.JobMediaId,Job.JobId FROM JobMedia "
-                "LEFT OUTER JOIN Job ON (JobMedia.JobId=Job.JobId) "
-                "WHERE Job.JobId IS NULL LIMIT %llu";
-   Mmsg(query, q, nb_changes);
 
-   printf_tstamp(_("Checking for orphaned JobMedia entries.\n"));
-   if (!make_id_list(query.c_str(), &id_list)) {
+   /*
+    * Map each duplicate PathId to the first PathId of the same name.
+    *  The table is TEMPORARY, so nothing is left in the catalog if we
+    *  are stopped, and the queries below reference it only once in a
+    *  statement because MySQL cannot do more with a temporary table.
+    */
+   db_sql_query(db, "DROP TABLE IF EXISTS dbcheck_pathmap", NULL, NULL);
+   query = "CREATE TEMPORARY TABLE dbcheck_pathmap AS "
+              "SELECT Path.PathId AS OldId, T.KeepId AS KeepId FROM Path "
+                "JOIN (SELECT Path, MIN(PathId) AS KeepId FROM Path "
+                       "GROUP BY Path HAVING count(Path) > 1) AS T "
+                  "ON (Path.Path = T.Path) "
+              "WHERE Path.PathId <> T.KeepId";
+   if (verbose > 1) {
+      printf_tstamp("%s\n", query);
+   }
+   if (!db_sql_query(db, query, NULL, NULL) ||
+       !db_sql_query(db, "CREATE INDEX dbcheck_pathmap_idx ON dbcheck_pathmap (OldId)",
+                     NULL, NULL)) {
+      printf_tstamp("%s\n", db_strerror(db));
       exit(1);
    }
-   /* Loop doing 300000 at a time */
-   while (id_list.num_ids != 0) {
-      printf_tstamp(_("Found %d orphaned JobMedia records.\n"), id_list.num_ids);
-      if (id_list.num_ids && verbose && yes_no(_("Print them? (yes/no): "))) {
-         for (int i=0; i < id_list.num_ids; i++) {
-            char ed1[50];
-            bsnprintf(buf, sizeof(buf),
-"SELECT JobMedia.JobMediaId,JobMedia.JobId,Media.VolumeName FROM JobMedia,Media "
-        "WHERE JobMedia.JobMediaId=%s AND Media.MediaId=JobMedia.MediaId",
-               edit_int64(id_list.Id[i], ed1));
-            if (!db_sql_query(db, buf, print_jobmedia_handler, NULL)) {
-               printf_tstamp("%s\n", db_strerror(db));
-            }
-         }
+
+   /*
+    * Force all File records to use the first id. We walk the File table
+    *  by chunks of nb_changes records, a single PathId can be used by
+    *  millions of File records.
+    */
+   switch (db_get_type_index(db)) {
+   case SQL_TYPE_MYSQL:
+      query = "UPDATE File JOIN dbcheck_pathmap AS M ON (M.OldId = File.PathId) "
+                 "SET File.PathId = M.KeepId "
+               "WHERE File.FileId > %s AND File.FileId <= %s";
+      break;
+   case SQL_TYPE_POSTGRESQL:
+      query = "UPDATE File SET PathId = M.KeepId FROM dbcheck_pathmap AS M "
+               "WHERE M.OldId = File.PathId "
+                 "AND File.FileId > %s AND File.FileId <= %s";
+      break;
+   default:
+      query = "UPDATE File SET PathId = "
+                 "(SELECT KeepId FROM dbcheck_pathmap WHERE OldId = File.PathId) "
+               "WHERE File.FileId > %s AND File.FileId <= %s "
+                 "AND File.PathId IN (SELECT OldId FROM dbcheck_pathmap)";
+      break;
+   }
+   max_key = get_max_key("File", "FileId");
+   while (!quit && get_next_chunk("File", "FileId", last, &next)) {
+      POOL_MEM upd;
+      Mmsg(upd, query, edit_int64(last, ed1), edit_int64(next, ed2));
+      if (verbose > 1) {
+         printf_tstamp("%s\n", upd.c_str());
       }
-      if (quit) {
-         return;
+      db_start_transaction(NULL, db);
+      if (!db_sql_query(db, upd.c_str(), NULL, NULL)) {
+         printf_tstamp("%s\n", db_strerror(db));
+         ok = false;
       }
-
-      if (fix && id_list.num_ids > 0) {
-         printf_tstamp(_("Deleting %d orphaned JobMedia records.\n"), id_list.num_ids);
-         delete_id_list("DELETE FROM JobMedia WHERE JobMediaId=%s", &id_list);
-      } else {
-         break;                       /* get out if not updating db */
+      db_end_transaction(NULL, db);
+      last = next;
+      print_chunk_progress(_("Duplicate Path records in File"), last, max_key, -1,
+                           &last_report);
+   }
+
+   /* No File record uses the other ids now, delete them */
+   if (!ok) {
+      printf_tstamp(_("Duplicate Path records are not deleted.\n"));
+   }
+   last = 0;
+   max_key = get_max_key("dbcheck_pathmap", "OldId");
+   while (ok && !quit && get_next_chunk("dbcheck_pathmap", "OldId", last, &next)) {
+      POOL_MEM del;
+      Mmsg(del, "DELETE FROM Path WHERE PathId IN (SELECT OldId FROM dbcheck_pathmap "
+                                  "WHERE OldId > %s AND OldId <= %s)",
+           edit_int64(last, ed1), edit_int64(next, ed2));
+      if (verbose > 1) {
+         printf_tstamp("%s\n", del.c_str());
       }
-      if (!make_id_list(query.c_str(), &id_list)) {
-         exit(1);
+      db_start_transaction(NULL, db);
+      if (!db_sql_query(db, del.c_str(), NULL, NULL)) {
+         printf_tstamp("%s\n", db_strerror(db));
       }
+      db_end_transaction(NULL, db);
+      last = next;
+      print_chunk_progress(_("Duplicate Path records"), last, max_key, -1, &last_report);
    }
+   db_sql_query(db, "DROP TABLE IF EXISTS dbcheck_pathmap", NULL, NULL);
 }
 
-static void eliminate_orphaned_file_records()
+static void eliminate_orphaned_jobmedia_records()
 {
-   POOL_MEM query;
-   const char *q = "SELECT File.FileId,Job.JobId FROM File "
-                "LEFT OUTER JOIN Job ON (File.JobId=Job.JobId) "
-               "WHERE Job.JobId IS NULL LIMIT %llu";
-   Mmsg(query, q, nb_changes);
+   printf_tstamp(_("Checking for orphaned JobMedia entries.\n"));
+   process_chunks(_("orphaned JobMedia records"), "JobMedia", "JobMediaId",
+      "JobMedia.JobMediaId > %s AND JobMedia.JobMediaId <= %s "
+      "AND NOT EXISTS (SELECT 1 FROM Job WHERE Job.JobId=JobMedia.JobId)",
+      "SELECT JobMedia.JobMediaId,JobMedia.JobId,Media.VolumeName FROM JobMedia "
+      "LEFT OUTER JOIN Media ON (Media.MediaId=JobMedia.MediaId) WHERE %s",
+      print_jobmedia_handler);
+}
 
+static void eliminate_orphaned_file_records()
+{
    printf_tstamp(_("Checking for orphaned File entries. This may take some time!\n"));
-   if (verbose > 1) {
-      printf_tstamp("%s\n", query.c_str());
-   }
-   if (!make_id_list(query.c_str(), &id_list)) {
-      exit(1);
-   }
-   /* Loop doing 300000 at a time */
-   while (id_list.num_ids != 0) {
-      printf_tstamp(_("Found %d orphaned File records.\n"), id_list.num_ids);
-      if (name_list.num_ids && verbose && yes_no(_("Print them? (yes/no): "))) {
-         for (int i=0; i < id_list.num_ids; i++) {
-            char ed1[50];
-            bsnprintf(buf, sizeof(buf),
-"SELECT File.FileId,File.JobId,File.Filename FROM File "
-"WHERE File.FileId=%s",
-               edit_int64(id_list.Id[i], ed1));
-            if (!db_sql_query(db, buf, print_file_handler, NULL)) {
-               printf_tstamp("%s\n", db_strerror(db));
-            }
-         }
-      }
-      if (quit) {
-         return;
-      }
-      if (fix && id_list.num_ids > 0) {
-         printf_tstamp(_("Deleting %d orphaned File records.\n"), id_list.num_ids);
-         delete_id_list("DELETE FROM File WHERE FileId=%s", &id_list);
-      } else {
-         break;                       /* get out if not updating db */
-      }
-      if (!make_id_list(query.c_str(), &id_list)) {
-         exit(1);
-      }
-   }
+   process_chunks(_("orphaned File records"), "File", "FileId",
+      "File.FileId > %s AND File.FileId <= %s "
+      "AND NOT EXISTS (SELECT 1 FROM Job WHERE Job.JobId=File.JobId)",
+      "SELECT File.FileId,File.JobId,File.Filename FROM File WHERE %s",
+      print_file_handler);
 }
 
 static void eliminate_orphaned_path_records()
@@ -826,43 +897,13 @@ static void eliminate_orphaned_path_records()
       }
    }
 
-   POOL_MEM query;
-   const char *q = "SELECT DISTINCT Path.PathId,File.PathId FROM Path "
-               "LEFT OUTER JOIN File ON (Path.PathId=File.PathId) "
-               "WHERE File.PathId IS NULL LIMIT %llu";
-   Mmsg(query, q, nb_changes);
-
    printf_tstamp(_("Checking for orphaned Path entries. This may take some time!\n"));
-   if (verbose > 1) {
-      printf_tstamp("%s\n", query.c_str());
-   }
-   if (!make_id_list(query.c_str(), &id_list)) {
-      exit(1);
-   }
-   /* Loop doing 300000 at a time */
-   while (id_list.num_ids != 0) {
-      printf_tstamp(_("Found %d orphaned Path records.\n"), id_list.num_ids);
-      if (id_list.num_ids && verbose && yes_no(_("Print them? (yes/no): "))) {
-         for (int i=0; i < id_list.num_ids; i++) {
-            char ed1[50];
-            bsnprintf(buf, sizeof(buf), "SELECT Path FROM Path WHERE PathId=%s", 
-               edit_int64(id_list.Id[i], ed1));
-            db_sql_query(db, buf, print_name_handler, NULL);
-         }
-      }
-      if (quit) {
-         return;
-      }
-      if (fix && id_list.num_ids > 0) {
-         printf_tstamp(_("Deleting %d orphaned Path records.\n"), id_list.num_ids);
-         delete_id_list("DELETE FROM Path WHERE PathId=%s", &id_list);
-      } else {
-         break;                       /* get out if not updating db */
-      }
-      if (!make_id_list(query.c_str(), &id_list)) {
-         exit(1);
-      }
-   } 
+   process_chunks(_("orphaned Path records"), "Path", "PathId",
+      "Path.PathId > %s AND Path.PathId <= %s "
+      "AND NOT EXISTS (SELECT 1 FROM File WHERE File.PathId=Path.PathId)",
+      "SELECT Path FROM Path WHERE %s",
+      print_name_handler);
+
    /* Drop temporary index idx_tmp_name */
    drop_tmp_idx("idxPIchk", "File");
 }
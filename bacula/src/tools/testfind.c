@@ -63,6 +63,7 @@ static void usage()
 "       -dt         print timestamp in debug output\n"
 "       -c          specify config file containing FileSet resources\n"
 "       -f          specify which FileSet to use\n"
+"       -p <nn>     prefetch the files <nn> directory entries ahead\n"
 "       -?          print this message.\n"
 "\n"
 "Patterns are used for file inclusion -- normally directories.\n"
@@ -84,6 +85,7 @@ main (int argc, char *const *argv)
    const char *configfile = "bacula-dir.conf";
    const char *fileset_name = "Windows-Full-Set";
    int ch, hard_links;
+   int prefetch_files = 0;
 
    OSDependentInit();
 
@@ -92,7 +94,7 @@ main (int argc, char *const *argv)
    textdomain("bacula");
    lmgr_init_thread();
 
-   while ((ch = getopt(argc, argv, "ac:d:f:?")) != -1) {
+   while ((ch = getopt(argc, argv, "ac:d:f:p:?")) != -1) {
       switch (ch) {
          case 'a':                    /* print extended attributes *debug* */
             attrs = 1;
@@ -117,6 +119,10 @@ main (int argc, char *const *argv)
             fileset_name = optarg;
             break;
 
+         case 'p':                    /* prefetch window */
+            prefetch_files = atoi(optarg);
+            break;
+
          case '?':
          default:
             usage();
@@ -157,6 +163,7 @@ main (int argc, char *const *argv)
    ff = init_find_files();
    
    copy_fileset(ff, jcr);
+   set_find_prefetch(ff, prefetch_files);
 
    find_files(jcr, ff, print_file, NULL);
 
@@ -506,7 +513,7 @@ static bool copy_fileset(FF_PKT *ff, JCR *jcr)
          }
 
          for (j=0; j<ie->name_list.size(); j++) {
-            fileset->incexe->name_list.append(bstrdup((const char *)ie->name_list.get(j)));
+            fileset->incexe->name_list.append(new_dlistString((const char *)ie->name_list.get(j)));
          }
       }
 
@@ -579,6 +586,10 @@ static void set_options(findFOPTS *fo, const char *opts)
             p++;
             break;
 #endif
+         case '4':
+            fo->flags |= FO_XXH64;
+            p++;
+            break;
          default:
             /* Automatically downgrade to SHA-1 if an unsupported
              * SHA variant is specified */
@@ -201,17 +201,19 @@
  *  12 22Jun14 - added new capabilities comm protocol with the SD
  *  13 04Feb15 - added snapshot protocol with the DIR
  *  14 06Sep17 - added send file list during restore
+ *  15 19Oct26 - added XXH64 signature (S4)
  *
  *  Community:
  * 213 04Feb15 - added snapshot protocol with the DIR
  * 214 20Mar17 - added comm line compression
  *  14 02Dec20 - Sync with Enterprise
+ *  15 19Oct26 - added XXH64 signature (S4)
  */
 
 #ifdef COMMUNITY
-#define FD_VERSION 14  /* make same as community Linux FD */
+#define FD_VERSION 15  /* make same as community Linux FD */
 #else
-#define FD_VERSION 14 /* Enterprise FD version */
+#define FD_VERSION 15 /* Enterprise FD version */
 #endif
 
 /*
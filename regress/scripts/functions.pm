@@ -37,7 +37,7 @@ our @EXPORT = qw(update_some_files create_many_files check_multiple_copies
                   stop_bacula get_resource set_maximum_concurrent_jobs get_time
                   add_attribute check_prune_list check_min_volume_size
                   init_delta update_delta check_max_backup_size comment_out
-                  create_many_files_size check_jobmedia  $plugins debug p
+                  create_many_files_size create_bench_files check_jobmedia  $plugins debug p
                   check_max_volume_size $estat $bstat $rstat $zstat $cwd $bin
                   $scripts $conf $rscripts $tmp $working $dstat extract_resource
                   $db_name $db_user $db_password $src $tmpsrc $out $CLIENT docmd
@@ -888,6 +888,62 @@ sub create_many_files_size
     print "\n";
 }
 
+# create a reproducible dataset for the benchmarks
+# Inputs: dest      destination directory
+#         nb        number of files to create
+#         min, max  size of the files, the sizes have a log-uniform
+#                   distribution, most files are small
+#         compress  percentage of each file that compresses well
+#         seed      random seed, the same seed gives the same files
+# Example:
+# perl -Mscripts::functions -e 'create_bench_files("$cwd/files", 10000, 1024, 1048576, 50, 1)'
+sub create_bench_files
+{
+    my ($dest, $nb, $min, $max, $compress, $seed) = @_;
+    $nb = $nb || 10000;
+    $min = $min || 1024;
+    $max = $max || 1048576;
+    $compress = 50 if (!defined $compress);
+    $seed = $seed || 1;
+    $max = $min if ($max < $min);
+
+    srand($seed);
+    mkdir $dest;
+
+    # Data that does not compress, the files take parts of it
+    my $random = join('', map { chr(int(rand(256))) } 1..262144);
+    my $total = 0;
+
+    # auto flush stdout for dots
+    $| = 1;
+    print "Create $nb files into $dest\n";
+    for (my $i = 0; $i < $nb; $i++) {
+        my $dir = sprintf("%s/d%04d", $dest, int($i / 1000));
+        mkdir $dir if (!($i % 1000));
+        my $size = int(exp(log($min) + rand() * (log($max) - log($min))));
+        open(FP, ">$dir/f$i") or die "$dir $!";
+        binmode(FP);
+        for (my $done = 0; $done < $size; ) {
+            my $len = $size - $done;
+            $len = 65536 if ($len > 65536);
+            my $text = int($len * $compress / 100);
+            if ($text > 0) {
+                my $line = "File $i block $done of the benchmark dataset\n";
+                print FP substr($line x (int($text / length($line)) + 1), 0, $text);
+            }
+            if ($len > $text) {
+                print FP substr($random, int(rand(262144 - 65536)), $len - $text);
+            }
+            $done += $len;
+        }
+        close(FP);
+        $total += $size;
+        print "." if (!($i % 10000));
+    }
+    print "\n";
+    return $total;
+}
+
 # create big number of dirs in a given directory
 # Inputs: dest  destination directory
 #         nb    number of dirs to create